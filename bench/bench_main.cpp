@@ -0,0 +1,453 @@
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "decimator.h"
+#include "gyro.h"
+#include "latency_trace.h"
+#include "raw_codec.h"
+#include "sample_bus.h"
+#include "sample_log.h"
+#include "sample_store.h"
+#include "sim_ism330dhcx.h"
+
+// GyroAPI configuration with both sensors batched into the FIFO, so the FIFO
+// drain has data on real hardware
+constexpr sfe_ism_profile_t kBenchProfile = []
+{
+  sfe_ism_profile_t profile = kGyroApiProfile;
+  profile.accelFifoBatch = ISM_XL_BATCH_AT_6667Hz;
+  profile.gyroFifoBatch = ISM_GY_BATCH_AT_6667Hz;
+  profile.fifoMode = ISM_STREAM_MODE;
+  return profile;
+}();
+
+// A device and the bus it sits on, a QwI2C over TwoWire in both cases; the
+// simulated one only swaps the i2c-dev calls under TwoWire (SimTwoWire)
+struct BenchTarget
+{
+  std::string name;
+  sfe_ISM330DHCX::QwIDeviceBus *bus;
+  QwDevISM330DHCX *device;
+  uint8_t address;
+};
+
+static std::filesystem::path benchFile(const char *name)
+{
+  return std::filesystem::temp_directory_path() / name;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Bus and device benchmarks, registered once per target
+
+// One WHO_AM_I read straight through TwoWire, without the SparkFun layers
+static void BM_TwoWireReadByte(benchmark::State &state, TwoWire *wire, uint8_t address)
+{
+  for (auto _ : state)
+  {
+    wire->beginTransmission(address);
+    wire->write((uint8_t)ISM330DHCX_WHO_AM_I);
+    wire->endTransmission(false);
+    wire->requestFrom(address, (uint8_t)1);
+    benchmark::DoNotOptimize(wire->read());
+  }
+}
+
+// QwI2C::readRegisterRegion() from the FIFO output registers, which wrap
+// every 7 bytes, so any length stays within valid registers. Past 32 bytes
+// QwI2C splits the read into chunks of one write and one read each.
+static void BM_ReadRegisterRegion(benchmark::State &state, BenchTarget target)
+{
+  std::vector<uint8_t> buffer(state.range(0));
+  for (auto _ : state)
+  {
+    if (target.bus->readRegisterRegion(target.address, ISM330DHCX_FIFO_DATA_OUT_TAG, buffer.data(), buffer.size()) != 0)
+    {
+      state.SkipWithError("bus read failed");
+      break;
+    }
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+// Gyro only, as the baseline GyroAPI loop used to read it
+static void BM_GetGyro(benchmark::State &state, BenchTarget target)
+{
+  sfe_ism_data_t data;
+  for (auto _ : state)
+    benchmark::DoNotOptimize(target.device->getGyro(&data));
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Temperature, gyro and accel in one burst, converted through the profile
+static void BM_BurstRead(benchmark::State &state, BenchTarget target)
+{
+  sfe_ism_raw_all_t raw;
+  sfe_ism_data_t gyro, accel;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(target.device->getRawAllSensors(&raw));
+    QwDevISM330DHCX::convertGyro<kBenchProfile>(&raw.gyro, &gyro);
+    QwDevISM330DHCX::convertAccel<kBenchProfile>(&raw.accel, &accel);
+    benchmark::DoNotOptimize(gyro);
+    benchmark::DoNotOptimize(accel);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Drains up to range(0) FIFO words per call; a sample is one gyro and one accel
+// word
+static void BM_FifoDrain(benchmark::State &state, BenchTarget target)
+{
+  std::vector<sfe_ism_fifo_word_t> words(state.range(0));
+  int64_t drained = 0;
+  for (auto _ : state)
+    drained += target.device->readFifo(words.data(), words.size());
+  state.SetItemsProcessed(drained / 2);
+  state.counters["words_per_call"] = benchmark::Counter(drained, benchmark::Counter::kAvgIterations);
+}
+
+// Everything GyroAPI does for one sample: status check, burst read, conversion,
+// sample store and CSV log
+static void BM_EndToEndSample(benchmark::State &state, BenchTarget target)
+{
+  SampleStore store(1, kSampleStoreChunks);
+  SampleLog log;
+  log.open(benchFile("ism330dhcx_bench_e2e.csv"), false);
+
+  sfe_ism_raw_all_t raw;
+  sfe_ism_data_t gyro, accel;
+  int64_t timestamp = 0;
+  for (auto _ : state)
+  {
+    if (!target.device->checkGyroStatus() || !target.device->getRawAllSensors(&raw))
+      continue;
+    QwDevISM330DHCX::convertGyro<kBenchProfile>(&raw.gyro, &gyro);
+    QwDevISM330DHCX::convertAccel<kBenchProfile>(&raw.accel, &accel);
+    SampleRecord sample = {timestamp++, gyro.xData, gyro.yData, gyro.zData,
+                           accel.xData, accel.yData, accel.zData, target.device->convertToCelsius(raw.temp)};
+    store.append(0, sample);
+    log.write(sample);
+  }
+  state.SetItemsProcessed(timestamp);
+
+  log.close();
+  std::filesystem::remove(benchFile("ism330dhcx_bench_e2e.csv"));
+}
+
+static void registerTarget(const BenchTarget &target)
+{
+  const std::string prefix = target.name + "/";
+
+  benchmark::RegisterBenchmark((prefix + "ReadRegisterRegion").c_str(), BM_ReadRegisterRegion, target)
+      ->RangeMultiplier(2)
+      ->Range(1, 512);
+  benchmark::RegisterBenchmark((prefix + "GetGyro").c_str(), BM_GetGyro, target);
+  benchmark::RegisterBenchmark((prefix + "BurstRead").c_str(), BM_BurstRead, target);
+  benchmark::RegisterBenchmark((prefix + "FifoDrain").c_str(), BM_FifoDrain, target)
+      ->RangeMultiplier(4)
+      ->Range(2, 512);
+  benchmark::RegisterBenchmark((prefix + "EndToEndSample").c_str(), BM_EndToEndSample, target);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Statically bound data path, against the simulated device only. Compare
+// with the type-erased sim/BurstRead and sim/FifoDrain, which run on the
+// same QwI2C and SimTwoWire.
+
+using BoundSimDevice = QwDevISM330DHCXBound<sfe_ISM330DHCX::QwI2C>;
+
+static void BM_BoundBurstRead(benchmark::State &state, BoundSimDevice *device)
+{
+  sfe_ism_raw_all_t raw;
+  sfe_ism_data_t gyro, accel;
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(device->getRawAllSensors(&raw));
+    QwDevISM330DHCX::convertGyro<kBenchProfile>(&raw.gyro, &gyro);
+    QwDevISM330DHCX::convertAccel<kBenchProfile>(&raw.accel, &accel);
+    benchmark::DoNotOptimize(gyro);
+    benchmark::DoNotOptimize(accel);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_BoundFifoDrain(benchmark::State &state, BoundSimDevice *device)
+{
+  std::vector<sfe_ism_fifo_word_t> words(state.range(0));
+  int64_t drained = 0;
+  for (auto _ : state)
+    drained += device->readFifo(words.data(), words.size());
+  state.SetItemsProcessed(drained / 2);
+  state.counters["words_per_call"] = benchmark::Counter(drained, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_BoundStatusPoll(benchmark::State &state, BoundSimDevice *device)
+{
+  for (auto _ : state)
+    benchmark::DoNotOptimize(device->checkGyroStatus());
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_StatusPoll(benchmark::State &state, QwDevISM330DHCX *device)
+{
+  for (auto _ : state)
+    benchmark::DoNotOptimize(device->checkGyroStatus());
+  state.SetItemsProcessed(state.iterations());
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Host-only benchmarks
+
+static std::vector<sfe_ism_raw_data_t> rawSamples()
+{
+  std::vector<sfe_ism_raw_data_t> raw(1024);
+  for (size_t i = 0; i < raw.size(); i++)
+    raw[i] = {(int16_t)(i * 37), (int16_t)(i * -11), (int16_t)(i * 5)};
+  return raw;
+}
+
+// Conversion through the runtime full scale switch of getGyro()
+static void BM_ConvertRuntime(benchmark::State &state)
+{
+  std::vector<sfe_ism_raw_data_t> raw = rawSamples();
+  std::vector<sfe_ism_data_t> out(raw.size());
+  QwDevISM330DHCX device;
+  for (auto _ : state)
+  {
+    for (size_t i = 0; i < raw.size(); i++)
+    {
+      out[i].xData = device.convert250dpsToMdps(raw[i].xData);
+      out[i].yData = device.convert250dpsToMdps(raw[i].yData);
+      out[i].zData = device.convert250dpsToMdps(raw[i].zData);
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * raw.size());
+}
+BENCHMARK(BM_ConvertRuntime)->Name("host/ConvertRuntime");
+
+// Conversion with the sensitivity fixed by the compile-time profile
+static void BM_ConvertProfile(benchmark::State &state)
+{
+  std::vector<sfe_ism_raw_data_t> raw = rawSamples();
+  std::vector<sfe_ism_data_t> out(raw.size());
+  for (auto _ : state)
+  {
+    for (size_t i = 0; i < raw.size(); i++)
+      QwDevISM330DHCX::convertGyro<kBenchProfile>(&raw[i], &out[i]);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * raw.size());
+}
+BENCHMARK(BM_ConvertProfile)->Name("host/ConvertProfile");
+
+static SampleRecord benchSample(int64_t timestamp)
+{
+  return {timestamp, 123.25f, -45.5f, 6.125f, 12.0f, -20.0f, 1000.0f, 25.0f, 1.0f, 0.0f, 0.0f, 0.0f};
+}
+
+static void BM_SampleLogWrite(benchmark::State &state)
+{
+  std::filesystem::path path = benchFile("ism330dhcx_bench_log.csv");
+  SampleLog log;
+  log.open(path, state.range(0) != 0, (LogFileMode)state.range(1));
+  int64_t timestamp = 0;
+  for (auto _ : state)
+    log.write(benchSample(timestamp++));
+  state.SetItemsProcessed(state.iterations());
+  log.close();
+  std::filesystem::remove(path);
+}
+// mode: 0 buffered, 1 mapped, 2 direct (see LogFileMode)
+BENCHMARK(BM_SampleLogWrite)
+    ->Name("host/SampleLogWrite")
+    ->ArgNames({"orientation", "mode"})
+    ->ArgsProduct({{0, 1}, {0, 1, 2}});
+
+static void BM_SampleStoreAppend(benchmark::State &state)
+{
+  SampleStore store(1, kSampleStoreChunks);
+  int64_t timestamp = 0;
+  for (auto _ : state)
+    store.append(0, benchSample(timestamp++));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SampleStoreAppend)->Name("host/SampleStoreAppend");
+
+static void BM_SampleBusPublish(benchmark::State &state)
+{
+  SampleBus bus;
+  if (!bus.create("/ism330dhcx_bench", 1, 8192))
+  {
+    state.SkipWithError("could not create the sample bus");
+    return;
+  }
+  int64_t timestamp = 0;
+  for (auto _ : state)
+    bus.publish(0, benchSample(timestamp++));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SampleBusPublish)->Name("host/SampleBusPublish");
+
+// One block of gyro samples at rest: a slow drift plus a few LSB of noise
+static std::vector<sfe_ism_raw_data_t> benchRawBlock()
+{
+  std::vector<sfe_ism_raw_data_t> samples;
+  uint32_t seed = 1;
+  for (size_t i = 0; i < raw_codec::kBlockSamples; i++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    int16_t n = (int16_t)((seed >> 24) % 9) - 4;
+    samples.push_back({(int16_t)(100 + i / 8 + n), (int16_t)(-40 + n), (int16_t)(12 - n)});
+  }
+  return samples;
+}
+
+static void BM_RawEncode(benchmark::State &state)
+{
+  std::vector<sfe_ism_raw_data_t> samples = benchRawBlock();
+  std::vector<uint8_t> out(raw_codec::maxBlockSize(samples.size()));
+  size_t size = 0;
+  for (auto _ : state)
+  {
+    size = raw_codec::encodeBlock(samples.data(), samples.size(), out.data());
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * samples.size());
+  state.counters["ratio"] = (double)(samples.size() * sizeof(sfe_ism_raw_data_t)) / size;
+}
+BENCHMARK(BM_RawEncode)->Name("host/RawEncode");
+
+static void BM_RawDecode(benchmark::State &state)
+{
+  std::vector<sfe_ism_raw_data_t> samples = benchRawBlock();
+  std::vector<uint8_t> encoded;
+  raw_codec::encode(samples.data(), samples.size(), &encoded);
+  sfe_ism_raw_data_t block[raw_codec::kBlockSamples];
+  size_t count;
+  for (auto _ : state)
+  {
+    raw_codec::decodeBlock(encoded.data(), encoded.size(), block, &count);
+    benchmark::DoNotOptimize(block);
+  }
+  state.SetItemsProcessed(state.iterations() * samples.size());
+}
+BENCHMARK(BM_RawDecode)->Name("host/RawDecode");
+
+// 6667Hz in, about 100Hz out: the per-sample cost of one decimated output
+static void BM_Decimate(benchmark::State &state)
+{
+  Decimator decimator(66);
+  SampleRecord in = {0, 1, 2, 3, 4, 5, 1000, 25}, out;
+  for (auto _ : state)
+  {
+    in.gx += 0.5f;
+    if (decimator.push(in, &out))
+      benchmark::DoNotOptimize(out);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["taps"] = (double)decimator.taps();
+}
+BENCHMARK(BM_Decimate)->Name("host/Decimate");
+
+// Cost of one timed scope when ISM_LATENCY_TRACE is enabled
+static void BM_LatencyTraceScope(benchmark::State &state)
+{
+  for (auto _ : state)
+  {
+    latency_trace::Scope scope(TraceOp::Conversion);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LatencyTraceScope)->Name("host/LatencyTraceScope");
+
+//////////////////////////////////////////////////////////////////////////////
+// main()
+//
+// Besides the Google Benchmark flags (--benchmark_format=json,
+// --benchmark_out=<file>, --benchmark_filter=<regex>, ...) accepts:
+//
+//  Parameter          Description
+//  ---------          -----------------------------
+//  --i2c=<path>       I2C adapter of the real device, default /dev/i2c-16
+//  --address=<addr>   I2C address of the real device, default 0x6b
+//
+// Simulated ("sim/") and host ("host/") benchmarks always run, hardware ("hw/")
+// benchmarks only when a device answers at the given address.
+
+int main(int argc, char **argv)
+{
+  std::string i2c_path = "/dev/i2c-16";
+  uint8_t address = ISM330DHCX_ADDRESS_HIGH;
+
+  int kept = 1;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strncmp(argv[i], "--i2c=", 6) == 0)
+      i2c_path = argv[i] + 6;
+    else if (std::strncmp(argv[i], "--address=", 10) == 0)
+      address = (uint8_t)std::strtoul(argv[i] + 10, nullptr, 0);
+    else
+      argv[kept++] = argv[i];
+  }
+  argc = kept;
+
+  SimISM330DHCX sim;
+  SimTwoWire simWire(sim);
+  sfe_ISM330DHCX::QwI2C simBus;
+  simWire.begin();
+  simBus.init(simWire);
+  QwDevISM330DHCX simDevice;
+  simDevice.setCommunicationBus(simBus, ISM330DHCX_ADDRESS_HIGH);
+  if (!simDevice.init() || !simDevice.applyProfile<kBenchProfile>())
+  {
+    std::cerr << "Simulated device failed to start" << std::endl;
+    return 1;
+  }
+  benchmark::RegisterBenchmark("sim/TwoWireReadByte", BM_TwoWireReadByte, &simWire, ISM330DHCX_ADDRESS_HIGH);
+  registerTarget({"sim", &simBus, &simDevice, ISM330DHCX_ADDRESS_HIGH});
+
+  BoundSimDevice boundDevice;
+  boundDevice.setCommunicationBus(simBus, ISM330DHCX_ADDRESS_HIGH);
+  boundDevice.init();
+  benchmark::RegisterBenchmark("sim/StatusPoll", BM_StatusPoll, &simDevice);
+  benchmark::RegisterBenchmark("sim/BoundStatusPoll", BM_BoundStatusPoll, &boundDevice);
+  benchmark::RegisterBenchmark("sim/BoundBurstRead", BM_BoundBurstRead, &boundDevice);
+  benchmark::RegisterBenchmark("sim/BoundFifoDrain", BM_BoundFifoDrain, &boundDevice)
+      ->RangeMultiplier(4)
+      ->Range(2, 512);
+
+  TwoWire wire(i2c_path.c_str());
+  sfe_ISM330DHCX::QwI2C hwBus;
+  QwDevISM330DHCX hwDevice;
+  if (std::filesystem::exists(i2c_path))
+  {
+    wire.begin();
+    hwBus.init(wire);
+    hwDevice.setCommunicationBus(hwBus, address);
+    if (hwDevice.init() && hwDevice.applyProfile<kBenchProfile>())
+    {
+      benchmark::RegisterBenchmark("hw/TwoWireReadByte", BM_TwoWireReadByte, &wire, address);
+      registerTarget({"hw", &hwBus, &hwDevice, address});
+    }
+    else
+      std::cerr << "No ISM330DHCX at 0x" << std::hex << (int)address << std::dec << " on " << i2c_path
+                << ", skipping hardware benchmarks" << std::endl;
+  }
+  else
+    std::cerr << i2c_path << " not found, skipping hardware benchmarks" << std::endl;
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
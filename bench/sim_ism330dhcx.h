@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstring>
+#include "Wire.h"
+#include "sfe_ism330dhcx.h"
+
+///////////////////////////////////////////////////////////////////////
+// SimISM330DHCX
+//
+// Register-level stand-in for an ISM330DHCX behind a QwIDeviceBus. Data is
+// always ready, the output registers change on every read and the FIFO always
+// holds fifoLevel words, so the benchmarks measure the cost of the software
+// stack without bus time. The benchmarks reach it through SimTwoWire, so
+// that QwI2C and TwoWire run as they do against hardware.
+
+class SimISM330DHCX : public sfe_ISM330DHCX::QwIDeviceBus
+{
+public:
+    explicit SimISM330DHCX(uint16_t fifoLevel = 512) : m_fifo_level(fifoLevel) { softwareReset(); }
+
+    bool ping(uint8_t address) { return true; }
+
+    bool writeRegisterByte(uint8_t address, uint8_t offset, uint8_t data)
+    {
+        return writeRegisterRegion(address, offset, &data, 1) == 0;
+    }
+
+    int writeRegisterRegion(uint8_t address, uint8_t offset, const uint8_t *data, uint16_t length)
+    {
+        for (uint16_t i = 0; i < length; i++)
+            m_regs[(uint8_t)(offset + i)] = data[i];
+        if (m_regs[ISM330DHCX_CTRL3_C] & 0x01)
+            softwareReset();
+        return 0;
+    }
+
+    int readRegisterRegion(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t numBytes)
+    {
+        // FIFO output registers wrap from FIFO_DATA_OUT_Z_H to FIFO_DATA_OUT_TAG
+        if (reg >= ISM330DHCX_FIFO_DATA_OUT_TAG)
+        {
+            for (uint16_t i = 0; i < numBytes; i++)
+            {
+                uint16_t byte = (reg - ISM330DHCX_FIFO_DATA_OUT_TAG + i) % 7;
+                if (byte == 0)
+                    m_fifo_word++;
+                data[i] = byte == 0 ? (uint8_t)(((m_fifo_word & 1) ? ISM330DHCX_GYRO_NC_TAG : ISM330DHCX_XL_NC_TAG) << 3)
+                                    : (uint8_t)(m_fifo_word + byte);
+            }
+            return 0;
+        }
+
+        m_sample++;
+        for (uint8_t r = ISM330DHCX_OUT_TEMP_L; r <= ISM330DHCX_OUTZ_H_A; r++)
+            m_regs[r] = (uint8_t)(m_sample + r);
+        m_regs[ISM330DHCX_FIFO_STATUS1] = (uint8_t)m_fifo_level;
+        m_regs[ISM330DHCX_FIFO_STATUS2] = (uint8_t)((m_fifo_level >> 8) & 0x03);
+
+        for (uint16_t i = 0; i < numBytes; i++)
+            data[i] = m_regs[(uint8_t)(reg + i)];
+        return 0;
+    }
+
+    void softwareReset()
+    {
+        std::memset(m_regs, 0, sizeof(m_regs));
+        for (size_t i = 0; i < sfe_ism_profile::kImageLength; i++)
+            m_regs[sfe_ism_profile::kImageRegs[i]] = sfe_ism_profile::kResetImage[i];
+        m_regs[ISM330DHCX_WHO_AM_I] = ISM330DHCX_ID;
+        m_regs[ISM330DHCX_STATUS_REG] = 0x07; // XLDA, GDA, TDA
+    }
+
+private:
+    uint8_t m_regs[256];
+    uint16_t m_fifo_level;
+    uint32_t m_fifo_word = 0;
+    uint8_t m_sample = 0;
+};
+
+///////////////////////////////////////////////////////////////////////
+// SimTwoWire
+//
+// TwoWire whose i2c-dev calls are answered by a SimISM330DHCX, as the device
+// answers i2c-dev transfers: a write sets the register pointer (and writes
+// any bytes after it), and a read continues from the pointer, which
+// auto-increments and wraps within the FIFO output registers.
+
+class SimTwoWire : public TwoWire
+{
+public:
+    explicit SimTwoWire(SimISM330DHCX &device) : TwoWire("sim"), m_device(device) {}
+    ~SimTwoWire() override { end(); }
+
+protected:
+    int openDevice(const char *) override { return 0; }
+    void closeDevice(int) override {}
+
+    int selectDevice(int, uint8_t address) override
+    {
+        m_address = address;
+        return 0;
+    }
+
+    ssize_t writeDevice(int, const uint8_t *data, size_t length) override
+    {
+        // An empty write (QwI2C between read chunks) leaves the pointer
+        if (length == 0)
+            return 0;
+        if (length > 1)
+            m_device.writeRegisterRegion(m_address, data[0], data + 1, (uint16_t)(length - 1));
+        m_pointer = (uint8_t)(data[0] + length - 1);
+        return (ssize_t)length;
+    }
+
+    ssize_t readDevice(int, uint8_t *data, size_t length) override
+    {
+        m_device.readRegisterRegion(m_address, m_pointer, data, (uint16_t)length);
+        if (m_pointer >= ISM330DHCX_FIFO_DATA_OUT_TAG)
+            m_pointer = (uint8_t)(ISM330DHCX_FIFO_DATA_OUT_TAG + (m_pointer - ISM330DHCX_FIFO_DATA_OUT_TAG + length) % 7);
+        else
+            m_pointer = (uint8_t)(m_pointer + length);
+        return (ssize_t)length;
+    }
+
+private:
+    SimISM330DHCX &m_device;
+    uint8_t m_address = 0;
+    uint8_t m_pointer = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////
+// ActivityMonitor
+//
+// Host side of the device's inactivity function (see
+// QwDevISM330DHCX::setActivityMode()). It schedules reads of the sleep
+// state: every active_check_ns while the device is awake, alongside the
+// data polls, and every sleep_check_ns while it is asleep, when the data
+// polls stop. Waking is therefore noticed within sleep_check_ns, and nothing
+// else touches the bus while the device is motionless.
+//
+// All times are in nanoseconds on one monotonic clock.
+
+class ActivityMonitor
+{
+public:
+    // 50ms awake; 80ms asleep, one sample of the accelerometer at 12.5Hz
+    static constexpr int64_t kActiveCheck = 50000000;
+    static constexpr int64_t kSleepCheck = 80000000;
+
+    explicit ActivityMonitor(int64_t active_check_ns = kActiveCheck, int64_t sleep_check_ns = kSleepCheck)
+        : m_active_check(active_check_ns), m_sleep_check(sleep_check_ns)
+    {
+    }
+
+    // Earliest time worth reading the sleep state again
+    int64_t nextCheck() const { return m_next_check; }
+
+    // Sleep state read at time t. Returns true if it changed.
+    bool observe(int64_t t, bool asleep);
+
+    bool asleep() const { return m_asleep; }
+    uint64_t wakeUps() const { return m_wake_ups; }
+
+    // Total time spent asleep up to t
+    int64_t sleepTime(int64_t t) const { return m_sleep_time + (m_asleep ? t - m_sleep_start : 0); }
+
+private:
+    int64_t m_active_check, m_sleep_check;
+    int64_t m_next_check = 0;
+    bool m_asleep = false;
+    int64_t m_sleep_start = 0, m_sleep_time = 0;
+    uint64_t m_wake_ups = 0;
+};
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "sfe_ism330dhcx.h"
+
+// C++20 coroutine API for keeping transfers to many sensors on many buses in
+// flight from a single thread:
+//
+//   EventLoop loop;
+//   AsyncBus bus0(loop, i2c0), bus1(loop, i2c1);
+//   AsyncISM330DHCX a(bus0, 0x6a), b(bus1, 0x6b);
+//   loop.spawn(follow(a));   // Task<void> follow(AsyncISM330DHCX &dev)
+//   loop.spawn(follow(b));   // { sfe_ism_data_t g; co_await dev.readGyroAsync(&g); ... }
+//   loop.run();
+//
+// Linux i2c-dev has no asynchronous interface (no poll support, and io_uring
+// would only hand the blocking read()/write() to a kernel worker), so each
+// AsyncBus owns one worker thread that runs its transfers in order. The event
+// loop thread only resumes coroutines: completions are queued and signalled
+// through an eventfd it waits on with epoll. Buses therefore overlap, while
+// transfers on one bus stay serialised as the bus requires.
+
+template <typename T = void> class Task;
+
+namespace async_detail
+{
+template <typename T> struct PromiseResult
+{
+    std::optional<T> value;
+    void return_value(T v) { value = std::move(v); }
+    T result() { return std::move(*value); }
+};
+
+template <> struct PromiseResult<void>
+{
+    void return_void() {}
+    void result() {}
+};
+} // namespace async_detail
+
+///////////////////////////////////////////////////////////////////////
+// Task
+//
+// Lazily started coroutine returning T. Awaiting it starts it and resumes the
+// awaiting coroutine once it has finished.
+
+template <typename T> class Task
+{
+public:
+    struct promise_type : async_detail::PromiseResult<T>
+    {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    Task(Task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_handle)
+                m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+    ~Task()
+    {
+        if (m_handle)
+            m_handle.destroy();
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    bool await_ready() const { return !m_handle || m_handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+    {
+        m_handle.promise().continuation = awaiting;
+        return m_handle;
+    }
+
+    T await_resume()
+    {
+        if (m_handle.promise().exception)
+            std::rethrow_exception(m_handle.promise().exception);
+        return m_handle.promise().result();
+    }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+///////////////////////////////////////////////////////////////////////
+// EventLoop
+//
+// Resumes coroutines on the thread that calls run(). Other threads hand
+// coroutines back with post().
+
+class EventLoop
+{
+public:
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // Takes ownership of task and starts it from run()
+    void spawn(Task<void> task);
+
+    // Resumes coroutines until every spawned task has finished
+    void run();
+
+    // Thread safe: queue handle to be resumed on the loop thread
+    void post(std::coroutine_handle<> handle);
+
+private:
+    struct Detached;
+    static Detached detach(EventLoop *loop, Task<void> task);
+
+    int m_epoll_fd = -1;
+    int m_event_fd = -1;
+
+    std::mutex m_mutex;
+    std::vector<std::coroutine_handle<>> m_ready;
+    size_t m_pending = 0; // loop thread only
+};
+
+///////////////////////////////////////////////////////////////////////
+// AsyncBus
+//
+// Runs register transfers of one bus on a worker thread, in submission order.
+// While an AsyncBus exists, the bus must not be used synchronously.
+
+class AsyncBus
+{
+public:
+    struct Transfer
+    {
+        bool write;
+        uint8_t address;
+        uint8_t reg;
+        uint8_t *data;
+        uint16_t length;
+        int result;
+        std::coroutine_handle<> handle;
+    };
+
+    // co_await yields the bus result: 0 on success, -1 on error
+    class TransferAwaiter
+    {
+    public:
+        TransferAwaiter(AsyncBus *bus, Transfer transfer) : m_bus(bus), m_transfer(transfer) {}
+
+        bool await_ready() const { return false; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            m_transfer.handle = handle;
+            m_bus->submit(&m_transfer);
+        }
+        int await_resume() const { return m_transfer.result; }
+
+    private:
+        AsyncBus *m_bus;
+        Transfer m_transfer;
+    };
+
+    AsyncBus(EventLoop &loop, sfe_ISM330DHCX::QwIDeviceBus &bus);
+    ~AsyncBus();
+
+    AsyncBus(const AsyncBus &) = delete;
+    AsyncBus &operator=(const AsyncBus &) = delete;
+
+    TransferAwaiter read(uint8_t address, uint8_t reg, uint8_t *data, uint16_t length)
+    {
+        return TransferAwaiter(this, {false, address, reg, data, length, -1, {}});
+    }
+
+    // data must stay valid until the transfer completes
+    TransferAwaiter write(uint8_t address, uint8_t reg, const uint8_t *data, uint16_t length)
+    {
+        return TransferAwaiter(this, {true, address, reg, const_cast<uint8_t *>(data), length, -1, {}});
+    }
+
+private:
+    void submit(Transfer *transfer);
+    void worker();
+
+    EventLoop &m_loop;
+    sfe_ISM330DHCX::QwIDeviceBus &m_bus;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Transfer *> m_queue;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+///////////////////////////////////////////////////////////////////////
+// AsyncISM330DHCX
+//
+// Data path of an ISM330DHCX as coroutines. Configure the device with the
+// blocking QwDevISM330DHCX API first; the full scales given here must match
+// that configuration.
+
+class AsyncISM330DHCX
+{
+public:
+    AsyncISM330DHCX(AsyncBus &bus, uint8_t address, uint8_t gyroFullScale = ISM_250dps,
+                    uint8_t accelFullScale = ISM_2g);
+
+    uint8_t address() const { return m_address; }
+
+    // Gyro data ready flag (STATUS_REG GDA)
+    Task<bool> gyroReadyAsync();
+
+    Task<bool> readGyroAsync(sfe_ism_data_t *gyroData);
+    Task<bool> readAccelAsync(sfe_ism_data_t *accelData);
+
+    // Temperature, gyro and accel in one burst, see getRawAllSensors()
+    Task<bool> readRawAllAsync(sfe_ism_raw_all_t *allData);
+
+    // Number of words drained, see readFifo()
+    Task<uint16_t> readFifoAsync(sfe_ism_fifo_word_t *words, uint16_t maxWords);
+
+private:
+    Task<bool> readVector(uint8_t reg, float sensitivity, sfe_ism_data_t *data);
+
+    AsyncBus &m_bus;
+    uint8_t m_address;
+    float m_gyro_sensitivity;
+    float m_accel_sensitivity;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "sample_store.h"
+
+///////////////////////////////////////////////////////////////////////
+// StillPeriod
+//
+// Running mean and variance (Welford) of the samples collected while a device
+// is expected to be at rest.
+
+class StillPeriod
+{
+public:
+    void reset();
+    void add(const SampleRecord &sample);
+
+    size_t count() const { return m_count; }
+
+    // Means of gyro (mdps), accel (mg) and temperature (degC)
+    void mean(float gyro[3], float accel[3], float *temp) const;
+
+    // Largest gyro standard deviation over the three axes, in mdps
+    float gyroStdDev() const;
+
+private:
+    size_t m_count = 0;
+    double m_mean[7] = {};
+    double m_m2[3] = {};
+};
+
+///////////////////////////////////////////////////////////////////////
+// DeviceCalibration
+//
+// Persisted calibration of one device, stored as calibration_<bus>_0xNN.txt
+// keyed by its adapter and I2C address: every CH341 adapter usually carries a
+// device at both 0x6a and 0x6b, so the address alone is not unique.
+//
+// The gyro bias is modelled as bias(T) = bias + slope * (T - reference_temp)
+// per axis. The turn-on bias changes from run to run, so bias and
+// reference_temp are those of the latest still period. Every still period
+// also adds its (temperature, bias) observation to running regression sums,
+// which only serve the temperature slope: it becomes observable once the
+// device has been calibrated at different temperatures.
+//
+// Accelerometer offsets are not corrected on the host: they are written to the
+// device's user offset registers.
+
+struct DeviceCalibration
+{
+    uint8_t address = 0;
+
+    float reference_temp = 25.0f;
+    float bias[3] = {0.0f, 0.0f, 0.0f};  // mdps
+    float slope[3] = {0.0f, 0.0f, 0.0f}; // mdps/degC
+
+    double n = 0, sum_t = 0, sum_tt = 0;
+    double sum_b[3] = {0, 0, 0};
+    double sum_tb[3] = {0, 0, 0};
+
+    int8_t accel_offset[3] = {0, 0, 0};
+    bool accel_coarse = false;
+
+    // Anchors the model at this still period and adds it to the history
+    void addObservation(float temp, const float gyro_bias[3]);
+    // Temperature slope from the history
+    void fit();
+
+    // Offsets for a mount with one axis aligned to gravity, from the mean accel
+    // (mg) measured with the user offsets cleared.
+    void computeAccelOffset(const float mean_accel[3]);
+
+    bool load(const std::filesystem::path &path);
+    bool save(const std::filesystem::path &path) const;
+
+    // bus is the adapter path, e.g. /dev/i2c-16 gives calibration_dev_i2c_16_0x6a.txt
+    static std::filesystem::path pathFor(const std::filesystem::path &directory, const std::string &bus,
+                                         uint8_t address);
+};
+
+///////////////////////////////////////////////////////////////////////
+// GyroCalibration
+//
+// Applies the gyro bias models of all devices to a sweep of samples in one
+// branch-free pass. Coefficients are kept per column across devices.
+
+class GyroCalibration
+{
+public:
+    void resize(size_t num_devices);
+    void setModel(size_t device, const DeviceCalibration &calibration);
+
+    // Corrects sweep[i] for every i with acquired[i] != 0
+    void apply(std::vector<SampleRecord> &sweep, const std::vector<uint8_t> &acquired) const;
+
+private:
+    std::vector<float> m_t0;
+    std::vector<float> m_bias_x, m_bias_y, m_bias_z;
+    std::vector<float> m_slope_x, m_slope_y, m_slope_z;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "sample_store.h"
+#include "fixed_ring.h"
+
+///////////////////////////////////////////////////////////////////////
+// DeviceClock
+//
+// Maps a device's time stamp counter onto the host clock. The counters of
+// all devices are reset together, which fixes each device's offset; the
+// rate starts from the factory calibration (INTERNAL_FREQ_FINE) and is then
+// tracked from pairs of (counter of a sample, host time it was read).
+//
+// The host time of a read trails the sample by a varying bus latency, so
+// the rate is fitted to the lower envelope of the pairs: the smallest
+// residual of every kBlockTicks long block, over the last kMaxBlocks
+// blocks. Latency never makes a read early, so the envelope follows the
+// oscillator and not the bus.
+
+class DeviceClock
+{
+public:
+    static constexpr double kNominalTickNs = 25000.0;
+    static constexpr uint64_t kBlockTicks = 40000; // 1s
+    static constexpr size_t kMaxBlocks = 120;
+
+    DeviceClock() { m_blocks.reset(kMaxBlocks); }
+
+    // The counter was reset at host time host_ns. fine is the device's
+    // INTERNAL_FREQ_FINE.
+    void reset(int64_t host_ns, int8_t fine = 0);
+
+    // Extends a 32-bit counter value to 64 bits; call in counter order
+    uint64_t unwrap(uint32_t ticks);
+
+    // A sample with (unwrapped) counter value ticks was read at host_ns
+    void observe(uint64_t ticks, int64_t host_ns);
+
+    int64_t toHost(uint64_t ticks) const { return m_anchor + (int64_t)(ticks * m_tick_ns); }
+
+    // Current estimate of one count, and its deviation from the factory
+    // calibrated value
+    double tickNs() const { return m_tick_ns; }
+    double skewPpm() const { return (m_tick_ns / m_nominal_tick_ns - 1.0) * 1e6; }
+
+private:
+    struct Block
+    {
+        uint64_t ticks;
+        double residual;
+    };
+
+    int64_t m_anchor = 0;
+    double m_nominal_tick_ns = kNominalTickNs, m_tick_ns = kNominalTickNs;
+    uint64_t m_unwrapped = 0;
+
+    uint64_t m_block = 0;
+    bool m_block_open = false;
+    Block m_current = {};
+    FixedRing<Block> m_blocks; // The last kMaxBlocks
+};
+
+// Samples of all devices at one instant of the common time base
+struct SyncFrame
+{
+    int64_t timestamp;                 // us, a multiple of the frame period
+    std::vector<SampleRecord> samples; // One per device, interpolated to timestamp
+    std::vector<uint8_t> valid;        // 0 where a device had no samples around timestamp
+};
+
+using SyncFrameSink = std::function<void(const SyncFrame &frame)>;
+
+///////////////////////////////////////////////////////////////////////
+// StreamAligner
+//
+// Resamples the streams of several devices onto one time grid and joins
+// them into SyncFrames. Each stream is linearly interpolated (the
+// quaternion normalised-linearly) at the grid times, so the samples of a
+// frame describe the same instant however the devices' own sample grids
+// are offset or drift. A frame is emitted once every active device has a
+// sample at or after its time. A device is marked invalid in a frame when
+// its samples around the frame time are more than max_gap_us apart (missed
+// samples; one frame period by default), when it is inactive (offline or
+// asleep, see setActive()), or when it falls more than kMaxQueue samples
+// behind the others, which it then no longer holds back.
+
+class StreamAligner
+{
+public:
+    static constexpr size_t kMaxQueue = 4096;
+
+    StreamAligner(size_t num_devices = 0, double period_us = 0.0, SyncFrameSink sink = {}, double max_gap_us = 0.0);
+
+    // Timestamps of a device must increase
+    void push(size_t device, const SampleRecord &sample);
+
+    // An inactive device holds no frames back and is invalid in them; its
+    // queued samples are dropped, as are any pushed until it is active
+    // again. Devices start active.
+    void setActive(size_t device, bool active);
+
+    uint64_t frames() const { return m_frames; }
+
+private:
+    void emit();
+
+    double m_period, m_max_gap;
+    SyncFrameSink m_sink;
+    std::vector<FixedRing<SampleRecord>> m_queues; // kMaxQueue + 1 each, allocated up front
+    std::vector<uint8_t> m_active;
+    bool m_started = false;
+    int64_t m_next = 0; // Grid index of the next frame
+    SyncFrame m_frame;
+    uint64_t m_frames = 0;
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include "sample_store.h"
+
+///////////////////////////////////////////////////////////////////////
+// fir
+//
+// Linear-phase low-pass filters by the Kaiser window method. Frequencies
+// are fractions of the input sample rate (0 .. 0.5).
+
+namespace fir
+{
+// Passband up to pass, at least attenuation_db down from stop on. Odd
+// length, unity gain at DC.
+std::vector<float> kaiserLowpass(double pass, double stop, double attenuation_db);
+
+// Anti-aliasing filter for decimating by factor: flat to 60% of the output
+// Nyquist frequency, attenuation_db down at and above it. A single tap of 1
+// for factor 1.
+std::vector<float> decimationFilter(unsigned factor, double attenuation_db = 60.0);
+} // namespace fir
+
+///////////////////////////////////////////////////////////////////////
+// Decimator
+//
+// Low-pass filters and downsamples one device's stream by an integer factor.
+// As a polyphase decimator it evaluates the filter only for the samples it
+// keeps, one in factor; the others just enter the history. The seven data
+// channels (gyro, accel, temperature) are interleaved and padded to eight,
+// so the filter loop runs over all channels per tap in one SIMD-wide step.
+//
+// The quaternion is not filtered but taken from the input sample at the
+// filter's group delay, together with its timestamp, so an output describes
+// one instant consistently.
+
+class Decimator
+{
+public:
+    static constexpr size_t kChannels = 8; // gx gy gz ax ay az temp, padding
+
+    Decimator(unsigned factor, std::vector<float> taps);
+    explicit Decimator(unsigned factor) : Decimator(factor, fir::decimationFilter(factor)) {}
+
+    // Returns true and fills out when this input completes an output sample.
+    // The first input fills the history, so there is no start-up transient.
+    bool push(const SampleRecord &in, SampleRecord *out);
+    void reset();
+
+    unsigned factor() const { return m_factor; }
+    size_t taps() const { return m_taps.size(); }
+
+    // Delay of the outputs behind the input, in input samples
+    size_t delay() const { return m_taps.size() / 2; }
+
+private:
+    unsigned m_factor;
+    std::vector<float> m_taps;
+
+    // Input frames, stored twice so the last taps() of them are always
+    // contiguous from m_history[m_pos * kChannels]
+    std::vector<float> m_history;
+    size_t m_pos = 0;
+    std::vector<SampleRecord> m_delayed; // Last delay() + 1 inputs
+    size_t m_count = 0;
+};
+
+// Receives the output samples of one rate
+using DecimatedSink = std::function<void(size_t device, const SampleRecord &sample)>;
+
+///////////////////////////////////////////////////////////////////////
+// MultiRatePipeline
+//
+// Fans one full-rate stream per device out to several outputs at lower
+// rates, each with its own anti-aliasing filter and sink. Sinks are called
+// from push(), i.e. on the acquisition thread, and should hand the sample
+// off rather than block.
+
+class MultiRatePipeline
+{
+public:
+    explicit MultiRatePipeline(size_t num_devices = 0) : m_num_devices(num_devices) {}
+
+    // Keeps the outputs, resetting their filters
+    void resize(size_t num_devices);
+
+    // Adds an output at the input rate divided by factor and returns its index
+    size_t addOutput(unsigned factor, DecimatedSink sink);
+    size_t addOutput(unsigned factor, std::vector<float> taps, DecimatedSink sink);
+
+    void push(size_t device, const SampleRecord &sample);
+
+    size_t numOutputs() const { return m_outputs.size(); }
+    unsigned factor(size_t output) const { return m_outputs[output].factor; }
+
+private:
+    struct Output
+    {
+        unsigned factor;
+        std::vector<float> taps;
+        DecimatedSink sink;
+        std::vector<Decimator> decimators; // One per device
+    };
+
+    size_t m_num_devices;
+    std::vector<Output> m_outputs;
+};
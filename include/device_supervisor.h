@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////
+// DeviceSupervisor
+//
+// Health of one device as seen by the acquisition loop. Any bus error
+// during the device's work takes it offline; the loop then leaves it alone
+// except for recovery attempts, the first kFirstRetry after the fault and
+// then at doubling intervals up to kMaxRetry. A glitch on the bus is thus
+// recovered from within a millisecond or two, while an unplugged adapter
+// costs a probe a few times a second until it is back.
+//
+// All times are in nanoseconds on one monotonic clock.
+
+class DeviceSupervisor
+{
+public:
+    static constexpr int64_t kFirstRetry = 1000000;  // 1ms
+    static constexpr int64_t kMaxRetry = 250000000;  // 250ms
+
+    // A device that never answered starts offline
+    explicit DeviceSupervisor(bool online = true) : m_online(online) {}
+
+    bool online() const { return m_online; }
+
+    // Bus errors counted while working with the device at time t. Returns
+    // true if they take it offline.
+    bool observe(int64_t t, uint64_t errors);
+
+    // Earliest time worth attempting recovery, valid while offline
+    int64_t nextRetry() const { return m_next_retry; }
+
+    // Result of a recovery attempt at time t
+    void recovered(int64_t t, bool ok);
+
+    // Time the device went offline
+    int64_t offlineSince() const { return m_offline_since; }
+
+    uint64_t faults() const { return m_faults; }
+    uint64_t attempts() const { return m_attempts; }
+
+    // Total time offline up to t, not counting a device that never answered
+    // before its first recovery
+    int64_t downtime(int64_t t) const { return m_downtime + (m_online || !m_faults ? 0 : t - m_offline_since); }
+
+private:
+    bool m_online;
+    int64_t m_offline_since = 0;
+    int64_t m_next_retry = 0;
+    int64_t m_retry_interval = kFirstRetry;
+    int64_t m_downtime = 0;
+    uint64_t m_faults = 0;
+    uint64_t m_attempts = 0;
+};
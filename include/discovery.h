@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// One I2C adapter and the ISM330DHCX devices on it
+struct I2cBus
+{
+    std::string path;               // Device node, e.g. /dev/i2c-16
+    std::string name;               // Adapter name as listed in sysfs
+    std::vector<uint8_t> addresses; // Addresses that answered with the ISM330DHCX WHO_AM_I
+};
+
+// Buses with at least one device, in adapter number order, as taken by
+// GyroAPI(const BusTopology &)
+using BusTopology = std::vector<I2cBus>;
+
+///////////////////////////////////////////////////////////////////////
+// discovery
+//
+// Finds the ISM330DHCX devices on a rig instead of configuring bus paths and
+// addresses by hand. Adapters are listed from sysfs and filtered by name,
+// then every adapter is probed in its own thread: a combined write/read of
+// WHO_AM_I at both device addresses, straight through i2c-dev, which costs
+// one transfer per address and prints nothing for an empty one. A slow or
+// hung adapter only delays its own result.
+
+namespace discovery
+{
+// Matches the adapter names of both Linux CH341 drivers (i2c-ch341-usb and
+// ch341)
+constexpr const char *kCh341 = "ch341";
+
+// Adapters in sysfs whose name contains filter, ignoring case (all of them
+// for an empty filter), with addresses left empty
+std::vector<I2cBus> adapters(const std::string &filter = kCh341,
+                             const std::filesystem::path &sysfs = "/sys/class/i2c-dev",
+                             const std::filesystem::path &dev = "/dev");
+
+// Fills bus->addresses. Returns false if the adapter cannot be opened.
+bool probe(I2cBus *bus);
+
+// adapters(), then probe() of all of them in parallel; adapters without
+// devices are left out
+BusTopology scan(const std::string &filter = kCh341, const std::filesystem::path &sysfs = "/sys/class/i2c-dev",
+                 const std::filesystem::path &dev = "/dev");
+} // namespace discovery
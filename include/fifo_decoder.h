@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sfe_ism330dhcx.h"
+
+// State of every batched sensor at one gyroscope FIFO word
+struct FifoSample
+{
+    sfe_ism_raw_data_t gyro;
+    sfe_ism_raw_data_t accel;
+    int16_t temp;
+    uint32_t timestamp; // Time stamp counter of the latest TIMESTAMP word
+    uint8_t hub[4][6]; // Bytes read from sensor hub slaves 0..3, as the slave sent them
+    uint8_t fresh;     // FifoDecoder::kFresh* bits of the parts batched since the previous sample
+};
+
+///////////////////////////////////////////////////////////////////////
+// FifoDecoder
+//
+// Turns drained FIFO words back into samples. The FIFO interleaves the
+// batched sensors at their own rates, so each gyroscope word completes a
+// FifoSample holding the most recent accelerometer, temperature and sensor
+// hub words. Keep one decoder per device and feed it every drain in order;
+// the state carries over between drains. With time stamp batching (see
+// QwDevISM330DHCX::setFifoTimestampDec()) the device writes a TIMESTAMP
+// word ahead of each data set, giving every sample its device time.
+
+class FifoDecoder
+{
+public:
+    static constexpr uint8_t kFreshAccel = 0x01;
+    static constexpr uint8_t kFreshTemp = 0x02;
+    static constexpr uint8_t kFreshTimestamp = 0x04;
+    static constexpr uint8_t kFreshHub0 = 0x10; // kFreshHub0 << n for slave n
+
+    // Appends a FifoSample per gyroscope word and returns how many
+    size_t decode(const sfe_ism_fifo_word_t *words, size_t count, std::vector<FifoSample> *samples);
+
+    // Words with a SENSORHUB_NACK tag, i.e. hub reads that failed
+    uint64_t hubNacks() const { return m_hub_nacks; }
+
+    // Words with tags the decoder does not handle (compressed data)
+    uint64_t skipped() const { return m_skipped; }
+
+private:
+    FifoSample m_latest = {};
+    uint64_t m_hub_nacks = 0, m_skipped = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////
+// FixedRing
+//
+// Queue of at most capacity() entries, allocated once by reset(). A push
+// into a full ring overwrites the oldest entry and counts it as dropped, so
+// the acquisition thread can queue without allocating and a consumer that
+// falls behind (or never reads) costs memory up to the cap and no more.
+// Not thread safe; callers sharing one hold their own lock.
+
+template <typename T>
+class FixedRing
+{
+public:
+    // Allocates room for capacity entries and empties the ring. Not on the
+    // acquisition path.
+    void reset(size_t capacity)
+    {
+        m_entries.assign(capacity, T());
+        m_head = m_size = 0;
+        m_dropped = 0;
+    }
+
+    size_t capacity() const { return m_entries.size(); }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    // Entries overwritten by push() since reset()
+    uint64_t dropped() const { return m_dropped; }
+
+    void push(const T &entry)
+    {
+        if (m_entries.empty())
+        {
+            m_dropped++;
+            return;
+        }
+        if (m_size == m_entries.size())
+        {
+            m_head = (m_head + 1) % m_entries.size();
+            m_size--;
+            m_dropped++;
+        }
+        m_entries[(m_head + m_size) % m_entries.size()] = entry;
+        m_size++;
+    }
+
+    // Oldest entry, valid while not empty
+    const T &front() const { return m_entries[m_head]; }
+    const T &back() const { return (*this)[m_size - 1]; }
+
+    // i-th oldest entry, i < size()
+    const T &operator[](size_t i) const { return m_entries[(m_head + i) % m_entries.size()]; }
+
+    void pop_front()
+    {
+        m_head = (m_head + 1) % m_entries.size();
+        m_size--;
+    }
+
+    void clear() { m_head = m_size = 0; }
+
+    // Moves every entry, oldest first, to the end of out
+    void drainTo(std::vector<T> *out)
+    {
+        for (; m_size > 0; pop_front())
+            out->push_back(front());
+    }
+
+private:
+    std::vector<T> m_entries;
+    size_t m_head = 0;
+    size_t m_size = 0;
+    uint64_t m_dropped = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sfe_ism330dhcx.h"
+
+// New output of one finite state machine program
+struct FsmEvent
+{
+    int64_t timestamp; // Host time (us) the output was read
+    uint8_t device;    // Index of the device in its GyroAPI, 0 elsewhere
+    uint8_t program;   // Program, 0..15 for FSM1..FSM16
+    uint8_t output;    // New value of FSM_OUTSx
+    uint8_t previous;  // Value before
+};
+
+///////////////////////////////////////////////////////////////////////
+// FsmMonitor
+//
+// Follows the programs loaded with QwDevISM330DHCX::loadFsmPrograms(). A
+// poll is a single two byte read of FSM_STATUS_A/B_MAINPAGE; the sixteen
+// output registers are only read when a program has raised its interrupt.
+// Every interrupt is reported, also when the program leaves its output
+// register unchanged, since FSM programs commonly signal with the interrupt
+// alone.
+
+class FsmMonitor
+{
+public:
+    FsmMonitor(QwDevISM330DHCX &device, uint16_t programs = 0xFFFF, uint8_t device_index = 0);
+
+    // Reads the current outputs as the baseline
+    bool begin();
+
+    // Appends new events. Returns false on a bus error.
+    bool poll(int64_t timestamp, std::vector<FsmEvent> *events);
+
+    uint64_t bytesRead() const { return m_bytes_read; }
+    uint8_t deviceIndex() const { return m_device_index; }
+
+private:
+    QwDevISM330DHCX &m_device;
+    uint16_t m_programs;
+    uint8_t m_device_index;
+    uint8_t m_outputs[16] = {};
+    uint64_t m_bytes_read = 0;
+};
@@ -1,45 +1,340 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include "Wire.h"
 #include "SparkFun_ISM330DHCX.h"
+#include "sample_store.h"
+#include "sample_bus.h"
+#include "orientation_filter.h"
+#include "calibration.h"
+#include "sample_log.h"
+#include "ready_poller.h"
+#include "rt_thread.h"
+#include "fsm_monitor.h"
+#include "fifo_decoder.h"
+#include "decimator.h"
+#include "clock_sync.h"
+#include "activity_monitor.h"
+#include "device_supervisor.h"
+#include "discovery.h"
+#include "telemetry.h"
+#include "fixed_ring.h"
+
+// Default configuration applied to every device by GyroAPI::add_device(),
+// see GyroAPI::setProfile(). Bring-up writes only the registers that differ
+// from reset and the acquisition loop converts samples without a full scale
+// switch.
+constexpr sfe_ism_profile_t kGyroApiProfile = {
+    .accelDataRate = ISM_XL_ODR_6667Hz,
+    .accelFullScale = ISM_4g,
+    .gyroDataRate = ISM_GY_ODR_6667Hz,
+    .gyroFullScale = ISM_250dps,
+    .gyroFilterLP1 = true,
+    .gyroLP1Bandwidth = ISM_MEDIUM,
+    .blockDataUpdate = true,
+    .deviceConfig = true,
+};
+
+// Chunks of history kept per device in the sample store (kSampleChunkSize each)
+constexpr size_t kSampleStoreChunks = 64;
+
+// Gyro standard deviation (mdps) above which a device is not considered still
+// during calibration
+constexpr float kStillGyroStdDev = 500.0f;
+
+// FIFO words read per drain when sensor hub batching is on
+constexpr uint16_t kFifoDrainWords = 1024;
+
+// Hub readings and FSM events kept until takeHubReadings()/takeFsmEvents();
+// beyond that the oldest are dropped and counted
+constexpr size_t kHubReadingCapacity = 4 * kFifoDrainWords;
+constexpr size_t kFsmEventCapacity = 1024;
+
+// Data of one sensor hub slave as batched into a device's FIFO
+struct HubReading
+{
+    int64_t timestamp; // us, of the gyroscope sample it was batched with
+    uint8_t device;    // Index of the device
+    uint8_t slave;     // Sensor hub slave, 0..3
+    uint8_t data[6];   // As read from the slave, lenData bytes are valid
+};
+
+// Inactivity function of the devices, see GyroAPI::setActivityMode()
+struct ActivityConfig
+{
+    bool enabled = false;
+    uint8_t wake_threshold = 2;   // 0 - 63, in full scale / 64 steps of accelerometer slope
+    uint8_t wake_duration = 0;    // 0 - 3 accelerometer output periods above the threshold
+    uint8_t sleep_duration = 15;  // 0 - 15, in 512 output periods still before sleeping
+    bool gyro_power_down = false; // Power the gyroscope down instead of sleeping it, slower to wake
+};
 
 class GyroAPI
 {
 public:
-    GyroAPI(const char *i2c_path = "/dev/i2c-16") : m_wire(i2c_path)
+    GyroAPI(const char *i2c_path = "/dev/i2c-16")
     {
-        m_wire.begin();
+        add_bus(i2c_path);
     }
+
+    // Every bus and device found by discovery::scan(), devices numbered in
+    // topology order, set up with profile
+    explicit GyroAPI(const BusTopology &topology, const sfe_ism_profile_t &profile = kGyroApiProfile);
+
     ~GyroAPI()
     {
-        m_wire.end();
+        for (auto &wire : m_wires)
+            wire->end();
     }
 
-    void add_device(uint8_t address);
+    // Opens another I2C adapter and returns its index for add_device()
+    size_t add_bus(const char *i2c_path);
+
+    // Configuration of the devices added from now on, instead of
+    // kGyroApiProfile, e.g. from gyro_config. The gyroscope must be on, it
+    // paces acquisition. Returns false, keeping the current profile,
+    // otherwise or if the profile is not valid.
+    bool setProfile(const sfe_ism_profile_t &profile);
+    const sfe_ism_profile_t &profile() const { return m_profile; }
+
+    // Adds a device and applies the profile, see setProfile(). A device that
+    // does not answer is added offline and set up once it does, see
+    // DeviceSupervisor; one that answers with the wrong WHO_AM_I aborts.
+    void add_device(uint8_t address, size_t bus = 0);
+
+    // Publish every sample to a shared-memory ring for local readers, see
+    // SampleBusReader. Call after the devices have been added.
+    bool openSampleBus(const char *name, uint32_t capacity = 8192);
 
     void startUpdateLoop(char *folder_name);
+
+    // Stops and joins the acquisition thread. Built with ISM_LATENCY_TRACE,
+    // also prints the latency histograms, see latency_trace.h.
     void stopUpdateLoop();
     void setRecord(bool value, int frequency);
+
+    // Drain the FIFO instead of polling the status register, also when no
+    // other setting needs it. Call before startUpdateLoop().
+    void setFifo(bool enable) { m_fifo_enabled = enable; }
+
+    // Run a Madgwick orientation estimator on the stream. The quaternion is
+    // added to the CSV, the sample store and the sample bus. Call before
+    // startUpdateLoop().
+    void setOrientationFilter(bool enable, float beta = 0.1f);
+
+    // Calibrate every device at startUpdateLoop() from still_samples samples
+    // taken while it is at rest and level on one axis. The gyro bias model is
+    // kept in directory as calibration_<bus>_0xNN.txt and refined on every run, the
+    // accelerometer offsets go to the device's user offset registers (unless
+    // the profile turns the accelerometer off). Returns false, changing
+    // nothing, if still_samples is below 1.
+    bool setCalibration(bool enable, const char *directory = ".", int still_samples = 2000);
+
+    // How the CSV logs are written, see LogFileMode. Mapped by default; call
+    // before startUpdateLoop().
+    void setLogMode(LogFileMode mode) { m_log_mode = mode; }
+
+    // Split the CSV logs into segments by size or time, compressing the
+    // closed ones in the background, see LogRotation. Call before
+    // startUpdateLoop().
+    void setLogRotation(const LogRotation &rotation) { m_log_rotation = rotation; }
+
+    // Real-time scheduling, CPU pinning and memory locking of the acquisition
+    // thread, see RtThreadConfig. What was granted is printed when the thread
+    // starts. The loop's queues and bus buffers are allocated before then,
+    // but the thread still allocates when a log segment rolls over (two
+    // maintenance jobs), when it recovers a device (reload and messages) and
+    // in the sinks of addDecimatedOutput()/setSynchronized(); the printed
+    // report says so.
+    // Call before startUpdateLoop().
+    void setRealtime(const RtThreadConfig &config) { m_realtime = config; }
+
+    // Finite state machine programs (as produced by ST's tools) loaded into
+    // every device at startUpdateLoop(). The acquisition thread then polls
+    // their status at the FSM rate and queues an FsmEvent per interrupt.
+    // Call before startUpdateLoop().
+    void setFsmPrograms(const std::vector<std::vector<uint8_t>> &programs, uint8_t rate = ISM_FSM_ODR_104Hz);
+
+    // Moves the queued FSM events to events, waiting up to timeout_ms for
+    // one if the queue is empty. Returns false if there were none. At most
+    // kFsmEventCapacity are queued; droppedFsmEvents() counts the older ones
+    // overwritten.
+    bool takeFsmEvents(std::vector<FsmEvent> *events, int timeout_ms = 0);
+    uint64_t droppedFsmEvents();
+
+    // Adds an anti-aliased output at a lower rate, fed with every sample
+    // after calibration and orientation, see MultiRatePipeline. The rate is
+    // the gyroscope output rate divided by a whole factor; the nearest one is
+    // used and returned. The filter needs every output sample, so with
+    // setRecord() below the output rate the FIFO must be on (setFifo());
+    // otherwise nothing is added and 0 is returned. sink runs on the
+    // acquisition thread. Call after setRecord() and before
+    // startUpdateLoop().
+    double addDecimatedOutput(double rate_hz, DecimatedSink sink);
+
+    // Capture all devices on one time base: their time stamp counters are
+    // reset together, every sample is timed by its device's counter (batched
+    // into the FIFO, which acquisition then drains) mapped onto the host
+    // clock by a DeviceClock, and the streams are resampled to rate_hz and
+    // joined into SyncFrames for sink, see StreamAligner. sink runs on the
+    // acquisition thread. Call before startUpdateLoop().
+    void setSynchronized(double rate_hz, SyncFrameSink sink);
+
+    // Read up to four external I2C sensors (e.g. a magnetometer) through the
+    // sensor hub of every device at rate (ISM_SH_ODR_*). Each sensor gives its
+    // 8-bit address, first register and length (up to 6). setup holds
+    // register writes sent to the sensors first, with lenData as the value.
+    // The hub data is batched into the FIFO with gyro and accel, and
+    // acquisition drains the FIFO instead of polling the status register. A
+    // drain is the level read plus one write/read pair per 32 bytes of words
+    // (QwI2C chunking), not a single burst. Call before startUpdateLoop().
+    void setHubSensors(const std::vector<sfe_hub_sensor_settings_t> &sensors, uint8_t rate = ISM_SH_ODR_104Hz,
+                       const std::vector<sfe_hub_sensor_settings_t> &setup = {});
+
+    // Moves the hub readings collected since the last call to readings.
+    // Returns false if there were none. At most kHubReadingCapacity are
+    // kept; droppedHubReadings() counts the older ones overwritten.
+    bool takeHubReadings(std::vector<HubReading> *readings);
+    uint64_t droppedHubReadings();
+
+    // Let every device idle while it is still: after config.sleep_duration
+    // without motion it drops to 12.5Hz with the gyroscope asleep, and the
+    // first motion above config.wake_threshold restores the full rate. The
+    // FIFO streams while a device is awake and is drained at the full rate;
+    // while it sleeps, acquisition only reads its sleep state, at 12.5Hz, see
+    // ActivityMonitor. Call before startUpdateLoop().
+    void setActivityMode(const ActivityConfig &config) { m_activity = config; }
+
+    // Serve per device rate, FIFO level and overruns, drops, bus errors and
+    // read latency on a Unix socket path or host:port from a low-priority
+    // thread while acquisition runs, see TelemetryServer. Call before
+    // startUpdateLoop().
+    void setTelemetry(const std::string &address) { m_telemetry_address = address; }
+
+    // The same counters in process, valid after startUpdateLoop()
+    const Telemetry &telemetry() const { return m_telemetry; }
+
+    // Whether all devices are online. While acquisition runs this is the
+    // supervisors' view, without touching the bus; otherwise every device
+    // is asked for its WHO_AM_I.
     bool statusCheck();
     void flush();
     void join();
 
+    // Columnar history of every device, valid after startUpdateLoop()
+    const SampleStore *sampleStore() const { return m_sample_store.get(); }
+
 private:
     void gyro_thread();
+    bool readSample(size_t index, SampleRecord *sample);
+    void writeSample(size_t index, const SampleRecord &sample);
+    void calibrate(size_t index);
+    void loadFsm();
+    void pollFsm();
+    void startFifo();
+    void startActivity();
+    void startTelemetry();
+    bool checkActivity(size_t index);
+    void resetClocks();
+    void resetClock(size_t index);
+    bool loadFsm(size_t index);
+    bool setupFifo(size_t index);
+    bool setupActivity(size_t index);
+    bool faulted(size_t index, uint64_t errors_before);
+    bool recoverDevice(size_t index);
+    bool restoreDevice(size_t index);
+    TwoWire &wireOf(size_t index) { return *m_wires[m_device_bus[index]]; }
+    double samplePeriodNs() const { return 1e9 / sfe_ism_profile::gyroDataRateHz(m_profile.gyroDataRate); }
+    // Acquisition drains the FIFO, so every sample arrives whatever setRecord() says
+    bool fifoFed() const { return m_fifo_enabled || !m_hub_sensors.empty() || m_sync_period_us > 0.0 || m_activity.enabled; }
+    // setRecord() reads fewer samples than the device outputs
+    bool throttled() const { return m_frequency > 0 && m_frequency < 1e9 / samplePeriodNs(); }
+    bool drainFifo(size_t index);
+    void processSweep(std::vector<SampleRecord> &sweep, std::vector<uint8_t> &acquired,
+                      std::vector<int64_t> &last_sample_times);
 
     uint64_t m_now_time, m_last_time;
 
-    TwoWire m_wire;
+    std::vector<std::unique_ptr<TwoWire>> m_wires;
+    std::vector<std::string> m_bus_paths;
 
     bool m_record = false, m_run_thread = false;
-    int m_frequency;
+    bool m_orientation_enabled = false;
+    bool m_fifo_enabled = false;
+    sfe_ism_profile_t m_profile = kGyroApiProfile;
+    float m_gyro_sensitivity = sfe_ism_profile::gyroSensitivity(kGyroApiProfile.gyroFullScale);
+    float m_accel_sensitivity = sfe_ism_profile::accelSensitivity(kGyroApiProfile.accelFullScale);
+    bool m_calibration_enabled = false;
+    int m_calibration_samples = 0;
+    std::filesystem::path m_calibration_directory;
+    int m_frequency = 0;
+    LogFileMode m_log_mode = LogFileMode::Mapped;
+    LogRotation m_log_rotation;
+    RtThreadConfig m_realtime;
+    std::vector<std::vector<uint8_t>> m_fsm_programs;
+    uint8_t m_fsm_rate = ISM_FSM_ODR_104Hz;
+    int64_t m_fsm_period = 0, m_fsm_next_poll = 0;
+    std::vector<sfe_hub_sensor_settings_t> m_hub_sensors, m_hub_setup;
+    uint8_t m_hub_rate = ISM_SH_ODR_104Hz;
+    double m_sync_period_us = 0.0;
+    SyncFrameSink m_sync_sink;
+    ActivityConfig m_activity;
 
     std::thread m_thread;
     std::vector<int64_t> m_last_times;
+    std::vector<int64_t> m_throttled_until; // Steady clock ns, when setRecord() lets a device be read again
     std::vector<SparkFun_ISM330DHCX *> m_devices;
-    std::vector<std::ofstream *> m_file_streams;
+    std::vector<uint8_t> m_addresses;
+    std::vector<size_t> m_device_bus; // Index into m_wires
+    std::vector<SampleLog> m_sample_logs;
+    std::vector<DeviceCalibration> m_device_calibrations; // As last written, restored after a power loss
+    std::vector<ReadyPoller> m_pollers;
+    std::unique_ptr<SampleStore> m_sample_store;
+    SampleBus m_sample_bus;
+    OrientationFilter m_orientation;
+    GyroCalibration m_calibration;
+    MultiRatePipeline m_decimation;
+    std::vector<FsmMonitor> m_fsm_monitors;
+    std::vector<FsmEvent> m_fsm_polled;
+
+    std::mutex m_fsm_mutex;
+    std::condition_variable m_fsm_cv;
+    FixedRing<FsmEvent> m_fsm_events; // Guarded by m_fsm_mutex
+
+    // Devices acquired by FIFO drain, see setHubSensors() and setSynchronized()
+    std::vector<uint8_t> m_fifo_mode;
+    std::vector<FifoDecoder> m_fifo_decoders;
+    std::vector<FixedRing<SampleRecord>> m_fifo_pending; // Decoded, not yet through processSweep()
+    std::vector<sfe_ism_fifo_word_t> m_fifo_words;
+    std::vector<FifoSample> m_fifo_samples;
+    std::vector<HubReading> m_hub_polled;
+
+    // Per device time bases, see setSynchronized()
+    std::vector<DeviceClock> m_clocks;
+    std::vector<uint64_t> m_last_ticks;
+    StreamAligner m_aligner;
+
+    // Sleep state of every device, see setActivityMode()
+    std::vector<ActivityMonitor> m_activity_monitors;
+
+    // Bus errors take a device offline until it is recovered, see
+    // DeviceSupervisor. Gaps are marked in the logs from m_lost_at (us).
+    std::vector<DeviceSupervisor> m_supervisors;
+    std::vector<int64_t> m_lost_at;
+    std::atomic<size_t> m_offline{0};
+
+    // Counters of the acquisition thread, served by m_telemetry_server
+    Telemetry m_telemetry;
+    TelemetryServer m_telemetry_server;
+    std::string m_telemetry_address;
+
+    std::mutex m_hub_mutex;
+    FixedRing<HubReading> m_hub_readings; // Guarded by m_hub_mutex
 };
\ No newline at end of file
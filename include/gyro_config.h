@@ -0,0 +1,60 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include "gyro.h"
+
+// Everything main.cpp used to hard-code, as read from a configuration file
+struct GyroConfig
+{
+    // Devices: the buses listed, or when there are none, what
+    // discovery::scan() finds on the adapters matching discover
+    BusTopology buses;
+    std::string discover = discovery::kCh341;
+
+    // Applied to every device as one register plan, see setProfile()
+    sfe_ism_profile_t profile = kGyroApiProfile;
+    bool fifo = false;
+    int record_hz = 0; // Logged sample rate, see setRecord(); 0 = the gyroscope rate
+
+    bool orientation = false;
+    float orientation_beta = 0.1f;
+    bool calibration = false;
+    std::string calibration_directory = ".";
+    int calibration_samples = 2000;
+    ActivityConfig activity;
+
+    // Sinks
+    std::filesystem::path log_folder = "logs";
+    LogFileMode log_mode = LogFileMode::Mapped;
+    LogRotation log_rotation;
+    std::string sample_bus; // Shared-memory name, empty = none
+    uint32_t sample_bus_capacity = 8192;
+
+    RtThreadConfig realtime;
+    std::string telemetry; // Unix socket path or host:port, empty = none
+};
+
+///////////////////////////////////////////////////////////////////////
+// gyro_config
+//
+// Reader for GyroAPI configuration files (JSON), see the README for the
+// keys. Unknown keys and values outside what the device supports are
+// errors, reported with their path, so a typo never silently falls back to
+// a default. The device section is checked as a whole with
+// sfe_ism_profile::isValid() and turned into one register plan, which every
+// device gets in a few burst writes.
+
+namespace gyro_config
+{
+bool parse(const std::string &text, GyroConfig *config, std::string *error = nullptr);
+bool load(const std::filesystem::path &path, GyroConfig *config, std::string *error = nullptr);
+
+// config.buses, or the result of discovery::scan(config.discover)
+BusTopology topology(const GyroConfig &config);
+
+// Sets everything but the devices on api, which must have been built from
+// topology() and config.profile, and opens the sample bus. Returns false
+// if a setting is refused or the sample bus cannot be opened.
+bool apply(const GyroConfig &config, GyroAPI *api);
+} // namespace gyro_config
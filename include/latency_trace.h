@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Operations timed by the latency trace
+enum class TraceOp : uint8_t
+{
+    Ioctl,         // TwoWire: I2C_SLAVE address selection
+    Write,         // TwoWire: write() to the adapter
+    Read,          // TwoWire: read() from the adapter
+    RegisterWrite, // QwI2C::writeRegisterRegion
+    RegisterRead,  // QwI2C::readRegisterRegion
+    StatusPoll,    // GyroAPI: data ready check
+    Conversion,    // GyroAPI: raw to physical units
+    LogWrite,      // GyroAPI: store, bus and CSV for one sample
+    Sweep,         // GyroAPI: one pass over all devices
+    Count
+};
+
+// Events counted by the latency trace
+enum class TraceCounter : uint8_t
+{
+    BusError, // failed open, ioctl, write or read, short transfers included
+    NotReady, // data ready poll came back empty, the device is retried next sweep
+    Count
+};
+
+///////////////////////////////////////////////////////////////////////
+// LatencyHistogram
+//
+// HDR-style histogram of nanosecond latencies: exact below 8 ns, then eight
+// linear sub-buckets per power of two, so any recorded value is known to
+// within 12.5% over the full 64-bit range.
+
+class LatencyHistogram
+{
+public:
+    static constexpr size_t kSubBuckets = 8;
+    static constexpr size_t kBuckets = (64 - 2) * kSubBuckets;
+
+    static size_t bucketOf(uint64_t ns);
+    static uint64_t bucketLow(size_t bucket);
+    static uint64_t bucketHigh(size_t bucket);
+
+    void record(uint64_t ns, uint64_t count = 1);
+    void merge(const LatencyHistogram &other);
+
+    // Adds kBuckets raw bucket counts with their summary values
+    void add(const uint64_t *buckets, uint64_t count, uint64_t sum, uint64_t min, uint64_t max);
+
+    uint64_t count() const { return m_count; }
+    uint64_t min() const { return m_count ? m_min : 0; }
+    uint64_t max() const { return m_max; }
+    double mean() const { return m_count ? (double)m_sum / m_count : 0.0; }
+
+    // Upper bound of the bucket holding the p-th percentile (0..100)
+    uint64_t percentile(double p) const;
+
+    uint64_t bucketCount(size_t bucket) const { return m_buckets[bucket]; }
+
+private:
+    uint64_t m_buckets[kBuckets] = {};
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = UINT64_MAX;
+    uint64_t m_max = 0;
+};
+
+///////////////////////////////////////////////////////////////////////
+// latency_trace
+//
+// Process-wide latency histograms and counters. Every thread records into its
+// own block with relaxed atomic stores, so recording takes no lock and no
+// read-modify-write; queries sum the blocks of all threads.
+//
+// The bus and device layers record through the ISM_TRACE_* macros, which only
+// expand when ISM_LATENCY_TRACE is defined (CMake option
+// ISM330DHCX_LATENCY_TRACE) and cost nothing otherwise.
+
+namespace latency_trace
+{
+void record(TraceOp op, uint64_t ns);
+void count(TraceCounter counter, uint64_t n = 1);
+
+// Aggregates over all threads, safe to call while others record
+LatencyHistogram histogram(TraceOp op);
+uint64_t counter(TraceCounter counter);
+
+// Clears every histogram and counter; recordings racing with it may survive
+void reset();
+
+const char *name(TraceOp op);
+const char *name(TraceCounter counter);
+
+// Table of count, mean, percentiles and max per operation, then the counters
+void dump(std::ostream &out);
+
+inline uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Records the lifetime of the scope under op
+class Scope
+{
+public:
+    explicit Scope(TraceOp op) : m_op(op), m_start(now()) {}
+    ~Scope() { record(m_op, now() - m_start); }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    TraceOp m_op;
+    uint64_t m_start;
+};
+} // namespace latency_trace
+
+#define ISM_TRACE_CONCAT_(a, b) a##b
+#define ISM_TRACE_CONCAT(a, b) ISM_TRACE_CONCAT_(a, b)
+
+#ifdef ISM_LATENCY_TRACE
+#define ISM_TRACE_SCOPE(op) latency_trace::Scope ISM_TRACE_CONCAT(ism_trace_scope_, __LINE__)(op)
+#define ISM_TRACE_COUNT(counter) latency_trace::count(counter)
+#else
+#define ISM_TRACE_SCOPE(op) ((void)0)
+#define ISM_TRACE_COUNT(counter) ((void)0)
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <sys/types.h>
+
+// How LogFile gets records to disk
+enum class LogFileMode
+{
+    Buffered, // write(2) from a small user buffer, in the writing thread
+    Mapped,   // preallocated file written through an mmap window
+    Direct,   // O_DIRECT writes of whole windows from a double buffer
+};
+
+///////////////////////////////////////////////////////////////////////
+// LogFile
+//
+// Append-only file for long captures. Mapped and Direct keep the file
+// system out of the writing thread: space is preallocated with fallocate()
+// in extents of kExtentWindows windows, and full windows are handed to a
+// shared background thread that starts their writeback (sync_file_range) or
+// writes them with O_DIRECT. In Mapped mode the same thread also maps and
+// pre-faults the next window ahead of time, so write() is a memcpy except
+// for a pointer swap at each window boundary.
+//
+// Until close() the file is longer than its contents; the preallocated tail
+// reads as zeros. close() trims it.
+
+class LogFile
+{
+public:
+    static constexpr size_t kDefaultWindow = 4 << 20;
+    static constexpr size_t kExtentWindows = 16;
+
+    LogFile();
+    ~LogFile();
+
+    LogFile(LogFile &&other) noexcept;
+    LogFile &operator=(LogFile &&other) noexcept;
+    LogFile(const LogFile &) = delete;
+    LogFile &operator=(const LogFile &) = delete;
+
+    // Truncates path. window must be a multiple of the page size. Direct
+    // falls back to ordinary writes where the file system refuses O_DIRECT.
+    bool open(const std::filesystem::path &path, LogFileMode mode, size_t window = kDefaultWindow);
+    void close();
+
+    bool isOpen() const { return m_state != nullptr; }
+    LogFileMode mode() const { return m_mode; }
+
+    // Bytes written so far
+    uint64_t size() const { return m_size; }
+
+    // false once the file has failed; later writes are dropped
+    bool write(const char *data, size_t length);
+
+    // Hands everything written so far to the kernel. Only Buffered and
+    // Direct block; Mapped starts writeback of the current window.
+    void flush();
+
+    struct State;
+
+private:
+    bool nextWindow();
+    bool writeBuffered(const char *data, size_t length);
+
+    LogFileMode m_mode = LogFileMode::Buffered;
+    std::unique_ptr<State> m_state;
+
+    char *m_window = nullptr;   // Current mmap window or Direct/Buffered buffer
+    size_t m_window_size = 0;
+    size_t m_window_used = 0;
+    off_t m_window_offset = 0;  // File offset of m_window
+    uint64_t m_size = 0;
+};
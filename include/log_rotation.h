@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+// When SampleLog starts a new segment. With neither limit set the log is a
+// single file at its own path.
+struct LogRotation
+{
+    uint64_t max_bytes = 0;   // Roll once a segment holds this many bytes, 0 = no limit
+    int64_t interval_us = 0;  // Roll when the sample time crosses a multiple of this, 0 = no limit
+    bool compress = true;     // gzip closed segments, see log_segments::compress()
+    size_t keep_segments = 0; // Delete the oldest closed segments beyond this many, 0 = keep all
+
+    bool enabled() const { return max_bytes > 0 || interval_us > 0; }
+};
+
+// Start of an independently compressed block of a segment
+struct SegmentIndexEntry
+{
+    int64_t timestamp;    // First sample time in the block (us)
+    uint64_t offset;      // Offset of the block's gzip member in the compressed file
+    uint64_t csv_offset;  // Offset of the block in the uncompressed CSV
+};
+
+///////////////////////////////////////////////////////////////////////
+// log_segments
+//
+// Segments of a log at dir/name.csv are dir/name.NNNNNN.csv, numbered from 0
+// and never reused, also across runs. Closed segments are compressed to
+// name.NNNNNN.csv.gz as a series of gzip members, one per kIndexBlock bytes
+// of CSV, followed by an empty member whose extra field holds the index. Any
+// gzip reader decompresses the whole file; readIndex() and find() give the
+// member to start inflating from for a timestamp.
+//
+// Compression, pruning and opening the next segment run on one background
+// thread with idle CPU and I/O priority.
+
+namespace log_segments
+{
+constexpr size_t kIndexBlock = 64 << 10;
+
+std::filesystem::path segmentPath(const std::filesystem::path &base, uint64_t index, bool compressed = false);
+
+// Index following the highest existing segment of base
+uint64_t nextIndex(const std::filesystem::path &base);
+
+// false if compression is not built in (no zlib) or fails
+bool compress(const std::filesystem::path &csv, const std::filesystem::path &gz);
+bool readIndex(const std::filesystem::path &gz, std::vector<SegmentIndexEntry> *entries);
+
+// Block containing timestamp: the last entry starting at or before it
+const SegmentIndexEntry *find(const std::vector<SegmentIndexEntry> &entries, int64_t timestamp);
+
+// Deletes the oldest segments of base numbered below before (the closed
+// ones) until at most keep of them remain
+void prune(const std::filesystem::path &base, uint64_t before, size_t keep);
+
+// Runs job on the background thread
+void post(std::function<void()> job);
+
+// Waits until every posted job has finished
+void drain();
+} // namespace log_segments
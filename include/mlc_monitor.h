@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "sfe_ism330dhcx.h"
+
+///////////////////////////////////////////////////////////////////////
+// ucf
+//
+// Reader for the register configurations ST's tools export for the Machine
+// Learning Core and the finite state machine (.ucf): one "Ac <reg> <value>"
+// line per register write, in hex, and "--" comment lines. Load the result
+// with QwDevISM330DHCX::loadUcf().
+
+namespace ucf
+{
+// false, with the offending line in error, on anything else (WAIT lines
+// included, which ISM330DHCX configurations do not use)
+bool parse(const std::string &text, std::vector<sfe_ism_reg_write_t> *writes, std::string *error = nullptr);
+bool load(const std::filesystem::path &path, std::vector<sfe_ism_reg_write_t> *writes, std::string *error = nullptr);
+} // namespace ucf
+
+// Change of the output class of one decision tree
+struct MlcEvent
+{
+    int64_t timestamp; // Host time (us) the new output was read
+    uint8_t tree;      // Decision tree, 0..7 for MLC1..MLC8
+    uint8_t output;    // New output class (MLCx_SRC)
+    uint8_t previous;  // Output class before the change
+
+    // Raw FIFO words around the change: up to MlcMonitor's pre_words from
+    // before it, then post_words from after it
+    std::vector<sfe_ism_fifo_word_t> window;
+};
+
+///////////////////////////////////////////////////////////////////////
+// MlcMonitor
+//
+// Follows the decision trees of the Machine Learning Core instead of the
+// raw data. A poll is a single read of MLC_STATUS_MAINPAGE; the outputs
+// are only read when a tree reports a new result, and only changes are
+// returned as events.
+//
+// With a window requested, the FIFO must run in continuous mode with the
+// wanted sensors batched. It then holds the recent history on the device
+// and is only read when an event needs its pre_words, and after that until
+// post_words more have arrived. Between events the host reads nothing but
+// the status register.
+
+class MlcMonitor
+{
+public:
+    static constexpr uint16_t kFifoWords = 1024; // Upper bound of the FIFO depth
+
+    MlcMonitor(QwDevISM330DHCX &device, uint8_t trees = 0xFF, uint16_t pre_words = 0, uint16_t post_words = 0);
+
+    // Reads the current outputs as the baseline and, with a window, empties
+    // the FIFO
+    bool begin();
+
+    // Appends completed events. Returns false on a bus error.
+    bool poll(int64_t timestamp, std::vector<MlcEvent> *events);
+
+    // Bytes read from the device so far, for comparison with streaming the
+    // raw data
+    uint64_t bytesRead() const { return m_bytes_read; }
+
+private:
+    struct Pending
+    {
+        MlcEvent event;
+        uint16_t post_left;
+    };
+
+    QwDevISM330DHCX &m_device;
+    uint8_t m_trees;
+    uint16_t m_pre_words, m_post_words;
+    uint8_t m_outputs[8] = {};
+    uint64_t m_bytes_read = 0;
+
+    std::vector<sfe_ism_fifo_word_t> m_fifo;
+    std::vector<Pending> m_pending; // Events still collecting post_words
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "sample_store.h"
+
+///////////////////////////////////////////////////////////////////////
+// OrientationFilter
+//
+// Madgwick IMU (gyro + accel) attitude estimator running on the acquisition
+// stream. State and inputs are kept as structure-of-arrays across devices and
+// update() is a single branch-free loop over them, so the compiler can process
+// several sensors per SIMD instruction.
+//
+// Typical use from the acquisition thread, once per sweep over the devices:
+//
+//   filter.setInput(i, sample, dt);   // for every device that produced data
+//   filter.update();                  // one pass over all devices
+//   filter.getQuaternion(i, &sample); // copy the result into the record
+
+class OrientationFilter
+{
+public:
+    explicit OrientationFilter(size_t num_devices = 0, float beta = 0.1f);
+
+    void resize(size_t num_devices);
+    void reset();
+
+    size_t numDevices() const { return m_q0.size(); }
+
+    // Gain of the accelerometer correction step (rad/s)
+    void setBeta(float beta) { m_beta = beta; }
+    float beta() const { return m_beta; }
+
+    //////////////////////////////////////////////////////////////////////////////
+    // setInput()
+    //
+    // Queues one sample for the next update(). Devices without an input since
+    // the last update() are left untouched.
+    //
+    //  Parameter    Description
+    //  ---------    -----------------------------
+    //  device       Device index
+    //  sample       Gyro in mdps, accel in mg (any unit works, it is normalised)
+    //  dt           Time since the previous sample of this device, in seconds
+
+    void setInput(size_t device, const SampleRecord &sample, float dt);
+
+    void update();
+
+    // Writes qw, qx, qy, qz of a device into sample
+    void getQuaternion(size_t device, SampleRecord *sample) const;
+
+private:
+    float m_beta;
+
+    // Quaternion state (w, x, y, z)
+    std::vector<float> m_q0, m_q1, m_q2, m_q3;
+
+    // Pending inputs, gyro already converted to rad/s. dt == 0 means no input.
+    std::vector<float> m_gx, m_gy, m_gz;
+    std::vector<float> m_ax, m_ay, m_az;
+    std::vector<float> m_dt;
+};
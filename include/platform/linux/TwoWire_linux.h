@@ -1,40 +1,54 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
+#include <string>
 #include <vector>
-#include <queue>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
-
+#include "latency_trace.h"
+
+// Arduino-style I2C over i2c-dev. Transfers go through member buffers that
+// are sized once, so the acquisition loop never allocates for a bus access:
+// a read lands in a fixed array (requestFrom() takes at most 255 bytes),
+// and writes up to kTxReserve bytes fit the transmit buffer reserved up
+// front. Only longer writes, such as program uploads during setup, grow it.
+//
+// The i2c-dev calls themselves are virtual, so a simulated device can stand
+// behind the same TwoWire and QwI2C code as a real one (the benchmarks do).
+// A subclass that overrides closeDevice() calls end() in its destructor.
 class TwoWire {
 public:
-    TwoWire(const char* device = "/dev/i2c-16") : devicePath(device) {}
+    static constexpr size_t kTxReserve = 1024;
+
+    TwoWire(const char* device = "/dev/i2c-16") : devicePath(device) { txBuffer.reserve(kTxReserve); }
 
-    ~TwoWire() {
+    virtual ~TwoWire() {
         if (fd >= 0) {
-            close(fd);
+            closeDevice(fd);
         }
     }
 
     void begin() {
-        if (fd >= 0) close(fd);  // close if previously open
-        fd = open(devicePath.c_str(), O_RDWR);
+        if (fd >= 0) closeDevice(fd);  // close if previously open
+        fd = openDevice(devicePath.c_str());
         if (fd < 0) {
+            countError();
             perror("Failed to open I2C device");
         }
         txBuffer.clear();
-        while (!rxBuffer.empty()) rxBuffer.pop();
+        rxHead = rxTail = 0;
     }
 
     void end() {
         if (fd >= 0) {
-            close(fd);
+            closeDevice(fd);
             fd = -1;
         }
         txBuffer.clear();
-        while (!rxBuffer.empty()) rxBuffer.pop();
+        rxHead = rxTail = 0;
     }
 
     void beginTransmission(uint8_t address) {
@@ -51,14 +65,16 @@ public:
     }
 
     int endTransmission(bool stop = true) {
-        if (fd < 0) return -1;
-        if (ioctl(fd, I2C_SLAVE, targetAddress) < 0) {
-            perror("Failed to set I2C address");
-            return -1;
-        }
+        if (fd < 0) { countError(); return -1; }
+        if (!selectAddress(targetAddress)) return -1;
 
-        ssize_t written = ::write(fd, txBuffer.data(), txBuffer.size());
+        ssize_t written;
+        {
+            ISM_TRACE_SCOPE(TraceOp::Write);
+            written = writeDevice(fd, txBuffer.data(), txBuffer.size());
+        }
         if (written != (ssize_t)txBuffer.size()) {
+            countError();
             perror("Failed to write all bytes");
             return -1;
         }
@@ -66,43 +82,79 @@ public:
     }
 
     uint16_t requestFrom(uint8_t address, uint8_t numBytes, bool stop = true) {
-        if (fd < 0) return 0;
-        if (ioctl(fd, I2C_SLAVE, address) < 0) {
-            perror("Failed to set I2C address");
-            return 0;
+        if (fd < 0) { countError(); return 0; }
+        if (!selectAddress(address)) return 0;
+
+        // As on Arduino, a new request replaces what was not read
+        rxHead = rxTail = 0;
+        ssize_t readBytes;
+        {
+            ISM_TRACE_SCOPE(TraceOp::Read);
+            readBytes = readDevice(fd, rxBuffer, numBytes);
         }
-
-        std::vector<uint8_t> buf(numBytes);
-        ssize_t readBytes = ::read(fd, buf.data(), numBytes);
+        if (readBytes < (ssize_t)numBytes) countError();
         if (readBytes < 0) {
             perror("Failed to read");
             return 0;
         }
 
-        // push into RX queue
-        for (ssize_t i = 0; i < readBytes; i++) {
-            rxBuffer.push(buf[i]);
-        }
+        rxTail = static_cast<uint16_t>(readBytes);
         return static_cast<uint16_t>(readBytes);
     }
 
     uint8_t read() {
-        if (rxBuffer.empty()) {
+        if (rxHead == rxTail) {
             return 0xFF; // mimic Arduino: return -1, but cast to uint8_t
         }
-        uint8_t b = rxBuffer.front();
-        rxBuffer.pop();
-        return b;
+        return rxBuffer[rxHead++];
     }
 
     int available() const {
-        return rxBuffer.size();
+        return rxTail - rxHead;
     }
 
+    bool isOpen() const { return fd >= 0; }
+
+    // Failed transfers (and opens) so far; a change marks a bus error even
+    // where the caller only sees a short read
+    uint64_t errors() const { return errorCount; }
+
+protected:
+    // i2c-dev: open the adapter, address a device, then plain write/read
+    virtual int openDevice(const char *path) { return open(path, O_RDWR); }
+    virtual void closeDevice(int handle) { close(handle); }
+    virtual int selectDevice(int handle, uint8_t address) { return ioctl(handle, I2C_SLAVE, address); }
+    virtual ssize_t writeDevice(int handle, const uint8_t *data, size_t length) { return ::write(handle, data, length); }
+    virtual ssize_t readDevice(int handle, uint8_t *data, size_t length) { return ::read(handle, data, length); }
+
 private:
+    // Every failed open or transfer, short ones included, shows in both
+    // errors() and the trace. Nothing here retries: a failed transfer is
+    // returned to the caller, and recovery is DeviceSupervisor's.
+    void countError() {
+        errorCount++;
+        ISM_TRACE_COUNT(TraceCounter::BusError);
+    }
+
+    bool selectAddress(uint8_t address) {
+        int result;
+        {
+            ISM_TRACE_SCOPE(TraceOp::Ioctl);
+            result = selectDevice(fd, address);
+        }
+        if (result < 0) {
+            countError();
+            perror("Failed to set I2C address");
+            return false;
+        }
+        return true;
+    }
+
     std::string devicePath;
     int fd = -1;
+    uint64_t errorCount = 0;
     uint8_t targetAddress = 0;
     std::vector<uint8_t> txBuffer;
-    std::queue<uint8_t> rxBuffer;
+    uint8_t rxBuffer[256];
+    uint16_t rxHead = 0, rxTail = 0;
 };
@@ -19,17 +19,21 @@ public:
             ch341 = std::make_unique<CH341Wrapper>();
         }
         
+        isInitialized = false;
         if (!ch341->LoadDLL()) {
+            errorCount++;
             std::cerr << "Failed to load CH341 DLL" << std::endl;
             return;
         }
         
         if (!ch341->OpenDevice(0)) {
+            errorCount++;
             std::cerr << "Failed to open CH341 device 0" << std::endl;
             return;
         }
         
         if (!ch341->SetStream(0, 1)) { // Set I2C mode
+            errorCount++;
             std::cerr << "Failed to set I2C mode" << std::endl;
             return;
         }
@@ -63,7 +67,7 @@ public:
     }
 
     int endTransmission(bool stop = true) {
-        if (!isInitialized || !ch341) return -1;
+        if (!isInitialized || !ch341) { errorCount++; return -1; }
         
         if (txBuffer.empty()) return 0;
         
@@ -78,6 +82,7 @@ public:
             std::vector<unsigned char> data(txBuffer.begin() + 1, txBuffer.end());
             
             bool success = ch341->WriteI2C(0, targetAddress, regAddr, data.data(), data.size());
+            if (!success) errorCount++;
             return success ? 0 : -1;
         }
         
@@ -85,12 +90,12 @@ public:
     }
 
     uint16_t requestFrom(uint8_t address, uint8_t numBytes, bool stop = true) {
-        if (!isInitialized || !ch341) return 0;
+        if (!isInitialized || !ch341) { errorCount++; return 0; }
         
         std::vector<unsigned char> buffer(numBytes);
         bool success = ch341->ReadI2C(0, address, lastRegisterAddress, buffer.data(), numBytes);
         
-        if (!success) return 0;
+        if (!success) { errorCount++; return 0; }
         
         // Push received data into RX queue
         for (int i = 0; i < numBytes; i++) {
@@ -113,10 +118,17 @@ public:
         return rxBuffer.size();
     }
 
+    bool isOpen() const { return isInitialized; }
+
+    // Failed transfers (and opens) so far; a change marks a bus error even
+    // where the caller only sees a short read
+    uint64_t errors() const { return errorCount; }
+
 private:
     std::string deviceName;
     std::unique_ptr<CH341Wrapper> ch341;
     bool isInitialized = false;
+    uint64_t errorCount = 0;
     uint8_t targetAddress = 0;
     uint8_t lastRegisterAddress = 0;
     std::vector<uint8_t> txBuffer;
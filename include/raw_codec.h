@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "sfe_ism330dhcx.h"
+
+///////////////////////////////////////////////////////////////////////
+// raw_codec
+//
+// Lossless compression of raw sensor sequences (sfe_ism_raw_data_t) for logs
+// and for streaming between processes or hosts. Consecutive samples at a
+// high output data rate differ little, so each axis is stored as zigzag
+// encoded deltas, bit-packed in groups of kGroupSamples with the width of
+// the group's largest delta.
+//
+// A stream is a sequence of self-contained blocks of up to kBlockSamples
+// samples:
+//
+//   offset  size  field
+//   0       1     kBlockMagic
+//   1       1     kVersion
+//   2       2     sample count n (little endian)
+//   4       6     first sample x, y, z (int16, little endian)
+//   10      3g    bit width of every group, x groups then y then z,
+//                 g = ceil((n - 1) / kGroupSamples)
+//   10+3g   ...   packed deltas, x then y then z, LSB first, padded to a byte
+//
+// Every block decodes on its own, so a reader can start at any block and
+// skip blocks by reading their header only (blockSize()).
+//
+// The delta, zigzag and width passes work on per-axis arrays that the
+// compiler vectorises.
+
+namespace raw_codec
+{
+constexpr uint8_t kBlockMagic = 0xA5;
+constexpr uint8_t kVersion = 1;
+constexpr size_t kBlockSamples = 256;
+constexpr size_t kGroupSamples = 32;
+constexpr size_t kHeaderSize = 10;
+
+// Upper bound of an encoded block of count samples
+constexpr size_t maxBlockSize(size_t count)
+{
+    size_t deltas = count > 0 ? count - 1 : 0;
+    size_t groups = (deltas + kGroupSamples - 1) / kGroupSamples;
+    return kHeaderSize + 3 * groups + (3 * deltas * 17 + 7) / 8;
+}
+
+// Encodes 1..kBlockSamples samples into out (at least maxBlockSize(count)
+// bytes). Returns the bytes written.
+size_t encodeBlock(const sfe_ism_raw_data_t *samples, size_t count, uint8_t *out);
+
+// Size of the block starting at in, 0 if in does not start a valid block or
+// holds only part of it
+size_t blockSize(const uint8_t *in, size_t length);
+
+// Decodes the block starting at in into samples (room for kBlockSamples).
+// Returns the bytes consumed and sets count, 0 on a malformed or partial
+// block.
+size_t decodeBlock(const uint8_t *in, size_t length, sfe_ism_raw_data_t *samples, size_t *count);
+
+// Whole sequences, appended to out
+void encode(const sfe_ism_raw_data_t *samples, size_t count, std::vector<uint8_t> *out);
+bool decode(const uint8_t *in, size_t length, std::vector<sfe_ism_raw_data_t> *out);
+
+// Offsets of the blocks of a stream, for random access by sample number
+// (sample i is in block i / kBlockSamples when every block is full)
+bool indexBlocks(const uint8_t *in, size_t length, std::vector<size_t> *offsets);
+} // namespace raw_codec
+
+///////////////////////////////////////////////////////////////////////
+// RawStreamEncoder / RawStreamDecoder
+//
+// Incremental versions for sinks that see one sample, or one network read,
+// at a time. The encoder appends a block to its output every kBlockSamples
+// samples; flush() closes a partial block. The decoder accepts the stream in
+// arbitrary pieces and returns the samples of every block completed so far.
+
+class RawStreamEncoder
+{
+public:
+    // Returns true when a block was appended to output()
+    bool add(const sfe_ism_raw_data_t &sample);
+    bool flush();
+
+    // Encoded bytes not yet taken by the caller
+    std::vector<uint8_t> &output() { return m_output; }
+
+private:
+    sfe_ism_raw_data_t m_pending[raw_codec::kBlockSamples];
+    size_t m_count = 0;
+    std::vector<uint8_t> m_output;
+};
+
+class RawStreamDecoder
+{
+public:
+    // Appends the samples of every block completed by data to samples.
+    // Returns false if the stream is corrupt.
+    bool feed(const uint8_t *data, size_t length, std::vector<sfe_ism_raw_data_t> *samples);
+
+    // Bytes of an incomplete block held back
+    size_t buffered() const { return m_buffer.size(); }
+
+private:
+    std::vector<uint8_t> m_buffer;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////
+// ReadyPoller
+//
+// Schedules the data-ready polls of one device from the timing of its
+// data-ready edges, instead of polling STATUS_REG in a loop.
+//
+// Every poll bounds the next edge from below: a not-ready poll because the
+// edge has not happened yet, a ready poll because reading the data clears the
+// flag. A ready poll shortly after the previous poll therefore brackets the
+// edge. The poller produces such brackets on purpose, with a fine search of
+// period / 16 steps when it is unlocked and with one early probe every few
+// samples once locked. The probe interval doubles up to kProbeInterval as the
+// period estimate firms up. Between probes it polls once per sample, just
+// after the predicted edge.
+//
+// The period is measured edge to edge over an up to kMaxBaseline periods long
+// baseline, so it follows the drift of the sensor's oscillator.
+//
+// All times are in nanoseconds on one monotonic clock.
+
+class ReadyPoller
+{
+public:
+    static constexpr uint32_t kProbeInterval = 64;
+    static constexpr int64_t kMaxBaseline = 8192;
+
+    explicit ReadyPoller(double nominal_period_ns = 0.0);
+
+    // Forget the phase and restart from the nominal period
+    void reset(double nominal_period_ns);
+
+    // Earliest time worth polling the device again
+    int64_t nextPoll() const;
+
+    // Result of a data-ready poll issued at time t
+    void observe(int64_t t, bool ready);
+
+    bool locked() const { return m_locked; }
+    double period() const { return m_period; }
+
+    // Predicted time of the next data-ready edge, valid when locked
+    double nextEdge() const { return m_next_edge; }
+
+    uint64_t polls() const { return m_polls; }
+    uint64_t notReady() const { return m_not_ready; }
+
+private:
+    double m_period = 0.0;
+    double m_next_edge = 0.0;
+
+    // Measured edge the period baseline starts from
+    bool m_has_anchor = false;
+    double m_anchor = 0.0;
+
+    int64_t m_prev_poll = -1;
+    bool m_locked = false;
+    bool m_searching = true;
+    uint32_t m_since_probe = 0;
+    uint32_t m_probe_interval = 1;
+
+    uint64_t m_polls = 0;
+    uint64_t m_not_ready = 0;
+};
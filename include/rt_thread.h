@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Scheduling class of a real-time thread
+enum class RtPolicy
+{
+    Default,  // Leave the thread as created (SCHED_OTHER)
+    Fifo,     // SCHED_FIFO at RtThreadConfig::priority
+    Deadline, // SCHED_DEADLINE with the runtime, deadline and period below
+};
+
+// How an acquisition thread is set up before it starts sampling. Everything
+// but the default needs CAP_SYS_NICE / CAP_IPC_LOCK or a suitable rtprio and
+// memlock limit (/etc/security/limits.conf); what was not granted is listed
+// in the RtThreadReport rather than treated as an error.
+struct RtThreadConfig
+{
+    RtPolicy policy = RtPolicy::Default;
+    int priority = 80; // SCHED_FIFO priority, 1..99
+
+    // SCHED_DEADLINE budget (ns). The kernel only accepts it for threads that
+    // may run on every CPU of their root domain, so combine it with cpus only
+    // on a cpuset partition of its own.
+    uint64_t runtime_ns = 0;
+    uint64_t deadline_ns = 0; // 0 = period_ns
+    uint64_t period_ns = 0;
+
+    std::vector<int> cpus;              // Pin to these CPUs (e.g. isolcpus=), empty = any
+    bool lock_memory = false;           // mlockall() the process
+    size_t stack_prefault = 256 << 10;  // Stack touched up front, so the loop never faults it in
+
+    bool enabled() const { return policy != RtPolicy::Default || !cpus.empty() || lock_memory; }
+};
+
+// What rt_thread::apply() actually got, read back from the kernel
+struct RtThreadReport
+{
+    bool scheduling = true;     // Requested policy and priority are in effect
+    bool affinity = true;       // Thread runs only on the requested CPUs
+    bool memory_locked = true;  // Current mappings are locked
+    bool future_locked = true;  // Later mappings are locked too (MCL_FUTURE)
+    std::vector<std::string> notes;
+
+    bool granted() const { return scheduling && affinity && memory_locked; }
+};
+
+std::ostream &operator<<(std::ostream &out, const RtThreadReport &report);
+
+///////////////////////////////////////////////////////////////////////
+// rt_thread
+//
+// Real-time setup of the calling thread. Call it at the top of the thread
+// function, after every buffer the thread uses has been allocated: locking
+// memory faults in everything mapped at that point, and later allocations
+// may fault or take the allocator's lock. Paths of the thread that still
+// allocate belong in the report's notes, so the printed report does not
+// promise more than the thread keeps.
+//
+// MCL_FUTURE is only requested when the memlock limit is unlimited. With a
+// finite limit it would make later mappings, such as the log file windows,
+// fail once the limit is reached; the report then has future_locked unset.
+// Linux only.
+
+namespace rt_thread
+{
+RtThreadReport apply(const RtThreadConfig &config);
+
+// Touches bytes of the calling thread's stack below the current frame
+void prefaultStack(size_t bytes);
+} // namespace rt_thread
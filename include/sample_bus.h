@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "sample_store.h"
+
+// Shared-memory layout, identical for publisher and readers. The segment is a
+// SampleBusHeader followed, for every device, by a SampleBusDevice and its
+// ring of capacity slots.
+constexpr uint32_t kSampleBusMagic = 0x49534d42; // "ISMB"
+constexpr uint32_t kSampleBusVersion = 2;
+
+struct SampleBusHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_devices;
+    uint32_t capacity; // slots per device, power of two
+
+    // Bumped on every publish, readers FUTEX_WAIT on it
+    alignas(64) std::atomic<uint32_t> futex;
+    std::atomic<uint32_t> waiters;
+};
+
+struct SampleBusDevice
+{
+    // Number of samples published so far
+    alignas(64) std::atomic<uint64_t> head;
+};
+
+// Per-slot seqlock: seq is 2*index+1 while the slot is being written and
+// 2*index+2 once sample index is complete.
+struct SampleBusSlot
+{
+    std::atomic<uint64_t> seq;
+    SampleRecord record;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Sample bus requires lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Sample bus requires lock-free 32-bit atomics");
+
+///////////////////////////////////////////////////////////////////////
+// SampleBus
+//
+// Publishes samples into a POSIX shared-memory ring (/dev/shm/<name>) so local
+// processes can follow the acquisition with no file or socket in between. There
+// is a single publisher; it never blocks on readers and overwrites the oldest
+// slot once a ring is full.
+
+class SampleBus
+{
+public:
+    SampleBus() = default;
+    ~SampleBus();
+
+    SampleBus(const SampleBus &) = delete;
+    SampleBus &operator=(const SampleBus &) = delete;
+
+    // name must start with '/', capacity is rounded up to a power of two
+    bool create(const char *name, uint32_t num_devices, uint32_t capacity);
+    void close();
+
+    bool isOpen() const { return m_header != nullptr; }
+
+    // Acquisition thread only
+    void publish(size_t device, const SampleRecord &sample);
+
+private:
+    std::string m_name;
+    void *m_map = nullptr;
+    size_t m_map_size = 0;
+    SampleBusHeader *m_header = nullptr;
+};
+
+///////////////////////////////////////////////////////////////////////
+// SampleBusReader
+//
+// Attaches to a SampleBus from any process. Reads go straight to the shared
+// mapping; the only system call is the futex wait when a reader has caught up.
+
+class SampleBusReader
+{
+public:
+    SampleBusReader() = default;
+    ~SampleBusReader();
+
+    SampleBusReader(const SampleBusReader &) = delete;
+    SampleBusReader &operator=(const SampleBusReader &) = delete;
+
+    bool attach(const char *name);
+    void detach();
+
+    uint32_t numDevices() const { return m_header ? m_header->num_devices : 0; }
+    uint32_t capacity() const { return m_header ? m_header->capacity : 0; }
+
+    // Number of samples published for a device
+    uint64_t head(size_t device) const;
+
+    // Oldest sample index that has not been overwritten yet
+    uint64_t oldest(size_t device) const;
+
+    //////////////////////////////////////////////////////////////////////////////
+    // read()
+    //
+    // Copies sample index of a device out of the ring.
+    //
+    //  Parameter    Description
+    //  ---------    -----------------------------
+    //  device       Device index
+    //  index        Sample index, between oldest() and head()
+    //  sample       Destination
+    //  retval       false if the sample is not published yet or was overwritten
+
+    bool read(size_t device, uint64_t index, SampleRecord *sample) const;
+
+    // Publish counter, pass to wait() after draining the ring
+    uint32_t sequence() const;
+
+    // Blocks until something is published after sequence was taken, or until
+    // timeout_us expires. Returns false on timeout.
+    bool wait(uint32_t sequence, int64_t timeout_us) const;
+
+private:
+    void *m_map = nullptr;
+    size_t m_map_size = 0;
+    SampleBusHeader *m_header = nullptr;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include "log_file.h"
+#include "log_rotation.h"
+#include "sample_store.h"
+
+///////////////////////////////////////////////////////////////////////
+// SampleLog
+//
+// CSV file with the samples of one device, as written by GyroAPI: time (us)
+// and gyro (mdps), followed by the quaternion when orientation is enabled.
+// Rows are formatted into a stack buffer and appended to a LogFile, see
+// LogFileMode for how they reach the disk.
+//
+// With a LogRotation the log is split into segments, each with its own
+// header, see log_segments. The next segment is opened ahead of time and
+// closed ones are compressed in the background, so rolling over costs the
+// writing thread a swap of files.
+
+class SampleLog
+{
+public:
+    SampleLog() = default;
+    ~SampleLog() { close(); }
+    SampleLog(SampleLog &&) = default;
+    SampleLog &operator=(SampleLog &&) = default;
+
+    bool open(const std::filesystem::path &path, bool orientation, LogFileMode mode = LogFileMode::Mapped,
+              const LogRotation &rotation = LogRotation());
+    void close();
+
+    bool isOpen() const { return m_file.isOpen(); }
+
+    // Number of the segment being written
+    uint64_t segment() const { return m_segment; }
+
+    void write(const SampleRecord &sample);
+
+    // Marks missing samples: a row at timestamp with nan in every other
+    // column, between the last sample before the gap and the first after it
+    void writeGap(int64_t timestamp);
+
+    void flush();
+
+    struct NextSegment;
+
+private:
+    void writeHeader();
+    bool shouldRoll(int64_t timestamp) const;
+    void roll();
+    void prepareNext();
+    void retire(LogFile file, uint64_t segment);
+
+    LogFile m_file;
+    bool m_orientation = false;
+    LogFileMode m_mode = LogFileMode::Mapped;
+    LogRotation m_rotation;
+    std::filesystem::path m_base;
+
+    uint64_t m_segment = 0;
+    int64_t m_segment_start = 0;
+    bool m_segment_empty = true;
+    std::shared_ptr<NextSegment> m_next;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+// Number of samples held by one chunk. Each column of a chunk is 4 KiB (8 KiB
+// for timestamps), so a column never straddles more pages than it needs to.
+constexpr size_t kSampleChunkSize = 1024;
+
+// One converted 6-DoF sample, as produced by the acquisition thread.
+struct SampleRecord
+{
+    int64_t timestamp; // us
+    float gx, gy, gz;  // mdps
+    float ax, ay, az;  // mg
+    float temp;        // degC
+
+    // Orientation, identity unless an OrientationFilter is running
+    float qw = 1.0f, qx = 0.0f, qy = 0.0f, qz = 0.0f;
+};
+
+// Fixed-size block of samples stored column by column. Every column starts on
+// its own cache line so per-axis consumers stream through contiguous memory.
+struct SampleChunk
+{
+    alignas(64) int64_t timestamp[kSampleChunkSize];
+    alignas(64) float gx[kSampleChunkSize];
+    alignas(64) float gy[kSampleChunkSize];
+    alignas(64) float gz[kSampleChunkSize];
+    alignas(64) float ax[kSampleChunkSize];
+    alignas(64) float ay[kSampleChunkSize];
+    alignas(64) float az[kSampleChunkSize];
+    alignas(64) float temp[kSampleChunkSize];
+    alignas(64) float qw[kSampleChunkSize];
+    alignas(64) float qx[kSampleChunkSize];
+    alignas(64) float qy[kSampleChunkSize];
+    alignas(64) float qz[kSampleChunkSize];
+
+    // Index of the first sample in this chunk within its device stream
+    uint64_t first = 0;
+    // Number of samples published to readers
+    std::atomic<uint32_t> count{0};
+    std::atomic<SampleChunk *> next{nullptr};
+};
+
+// Read-only, zero-copy window onto the committed part of one chunk.
+struct SampleView
+{
+    uint64_t first;
+    size_t count;
+    const int64_t *timestamp;
+    const float *gx, *gy, *gz;
+    const float *ax, *ay, *az;
+    const float *temp;
+    const float *qw, *qx, *qy, *qz;
+};
+
+// Preallocated pool of chunks. All memory is reserved up front so that the
+// acquisition thread never calls the allocator.
+class SampleChunkPool
+{
+public:
+    explicit SampleChunkPool(size_t capacity);
+
+    SampleChunk *acquire();
+    void release(SampleChunk *chunk);
+    size_t available();
+
+private:
+    std::unique_ptr<SampleChunk[]> m_chunks;
+    std::vector<SampleChunk *> m_free;
+    std::mutex m_mutex;
+};
+
+///////////////////////////////////////////////////////////////////////
+// SampleStore
+//
+// Per-device columnar sample history. There is a single writer per device (the
+// acquisition thread) and any number of readers. A device keeps at most
+// chunks_per_device chunks; once it is full the oldest chunk is recycled, so
+// the store behaves as a bounded ring measured in whole chunks.
+//
+// Samples are published with a release store of the chunk count, so readers
+// only ever observe fully written samples without taking a lock on the append
+// path.
+
+class SampleStore
+{
+public:
+    SampleStore(size_t num_devices, size_t chunks_per_device);
+
+    SampleStore(const SampleStore &) = delete;
+    SampleStore &operator=(const SampleStore &) = delete;
+
+    // Acquisition thread only
+    bool append(size_t device, const SampleRecord &sample);
+
+    size_t numDevices() const { return m_devices.size(); }
+
+    // Total number of samples ever appended for a device
+    uint64_t size(size_t device) const;
+
+    // Index of the oldest sample still held for a device
+    uint64_t oldest(size_t device) const;
+
+    bool latest(size_t device, SampleRecord *sample) const;
+
+    //////////////////////////////////////////////////////////////////////////////
+    // forEachChunk()
+    //
+    // Calls fn(const SampleView &) for every chunk holding samples with index >=
+    // from, oldest first. Views point directly into the store and are only valid
+    // for the duration of the callback. Returns the index one past the last
+    // sample visited, which can be passed as from on the next call.
+
+    template <typename F> uint64_t forEachChunk(size_t device, uint64_t from, F &&fn) const
+    {
+        const DeviceColumns &columns = *m_devices[device];
+        std::shared_lock<std::shared_mutex> lock(columns.recycle_mutex);
+
+        uint64_t end = from;
+        for (SampleChunk *chunk = columns.head; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire))
+        {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            if (chunk->first + count <= from)
+                continue;
+
+            size_t offset = from > chunk->first ? (size_t)(from - chunk->first) : 0;
+            SampleView view = {chunk->first + offset, count - offset,
+                               chunk->timestamp + offset,
+                               chunk->gx + offset, chunk->gy + offset, chunk->gz + offset,
+                               chunk->ax + offset, chunk->ay + offset, chunk->az + offset,
+                               chunk->temp + offset,
+                               chunk->qw + offset, chunk->qx + offset, chunk->qy + offset, chunk->qz + offset};
+            fn(view);
+            end = chunk->first + count;
+        }
+        return end;
+    }
+
+private:
+    struct DeviceColumns
+    {
+        SampleChunk *head = nullptr; // oldest, guarded by recycle_mutex
+        SampleChunk *tail = nullptr; // writer only
+        size_t chunks = 0;           // writer only
+        std::atomic<uint64_t> total{0};
+        mutable std::shared_mutex recycle_mutex;
+    };
+
+    SampleChunk *nextChunk(DeviceColumns &columns);
+
+    size_t m_chunks_per_device;
+    SampleChunkPool m_pool;
+    std::vector<std::unique_ptr<DeviceColumns>> m_devices;
+};
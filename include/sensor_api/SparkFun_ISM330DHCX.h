@@ -3,7 +3,8 @@
 #include "sfe_bus.h"
 #include <Wire.h>
 
-class SparkFun_ISM330DHCX : public QwDevISM330DHCX
+// Bound to QwI2C at compile time, see QwDevISM330DHCXBound
+class SparkFun_ISM330DHCX : public QwDevISM330DHCXBound<sfe_ISM330DHCX::QwI2C>
 {
 
 	public: 
@@ -53,7 +54,7 @@ class SparkFun_ISM330DHCX : public QwDevISM330DHCX
         _i2cBus.init(wirePort, true);
 
         // Initialize the system - return results
-        return this->QwDevISM330DHCX::init();
+        return this->QwDevISM330DHCXBound::init();
     }
 
 	private: 
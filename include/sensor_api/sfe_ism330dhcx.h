@@ -1,10 +1,17 @@
+#pragma once
+
+#include <type_traits>
 #include "sfe_bus.h"
 #include "sfe_ism330dhcx_defs.h"
 #include "sfe_ism_shim.h"
+#include "sfe_ism330dhcx_profile.h"
 
 #define ISM330DHCX_ADDRESS_LOW 0x6A
 #define ISM330DHCX_ADDRESS_HIGH 0x6B
 
+// Page address ST's examples load the FSM programs at
+#define ISM330DHCX_FSM_START_ADDRESS 0x0400
+
 struct sfe_ism_raw_data_t
 {
     int16_t xData;
@@ -19,6 +26,29 @@ struct sfe_ism_data_t
     float zData;
 };
 
+// Temperature, gyroscope and accelerometer output registers (OUT_TEMP_L..OUTZ_H_A)
+struct sfe_ism_raw_all_t
+{
+    int16_t temp;
+    sfe_ism_raw_data_t gyro;
+    sfe_ism_raw_data_t accel;
+};
+
+// One FIFO word (FIFO_DATA_OUT_TAG..FIFO_DATA_OUT_Z_H). The sensor is tag >> 3,
+// see ism330dhcx_fifo_tag_t.
+struct sfe_ism_fifo_word_t
+{
+    uint8_t tag;
+    uint8_t data[6];
+};
+
+// One finite state machine program, as produced by ST's tools
+struct sfe_ism_fsm_program_t
+{
+    const uint8_t *data;
+    uint16_t length;
+};
+
 struct sfe_hub_sensor_settings_t
 {
     uint8_t address;
@@ -91,6 +121,7 @@ class QwDevISM330DHCX
     bool getRawGyro(sfe_ism_raw_data_t *gyroData);
     bool getAccel(sfe_ism_data_t *accelData);
     bool getGyro(sfe_ism_data_t *gyroData);
+    bool getRawAllSensors(sfe_ism_raw_all_t *allData);
 
     // General Settings
     bool setDeviceConfig(bool enable = true);
@@ -106,6 +137,8 @@ class QwDevISM330DHCX
     bool setGyroDataRate(uint8_t rate);
     bool enableTimestamp(bool enable = true);
     bool resetTimestamp();
+    bool getTimestamp(uint32_t *ticks);
+    bool getFreqFineTuning(int8_t *fine);
 
     // Interrupt Settings
     bool setAccelStatustoInt1(bool enable = true);
@@ -122,9 +155,15 @@ class QwDevISM330DHCX
     bool setAccelFifoBatchSet(uint8_t val);
     bool setGyroFifoBatchSet(uint8_t val);
     bool setFifoTimestampDec(uint8_t val);
+    bool setTempFifoBatchSet(uint8_t val);
     bool setFIFOThresholdInt1(bool enable);
     bool setBatchCounterInt1(bool enable);
 
+    // FIFO Data
+    uint16_t getFifoLevel();
+    bool getFifoStatus(uint16_t *level, bool *overrun);
+    uint16_t readFifo(sfe_ism_fifo_word_t *words, uint16_t maxWords, bool *overrun = nullptr);
+
         // Sensor Hub Settings
         bool setHubODR(uint8_t rate);
     bool setHubSensorRead(uint8_t sensor, sfe_hub_sensor_settings_t *settings);
@@ -140,6 +179,38 @@ class QwDevISM330DHCX
     bool getHubStatus();
     bool getExternalSensorNack(uint8_t sensor);
     bool resetSensorHub();
+    bool setHubSlaveBatching(uint8_t sensor, bool enable = true);
+    bool configureHub(const sfe_hub_sensor_settings_t *sensors, uint8_t count, uint8_t rate, bool batch = true);
+    bool writeHubRegister(uint8_t address, uint8_t reg, uint8_t value);
+
+    // Accelerometer user offsets
+    bool setAccelUserOffset(int8_t x, int8_t y, int8_t z, bool coarseWeight = false);
+
+    // Activity / inactivity
+    bool setActivityMode(uint8_t mode);
+    bool setWakeUpThreshold(uint8_t threshold, bool fineWeight = false);
+    bool setWakeUpDuration(uint8_t duration);
+    bool setSleepDuration(uint8_t duration);
+    bool getSleepState(bool *asleep, bool *changed = nullptr);
+
+    // Machine Learning Core
+    bool loadUcf(const sfe_ism_reg_write_t *writes, uint32_t length);
+    bool setMlc(bool enable = true);
+    bool setMlcDataRate(uint8_t rate);
+    bool getMlcStatus(uint8_t *status);
+    bool getMlcOutputs(uint8_t *outputs);
+    bool setMlcInt1(uint8_t trees);
+    bool setMlcInt2(uint8_t trees);
+
+    // Finite State Machine
+    bool writeAdvancedPages(uint16_t address, const uint8_t *data, uint16_t length);
+    bool loadFsmPrograms(const sfe_ism_fsm_program_t *programs, uint8_t count, uint8_t rate,
+                         uint16_t startAddress = ISM330DHCX_FSM_START_ADDRESS);
+    bool getFsmStatus(uint16_t *status);
+    bool getFsmOutputs(uint8_t *outputs);
+    bool setFsmLongCounter(uint16_t value);
+    bool setFsmInt1(uint16_t programs);
+    bool setFsmInt2(uint16_t programs);
 
     // Self Test
     bool setAccelSelfTest(uint8_t val);
@@ -164,7 +235,135 @@ class QwDevISM330DHCX
     float convert4000dpsToMdps(int16_t data);
     float convertToCelsius(int16_t data);
 
-  private:
+    // Compile-time profiles
+    bool applyRegisterPlan(const sfe_ism_reg_write_t *plan, uint16_t length);
+
+    // Run-time profiles, see applyProfile<P>() and checkProfile<P>()
+    bool applyProfile(const sfe_ism_profile_t &profile);
+    bool checkProfile(const sfe_ism_profile_t &profile, bool *intact);
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // applyProfile()
+    //
+    // Resets the device and writes the minimal register plan for profile P. The
+    // cached full scale values are updated so the runtime getters stay valid.
+    //
+    //  Parameter    Description
+    //  ---------    -----------------------------
+    //  P            Device profile (template parameter)
+    //  retval       true on success, false on bus error
+
+    template <sfe_ism_profile_t P> bool applyProfile()
+    {
+        static constexpr auto plan = sfe_ism_profile::registerPlan<P>();
+
+        if (!deviceReset())
+            return false;
+
+        // The reset bit self-clears once the user registers are restored
+        int tries = 0;
+        while (!getDeviceReset())
+            if (++tries > 10)
+                return false;
+
+        if (!applyRegisterPlan(plan.data(), (uint16_t)plan.size()))
+            return false;
+
+        fullScaleAccel = P.accelFullScale;
+        fullScaleGyro = P.gyroFullScale;
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // checkProfile()
+    //
+    // Reads CTRL1_XL and CTRL2_G back in one burst and compares them with
+    // profile P. A device that was reset or lost power since applyProfile<P>()
+    // reads them at their reset value, so this tells whether its configuration
+    // survived.
+    //
+    //  Parameter    Description
+    //  ---------    -----------------------------
+    //  P            Device profile (template parameter)
+    //  intact       true if the registers still hold the profile
+    //  retval       true on success, false on bus error
+
+    template <sfe_ism_profile_t P> bool checkProfile(bool *intact)
+    {
+        static constexpr auto image = sfe_ism_profile::registerImage(P);
+
+        uint8_t ctrl[2];
+        if (readRegisterRegion(ISM330DHCX_CTRL1_XL, ctrl, sizeof(ctrl)) != 0)
+            return false;
+
+        *intact = ctrl[0] == image[2] && ctrl[1] == image[3];
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // getGyro<P>() / getAccel<P>()
+    //
+    // Same as getGyro()/getAccel() but with the full scale fixed by profile P, so
+    // the conversion is a constant multiply instead of a switch on every sample.
+
+    template <sfe_ism_profile_t P> bool getGyro(sfe_ism_data_t *gyroData)
+    {
+        sfe_ism_raw_data_t rawData;
+        if (!getRawGyro(&rawData))
+            return false;
+        convertGyro<P>(&rawData, gyroData);
+        return true;
+    }
+
+    template <sfe_ism_profile_t P> bool getAccel(sfe_ism_data_t *accelData)
+    {
+        sfe_ism_raw_data_t rawData;
+        if (!getRawAccel(&rawData))
+            return false;
+        convertAccel<P>(&rawData, accelData);
+        return true;
+    }
+
+    template <sfe_ism_profile_t P> static inline void convertGyro(const sfe_ism_raw_data_t *rawData, sfe_ism_data_t *gyroData)
+    {
+        constexpr float sensitivity = sfe_ism_profile::gyroSensitivity(P.gyroFullScale);
+        convertRaw(rawData, gyroData, sensitivity);
+    }
+
+    template <sfe_ism_profile_t P> static inline void convertAccel(const sfe_ism_raw_data_t *rawData, sfe_ism_data_t *accelData)
+    {
+        constexpr float sensitivity = sfe_ism_profile::accelSensitivity(P.accelFullScale);
+        convertRaw(rawData, accelData, sensitivity);
+    }
+
+    // Conversion with a sensitivity (mdps or mg per LSB) chosen at run time,
+    // still a single multiply per axis
+    static inline void convertRaw(const sfe_ism_raw_data_t *rawData, sfe_ism_data_t *data, float sensitivity)
+    {
+        data->xData = (float)rawData->xData * sensitivity;
+        data->yData = (float)rawData->yData * sensitivity;
+        data->zData = (float)rawData->zData * sensitivity;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////
+    // decodeRawAll()
+    //
+    // Unpacks an OUT_TEMP_L..OUTZ_H_A burst, as read by getRawAllSensors().
+
+    static inline void decodeRawAll(const uint8_t *buff, sfe_ism_raw_all_t *allData)
+    {
+        allData->temp = (int16_t)((buff[1] << 8) | buff[0]);
+        allData->gyro.xData = (int16_t)((buff[3] << 8) | buff[2]);
+        allData->gyro.yData = (int16_t)((buff[5] << 8) | buff[4]);
+        allData->gyro.zData = (int16_t)((buff[7] << 8) | buff[6]);
+        allData->accel.xData = (int16_t)((buff[9] << 8) | buff[8]);
+        allData->accel.yData = (int16_t)((buff[11] << 8) | buff[10]);
+        allData->accel.zData = (int16_t)((buff[13] << 8) | buff[12]);
+    }
+
+  protected:
+    bool routeEmbeddedInterrupt(uint8_t intReg, uint8_t *masks, uint8_t count, uint8_t mdCfgReg);
+
     sfe_ISM330DHCX::QwIDeviceBus *_sfeBus;
     uint8_t _i2cAddress;
     uint8_t _cs;
@@ -172,3 +371,168 @@ class QwDevISM330DHCX
     uint8_t fullScaleAccel = 0; // Powered down by default
     uint8_t fullScaleGyro = 0;  // Powered down by default
 };
+
+//////////////////////////////////////////////////////////////////////////////////
+// QwDevISM330DHCXBound
+//
+// QwDevISM330DHCX with the bus type fixed at compile time. The data path
+// (status, sensor and FIFO reads) calls Bus directly instead of going through
+// the ST driver, its read_reg function pointer and the virtual QwIDeviceBus,
+// so the whole register access can inline. The ST context is bound to the
+// same non-virtual accessors, which keeps the configuration methods working
+// and saves them the virtual call.
+//
+// The object is still a QwDevISM330DHCX; code holding the type-erased
+// interface keeps working, but only calls made through this type take the
+// direct path.
+
+template <typename Bus> class QwDevISM330DHCXBound : public QwDevISM330DHCX
+{
+    static_assert(std::is_base_of_v<sfe_ISM330DHCX::QwIDeviceBus, Bus>, "Bus must implement QwIDeviceBus");
+
+  public:
+    bool init()
+    {
+        bool connected = QwDevISM330DHCX::init();
+        bindCtx();
+        return connected;
+    }
+
+    void setCommunicationBus(Bus &theBus, uint8_t i2cAddress)
+    {
+        QwDevISM330DHCX::setCommunicationBus(theBus, i2cAddress);
+        _bus = &theBus;
+    }
+
+    void setCommunicationBus(Bus &theBus)
+    {
+        QwDevISM330DHCX::setCommunicationBus(theBus);
+        _bus = &theBus;
+    }
+
+    // Qualified calls, so a Bus overriding QwIDeviceBus is not dispatched virtually
+    int32_t writeRegisterRegion(uint8_t reg, uint8_t *data, uint16_t length)
+    {
+        return _bus->Bus::writeRegisterRegion(_i2cAddress, reg, data, length);
+    }
+
+    int32_t readRegisterRegion(uint8_t reg, uint8_t *data, uint16_t length)
+    {
+        return _bus->Bus::readRegisterRegion(_i2cAddress, reg, data, length);
+    }
+
+    bool getRawAccel(sfe_ism_raw_data_t *accelData) { return readRawVector(ISM330DHCX_OUTX_L_A, accelData); }
+    bool getRawGyro(sfe_ism_raw_data_t *gyroData) { return readRawVector(ISM330DHCX_OUTX_L_G, gyroData); }
+
+    bool getRawAllSensors(sfe_ism_raw_all_t *allData)
+    {
+        uint8_t buff[14];
+        if (readRegisterRegion(ISM330DHCX_OUT_TEMP_L, buff, sizeof(buff)) != 0)
+            return false;
+        decodeRawAll(buff, allData);
+        return true;
+    }
+
+    // STATUS_REG: XLDA bit 0, GDA bit 1, TDA bit 2
+    bool checkStatus() { return statusBits(0x03); }
+    bool checkAccelStatus() { return statusBits(0x01); }
+    bool checkGyroStatus() { return statusBits(0x02); }
+    bool checkTempStatus() { return statusBits(0x04); }
+
+    uint16_t getFifoLevel()
+    {
+        uint16_t level;
+        return getFifoStatus(&level, nullptr) ? level : 0;
+    }
+
+    bool getFifoStatus(uint16_t *level, bool *overrun)
+    {
+        // FIFO_STATUS1 and the DIFF_FIFO and FIFO_OVR_IA bits of FIFO_STATUS2
+        uint8_t status[2];
+        if (readRegisterRegion(ISM330DHCX_FIFO_STATUS1, status, sizeof(status)) != 0)
+            return false;
+        *level = (uint16_t)(((status[1] & 0x03) << 8) | status[0]);
+        if (overrun)
+            *overrun = (status[1] & 0x40) != 0;
+        return true;
+    }
+
+    uint16_t readFifo(sfe_ism_fifo_word_t *words, uint16_t maxWords, bool *overrun = nullptr)
+    {
+        uint16_t level;
+        if (!getFifoStatus(&level, overrun))
+            return 0;
+        if (level > maxWords)
+            level = maxWords;
+        if (level > 0xFFFF / sizeof(sfe_ism_fifo_word_t))
+            level = 0xFFFF / sizeof(sfe_ism_fifo_word_t);
+        if (level == 0)
+            return 0;
+
+        if (readRegisterRegion(ISM330DHCX_FIFO_DATA_OUT_TAG, (uint8_t *)words, level * sizeof(sfe_ism_fifo_word_t)) != 0)
+            return 0;
+        return level;
+    }
+
+    template <sfe_ism_profile_t P> bool getGyro(sfe_ism_data_t *gyroData)
+    {
+        sfe_ism_raw_data_t rawData;
+        if (!getRawGyro(&rawData))
+            return false;
+        convertGyro<P>(&rawData, gyroData);
+        return true;
+    }
+
+    template <sfe_ism_profile_t P> bool getAccel(sfe_ism_data_t *accelData)
+    {
+        sfe_ism_raw_data_t rawData;
+        if (!getRawAccel(&rawData))
+            return false;
+        convertAccel<P>(&rawData, accelData);
+        return true;
+    }
+
+    // The runtime full scale versions stay on the ST path
+    using QwDevISM330DHCX::getAccel;
+    using QwDevISM330DHCX::getGyro;
+
+  private:
+    bool readRawVector(uint8_t reg, sfe_ism_raw_data_t *data)
+    {
+        uint8_t buff[6];
+        if (readRegisterRegion(reg, buff, sizeof(buff)) != 0)
+            return false;
+        data->xData = (int16_t)((buff[1] << 8) | buff[0]);
+        data->yData = (int16_t)((buff[3] << 8) | buff[2]);
+        data->zData = (int16_t)((buff[5] << 8) | buff[4]);
+        return true;
+    }
+
+    bool statusBits(uint8_t mask)
+    {
+        uint8_t status;
+        if (readRegisterRegion(ISM330DHCX_STATUS_REG, &status, 1) != 0)
+            return false;
+        return (status & mask) == mask;
+    }
+
+    // ST context accessors, resolved at compile time for Bus
+    static int32_t boundWrite(void *handle, uint8_t reg, const uint8_t *bufp, uint16_t len)
+    {
+        return static_cast<QwDevISM330DHCXBound *>((QwDevISM330DHCX *)handle)->writeRegisterRegion(reg, (uint8_t *)bufp, len);
+    }
+
+    static int32_t boundRead(void *handle, uint8_t reg, uint8_t *bufp, uint16_t len)
+    {
+        return static_cast<QwDevISM330DHCXBound *>((QwDevISM330DHCX *)handle)->readRegisterRegion(reg, bufp, len);
+    }
+
+    void bindCtx()
+    {
+        sfe_dev.handle = (QwDevISM330DHCX *)this;
+        sfe_dev.write_reg = boundWrite;
+        sfe_dev.read_reg = boundRead;
+    }
+
+    Bus *_bus = nullptr;
+};
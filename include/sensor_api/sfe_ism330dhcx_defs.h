@@ -117,6 +117,12 @@
 #define ISM_GY_BATCH_AT_6667Hz   0x0A
 #define ISM_GY_BATCH_6Hz5        0x0B
 
+//FIFO Temperature Batch Settings
+#define ISM_TEMP_NOT_BATCHED     0x00
+#define ISM_TEMP_BATCH_AT_52Hz   0x01
+#define ISM_TEMP_BATCH_AT_12Hz5  0x02
+#define ISM_TEMP_BATCH_AT_1Hz6   0x03
+
 //Decimation rate
 #define ISM_NO_DECIMATION 0x00
 #define ISM_DEC_1         0x01
@@ -129,7 +135,25 @@
 #define ISM_BASE_PULSED_EMB_LATCHED   0x02
 #define ISM_ALL_INT_LATCHED           0x03
 
+//Activity / Inactivity Modes
+#define ISM_ACT_OFF                 0x00
+#define ISM_ACT_XL_12Hz5_GY_ON      0x01
+#define ISM_ACT_XL_12Hz5_GY_SLEEP   0x02
+#define ISM_ACT_XL_12Hz5_GY_PD      0x03
+
 #define ISM_SH_ODR_104Hz 0x00
 #define ISM_SH_ODR_52Hz  0x01
 #define ISM_SH_ODR_26Hz  0x02
 #define ISM_SH_ODR_13Hz  0x03
+
+//Machine Learning Core Output Data Rate
+#define ISM_MLC_ODR_12Hz5 0x00
+#define ISM_MLC_ODR_26Hz  0x01
+#define ISM_MLC_ODR_52Hz  0x02
+#define ISM_MLC_ODR_104Hz 0x03
+
+//Finite State Machine Output Data Rate
+#define ISM_FSM_ODR_12Hz5 0x00
+#define ISM_FSM_ODR_26Hz  0x01
+#define ISM_FSM_ODR_52Hz  0x02
+#define ISM_FSM_ODR_104Hz 0x03
@@ -0,0 +1,198 @@
+// sfe_ism330dhcx_profile.h
+//
+// Compile-time device profiles for the ISM330DHCX.
+//
+// A profile describes a fixed device configuration (output data rates, full
+// scales, filters and FIFO batching). When a profile is passed as a template
+// parameter the register image it implies is computed by the compiler, so
+// bring-up is reduced to the handful of register writes that differ from the
+// power-on defaults, and the data conversion used on the hot path collapses to
+// a single constant multiply per axis.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "sfe_ism330dhcx_defs.h"
+#include "st_src/ism330dhcx_reg.h"
+
+struct sfe_ism_reg_write_t
+{
+    uint8_t reg;
+    uint8_t value;
+};
+
+// Structural type, so it can be used directly as a template parameter.
+struct sfe_ism_profile_t
+{
+    uint8_t accelDataRate = ISM_XL_ODR_OFF;
+    uint8_t accelFullScale = ISM_2g;
+    bool accelFilterLP2 = false;
+
+    uint8_t gyroDataRate = ISM_GY_ODR_OFF;
+    uint8_t gyroFullScale = ISM_250dps;
+    bool gyroFilterLP1 = false;
+    uint8_t gyroLP1Bandwidth = ISM_ULTRA_LIGHT;
+
+    bool blockDataUpdate = true;
+    bool deviceConfig = true;
+
+    uint8_t accelFifoBatch = ISM_XL_NOT_BATCHED;
+    uint8_t gyroFifoBatch = ISM_GY_NOT_BATCHED;
+    uint8_t fifoMode = ISM_BYPASS_MODE;
+};
+
+namespace sfe_ism_profile
+{
+
+// Registers touched by a profile. CTRL1_XL..CTRL7_G are contiguous, so the
+// plan for them can be written with auto-increment bursts.
+constexpr size_t kImageLength = 10;
+
+constexpr std::array<uint8_t, kImageLength> kImageRegs = {
+    ISM330DHCX_FIFO_CTRL3, ISM330DHCX_FIFO_CTRL4,
+    ISM330DHCX_CTRL1_XL,   ISM330DHCX_CTRL2_G,
+    ISM330DHCX_CTRL3_C,    ISM330DHCX_CTRL4_C,
+    ISM330DHCX_CTRL5_C,    ISM330DHCX_CTRL6_C,
+    ISM330DHCX_CTRL7_G,    ISM330DHCX_CTRL9_XL,
+};
+
+// Values after a software reset (see the register map in the datasheet).
+constexpr std::array<uint8_t, kImageLength> kResetImage = {
+    0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0xE0,
+};
+
+constexpr bool isValidGyroFullScale(uint8_t fs)
+{
+    return fs == ISM_125dps || fs == ISM_250dps || fs == ISM_500dps ||
+           fs == ISM_1000dps || fs == ISM_2000dps || fs == ISM_4000dps;
+}
+
+constexpr bool isValidFifoMode(uint8_t mode)
+{
+    return mode == ISM_BYPASS_MODE || mode == ISM_FIFO_MODE || mode == ISM_STREAM_TO_FIFO_MODE ||
+           mode == ISM_BYPASS_TO_STREAM_MODE || mode == ISM_STREAM_MODE || mode == ISM_BYPASS_TO_FIFO_MODE;
+}
+
+// Same bounds as the runtime setters in QwDevISM330DHCX
+constexpr bool isValid(const sfe_ism_profile_t &p)
+{
+    return p.accelDataRate <= ISM_XL_ODR_1Hz6 && p.accelFullScale <= ISM_8g &&
+           p.gyroDataRate <= ISM_GY_ODR_6667Hz && isValidGyroFullScale(p.gyroFullScale) &&
+           p.gyroLP1Bandwidth <= ISM_XTREME && p.accelFifoBatch <= ISM_XL_BATCH_6Hz5 &&
+           p.gyroFifoBatch <= ISM_GY_BATCH_6Hz5 && isValidFifoMode(p.fifoMode);
+}
+
+// Sensitivity in mdps/LSB, matching ism330dhcx_from_fsXXXdps_to_mdps()
+constexpr float gyroSensitivity(uint8_t fs)
+{
+    switch (fs)
+    {
+    case ISM_125dps:
+        return 4.375f;
+    case ISM_250dps:
+        return 8.75f;
+    case ISM_500dps:
+        return 17.50f;
+    case ISM_1000dps:
+        return 35.0f;
+    case ISM_2000dps:
+        return 70.0f;
+    case ISM_4000dps:
+        return 140.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+// Sensitivity in mg/LSB, matching ism330dhcx_from_fsXg_to_mg()
+constexpr float accelSensitivity(uint8_t fs)
+{
+    switch (fs)
+    {
+    case ISM_2g:
+        return 0.061f;
+    case ISM_16g:
+        return 0.488f;
+    case ISM_4g:
+        return 0.122f;
+    case ISM_8g:
+        return 0.244f;
+    default:
+        return 0.0f;
+    }
+}
+
+// Nominal gyroscope output data rate in Hz, 0 when powered down
+constexpr float gyroDataRateHz(uint8_t odr)
+{
+    constexpr float kRates[] = {0.0f, 12.5f, 26.0f, 52.0f, 104.0f, 208.0f, 416.0f, 833.0f, 1666.0f, 3332.0f, 6667.0f};
+    return odr <= ISM_GY_ODR_6667Hz ? kRates[odr] : 0.0f;
+}
+
+// Full register image implied by a profile, in kImageRegs order.
+constexpr std::array<uint8_t, kImageLength> registerImage(const sfe_ism_profile_t &p)
+{
+    std::array<uint8_t, kImageLength> image = kResetImage;
+
+    image[0] = (uint8_t)((p.gyroFifoBatch << 4) | (p.accelFifoBatch & 0x0F));
+    image[1] = (uint8_t)(kResetImage[1] | (p.fifoMode & 0x07));
+    image[2] = (uint8_t)((p.accelDataRate << 4) | ((p.accelFullScale & 0x03) << 2) | (p.accelFilterLP2 ? 0x02 : 0x00));
+    image[3] = (uint8_t)((p.gyroDataRate << 4) | (p.gyroFullScale & 0x0F));
+    image[4] = (uint8_t)((kResetImage[4] & ~0x40) | (p.blockDataUpdate ? 0x40 : 0x00));
+    image[5] = (uint8_t)(kResetImage[5] | (p.gyroFilterLP1 ? 0x02 : 0x00));
+    image[7] = (uint8_t)(kResetImage[7] | (p.gyroLP1Bandwidth & 0x07));
+    image[9] = (uint8_t)((kResetImage[9] & ~0x02) | (p.deviceConfig ? 0x02 : 0x00));
+
+    return image;
+}
+
+// Number of registers that differ from their reset value.
+constexpr size_t planLength(const sfe_ism_profile_t &p)
+{
+    const std::array<uint8_t, kImageLength> image = registerImage(p);
+    size_t count = 0;
+    for (size_t i = 0; i < kImageLength; i++)
+        if (image[i] != kResetImage[i])
+            count++;
+    return count;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// registerPlan()
+//
+// Minimal register write sequence that takes a freshly reset device to the
+// configuration described by p: one write per register that differs from
+// reset, sorted by register address so that adjacent registers can be
+// written in a single burst. plan must hold kImageLength entries; returns
+// the number used. For a profile only known at run time (see gyro_config),
+// check isValid() first.
+
+constexpr size_t registerPlan(const sfe_ism_profile_t &p, sfe_ism_reg_write_t *plan)
+{
+    const std::array<uint8_t, kImageLength> image = registerImage(p);
+    size_t n = 0;
+    for (size_t i = 0; i < kImageLength; i++)
+        if (image[i] != kResetImage[i])
+            plan[n++] = {kImageRegs[i], image[i]};
+    return n;
+}
+
+// The same, computed by the compiler for a profile known at compile time
+
+template <sfe_ism_profile_t P>
+constexpr std::array<sfe_ism_reg_write_t, planLength(P)> registerPlan()
+{
+    static_assert(isValid(P), "Invalid ISM330DHCX device profile");
+
+    std::array<sfe_ism_reg_write_t, kImageLength> all{};
+    registerPlan(P, all.data());
+    std::array<sfe_ism_reg_write_t, planLength(P)> plan{};
+    for (size_t i = 0; i < plan.size(); i++)
+        plan[i] = all[i];
+    return plan;
+}
+
+} // namespace sfe_ism_profile
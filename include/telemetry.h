@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_trace.h"
+
+// What the acquisition thread has done for one device so far
+struct DeviceMetrics
+{
+    bool online = true;
+    uint64_t samples = 0;       // Delivered to the sinks
+    uint64_t dropped = 0;       // Missing between delivered samples, see Telemetry::sample()
+    uint64_t not_ready = 0;     // Data-ready polls that came back empty
+    uint64_t bus_errors = 0;    // Failed transfers while working with the device
+    uint64_t faults = 0;        // Times the device went offline
+    uint64_t fifo_overruns = 0; // FIFO drains that found FIFO_OVR_IA set
+    uint16_t fifo_level = 0;    // Words found by the last FIFO drain
+    double rate_hz = 0.0;       // Samples per second, filled in by TelemetryServer
+    LatencyHistogram latency;   // From the data-ready poll to the sample in hand (ns)
+};
+
+///////////////////////////////////////////////////////////////////////
+// Telemetry
+//
+// Per device counters of the acquisition thread, readable from any thread
+// while it runs. Each device has a single writer, so updates are relaxed
+// atomic stores, as in latency_trace: no lock, no read-modify-write and no
+// system call on the acquisition path.
+
+class Telemetry
+{
+public:
+    // Sizes for devices, all online, and clears everything. Not while the
+    // acquisition thread runs.
+    void reset(size_t devices);
+    size_t size() const { return m_devices.size(); }
+
+    // Acquisition thread only
+
+    // Nominal time between samples; a longer gap between two delivered
+    // samples counts the samples that should have been in it as dropped
+    void setInterval(size_t device, double interval_us);
+    void sample(size_t device, int64_t timestamp_us);
+    // The next sample starts a new stream, e.g. after the device slept
+    void restart(size_t device);
+
+    void latency(size_t device, uint64_t ns);
+    void notReady(size_t device);
+    void fifo(size_t device, uint16_t level, bool overrun);
+    void busErrors(size_t device, uint64_t errors);
+    void fault(size_t device); // Went offline
+    void setOnline(size_t device, bool online);
+
+    // Any thread. rate_hz is left at 0.
+    DeviceMetrics snapshot(size_t device) const;
+
+private:
+    struct Device
+    {
+        std::atomic<bool> online{true};
+        std::atomic<uint16_t> fifo_level{0};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> not_ready{0};
+        std::atomic<uint64_t> bus_errors{0};
+        std::atomic<uint64_t> faults{0};
+        std::atomic<uint64_t> fifo_overruns{0};
+
+        std::atomic<uint64_t> buckets[LatencyHistogram::kBuckets] = {};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> min{UINT64_MAX};
+        std::atomic<uint64_t> max{0};
+
+        // Writer only
+        double interval_us = 0.0;
+        int64_t last_us = 0;
+    };
+
+    std::vector<std::unique_ptr<Device>> m_devices;
+};
+
+///////////////////////////////////////////////////////////////////////
+// telemetry
+//
+// Prometheus text exposition (format 0.0.4) of the device metrics, one
+// series per device with labels[device] as its label set (e.g.
+// device="0",address="0x6a"), followed by the latency_trace histograms and
+// counters when the trace has recorded anything.
+
+namespace telemetry
+{
+void writePrometheus(std::ostream &out, const std::vector<DeviceMetrics> &devices,
+                     const std::vector<std::string> &labels);
+} // namespace telemetry
+
+///////////////////////////////////////////////////////////////////////
+// TelemetryServer
+//
+// Serves the metrics of a Telemetry from a thread of its own at the lowest
+// CPU priority, so scrapes never compete with acquisition. The address is a
+// Unix socket path (replaced if it exists) or host:port for TCP, e.g.
+// "127.0.0.1:9464" for Prometheus. A client sending an HTTP GET gets an
+// HTTP response, any other client just the text:
+//
+//     curl --unix-socket /tmp/ism330dhcx.sock http://localhost/metrics
+//     socat - UNIX-CONNECT:/tmp/ism330dhcx.sock
+//
+// Sample rates are measured over the refresh interval.
+
+class TelemetryServer
+{
+public:
+    TelemetryServer() = default;
+    ~TelemetryServer() { stop(); }
+
+    TelemetryServer(const TelemetryServer &) = delete;
+    TelemetryServer &operator=(const TelemetryServer &) = delete;
+
+    // telemetry must outlive the server; labels as for writePrometheus(). A
+    // Unix socket path must be free or hold a stale socket, which is replaced.
+    bool start(const std::string &address, const Telemetry &telemetry, const std::vector<std::string> &labels,
+               int64_t refresh_ms = 1000);
+    void stop();
+
+    bool running() const { return m_thread.joinable(); }
+
+    // The page a client gets now
+    std::string render();
+
+private:
+    void serve();
+    void refresh();
+    void answer(int client);
+
+    const Telemetry *m_telemetry = nullptr;
+    std::vector<std::string> m_labels;
+    std::string m_unix_path;
+    int64_t m_refresh_ns = 0;
+    int m_listen = -1;
+    int m_wake = -1; // eventfd, written by stop()
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::vector<double> m_rates;         // Guarded by m_mutex
+    std::vector<uint64_t> m_last_samples; // Guarded by m_mutex
+    int64_t m_last_refresh = 0;          // Guarded by m_mutex
+};
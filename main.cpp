@@ -1,25 +1,58 @@
 #include "gyro.h"
+#include "gyro_config.h"
 
 #include <fstream>
+// Usage: sparkfun_ism330dhcx <config.json>
+//        sparkfun_ism330dhcx <log folder> <frequency>
 int main(int argc, char **argv)
 {
-	std::filesystem::path log_folder_path = std::filesystem::path(argv[1]);
+  GyroConfig config;
+  if (argc == 2)
+  {
+    std::string error;
+    if (!gyro_config::load(argv[1], &config, &error))
+    {
+      std::cerr << "Invalid configuration " << argv[1] << ": " << error << "\n";
+      return 1;
+    }
+  }
+  else if (argc == 3)
+  {
+    config.log_folder = argv[1];
+    config.record_hz = std::stoi(argv[2]); // Desired frequency in Hz
+  }
+  else
+  {
+    std::cerr << "Usage: " << argv[0] << " <config.json> | <log folder> <frequency>\n";
+    return 1;
+  }
+
+	std::filesystem::path log_folder_path = config.log_folder;
 	if (!std::filesystem::exists(log_folder_path))
-		std::filesystem::create_directory(log_folder_path);
+		std::filesystem::create_directories(log_folder_path);
 	else
 		std::cout << "[WARNING] Log folder already exists. Data will be appended to existing files.\n";
 
   std::cout << "Initializing gyro...\n";
-  GyroAPI gyro_api = GyroAPI();
-  gyro_api.add_device(ISM330DHCX_ADDRESS_LOW); // Soldered address
-  gyro_api.add_device(ISM330DHCX_ADDRESS_HIGH); // Default (unsoldered) address
+  // The configured buses, or every ISM330DHCX on every CH341 adapter
+  BusTopology topology = gyro_config::topology(config);
+  if (topology.empty())
+  {
+    std::cerr << "No ISM330DHCX found on any " << config.discover << " adapter\n";
+    return 1;
+  }
+  GyroAPI gyro_api(topology, config.profile);
+  if (!gyro_config::apply(config, &gyro_api))
+  {
+    std::cerr << "Cannot apply the configuration or open sample bus " << config.sample_bus << "\n";
+    return 1;
+  }
 
-  int frequency = std::stoi(argv[2]); // Desired frequency in Hz
-  gyro_api.setRecord(true, frequency);
-  gyro_api.startUpdateLoop(argv[1]);
+  std::string folder = log_folder_path.string();
+  gyro_api.startUpdateLoop(folder.data());
   std::cout << "Started recording. Press Enter to stop.\n";
 
   std::cin.get();
-  gyro_api.stopUpdateLoop(); 
-	return 0; 
+  gyro_api.stopUpdateLoop();
+	return 0;
 }
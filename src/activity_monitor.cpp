@@ -0,0 +1,16 @@
+#include "activity_monitor.h"
+
+bool ActivityMonitor::observe(int64_t t, bool asleep)
+{
+  bool changed = asleep != m_asleep;
+  if (changed && asleep)
+    m_sleep_start = t;
+  else if (changed)
+  {
+    m_sleep_time += t - m_sleep_start;
+    m_wake_ups++;
+  }
+  m_asleep = asleep;
+  m_next_check = t + (asleep ? m_sleep_check : m_active_check);
+  return changed;
+}
@@ -0,0 +1,231 @@
+#include <cstdio>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "async_device.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// EventLoop
+
+// Coroutine owning a spawned task; frees itself when the task is done
+struct EventLoop::Detached
+{
+  struct promise_type
+  {
+    Detached get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+EventLoop::Detached EventLoop::detach(EventLoop *loop, Task<void> task)
+{
+  co_await task;
+  loop->m_pending--;
+}
+
+EventLoop::EventLoop()
+{
+  m_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_event_fd < 0 || m_epoll_fd < 0)
+  {
+    perror("Failed to create the event loop");
+    return;
+  }
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = m_event_fd;
+  epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &event);
+}
+
+EventLoop::~EventLoop()
+{
+  if (m_epoll_fd >= 0)
+    close(m_epoll_fd);
+  if (m_event_fd >= 0)
+    close(m_event_fd);
+}
+
+void EventLoop::spawn(Task<void> task)
+{
+  m_pending++;
+  post(detach(this, std::move(task)).handle);
+}
+
+void EventLoop::post(std::coroutine_handle<> handle)
+{
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    wake = m_ready.empty();
+    m_ready.push_back(handle);
+  }
+
+  // One wakeup per batch: the loop drains the whole queue each time
+  if (wake)
+  {
+    uint64_t one = 1;
+    if (write(m_event_fd, &one, sizeof(one)) < 0)
+      perror("Failed to wake the event loop");
+  }
+}
+
+void EventLoop::run()
+{
+  std::vector<std::coroutine_handle<>> batch;
+  while (m_pending > 0)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      batch.swap(m_ready);
+    }
+
+    if (batch.empty())
+    {
+      epoll_event event;
+      if (epoll_wait(m_epoll_fd, &event, 1, -1) > 0)
+      {
+        uint64_t count;
+        if (read(m_event_fd, &count, sizeof(count)) < 0)
+          continue;
+      }
+      continue;
+    }
+
+    for (std::coroutine_handle<> handle : batch)
+      handle.resume();
+    batch.clear();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// AsyncBus
+
+AsyncBus::AsyncBus(EventLoop &loop, sfe_ISM330DHCX::QwIDeviceBus &bus) : m_loop(loop), m_bus(bus)
+{
+  m_thread = std::thread(&AsyncBus::worker, this);
+}
+
+AsyncBus::~AsyncBus()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_one();
+  m_thread.join();
+}
+
+void AsyncBus::submit(Transfer *transfer)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back(transfer);
+  }
+  m_wake.notify_one();
+}
+
+void AsyncBus::worker()
+{
+  while (true)
+  {
+    Transfer *transfer;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+      if (m_queue.empty())
+        return;
+      transfer = m_queue.front();
+      m_queue.pop_front();
+    }
+
+    if (transfer->write)
+      transfer->result = m_bus.writeRegisterRegion(transfer->address, transfer->reg, transfer->data, transfer->length);
+    else
+      transfer->result = m_bus.readRegisterRegion(transfer->address, transfer->reg, transfer->data, transfer->length);
+
+    m_loop.post(transfer->handle);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// AsyncISM330DHCX
+
+AsyncISM330DHCX::AsyncISM330DHCX(AsyncBus &bus, uint8_t address, uint8_t gyroFullScale, uint8_t accelFullScale)
+    : m_bus(bus), m_address(address),
+      m_gyro_sensitivity(sfe_ism_profile::gyroSensitivity(gyroFullScale)),
+      m_accel_sensitivity(sfe_ism_profile::accelSensitivity(accelFullScale))
+{
+}
+
+Task<bool> AsyncISM330DHCX::gyroReadyAsync()
+{
+  uint8_t status;
+  if (co_await m_bus.read(m_address, ISM330DHCX_STATUS_REG, &status, 1) != 0)
+    co_return false;
+  co_return (status & 0x02) != 0;
+}
+
+Task<bool> AsyncISM330DHCX::readVector(uint8_t reg, float sensitivity, sfe_ism_data_t *data)
+{
+  uint8_t buff[6];
+  if (co_await m_bus.read(m_address, reg, buff, sizeof(buff)) != 0)
+    co_return false;
+
+  data->xData = (float)(int16_t)((buff[1] << 8) | buff[0]) * sensitivity;
+  data->yData = (float)(int16_t)((buff[3] << 8) | buff[2]) * sensitivity;
+  data->zData = (float)(int16_t)((buff[5] << 8) | buff[4]) * sensitivity;
+  co_return true;
+}
+
+Task<bool> AsyncISM330DHCX::readGyroAsync(sfe_ism_data_t *gyroData)
+{
+  co_return co_await readVector(ISM330DHCX_OUTX_L_G, m_gyro_sensitivity, gyroData);
+}
+
+Task<bool> AsyncISM330DHCX::readAccelAsync(sfe_ism_data_t *accelData)
+{
+  co_return co_await readVector(ISM330DHCX_OUTX_L_A, m_accel_sensitivity, accelData);
+}
+
+Task<bool> AsyncISM330DHCX::readRawAllAsync(sfe_ism_raw_all_t *allData)
+{
+  uint8_t buff[14];
+  if (co_await m_bus.read(m_address, ISM330DHCX_OUT_TEMP_L, buff, sizeof(buff)) != 0)
+    co_return false;
+
+  allData->temp = (int16_t)((buff[1] << 8) | buff[0]);
+  allData->gyro.xData = (int16_t)((buff[3] << 8) | buff[2]);
+  allData->gyro.yData = (int16_t)((buff[5] << 8) | buff[4]);
+  allData->gyro.zData = (int16_t)((buff[7] << 8) | buff[6]);
+  allData->accel.xData = (int16_t)((buff[9] << 8) | buff[8]);
+  allData->accel.yData = (int16_t)((buff[11] << 8) | buff[10]);
+  allData->accel.zData = (int16_t)((buff[13] << 8) | buff[12]);
+  co_return true;
+}
+
+Task<uint16_t> AsyncISM330DHCX::readFifoAsync(sfe_ism_fifo_word_t *words, uint16_t maxWords)
+{
+  // FIFO_STATUS1 and the DIFF_FIFO bits of FIFO_STATUS2
+  uint8_t status[2];
+  if (co_await m_bus.read(m_address, ISM330DHCX_FIFO_STATUS1, status, sizeof(status)) != 0)
+    co_return 0;
+
+  uint16_t level = (uint16_t)(((status[1] & 0x03) << 8) | status[0]);
+  if (level > maxWords)
+    level = maxWords;
+  if (level == 0)
+    co_return 0;
+
+  if (co_await m_bus.read(m_address, ISM330DHCX_FIFO_DATA_OUT_TAG, (uint8_t *)words,
+                          level * sizeof(sfe_ism_fifo_word_t)) != 0)
+    co_return 0;
+  co_return level;
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "calibration.h"
+
+// 1 g in mg
+static const float kGravity = 1000.0f;
+
+// User offset register weights in mg/LSB (2^-10 g and 2^-6 g)
+static const float kFineOffsetWeight = 1000.0f / 1024.0f;
+static const float kCoarseOffsetWeight = 1000.0f / 64.0f;
+
+// Temperature spread (degC^2 variance) needed before fitting a slope
+static const double kMinTempVariance = 1.0;
+
+void StillPeriod::reset()
+{
+  *this = StillPeriod();
+}
+
+void StillPeriod::add(const SampleRecord &sample)
+{
+  const double values[7] = {sample.gx, sample.gy, sample.gz, sample.ax, sample.ay, sample.az, sample.temp};
+
+  m_count++;
+  for (int i = 0; i < 7; i++)
+  {
+    double delta = values[i] - m_mean[i];
+    m_mean[i] += delta / m_count;
+    if (i < 3)
+      m_m2[i] += delta * (values[i] - m_mean[i]);
+  }
+}
+
+void StillPeriod::mean(float gyro[3], float accel[3], float *temp) const
+{
+  for (int i = 0; i < 3; i++)
+  {
+    gyro[i] = (float)m_mean[i];
+    accel[i] = (float)m_mean[i + 3];
+  }
+  *temp = (float)m_mean[6];
+}
+
+float StillPeriod::gyroStdDev() const
+{
+  if (m_count < 2)
+    return 0.0f;
+
+  double worst = 0.0;
+  for (int i = 0; i < 3; i++)
+    worst = std::max(worst, m_m2[i] / (m_count - 1));
+  return (float)std::sqrt(worst);
+}
+
+void DeviceCalibration::addObservation(float temp, const float gyro_bias[3])
+{
+  reference_temp = temp;
+  std::copy(gyro_bias, gyro_bias + 3, bias);
+
+  n += 1;
+  sum_t += temp;
+  sum_tt += (double)temp * temp;
+  for (int i = 0; i < 3; i++)
+  {
+    sum_b[i] += gyro_bias[i];
+    sum_tb[i] += (double)temp * gyro_bias[i];
+  }
+}
+
+void DeviceCalibration::fit()
+{
+  if (n < 1)
+    return;
+
+  double mean_t = sum_t / n;
+  double var_t = sum_tt / n - mean_t * mean_t;
+
+  for (int i = 0; i < 3; i++)
+  {
+    double mean_b = sum_b[i] / n;
+    double cov_tb = sum_tb[i] / n - mean_t * mean_b;
+    // With every observation at about the same temperature only the offset
+    // is observable
+    slope[i] = var_t >= kMinTempVariance ? (float)(cov_tb / var_t) : 0.0f;
+  }
+}
+
+void DeviceCalibration::computeAccelOffset(const float mean_accel[3])
+{
+  // Gravity is assumed to lie on the axis reading the largest magnitude
+  int up = 0;
+  for (int i = 1; i < 3; i++)
+    if (std::fabs(mean_accel[i]) > std::fabs(mean_accel[up]))
+      up = i;
+
+  float offset_mg[3];
+  float largest = 0.0f;
+  for (int i = 0; i < 3; i++)
+  {
+    float expected = i == up ? std::copysign(kGravity, mean_accel[i]) : 0.0f;
+    offset_mg[i] = mean_accel[i] - expected;
+    largest = std::max(largest, std::fabs(offset_mg[i]));
+  }
+
+  accel_coarse = largest / kFineOffsetWeight > 127.0f;
+  float weight = accel_coarse ? kCoarseOffsetWeight : kFineOffsetWeight;
+  for (int i = 0; i < 3; i++)
+  {
+    float lsb = std::round(offset_mg[i] / weight);
+    accel_offset[i] = (int8_t)std::max(-127.0f, std::min(127.0f, lsb));
+  }
+}
+
+std::filesystem::path DeviceCalibration::pathFor(const std::filesystem::path &directory, const std::string &bus,
+                                                 uint8_t address)
+{
+  // Anything but letters and digits becomes one underscore
+  std::string key;
+  for (char c : bus)
+  {
+    if (std::isalnum((unsigned char)c))
+      key += c;
+    else if (!key.empty() && key.back() != '_')
+      key += '_';
+  }
+  if (!key.empty() && key.back() == '_')
+    key.pop_back();
+
+  char name[16];
+  std::snprintf(name, sizeof(name), "0x%02x.txt", address);
+  return directory / ("calibration_" + (key.empty() ? "" : key + "_") + name);
+}
+
+bool DeviceCalibration::save(const std::filesystem::path &path) const
+{
+  std::ofstream file(path);
+  if (!file)
+    return false;
+
+  file.precision(17);
+  file << "address " << (int)address << "\n"
+       << "reference_temp " << reference_temp << "\n"
+       << "bias " << bias[0] << " " << bias[1] << " " << bias[2] << "\n"
+       << "slope " << slope[0] << " " << slope[1] << " " << slope[2] << "\n"
+       << "sums " << n << " " << sum_t << " " << sum_tt << "\n"
+       << "sum_b " << sum_b[0] << " " << sum_b[1] << " " << sum_b[2] << "\n"
+       << "sum_tb " << sum_tb[0] << " " << sum_tb[1] << " " << sum_tb[2] << "\n"
+       << "accel_offset " << (int)accel_offset[0] << " " << (int)accel_offset[1] << " " << (int)accel_offset[2] << "\n"
+       << "accel_coarse " << (int)accel_coarse << "\n";
+  return (bool)file;
+}
+
+bool DeviceCalibration::load(const std::filesystem::path &path)
+{
+  std::ifstream file(path);
+  if (!file)
+    return false;
+
+  DeviceCalibration loaded;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+
+    if (key == "address")
+    {
+      int value;
+      fields >> value;
+      loaded.address = (uint8_t)value;
+    }
+    else if (key == "reference_temp")
+      fields >> loaded.reference_temp;
+    else if (key == "bias")
+      fields >> loaded.bias[0] >> loaded.bias[1] >> loaded.bias[2];
+    else if (key == "slope")
+      fields >> loaded.slope[0] >> loaded.slope[1] >> loaded.slope[2];
+    else if (key == "sums")
+      fields >> loaded.n >> loaded.sum_t >> loaded.sum_tt;
+    else if (key == "sum_b")
+      fields >> loaded.sum_b[0] >> loaded.sum_b[1] >> loaded.sum_b[2];
+    else if (key == "sum_tb")
+      fields >> loaded.sum_tb[0] >> loaded.sum_tb[1] >> loaded.sum_tb[2];
+    else if (key == "accel_offset")
+    {
+      int x, y, z;
+      fields >> x >> y >> z;
+      loaded.accel_offset[0] = (int8_t)x;
+      loaded.accel_offset[1] = (int8_t)y;
+      loaded.accel_offset[2] = (int8_t)z;
+    }
+    else if (key == "accel_coarse")
+    {
+      int value;
+      fields >> value;
+      loaded.accel_coarse = value != 0;
+    }
+
+    if (fields.fail())
+      return false;
+  }
+
+  *this = loaded;
+  return true;
+}
+
+void GyroCalibration::resize(size_t num_devices)
+{
+  for (std::vector<float> *column : {&m_t0, &m_bias_x, &m_bias_y, &m_bias_z, &m_slope_x, &m_slope_y, &m_slope_z})
+    column->assign(num_devices, 0.0f);
+}
+
+void GyroCalibration::setModel(size_t device, const DeviceCalibration &calibration)
+{
+  if (device >= m_t0.size())
+    return;
+
+  m_t0[device] = calibration.reference_temp;
+  m_bias_x[device] = calibration.bias[0];
+  m_bias_y[device] = calibration.bias[1];
+  m_bias_z[device] = calibration.bias[2];
+  m_slope_x[device] = calibration.slope[0];
+  m_slope_y[device] = calibration.slope[1];
+  m_slope_z[device] = calibration.slope[2];
+}
+
+void GyroCalibration::apply(std::vector<SampleRecord> &sweep, const std::vector<uint8_t> &acquired) const
+{
+  const size_t n = std::min(sweep.size(), m_t0.size());
+
+  for (size_t i = 0; i < n; i++)
+  {
+    // Devices without a new sample get a zero correction instead of a branch
+    float mask = acquired[i] ? 1.0f : 0.0f;
+    float dT = sweep[i].temp - m_t0[i];
+    sweep[i].gx -= mask * (m_bias_x[i] + m_slope_x[i] * dT);
+    sweep[i].gy -= mask * (m_bias_y[i] + m_slope_y[i] * dT);
+    sweep[i].gz -= mask * (m_bias_z[i] + m_slope_z[i] * dT);
+  }
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cmath>
+
+#include "clock_sync.h"
+
+void DeviceClock::reset(int64_t host_ns, int8_t fine)
+{
+  m_anchor = host_ns;
+  m_nominal_tick_ns = kNominalTickNs / (1.0 + 0.0015 * fine);
+  m_tick_ns = m_nominal_tick_ns;
+  m_unwrapped = 0;
+  m_block_open = false;
+  m_blocks.clear();
+}
+
+uint64_t DeviceClock::unwrap(uint32_t ticks)
+{
+  uint32_t last = (uint32_t)m_unwrapped;
+  m_unwrapped += (uint32_t)(ticks - last);
+  return m_unwrapped;
+}
+
+void DeviceClock::observe(uint64_t ticks, int64_t host_ns)
+{
+  // Against the calibrated rate, so residuals of all blocks are comparable
+  double residual = (double)(host_ns - m_anchor) - ticks * m_nominal_tick_ns;
+  uint64_t block = ticks / kBlockTicks;
+
+  if (m_block_open && block == m_block)
+  {
+    if (residual < m_current.residual)
+      m_current = {ticks, residual};
+    return;
+  }
+
+  if (m_block_open)
+  {
+    // A full ring drops the oldest block
+    m_blocks.push(m_current);
+
+    // Least squares slope of the block minima is the rate error per count
+    if (m_blocks.size() >= 3)
+    {
+      double n = (double)m_blocks.size(), mean_t = 0.0, mean_r = 0.0;
+      for (size_t i = 0; i < m_blocks.size(); i++)
+      {
+        mean_t += m_blocks[i].ticks / n;
+        mean_r += m_blocks[i].residual / n;
+      }
+      double stt = 0.0, str = 0.0;
+      for (size_t i = 0; i < m_blocks.size(); i++)
+      {
+        const Block &b = m_blocks[i];
+        double dt = b.ticks - mean_t;
+        stt += dt * dt;
+        str += dt * (b.residual - mean_r);
+      }
+      if (stt > 0.0)
+        m_tick_ns = m_nominal_tick_ns + str / stt;
+    }
+  }
+  m_block = block;
+  m_block_open = true;
+  m_current = {ticks, residual};
+}
+
+StreamAligner::StreamAligner(size_t num_devices, double period_us, SyncFrameSink sink, double max_gap_us)
+    : m_period(period_us), m_max_gap(max_gap_us > 0.0 ? max_gap_us : period_us), m_sink(std::move(sink)),
+      m_queues(num_devices), m_active(num_devices, true)
+{
+  // One more than kMaxQueue, so an overflowing queue is seen before it drops
+  for (FixedRing<SampleRecord> &queue : m_queues)
+    queue.reset(kMaxQueue + 1);
+  m_frame.samples.resize(num_devices);
+  m_frame.valid.resize(num_devices);
+}
+
+void StreamAligner::push(size_t device, const SampleRecord &sample)
+{
+  if (device >= m_queues.size() || m_period <= 0.0 || !m_active[device])
+    return;
+  m_queues[device].push(sample);
+  emit();
+}
+
+void StreamAligner::setActive(size_t device, bool active)
+{
+  if (device >= m_queues.size() || (bool)m_active[device] == active)
+    return;
+  m_active[device] = active;
+  if (active)
+    return;
+
+  // What it had queued is as stale as the frames it no longer holds back
+  m_queues[device].clear();
+  if (m_period > 0.0)
+    emit();
+}
+
+static float lerp(float a, float b, float f)
+{
+  return a + (b - a) * f;
+}
+
+void StreamAligner::emit()
+{
+  if (!m_started)
+  {
+    // First frame at the first grid time every active device has reached
+    int64_t latest = INT64_MIN;
+    for (size_t d = 0; d < m_queues.size(); d++)
+    {
+      if (!m_active[d])
+        continue;
+      if (m_queues[d].empty())
+        return;
+      latest = std::max(latest, m_queues[d].front().timestamp);
+    }
+    if (latest == INT64_MIN)
+      return;
+    m_next = (int64_t)std::ceil(latest / m_period);
+    m_started = true;
+  }
+
+  while (true)
+  {
+    double t = m_next * m_period;
+    bool ready = true, active = false, overflow = false;
+    for (size_t d = 0; d < m_queues.size(); d++)
+    {
+      const FixedRing<SampleRecord> &queue = m_queues[d];
+      overflow = overflow || queue.size() > kMaxQueue;
+      if (!m_active[d])
+        continue;
+      active = true;
+      ready = ready && !queue.empty() && queue.back().timestamp >= t;
+    }
+    if (!(ready && active) && !overflow)
+      return;
+
+    bool any = false;
+    for (size_t d = 0; d < m_queues.size(); d++)
+    {
+      FixedRing<SampleRecord> &queue = m_queues[d];
+      m_frame.valid[d] = false;
+      if (!m_active[d])
+        continue;
+      while (queue.size() >= 2 && queue[1].timestamp <= t)
+        queue.pop_front();
+
+      if (queue.empty() || queue[0].timestamp > t || (queue.size() < 2 && queue[0].timestamp < t))
+      {
+        // Behind the others, or not started yet
+        if (!queue.empty())
+          m_frame.samples[d] = queue.front();
+        continue;
+      }
+
+      // A sample exactly at t is its own right neighbour
+      const SampleRecord &a = queue[0], &b = queue.size() < 2 ? queue[0] : queue[1];
+      double span = (double)(b.timestamp - a.timestamp);
+      float f = span > 0.0 ? (float)((t - a.timestamp) / span) : 0.0f;
+      SampleRecord &out = m_frame.samples[d];
+      out.gx = lerp(a.gx, b.gx, f);
+      out.gy = lerp(a.gy, b.gy, f);
+      out.gz = lerp(a.gz, b.gz, f);
+      out.ax = lerp(a.ax, b.ax, f);
+      out.ay = lerp(a.ay, b.ay, f);
+      out.az = lerp(a.az, b.az, f);
+      out.temp = lerp(a.temp, b.temp, f);
+
+      // Take the shorter way round between the two quaternions
+      float sign = a.qw * b.qw + a.qx * b.qx + a.qy * b.qy + a.qz * b.qz < 0.0f ? -1.0f : 1.0f;
+      out.qw = lerp(a.qw, sign * b.qw, f);
+      out.qx = lerp(a.qx, sign * b.qx, f);
+      out.qy = lerp(a.qy, sign * b.qy, f);
+      out.qz = lerp(a.qz, sign * b.qz, f);
+      float norm = std::sqrt(out.qw * out.qw + out.qx * out.qx + out.qy * out.qy + out.qz * out.qz);
+      if (norm > 0.0f)
+      {
+        out.qw /= norm;
+        out.qx /= norm;
+        out.qy /= norm;
+        out.qz /= norm;
+      }
+
+      out.timestamp = (int64_t)std::llround(t);
+      m_frame.valid[d] = span <= m_max_gap;
+      any = true;
+    }
+
+    m_frame.timestamp = (int64_t)std::llround(t);
+    m_next++;
+    if (any && m_sink)
+    {
+      m_sink(m_frame);
+      m_frames++;
+    }
+  }
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+
+#include "decimator.h"
+
+namespace
+{
+const double kPi = 3.14159265358979323846;
+
+// Modified Bessel function of the first kind, order 0
+double besselI0(double x)
+{
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 50 && term > 1e-12 * sum; k++)
+  {
+    double half = x / (2.0 * k);
+    term *= half * half;
+    sum += term;
+  }
+  return sum;
+}
+
+// Kept as a free function over restrict pointers so that the compiler can
+// vectorise the channel loop
+void firFrames(size_t taps, const float *__restrict h, const float *__restrict frames, float *__restrict acc)
+{
+  for (size_t c = 0; c < Decimator::kChannels; c++)
+    acc[c] = 0.0f;
+  for (size_t k = 0; k < taps; k++)
+    for (size_t c = 0; c < Decimator::kChannels; c++)
+      acc[c] += h[k] * frames[k * Decimator::kChannels + c];
+}
+} // namespace
+
+namespace fir
+{
+std::vector<float> kaiserLowpass(double pass, double stop, double attenuation_db)
+{
+  // Kaiser's estimates of the length and window shape
+  double transition = stop - pass;
+  size_t n = (size_t)std::ceil((attenuation_db - 7.95) / (2.285 * 2.0 * kPi * transition)) + 1;
+  n |= 1;
+  double beta = attenuation_db > 50.0   ? 0.1102 * (attenuation_db - 8.7)
+                : attenuation_db > 21.0 ? 0.5842 * std::pow(attenuation_db - 21.0, 0.4) + 0.07886 * (attenuation_db - 21.0)
+                                        : 0.0;
+
+  double cutoff = (pass + stop) / 2.0;
+  double middle = (n - 1) / 2.0;
+  std::vector<double> h(n);
+  double sum = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    double t = i - middle;
+    double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * kPi * cutoff * t) / (kPi * t);
+    double r = t / middle;
+    h[i] = sinc * besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+    sum += h[i];
+  }
+
+  std::vector<float> taps(n);
+  for (size_t i = 0; i < n; i++)
+    taps[i] = (float)(h[i] / sum);
+  return taps;
+}
+
+std::vector<float> decimationFilter(unsigned factor, double attenuation_db)
+{
+  if (factor <= 1)
+    return {1.0f};
+  return kaiserLowpass(0.3 / factor, 0.5 / factor, attenuation_db);
+}
+} // namespace fir
+
+Decimator::Decimator(unsigned factor, std::vector<float> taps) : m_factor(std::max(1u, factor)), m_taps(std::move(taps))
+{
+  if (m_taps.empty())
+    m_taps = {1.0f};
+  m_history.resize(2 * m_taps.size() * kChannels);
+  m_delayed.resize(delay() + 1);
+}
+
+void Decimator::reset()
+{
+  m_count = 0;
+  m_pos = 0;
+}
+
+bool Decimator::push(const SampleRecord &in, SampleRecord *out)
+{
+  const size_t taps = m_taps.size();
+  const float frame[kChannels] = {in.gx, in.gy, in.gz, in.ax, in.ay, in.az, in.temp, 0.0f};
+
+  if (m_count == 0)
+  {
+    for (size_t i = 0; i < 2 * taps; i++)
+      std::copy(frame, frame + kChannels, &m_history[i * kChannels]);
+    std::fill(m_delayed.begin(), m_delayed.end(), in);
+  }
+
+  // Newest frame at m_pos + taps - 1, written to both copies
+  std::copy(frame, frame + kChannels, &m_history[m_pos * kChannels]);
+  std::copy(frame, frame + kChannels, &m_history[(m_pos + taps) * kChannels]);
+  m_pos = m_pos + 1 == taps ? 0 : m_pos + 1;
+  m_delayed[m_count % m_delayed.size()] = in;
+
+  bool produce = m_count % m_factor == 0;
+  m_count++;
+  if (!produce)
+    return false;
+
+  float acc[kChannels];
+  firFrames(taps, m_taps.data(), &m_history[m_pos * kChannels], acc);
+
+  // The input delay() samples back, the oldest entry of m_delayed
+  *out = m_delayed[m_count % m_delayed.size()];
+  out->gx = acc[0];
+  out->gy = acc[1];
+  out->gz = acc[2];
+  out->ax = acc[3];
+  out->ay = acc[4];
+  out->az = acc[5];
+  out->temp = acc[6];
+  return true;
+}
+
+void MultiRatePipeline::resize(size_t num_devices)
+{
+  m_num_devices = num_devices;
+  for (Output &output : m_outputs)
+    output.decimators.assign(num_devices, Decimator(output.factor, output.taps));
+}
+
+size_t MultiRatePipeline::addOutput(unsigned factor, DecimatedSink sink)
+{
+  return addOutput(factor, fir::decimationFilter(factor), std::move(sink));
+}
+
+size_t MultiRatePipeline::addOutput(unsigned factor, std::vector<float> taps, DecimatedSink sink)
+{
+  Output output = {std::max(1u, factor), std::move(taps), std::move(sink), {}};
+  output.decimators.assign(m_num_devices, Decimator(output.factor, output.taps));
+  m_outputs.push_back(std::move(output));
+  return m_outputs.size() - 1;
+}
+
+void MultiRatePipeline::push(size_t device, const SampleRecord &sample)
+{
+  SampleRecord out;
+  for (Output &output : m_outputs)
+    if (device < output.decimators.size() && output.decimators[device].push(sample, &out))
+      output.sink(device, out);
+}
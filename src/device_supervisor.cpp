@@ -0,0 +1,31 @@
+#include <algorithm>
+
+#include "device_supervisor.h"
+
+bool DeviceSupervisor::observe(int64_t t, uint64_t errors)
+{
+  if (!m_online || errors == 0)
+    return false;
+  m_online = false;
+  m_offline_since = t;
+  m_retry_interval = kFirstRetry;
+  m_next_retry = t + m_retry_interval;
+  m_faults++;
+  return true;
+}
+
+void DeviceSupervisor::recovered(int64_t t, bool ok)
+{
+  if (m_online)
+    return;
+  m_attempts++;
+  if (ok)
+  {
+    if (m_faults > 0)
+      m_downtime += t - m_offline_since;
+    m_online = true;
+    return;
+  }
+  m_retry_interval = std::min(2 * m_retry_interval, kMaxRetry);
+  m_next_retry = t + m_retry_interval;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cctype>
+#include <fcntl.h>
+#include <fstream>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+
+#include "discovery.h"
+#include "sfe_ism330dhcx.h"
+
+namespace
+{
+std::string lower(std::string text)
+{
+  std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+  return text;
+}
+
+// Adapter number of an i2c-N entry, -1 for anything else
+int adapterNumber(const std::string &entry)
+{
+  if (entry.compare(0, 4, "i2c-") != 0 || entry.size() == 4 ||
+      !std::all_of(entry.begin() + 4, entry.end(), [](unsigned char c) { return std::isdigit(c); }))
+    return -1;
+  return std::stoi(entry.substr(4));
+}
+
+// WHO_AM_I of the device at address, with a repeated start where the adapter
+// supports it
+bool readWhoAmI(int fd, bool combined, uint8_t address, uint8_t *id)
+{
+  uint8_t reg = ISM330DHCX_WHO_AM_I;
+  if (combined)
+  {
+    i2c_msg messages[2] = {{address, 0, 1, &reg}, {address, I2C_M_RD, 1, id}};
+    i2c_rdwr_ioctl_data transfer = {messages, 2};
+    return ioctl(fd, I2C_RDWR, &transfer) == 2;
+  }
+  return ioctl(fd, I2C_SLAVE, address) >= 0 && ::write(fd, &reg, 1) == 1 && ::read(fd, id, 1) == 1;
+}
+} // namespace
+
+namespace discovery
+{
+std::vector<I2cBus> adapters(const std::string &filter, const std::filesystem::path &sysfs,
+                             const std::filesystem::path &dev)
+{
+  std::vector<std::pair<int, I2cBus>> found;
+  std::error_code ec;
+  for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(sysfs, ec))
+  {
+    std::string entry_name = entry.path().filename().string();
+    int number = adapterNumber(entry_name);
+    if (number < 0)
+      continue;
+
+    std::string name;
+    std::ifstream name_file(entry.path() / "name");
+    std::getline(name_file, name);
+    if (!filter.empty() && lower(name).find(lower(filter)) == std::string::npos)
+      continue;
+    found.push_back({number, {(dev / entry_name).string(), name, {}}});
+  }
+
+  std::sort(found.begin(), found.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+  std::vector<I2cBus> buses;
+  for (auto &bus : found)
+    buses.push_back(std::move(bus.second));
+  return buses;
+}
+
+bool probe(I2cBus *bus)
+{
+  bus->addresses.clear();
+  int fd = open(bus->path.c_str(), O_RDWR);
+  if (fd < 0)
+    return false;
+
+  unsigned long functions = 0;
+  bool combined = ioctl(fd, I2C_FUNCS, &functions) >= 0 && (functions & I2C_FUNC_I2C);
+  for (uint8_t address : {ISM330DHCX_ADDRESS_LOW, ISM330DHCX_ADDRESS_HIGH})
+  {
+    uint8_t id = 0;
+    if (readWhoAmI(fd, combined, address, &id) && id == ISM330DHCX_ID)
+      bus->addresses.push_back(address);
+  }
+  close(fd);
+  return true;
+}
+
+BusTopology scan(const std::string &filter, const std::filesystem::path &sysfs, const std::filesystem::path &dev)
+{
+  BusTopology buses = adapters(filter, sysfs, dev);
+  std::vector<std::thread> probes;
+  for (I2cBus &bus : buses)
+    probes.emplace_back([&bus]() { probe(&bus); });
+  for (std::thread &thread : probes)
+    thread.join();
+
+  buses.erase(std::remove_if(buses.begin(), buses.end(), [](const I2cBus &bus) { return bus.addresses.empty(); }),
+              buses.end());
+  return buses;
+}
+} // namespace discovery
@@ -0,0 +1,66 @@
+#include <cstring>
+
+#include "fifo_decoder.h"
+
+namespace
+{
+// FIFO_DATA_OUT_TAG sensor field (tag >> 3), see ism330dhcx_fifo_tag_t
+enum : uint8_t
+{
+  kTagGyro = 0x01,
+  kTagAccel = 0x02,
+  kTagTemp = 0x03,
+  kTagTimestamp = 0x04,
+  kTagHubSlave0 = 0x0E,
+  kTagHubSlave3 = 0x11,
+  kTagHubNack = 0x19,
+};
+
+sfe_ism_raw_data_t rawAxes(const uint8_t *data)
+{
+  return {(int16_t)(data[0] | data[1] << 8), (int16_t)(data[2] | data[3] << 8), (int16_t)(data[4] | data[5] << 8)};
+}
+} // namespace
+
+size_t FifoDecoder::decode(const sfe_ism_fifo_word_t *words, size_t count, std::vector<FifoSample> *samples)
+{
+  size_t added = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    const sfe_ism_fifo_word_t &word = words[i];
+    uint8_t tag = word.tag >> 3;
+    if (tag == kTagGyro)
+    {
+      m_latest.gyro = rawAxes(word.data);
+      samples->push_back(m_latest);
+      m_latest.fresh = 0;
+      added++;
+    }
+    else if (tag == kTagAccel)
+    {
+      m_latest.accel = rawAxes(word.data);
+      m_latest.fresh |= kFreshAccel;
+    }
+    else if (tag == kTagTemp)
+    {
+      m_latest.temp = (int16_t)(word.data[0] | word.data[1] << 8);
+      m_latest.fresh |= kFreshTemp;
+    }
+    else if (tag == kTagTimestamp)
+    {
+      m_latest.timestamp = (uint32_t)word.data[0] | (uint32_t)word.data[1] << 8 | (uint32_t)word.data[2] << 16 |
+                           (uint32_t)word.data[3] << 24;
+      m_latest.fresh |= kFreshTimestamp;
+    }
+    else if (tag >= kTagHubSlave0 && tag <= kTagHubSlave3)
+    {
+      std::memcpy(m_latest.hub[tag - kTagHubSlave0], word.data, sizeof(word.data));
+      m_latest.fresh |= kFreshHub0 << (tag - kTagHubSlave0);
+    }
+    else if (tag == kTagHubNack)
+      m_hub_nacks++;
+    else
+      m_skipped++;
+  }
+  return added;
+}
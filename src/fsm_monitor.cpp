@@ -0,0 +1,40 @@
+#include "fsm_monitor.h"
+
+FsmMonitor::FsmMonitor(QwDevISM330DHCX &device, uint16_t programs, uint8_t device_index)
+    : m_device(device), m_programs(programs), m_device_index(device_index)
+{
+}
+
+bool FsmMonitor::begin()
+{
+  if (!m_device.getFsmOutputs(m_outputs))
+    return false;
+  m_bytes_read += sizeof(m_outputs);
+  return true;
+}
+
+bool FsmMonitor::poll(int64_t timestamp, std::vector<FsmEvent> *events)
+{
+  uint16_t status;
+  if (!m_device.getFsmStatus(&status))
+    return false;
+  m_bytes_read += 2;
+
+  status &= m_programs;
+  if (status == 0)
+    return true;
+
+  uint8_t outputs[16];
+  if (!m_device.getFsmOutputs(outputs))
+    return false;
+  m_bytes_read += sizeof(outputs);
+
+  for (uint8_t program = 0; program < 16; program++)
+  {
+    if (!(status & (1u << program)))
+      continue;
+    events->push_back({timestamp, m_device_index, program, outputs[program], m_outputs[program]});
+    m_outputs[program] = outputs[program];
+  }
+  return true;
+}
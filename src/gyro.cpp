@@ -1,59 +1,563 @@
+#include <algorithm>
+#include <cmath>
 #include <thread>
 #include <chrono>
 #include <cstdlib>
+#include <sstream>
 #include <boost/bind/bind.hpp>
 
 #include "gyro.h"
+#include "latency_trace.h"
+
+// Shortest wait (ns) worth a sleep instead of spinning on the clock
+static const int64_t kMinPollSleep = 100000;
+
+static int64_t steadyNow()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 void GyroAPI::startUpdateLoop(char *folder_name)
 {
   m_run_thread = true;
+  m_sample_store = std::make_unique<SampleStore>(m_devices.size(), kSampleStoreChunks);
+  m_orientation.resize(m_devices.size());
+  m_calibration.resize(m_devices.size());
+  m_decimation.resize(m_devices.size());
+  m_pollers.assign(m_devices.size(), ReadyPoller(samplePeriodNs()));
+  m_device_calibrations.assign(m_devices.size(), DeviceCalibration());
+  m_lost_at.assign(m_devices.size(), 0);
+  m_throttled_until.assign(m_devices.size(), 0);
+  m_offline = std::count_if(m_supervisors.begin(), m_supervisors.end(), [](const DeviceSupervisor &s)
+                            { return !s.online(); });
+  if (m_calibration_enabled)
+    for (size_t i = 0; i < m_devices.size(); i++)
+      calibrate(i);
+  if (!m_fsm_programs.empty())
+    loadFsm();
+  m_fifo_mode.assign(m_devices.size(), false);
+  m_fifo_decoders.assign(m_devices.size(), FifoDecoder());
+  m_fifo_pending.assign(m_devices.size(), {});
+  if (fifoFed())
+    startFifo();
+  // setRecord() may have throttled after the outputs were added, or the FIFO
+  // could not be set up
+  if (m_decimation.numOutputs() > 0 && throttled())
+    for (size_t i = 0; i < m_devices.size(); i++)
+      if (!m_fifo_mode[i])
+        std::cerr << "Decimated outputs of device " << i << " are fed at the recording rate, not "
+                  << 1e9 / samplePeriodNs() << " Hz" << std::endl;
+  m_activity_monitors.clear();
+  if (m_activity.enabled)
+    startActivity();
+  startTelemetry();
+  m_sample_logs.resize(m_devices.size());
   for (unsigned int i = 0; i < m_devices.size(); i++)
   {
     std::filesystem::path log_file_path = std::filesystem::path(folder_name) / std::filesystem::path("sensor" + std::to_string(i) + ".csv");
-    std::ofstream *file_stream = new std::ofstream();
-    file_stream->open(log_file_path);
-    m_file_streams.emplace_back(file_stream);
-    *m_file_streams.back() << "time (us),x (mdps),y (mdps),z(mdps)\n";
+    m_sample_logs[i].open(log_file_path, m_orientation_enabled, m_log_mode, m_log_rotation);
 
     m_last_times.push_back(0);
   }
   m_thread = std::thread(boost::bind(&GyroAPI::gyro_thread, this));
 }
 
+void GyroAPI::startTelemetry()
+{
+  // A FIFO delivers every output period, polling at most at the recording rate
+  const double period_us = samplePeriodNs() / 1000.0;
+  m_telemetry.reset(m_devices.size());
+  for (size_t i = 0; i < m_devices.size(); i++)
+  {
+    double interval_us = period_us;
+    if (!m_fifo_mode[i] && m_frequency > 0)
+      interval_us = std::max(period_us, 1e6 / m_frequency);
+    m_telemetry.setInterval(i, interval_us);
+    m_telemetry.setOnline(i, m_supervisors[i].online());
+  }
+  if (m_telemetry_address.empty())
+    return;
+
+  std::vector<std::string> labels;
+  for (size_t i = 0; i < m_devices.size(); i++)
+  {
+    std::ostringstream label;
+    label << "device=\"" << i << "\",address=\"0x" << std::hex << (int)m_addresses[i] << "\",bus=\""
+          << m_bus_paths[m_device_bus[i]] << "\"";
+    labels.push_back(label.str());
+  }
+  if (m_telemetry_server.start(m_telemetry_address, m_telemetry, labels))
+    std::cout << "Serving telemetry on " << m_telemetry_address << std::endl;
+  else
+    std::cerr << "Could not serve telemetry on " << m_telemetry_address << std::endl;
+}
+
+void GyroAPI::setOrientationFilter(bool enable, float beta)
+{
+  m_orientation_enabled = enable;
+  m_orientation.setBeta(beta);
+}
+
+bool GyroAPI::setCalibration(bool enable, const char *directory, int still_samples)
+{
+  // No samples would never be still
+  if (still_samples < 1)
+    return false;
+  m_calibration_enabled = enable;
+  m_calibration_directory = directory;
+  m_calibration_samples = still_samples;
+  return true;
+}
+
+void GyroAPI::calibrate(size_t index)
+{
+  std::filesystem::path path = DeviceCalibration::pathFor(m_calibration_directory, m_bus_paths[m_device_bus[index]],
+                                                            m_addresses[index]);
+  DeviceCalibration calibration;
+  calibration.load(path);
+  calibration.address = m_addresses[index];
+
+  // With the accelerometer off only the gyro bias model is calibrated, and
+  // the stored accelerometer offsets are kept as they are
+  const bool accel_on = m_profile.accelDataRate != ISM_XL_ODR_OFF;
+  StillPeriod still;
+  if (m_supervisors[index].online())
+  {
+    // Measure with the on-chip accelerometer offsets cleared
+    if (accel_on)
+      m_devices[index]->setAccelUserOffset(0, 0, 0);
+
+    int attempts = 0;
+    while (still.count() < (size_t)m_calibration_samples && attempts++ < 10 * m_calibration_samples)
+    {
+      SampleRecord sample;
+      if (m_devices[index]->checkGyroStatus() && readSample(index, &sample))
+        still.add(sample);
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  if (still.count() == (size_t)m_calibration_samples && still.gyroStdDev() <= kStillGyroStdDev)
+  {
+    float gyro[3], accel[3], temp;
+    still.mean(gyro, accel, &temp);
+    calibration.addObservation(temp, gyro);
+    calibration.fit();
+    if (accel_on)
+      calibration.computeAccelOffset(accel);
+    if (!calibration.save(path))
+      std::cout << "Could not save calibration to " << path << std::endl;
+    std::cout << "Calibrated device 0x" << std::hex << (int)m_addresses[index] << std::dec
+              << " at " << temp << " degC" << std::endl;
+  }
+  else
+  {
+    std::cout << "Device 0x" << std::hex << (int)m_addresses[index] << std::dec
+              << (m_supervisors[index].online() ? " is not still" : " is offline") << ", using the stored calibration"
+              << std::endl;
+  }
+
+  // An offline device gets the offsets when it is restored
+  if (accel_on && m_supervisors[index].online())
+    m_devices[index]->setAccelUserOffset(calibration.accel_offset[0], calibration.accel_offset[1],
+                                         calibration.accel_offset[2], calibration.accel_coarse);
+  m_calibration.setModel(index, calibration);
+  m_device_calibrations[index] = calibration;
+}
+
+void GyroAPI::setFsmPrograms(const std::vector<std::vector<uint8_t>> &programs, uint8_t rate)
+{
+  m_fsm_programs = programs;
+  m_fsm_rate = rate;
+}
+
+void GyroAPI::loadFsm()
+{
+  static const double kFsmRateHz[] = {12.5, 26.0, 52.0, 104.0};
+  m_fsm_period = (int64_t)(1e9 / kFsmRateHz[m_fsm_rate & 0x03]);
+  m_fsm_monitors.clear();
+  // A poll yields at most one event per program and device
+  m_fsm_polled.reserve(16 * m_devices.size());
+  {
+    std::lock_guard<std::mutex> lock(m_fsm_mutex);
+    m_fsm_events.reset(kFsmEventCapacity);
+  }
+  for (size_t i = 0; i < m_devices.size(); i++)
+    if (m_supervisors[i].online() && !loadFsm(i))
+      std::cerr << "Could not load the FSM programs into device 0x" << std::hex << (int)m_addresses[i] << std::dec
+                << std::endl;
+}
+
+bool GyroAPI::loadFsm(size_t index)
+{
+  std::vector<sfe_ism_fsm_program_t> programs;
+  for (const std::vector<uint8_t> &program : m_fsm_programs)
+    programs.push_back({program.data(), (uint16_t)program.size()});
+  uint16_t mask = (uint16_t)((1u << programs.size()) - 1);
+
+  FsmMonitor monitor(*m_devices[index], mask, (uint8_t)index);
+  if (!m_devices[index]->loadFsmPrograms(programs.data(), (uint8_t)programs.size(), m_fsm_rate) || !monitor.begin())
+    return false;
+
+  // Replaces the monitor of a device that was reloaded
+  auto it = std::find_if(m_fsm_monitors.begin(), m_fsm_monitors.end(),
+                         [index](const FsmMonitor &m) { return m.deviceIndex() == index; });
+  if (it != m_fsm_monitors.end())
+    it->begin();
+  else
+    m_fsm_monitors.push_back(monitor);
+  return true;
+}
+
+void GyroAPI::pollFsm()
+{
+  int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  m_fsm_polled.clear();
+  for (FsmMonitor &monitor : m_fsm_monitors)
+  {
+    // Bus errors count against the device, as in the sweeps
+    size_t index = monitor.deviceIndex();
+    if (!m_supervisors[index].online())
+      continue;
+    uint64_t errors = wireOf(index).errors();
+    monitor.poll(now, &m_fsm_polled);
+    faulted(index, errors);
+  }
+  if (m_fsm_polled.empty())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_fsm_mutex);
+    for (const FsmEvent &event : m_fsm_polled)
+      m_fsm_events.push(event);
+  }
+  m_fsm_cv.notify_all();
+}
+
+bool GyroAPI::takeFsmEvents(std::vector<FsmEvent> *events, int timeout_ms)
+{
+  std::unique_lock<std::mutex> lock(m_fsm_mutex);
+  if (m_fsm_events.empty() && timeout_ms > 0)
+    m_fsm_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]()
+                      { return !m_fsm_events.empty(); });
+  if (m_fsm_events.empty())
+    return false;
+  m_fsm_events.drainTo(events);
+  return true;
+}
+
+uint64_t GyroAPI::droppedFsmEvents()
+{
+  std::lock_guard<std::mutex> lock(m_fsm_mutex);
+  return m_fsm_events.dropped();
+}
+
+void GyroAPI::setHubSensors(const std::vector<sfe_hub_sensor_settings_t> &sensors, uint8_t rate,
+                            const std::vector<sfe_hub_sensor_settings_t> &setup)
+{
+  m_hub_sensors = sensors;
+  m_hub_rate = rate;
+  m_hub_setup = setup;
+}
+
+void GyroAPI::startFifo()
+{
+  // A drain decodes at most one sample per word, and the loop passes them
+  // all on before the next drain, so the pending rings never overflow
+  m_fifo_words.resize(kFifoDrainWords);
+  m_fifo_samples.reserve(kFifoDrainWords);
+  m_hub_polled.reserve(kFifoDrainWords);
+  for (FixedRing<SampleRecord> &pending : m_fifo_pending)
+    pending.reset(kFifoDrainWords);
+  {
+    std::lock_guard<std::mutex> lock(m_hub_mutex);
+    m_hub_readings.reset(kHubReadingCapacity);
+  }
+  for (size_t i = 0; i < m_devices.size(); i++)
+  {
+    // An offline device is set up when it is restored
+    m_fifo_mode[i] = !m_supervisors[i].online() || setupFifo(i);
+    if (!m_fifo_mode[i])
+    {
+      std::cerr << "Could not set up the FIFO of device 0x" << std::hex << (int)m_addresses[i] << std::dec
+                << ", reading it without" << std::endl;
+      m_devices[i]->setFifoMode(ISM_BYPASS_MODE);
+    }
+  }
+
+  if (m_sync_period_us > 0.0)
+    resetClocks();
+}
+
+bool GyroAPI::setupFifo(size_t index)
+{
+  // The FIFO batch rates take the same codes as the output data rates, up
+  // to 6667Hz
+  uint8_t accel_batch = m_profile.accelDataRate <= ISM_XL_ODR_6667Hz ? m_profile.accelDataRate : ISM_XL_BATCH_6Hz5;
+  uint8_t gyro_batch = m_profile.gyroDataRate <= ISM_GY_ODR_6667Hz ? m_profile.gyroDataRate : ISM_GY_BATCH_6Hz5;
+
+  SparkFun_ISM330DHCX *device = m_devices[index];
+  bool ok = true;
+  if (!m_hub_sensors.empty())
+  {
+    for (const sfe_hub_sensor_settings_t &write : m_hub_setup)
+      ok = ok && device->writeHubRegister(write.address, write.subAddress, write.lenData);
+    ok = ok && device->configureHub(m_hub_sensors.data(), (uint8_t)m_hub_sensors.size(), m_hub_rate);
+  }
+  // A time stamp word ahead of every data set when synchronising
+  if (m_sync_period_us > 0.0)
+    ok = ok && device->enableTimestamp() && device->setFifoTimestampDec(ISM_DEC_1);
+
+  // Bypass first to discard anything batched before
+  return ok && device->setFifoMode(ISM_BYPASS_MODE) && device->setAccelFifoBatchSet(accel_batch) &&
+         device->setGyroFifoBatchSet(gyro_batch) && device->setTempFifoBatchSet(ISM_TEMP_BATCH_AT_52Hz) &&
+         device->setFifoMode(ISM_STREAM_MODE);
+}
+
+void GyroAPI::setSynchronized(double rate_hz, SyncFrameSink sink)
+{
+  m_sync_period_us = rate_hz > 0.0 ? 1e6 / rate_hz : 0.0;
+  m_sync_sink = std::move(sink);
+}
+
+void GyroAPI::resetClocks()
+{
+  m_clocks.assign(m_devices.size(), DeviceClock());
+  m_last_ticks.assign(m_devices.size(), 0);
+  // Interpolating across more than one missed sample is not aligning
+  double sample_period_us = samplePeriodNs() / 1000.0;
+  m_aligner = StreamAligner(m_devices.size(), m_sync_period_us, m_sync_sink, 2.5 * sample_period_us);
+
+  // Back to back; an offline device joins the frames once it is restored
+  for (size_t i = 0; i < m_devices.size(); i++)
+    if (m_supervisors[i].online())
+      resetClock(i);
+    else
+      m_aligner.setActive(i, false);
+
+  // Drop what was batched with the counters' old values
+  for (size_t i = 0; i < m_devices.size(); i++)
+  {
+    if (!m_fifo_mode[i] || !m_supervisors[i].online())
+      continue;
+    m_devices[i]->setFifoMode(ISM_BYPASS_MODE);
+    m_devices[i]->setFifoMode(ISM_STREAM_MODE);
+  }
+}
+
+void GyroAPI::startActivity()
+{
+  for (size_t i = 0; i < m_devices.size(); i++)
+    if (m_supervisors[i].online() && !setupActivity(i))
+      std::cerr << "Could not set up the inactivity function of device 0x" << std::hex << (int)m_addresses[i]
+                << std::dec << ", it stays at the full rate" << std::endl;
+  m_activity_monitors.assign(m_devices.size(), ActivityMonitor());
+}
+
+bool GyroAPI::setupActivity(size_t index)
+{
+  uint8_t mode = m_activity.gyro_power_down ? ISM_ACT_XL_12Hz5_GY_PD : ISM_ACT_XL_12Hz5_GY_SLEEP;
+  SparkFun_ISM330DHCX *device = m_devices[index];
+  return device->setWakeUpThreshold(m_activity.wake_threshold) && device->setWakeUpDuration(m_activity.wake_duration) &&
+         device->setSleepDuration(m_activity.sleep_duration) && device->setActivityMode(mode);
+}
+
+// Restarts the device's counter, anchored at the middle of its reset write
+void GyroAPI::resetClock(size_t index)
+{
+  int8_t fine = 0;
+  m_devices[index]->getFreqFineTuning(&fine);
+  int64_t before = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  m_devices[index]->resetTimestamp();
+  int64_t after = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  m_clocks[index].reset(before + (after - before) / 2, fine);
+  m_last_ticks[index] = 0;
+}
+
+bool GyroAPI::drainFifo(size_t index)
+{
+  bool overrun = false;
+  uint16_t n = m_devices[index]->readFifo(m_fifo_words.data(), (uint16_t)m_fifo_words.size(), &overrun);
+  m_telemetry.fifo(index, n, overrun);
+  if (n == 0)
+    return false;
+  int64_t now_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  ISM_TRACE_SCOPE(TraceOp::Conversion);
+  m_fifo_samples.clear();
+  size_t count = m_fifo_decoders[index].decode(m_fifo_words.data(), n, &m_fifo_samples);
+
+  // Without device time stamps the newest gyroscope word was sampled just
+  // now, the older ones one output period apart before it
+  const double period = samplePeriodNs() / 1000.0;
+  const bool synchronised = !m_clocks.empty();
+  m_hub_polled.clear();
+  for (size_t k = 0; k < count; k++)
+  {
+    const FifoSample &fifo = m_fifo_samples[k];
+    int64_t timestamp = now_time - (int64_t)((count - 1 - k) * period);
+    if (synchronised)
+    {
+      // A set without its own time stamp word follows the previous one by a
+      // sample period
+      if (fifo.fresh & FifoDecoder::kFreshTimestamp)
+        m_last_ticks[index] = m_clocks[index].unwrap(fifo.timestamp);
+      else
+        m_last_ticks[index] += (uint64_t)std::llround(period * 1000.0 / m_clocks[index].tickNs());
+      timestamp = m_clocks[index].toHost(m_last_ticks[index]) / 1000;
+    }
+
+    sfe_ism_data_t gyroData, accelData;
+    QwDevISM330DHCX::convertRaw(&fifo.gyro, &gyroData, m_gyro_sensitivity);
+    QwDevISM330DHCX::convertRaw(&fifo.accel, &accelData, m_accel_sensitivity);
+    m_fifo_pending[index].push({timestamp,
+                                gyroData.xData, gyroData.yData, gyroData.zData,
+                                accelData.xData, accelData.yData, accelData.zData,
+                                m_devices[index]->convertToCelsius(fifo.temp)});
+
+    for (uint8_t slave = 0; slave < m_hub_sensors.size(); slave++)
+    {
+      if (!(fifo.fresh & (FifoDecoder::kFreshHub0 << slave)))
+        continue;
+      HubReading reading = {timestamp, (uint8_t)index, slave, {}};
+      std::copy(fifo.hub[slave], fifo.hub[slave] + sizeof(reading.data), reading.data);
+      m_hub_polled.push_back(reading);
+    }
+  }
+
+  if (synchronised && count > 0)
+    m_clocks[index].observe(m_last_ticks[index], now_time * 1000);
+
+  if (!m_hub_polled.empty())
+  {
+    std::lock_guard<std::mutex> lock(m_hub_mutex);
+    for (const HubReading &reading : m_hub_polled)
+      m_hub_readings.push(reading);
+  }
+  return count > 0;
+}
+
+bool GyroAPI::takeHubReadings(std::vector<HubReading> *readings)
+{
+  std::lock_guard<std::mutex> lock(m_hub_mutex);
+  if (m_hub_readings.empty())
+    return false;
+  m_hub_readings.drainTo(readings);
+  return true;
+}
+
+uint64_t GyroAPI::droppedHubReadings()
+{
+  std::lock_guard<std::mutex> lock(m_hub_mutex);
+  return m_hub_readings.dropped();
+}
+
+double GyroAPI::addDecimatedOutput(double rate_hz, DecimatedSink sink)
+{
+  // Polling at the recording rate would feed the filter an irregular subset
+  // of the samples, not the rate it was designed for
+  if (throttled() && !fifoFed())
+  {
+    std::cerr << "Decimated outputs need every sample: enable the FIFO or record at the full rate" << std::endl;
+    return 0.0;
+  }
+  double input_hz = sfe_ism_profile::gyroDataRateHz(m_profile.gyroDataRate);
+  unsigned factor = rate_hz > 0 ? (unsigned)std::max(1.0, std::round(input_hz / rate_hz)) : 1;
+  m_decimation.addOutput(factor, std::move(sink));
+  return input_hz / factor;
+}
+
 void GyroAPI::setRecord(bool value, int frequency)
 {
   m_record = value;
   m_frequency = frequency;
 }
 
-void GyroAPI::add_device(uint8_t address)
+GyroAPI::GyroAPI(const BusTopology &topology, const sfe_ism_profile_t &profile)
 {
-  SparkFun_ISM330DHCX *new_device = new SparkFun_ISM330DHCX();
-  new_device->begin(m_wire, address);
-  new_device->setDeviceConfig();
-  new_device->setBlockDataUpdate();
+  if (!setProfile(profile))
+    std::cerr << "Invalid device profile, using the default" << std::endl;
+  for (const I2cBus &bus : topology)
+  {
+    size_t index = add_bus(bus.path.c_str());
+    for (uint8_t address : bus.addresses)
+      add_device(address, index);
+  }
+}
+
+bool GyroAPI::setProfile(const sfe_ism_profile_t &profile)
+{
+  if (!sfe_ism_profile::isValid(profile) || profile.gyroDataRate == ISM_GY_ODR_OFF)
+    return false;
+  m_profile = profile;
+  m_gyro_sensitivity = sfe_ism_profile::gyroSensitivity(profile.gyroFullScale);
+  m_accel_sensitivity = sfe_ism_profile::accelSensitivity(profile.accelFullScale);
+  return true;
+}
 
-  // Set the output data rate and precision of the gyroscope
-  new_device->setGyroDataRate(ISM_GY_ODR_6667Hz);
-  new_device->setGyroFullScale(ISM_250dps);
+size_t GyroAPI::add_bus(const char *i2c_path)
+{
+  m_wires.push_back(std::make_unique<TwoWire>(i2c_path));
+  m_wires.back()->begin();
+  m_bus_paths.push_back(i2c_path);
+  return m_wires.size() - 1;
+}
+
+void GyroAPI::add_device(uint8_t address, size_t bus)
+{
+  SparkFun_ISM330DHCX *new_device = new SparkFun_ISM330DHCX();
+  TwoWire &wire = *m_wires[bus];
+  uint64_t errors = wire.errors();
+  new_device->begin(wire, address);
 
-  // Turn on the gyroscope's filter and apply settings.
-  new_device->setGyroFilterLP1();
-  new_device->setGyroLP1Bandwidth(ISM_MEDIUM);
+  // Reset the device, then set the output data rate, precision and filter of
+  // the gyroscope in as few bus transactions as possible.
+  bool configured = new_device->applyProfile(m_profile);
   m_devices.push_back(new_device);
+  m_addresses.push_back(address);
+  m_device_bus.push_back(bus);
 
+  // Checked explicitly rather than with assert, which release builds compile out
   uint8_t who_am_i = new_device->getUniqueId();
-  assert(new_device->getUniqueId() == 0x6b && "Who am I register returned incorrect value. Expected 0x6b.");
-  std::cout << "Added device with address 0x" << std::hex << (int)address << std::endl;
+  bool answered = wire.errors() == errors;
+  // A device that answers but never finishes its reset would otherwise
+  // stream unconfigured; offline, recovery applies the profile again
+  m_supervisors.emplace_back(answered && configured);
+  if (!answered)
+  {
+    std::cerr << "Device 0x" << std::hex << (int)address << std::dec
+              << " is not answering, it will be set up once it does" << std::endl;
+  }
+  else if (who_am_i != 0x6b)
+  {
+    std::cerr << "Who am I register of device 0x" << std::hex << (int)address << " returned 0x" << (int)who_am_i
+              << ", expected 0x6b" << std::dec << std::endl;
+    std::abort();
+  }
+  else if (!configured)
+  {
+    std::cerr << "Device 0x" << std::hex << (int)address << std::dec
+              << " did not complete its reset, it starts offline until recovery configures it" << std::endl;
+  }
+  std::cout << "Added device with address 0x" << std::hex << (int)address << std::dec << " on " << m_bus_paths[bus]
+            << std::endl;
   std::cout << "This device will log to sensor" << m_devices.size() - 1 << ".csv" << std::endl;
 }
 
+bool GyroAPI::openSampleBus(const char *name, uint32_t capacity)
+{
+  if (!m_sample_bus.create(name, (uint32_t)m_devices.size(), capacity))
+    return false;
+  std::cout << "Publishing samples to shared memory " << name << std::endl;
+  return true;
+}
+
 void GyroAPI::flush()
 {
-  for (auto &stream : m_file_streams)
+  for (auto &log : m_sample_logs)
   {
-    stream->flush();
+    log.flush();
   }
 }
 
@@ -67,6 +571,9 @@ bool GyroAPI::statusCheck()
 {
   if (m_devices.size() == 0)
     return false;
+  // The acquisition thread owns the bus while it runs
+  if (m_run_thread)
+    return m_offline == 0;
   // Check connection status of all devices
   for (auto &device : m_devices)
     if (!device->isConnected())
@@ -77,50 +584,383 @@ void GyroAPI::stopUpdateLoop()
 {
   m_run_thread = false;
   join();
+  m_telemetry_server.stop();
+
+  // Close the logs of devices still offline with their gap
+  for (size_t i = 0; i < m_supervisors.size(); i++)
+    if (!m_supervisors[i].online() && m_supervisors[i].faults() > 0)
+      m_sample_logs[i].writeGap(m_lost_at[i]);
   flush();
-  for (auto &stream : m_file_streams)
+  for (auto &log : m_sample_logs)
   {
-    stream->close();
+    log.close();
   }
+
+  for (size_t i = 0; i < m_pollers.size(); i++)
+    std::cout << "\nDevice " << i << ": output period " << m_pollers[i].period() / 1000.0 << " us, "
+              << m_pollers[i].notReady() << " of " << m_pollers[i].polls() << " status polls not ready";
+  int64_t stop_time = steadyNow();
+  for (size_t i = 0; i < m_supervisors.size(); i++)
+    if (m_supervisors[i].faults() > 0 || !m_supervisors[i].online())
+      std::cout << "\nDevice " << i << ": " << m_supervisors[i].faults() << " faults, "
+                << m_supervisors[i].downtime(stop_time) / 1e6 << " ms offline"
+                << (m_supervisors[i].online() ? "" : ", offline at the end");
+  for (size_t i = 0; i < m_activity_monitors.size(); i++)
+    std::cout << "\nDevice " << i << ": " << m_activity_monitors[i].sleepTime(steadyNow()) / 1e9 << " s asleep, "
+              << m_activity_monitors[i].wakeUps() << " wake-ups";
+  if (uint64_t dropped = droppedHubReadings())
+    std::cout << "\n" << dropped << " hub readings dropped, takeHubReadings() fell behind";
+  if (uint64_t dropped = droppedFsmEvents())
+    std::cout << "\n" << dropped << " FSM events dropped, takeFsmEvents() fell behind";
+  std::cout << std::endl;
+
+#ifdef ISM_LATENCY_TRACE
+  std::cout << "\nLatency per operation:\n";
+  latency_trace::dump(std::cout);
+#endif
+}
+
+bool GyroAPI::readSample(size_t index, SampleRecord *sample)
+{
+  // Temperature, gyro and accel in one burst
+  sfe_ism_raw_all_t rawData;
+  if (!m_devices[index]->getRawAllSensors(&rawData))
+    return false;
+  int64_t now_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+  ISM_TRACE_SCOPE(TraceOp::Conversion);
+  sfe_ism_data_t gyroData, accelData;
+  QwDevISM330DHCX::convertRaw(&rawData.gyro, &gyroData, m_gyro_sensitivity);
+  QwDevISM330DHCX::convertRaw(&rawData.accel, &accelData, m_accel_sensitivity);
+
+  *sample = {now_time,
+             gyroData.xData, gyroData.yData, gyroData.zData,
+             accelData.xData, accelData.yData, accelData.zData,
+             m_devices[index]->convertToCelsius(rawData.temp)};
+  return true;
+}
+
+void GyroAPI::writeSample(size_t index, const SampleRecord &sample)
+{
+  ISM_TRACE_SCOPE(TraceOp::LogWrite);
+  m_sample_store->append(index, sample);
+  m_sample_bus.publish(index, sample);
+  m_telemetry.sample(index, sample.timestamp);
+
+  m_sample_logs[index].write(sample);
+}
+
+void GyroAPI::processSweep(std::vector<SampleRecord> &sweep, std::vector<uint8_t> &acquired,
+                           std::vector<int64_t> &last_sample_times)
+{
+  // Temperature compensated gyro bias, removed before anything consumes it
+  if (m_calibration_enabled)
+    m_calibration.apply(sweep, acquired);
+
+  // Orientation of every device that produced a sample is updated in one pass
+  if (m_orientation_enabled)
+  {
+    for (size_t index = 0; index < m_devices.size(); index++)
+    {
+      if (!acquired[index])
+        continue;
+      float dt = last_sample_times[index] ? (sweep[index].timestamp - last_sample_times[index]) * 1e-6f : 0.0f;
+      last_sample_times[index] = sweep[index].timestamp;
+      m_orientation.setInput(index, sweep[index], dt);
+    }
+    m_orientation.update();
+    for (size_t index = 0; index < m_devices.size(); index++)
+      if (acquired[index])
+        m_orientation.getQuaternion(index, &sweep[index]);
+  }
+
+  for (size_t index = 0; index < m_devices.size(); index++)
+    if (acquired[index])
+      writeSample(index, sweep[index]);
+
+  if (m_decimation.numOutputs() > 0)
+    for (size_t index = 0; index < m_devices.size(); index++)
+      if (acquired[index])
+        m_decimation.push(index, sweep[index]);
+
+  if (!m_clocks.empty())
+    for (size_t index = 0; index < m_devices.size(); index++)
+      if (acquired[index])
+        m_aligner.push(index, sweep[index]);
+}
+
+bool GyroAPI::checkActivity(size_t index)
+{
+  ActivityMonitor &monitor = m_activity_monitors[index];
+  int64_t now = steadyNow();
+  if (now < monitor.nextCheck())
+    return !monitor.asleep();
+
+  // Keep the last known state through a failed read
+  bool asleep = monitor.asleep();
+  m_devices[index]->getSleepState(&asleep);
+  if (monitor.observe(now, asleep))
+  {
+    // The FIFO only streams while awake; on waking it restarts empty, and
+    // the data-ready phase is searched for again at the full rate
+    m_devices[index]->setFifoMode(ISM_BYPASS_MODE);
+    m_telemetry.restart(index);
+    m_aligner.setActive(index, !asleep);
+    if (!asleep)
+    {
+      m_fifo_decoders[index] = FifoDecoder();
+      m_devices[index]->setFifoMode(ISM_STREAM_MODE);
+      m_pollers[index].reset(samplePeriodNs());
+    }
+  }
+  return !asleep;
+}
+
+bool GyroAPI::faulted(size_t index, uint64_t errors_before)
+{
+  uint64_t errors = wireOf(index).errors() - errors_before;
+  if (!m_supervisors[index].observe(steadyNow(), errors))
+    return !m_supervisors[index].online();
+  m_telemetry.busErrors(index, errors);
+  m_telemetry.fault(index);
+  m_aligner.setActive(index, false);
+
+  m_lost_at[index] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  m_offline++;
+  std::cerr << "\nDevice 0x" << std::hex << (int)m_addresses[index] << std::dec << " lost, recovering" << std::endl;
+  return true;
+}
+
+bool GyroAPI::recoverDevice(size_t index)
+{
+  // With every device on its bus gone the adapter itself is the likely
+  // cause, e.g. a USB adapter that re-enumerated: open it again
+  TwoWire &wire = wireOf(index);
+  uint64_t errors_before = wire.errors();
+  bool bus_down = true;
+  for (size_t i = 0; i < m_devices.size(); i++)
+    if (m_device_bus[i] == m_device_bus[index] && m_supervisors[i].online())
+      bus_down = false;
+  if (bus_down)
+  {
+    wire.end();
+    wire.begin();
+  }
+
+  uint64_t errors = wire.errors();
+  bool intact = false;
+  bool ok = wire.isOpen() && m_devices[index]->getUniqueId() == 0x6b && wire.errors() == errors &&
+            m_devices[index]->checkProfile(m_profile, &intact);
+  // Configuration lost with power is restored; otherwise only what was
+  // batched across the outage is dropped
+  if (ok && !intact)
+    ok = restoreDevice(index);
+  else if (ok && m_fifo_mode[index])
+    ok = m_devices[index]->setFifoMode(ISM_BYPASS_MODE) && m_devices[index]->setFifoMode(ISM_STREAM_MODE);
+  ok = ok && wire.errors() == errors;
+
+  int64_t now = steadyNow();
+  bool first = m_supervisors[index].faults() == 0;
+  m_supervisors[index].recovered(now, ok);
+  m_telemetry.busErrors(index, wire.errors() - errors_before);
+  if (!ok)
+    return false;
+  m_telemetry.setOnline(index, true);
+  m_aligner.setActive(index, true);
+
+  m_fifo_decoders[index] = FifoDecoder();
+  m_fifo_pending[index].clear();
+  m_pollers[index].reset(samplePeriodNs());
+  if (!m_activity_monitors.empty())
+    m_activity_monitors[index] = ActivityMonitor();
+  if (!first)
+    m_sample_logs[index].writeGap(m_lost_at[index]);
+  m_offline--;
+
+  std::cerr << "\nDevice 0x" << std::hex << (int)m_addresses[index] << std::dec
+            << (first ? " answered" : " recovered") << (intact ? "" : ", configuration restored") << std::endl;
+  return true;
+}
+
+bool GyroAPI::restoreDevice(size_t index)
+{
+  SparkFun_ISM330DHCX *device = m_devices[index];
+  // The profile first: it starts with a software reset
+  bool ok = device->applyProfile(m_profile);
+  if (m_calibration_enabled && m_profile.accelDataRate != ISM_XL_ODR_OFF)
+  {
+    const DeviceCalibration &calibration = m_device_calibrations[index];
+    ok = ok && device->setAccelUserOffset(calibration.accel_offset[0], calibration.accel_offset[1],
+                                          calibration.accel_offset[2], calibration.accel_coarse);
+  }
+  if (!m_fsm_programs.empty())
+    ok = ok && loadFsm(index);
+  if (m_fifo_mode[index])
+    ok = ok && setupFifo(index);
+  if (!m_activity_monitors.empty())
+    ok = ok && setupActivity(index);
+  // The time stamp counter restarted with the reset
+  if (ok && !m_clocks.empty())
+    resetClock(index);
+  return ok;
 }
 
 void GyroAPI::gyro_thread()
 {
+  std::vector<SampleRecord> sweep(m_devices.size());
+  std::vector<uint8_t> acquired(m_devices.size());
+  std::vector<int64_t> last_sample_times(m_devices.size(), 0);
+
+  // The loop's queues and the TwoWire transfer buffers are allocated by now;
+  // the rarer paths that still allocate are listed in the report
+  if (m_realtime.enabled())
+  {
+    RtThreadReport report = rt_thread::apply(m_realtime);
+    if (m_log_rotation.enabled())
+      report.notes.push_back("allocates when a log segment rolls over");
+    report.notes.push_back("allocates while recovering a device");
+    if (m_decimation.numOutputs() > 0 || m_sync_sink)
+      report.notes.push_back("decimated and synchronised sinks run on this thread");
+    std::cout << "Acquisition thread: " << report << std::endl;
+  }
+  m_fsm_next_poll = steadyNow();
+
   while (m_run_thread)
   {
+    // Sleep until the first device is expected to have new data, rather than
+    // spin, when the wait is long enough for the scheduler to honour
+    if (!m_pollers.empty())
+    {
+      int64_t next_poll = INT64_MAX;
+      for (size_t index = 0; index < m_pollers.size(); index++)
+      {
+        if (!m_supervisors[index].online())
+        {
+          next_poll = std::min(next_poll, m_supervisors[index].nextRetry());
+          continue;
+        }
+        // A sleeping device has nothing but its sleep state to read
+        bool asleep = !m_activity_monitors.empty() && m_activity_monitors[index].asleep();
+        if (!asleep)
+          next_poll = std::min(next_poll, std::max(m_pollers[index].nextPoll(), m_throttled_until[index]));
+        if (!m_activity_monitors.empty())
+          next_poll = std::min(next_poll, m_activity_monitors[index].nextCheck());
+      }
+      if (!m_fsm_monitors.empty())
+        next_poll = std::min(next_poll, m_fsm_next_poll);
+      int64_t wait = next_poll - steadyNow();
+      if (wait > kMinPollSleep)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait - kMinPollSleep / 2));
+    }
+
+    ISM_TRACE_SCOPE(TraceOp::Sweep);
     for (int index = 0; index < m_devices.size(); index++)
     {
+      acquired[index] = false;
       if (!m_run_thread)
         break;
 
+      // An offline device is only touched to bring it back
+      if (!m_supervisors[index].online())
+      {
+        if (steadyNow() >= m_supervisors[index].nextRetry() && recoverDevice(index))
+          last_sample_times[index] = 0;
+        continue;
+      }
+
+      // Any bus error from here on takes the device offline
+      uint64_t errors = wireOf(index).errors();
+      bool awake = m_activity_monitors.empty() || checkActivity(index);
+      if (faulted(index, errors) || !awake)
+        continue;
+
+      // Leave the bus alone until the device is expected to have new data
+      int64_t poll_time = steadyNow();
+      if (poll_time < std::max(m_pollers[index].nextPoll(), m_throttled_until[index]))
+        continue;
+
       // Get current time
       int64_t now_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
       // Save results to file
       if ((1000000000.0 / (now_time - m_last_times[index]) <= m_frequency) && m_record)
       {
-        double current_rate = 1000000000.0 / (now_time - m_last_times[index]);
-        std::cout << "\rCurrent rate: " << current_rate << " Hz     " << std::flush;
         m_last_times[index] = now_time;
 
-        bool success;
-
-        if (m_devices[index]->checkGyroStatus())
+        bool ready;
+        if (m_fifo_mode[index])
         {
-          sfe_ism_data_t gyroData;
-          m_devices[index]->getGyro(&gyroData);
-          now_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-
-          *m_file_streams[index] << now_time
-                                 << "," << gyroData.xData
-                                 << "," << gyroData.yData
-                                 << "," << gyroData.zData << "," << std::endl;
+          // The FIFO level read stands in for the status poll
+          ready = drainFifo(index);
         }
         else
         {
-          std::cout << "Gyro data not ready. Data will not be logged.\n";
+          ISM_TRACE_SCOPE(TraceOp::StatusPoll);
+          ready = m_devices[index]->checkGyroStatus();
+        }
+        // Not-ready polls are expected now and then, the poller probes early
+        // on purpose to keep its phase estimate
+        m_pollers[index].observe(poll_time, ready);
+        if (ready && m_fifo_mode[index])
+        {
+          sweep[index] = m_fifo_pending[index].front();
+          m_fifo_pending[index].pop_front();
+          acquired[index] = true;
         }
+        else if (ready)
+        {
+          acquired[index] = readSample(index, &sweep[index]);
+        }
+        else
+        {
+          ISM_TRACE_COUNT(TraceCounter::NotReady);
+          m_telemetry.notReady(index);
+        }
+        if (faulted(index, errors))
+          acquired[index] = false;
+        else if (ready)
+          m_telemetry.latency(index, steadyNow() - poll_time);
       }
+      else
+      {
+        // Not due at the recording rate, or not recording: the poller never
+        // sees this poll, so the wait until the next read is kept here (on
+        // the steady clock, m_last_times is system time)
+        int64_t wait = (int64_t)samplePeriodNs();
+        if (m_record && m_frequency > 0)
+          wait = m_last_times[index] + (int64_t)(1e9 / m_frequency) - now_time;
+        m_throttled_until[index] = poll_time + std::max<int64_t>(wait, 0);
+      }
+    }
+
+    processSweep(sweep, acquired, last_sample_times);
+
+    // Samples drained from a FIFO beyond the first go through in further
+    // sweeps, so calibration and orientation see every one in order
+    bool pending = true;
+    while (pending)
+    {
+      pending = false;
+      for (size_t index = 0; index < m_devices.size(); index++)
+      {
+        acquired[index] = !m_fifo_pending[index].empty();
+        if (!acquired[index])
+          continue;
+        sweep[index] = m_fifo_pending[index].front();
+        m_fifo_pending[index].pop_front();
+        pending = true;
+      }
+      if (pending)
+        processSweep(sweep, acquired, last_sample_times);
+    }
+
+    // FSM status is only read as often as the programs run
+    if (!m_fsm_monitors.empty() && steadyNow() >= m_fsm_next_poll)
+    {
+      pollFsm();
+      m_fsm_next_poll += m_fsm_period;
+      if (m_fsm_next_poll < steadyNow())
+        m_fsm_next_poll = steadyNow() + m_fsm_period;
     }
   }
   std::cout << "Gyro thread stopped." << std::endl;
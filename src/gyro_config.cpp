@@ -0,0 +1,387 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <utility>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "gyro_config.h"
+
+namespace pt = boost::property_tree;
+
+namespace
+{
+// Output data rates in Hz by ISM_XL_ODR_* / ISM_GY_ODR_* code
+const double kAccelRates[] = {0.0, 12.5, 26.0, 52.0, 104.0, 208.0, 416.0, 833.0, 1666.0, 3332.0, 6667.0, 1.6};
+const double kGyroRates[] = {0.0, 12.5, 26.0, 52.0, 104.0, 208.0, 416.0, 833.0, 1666.0, 3332.0, 6667.0};
+
+// The child named key, or an empty node when there is none
+const pt::ptree &section(const pt::ptree &node, const char *key)
+{
+  static const pt::ptree kEmpty;
+  boost::optional<const pt::ptree &> child = node.get_child_optional(key);
+  return child ? *child : kEmpty;
+}
+
+std::string join(const std::string &path, const std::string &key)
+{
+  return path.empty() ? key : path + "." + key;
+}
+
+// Walks the tree, keeping the first error with the path of its key
+class Reader
+{
+public:
+  std::string error;
+
+  bool fail(const std::string &path, const std::string &what)
+  {
+    if (error.empty())
+      error = path + ": " + what;
+    return false;
+  }
+
+  bool keys(const pt::ptree &node, const std::string &path, std::initializer_list<const char *> allowed)
+  {
+    for (const auto &child : node)
+      if (std::none_of(allowed.begin(), allowed.end(), [&](const char *key) { return child.first == key; }))
+        return fail(join(path, child.first), "unknown key");
+    return true;
+  }
+
+  // Leaves *out alone when the key is missing
+  template <typename T> bool value(const pt::ptree &node, const std::string &path, const char *key, T *out)
+  {
+    boost::optional<const pt::ptree &> child = node.get_child_optional(key);
+    if (!child)
+      return true;
+    boost::optional<T> parsed = child->get_value_optional<T>();
+    if (!child->empty() || !parsed)
+      return fail(join(path, key), "invalid value \"" + child->data() + "\"");
+    *out = *parsed;
+    return true;
+  }
+
+  // Decimal or 0x prefixed hex, within [min, max]
+  template <typename T>
+  bool integer(const pt::ptree &node, const std::string &path, const char *key, T *out, long long min, long long max)
+  {
+    boost::optional<const pt::ptree &> child = node.get_child_optional(key);
+    if (!child)
+      return true;
+    return integerValue(*child, join(path, key), out, min, max);
+  }
+
+  template <typename T> bool integerValue(const pt::ptree &node, const std::string &path, T *out, long long min, long long max)
+  {
+    const std::string &text = node.data();
+    size_t used = 0;
+    long long parsed = 0;
+    try
+    {
+      parsed = std::stoll(text, &used, 0);
+    }
+    catch (const std::exception &)
+    {
+      used = 0;
+    }
+    if (!node.empty() || text.empty() || used != text.size())
+      return fail(path, "invalid value \"" + text + "\"");
+    if (parsed < min || parsed > max)
+      return fail(path, std::to_string(parsed) + " is outside " + std::to_string(min) + ".." + std::to_string(max));
+    *out = (T)parsed;
+    return true;
+  }
+
+  // One of the named values
+  template <typename T>
+  bool choice(const pt::ptree &node, const std::string &path, const char *key,
+              std::initializer_list<std::pair<const char *, T>> names, T *out)
+  {
+    std::string name;
+    if (!value(node, path, key, &name) || !node.get_child_optional(key))
+      return error.empty();
+    for (const auto &entry : names)
+      if (name == entry.first)
+      {
+        *out = entry.second;
+        return true;
+      }
+    std::string valid;
+    for (const auto &entry : names)
+      valid += std::string(valid.empty() ? "" : ", ") + entry.first;
+    return fail(join(path, key), "\"" + name + "\" is not one of " + valid);
+  }
+
+  // Output data rate in Hz to its register code
+  bool rate(const pt::ptree &node, const std::string &path, const char *key, const double *rates, size_t count,
+            uint8_t *out)
+  {
+    double hz = 0.0;
+    if (!value(node, path, key, &hz) || !node.get_child_optional(key))
+      return error.empty();
+    if (hz < 0.0)
+      return fail(join(path, key), "negative rate " + node.get<std::string>(key) + " Hz");
+    for (size_t code = 0; code < count; code++)
+      if (std::fabs(rates[code] - hz) < 0.05)
+      {
+        *out = (uint8_t)code;
+        return true;
+      }
+    return fail(join(path, key), "unsupported rate " + node.get<std::string>(key) + " Hz");
+  }
+
+  bool fullScale(const pt::ptree &node, const std::string &path, const char *key,
+                 std::initializer_list<std::pair<int, uint8_t>> scales, uint8_t *out)
+  {
+    int value = 0;
+    if (!integer(node, path, key, &value, 0, 1 << 16) || !node.get_child_optional(key))
+      return error.empty();
+    for (const auto &scale : scales)
+      if (value == scale.first)
+      {
+        *out = scale.second;
+        return true;
+      }
+    return fail(join(path, key), "unsupported full scale " + std::to_string(value));
+  }
+};
+
+bool readBuses(Reader &r, const pt::ptree &node, BusTopology *buses)
+{
+  for (const auto &entry : node)
+  {
+    std::string path = "buses[" + std::to_string(buses->size()) + "]";
+    I2cBus bus;
+    if (!r.keys(entry.second, path, {"path", "devices"}) || !r.value(entry.second, path, "path", &bus.path))
+      return false;
+    if (bus.path.empty())
+      return r.fail(join(path, "path"), "missing");
+
+    boost::optional<const pt::ptree &> devices = entry.second.get_child_optional("devices");
+    if (!devices || devices->empty())
+      return r.fail(join(path, "devices"), "missing");
+    for (const auto &device : *devices)
+    {
+      uint8_t address = 0;
+      if (!r.integerValue(device.second, join(path, "devices"), &address, 0x08, 0x77))
+        return false;
+      bus.addresses.push_back(address);
+    }
+    buses->push_back(bus);
+  }
+  return true;
+}
+
+bool readDevice(Reader &r, const pt::ptree &node, sfe_ism_profile_t *profile)
+{
+  if (!r.keys(node, "device", {"accel", "gyro", "block_data_update"}) ||
+      !r.value(node, "device", "block_data_update", &profile->blockDataUpdate))
+    return false;
+
+  const pt::ptree &accel = section(node, "accel");
+  if (!r.keys(accel, "device.accel", {"odr_hz", "full_scale_g", "lp2"}) ||
+      !r.rate(accel, "device.accel", "odr_hz", kAccelRates, std::size(kAccelRates), &profile->accelDataRate) ||
+      !r.fullScale(accel, "device.accel", "full_scale_g", {{2, ISM_2g}, {4, ISM_4g}, {8, ISM_8g}, {16, ISM_16g}},
+                   &profile->accelFullScale) ||
+      !r.value(accel, "device.accel", "lp2", &profile->accelFilterLP2))
+    return false;
+
+  const pt::ptree &gyro = section(node, "gyro");
+  return r.keys(gyro, "device.gyro", {"odr_hz", "full_scale_dps", "lp1", "lp1_bandwidth"}) &&
+         r.rate(gyro, "device.gyro", "odr_hz", kGyroRates, std::size(kGyroRates), &profile->gyroDataRate) &&
+         r.fullScale(gyro, "device.gyro", "full_scale_dps",
+                     {{125, ISM_125dps}, {250, ISM_250dps}, {500, ISM_500dps}, {1000, ISM_1000dps},
+                      {2000, ISM_2000dps}, {4000, ISM_4000dps}},
+                     &profile->gyroFullScale) &&
+         r.value(gyro, "device.gyro", "lp1", &profile->gyroFilterLP1) &&
+         r.choice<uint8_t>(gyro, "device.gyro", "lp1_bandwidth",
+                           {{"ultra_light", ISM_ULTRA_LIGHT}, {"very_light", ISM_VERY_LIGHT}, {"light", ISM_LIGHT},
+                            {"medium", ISM_MEDIUM}, {"strong", ISM_STRONG}, {"very_strong", ISM_VERY_STRONG},
+                            {"aggressive", ISM_AGGRESSIVE}, {"xtreme", ISM_XTREME}},
+                           &profile->gyroLP1Bandwidth);
+}
+
+bool readSinks(Reader &r, const pt::ptree &node, GyroConfig *config)
+{
+  if (!r.keys(node, "sinks", {"csv", "sample_bus"}))
+    return false;
+
+  const pt::ptree &csv = section(node, "csv");
+  std::string folder = config->log_folder.string();
+  if (!r.keys(csv, "sinks.csv", {"folder", "mode", "rotation"}) || !r.value(csv, "sinks.csv", "folder", &folder) ||
+      !r.choice<LogFileMode>(csv, "sinks.csv", "mode",
+                             {{"buffered", LogFileMode::Buffered}, {"mapped", LogFileMode::Mapped},
+                              {"direct", LogFileMode::Direct}},
+                             &config->log_mode))
+    return false;
+  config->log_folder = folder;
+
+  const pt::ptree &rotation = section(csv, "rotation");
+  const std::string path = "sinks.csv.rotation";
+  uint64_t max_mb = 0, interval_s = 0;
+  if (!r.keys(rotation, path, {"max_mb", "interval_s", "compress", "keep_segments"}) ||
+      !r.integer(rotation, path, "max_mb", &max_mb, 0, 1 << 30) ||
+      !r.integer(rotation, path, "interval_s", &interval_s, 0, 1ll << 32) ||
+      !r.value(rotation, path, "compress", &config->log_rotation.compress) ||
+      !r.integer(rotation, path, "keep_segments", &config->log_rotation.keep_segments, 0, 1 << 30))
+    return false;
+  config->log_rotation.max_bytes = max_mb << 20;
+  config->log_rotation.interval_us = (int64_t)interval_s * 1000000;
+
+  const pt::ptree &bus = section(node, "sample_bus");
+  return r.keys(bus, "sinks.sample_bus", {"name", "capacity"}) &&
+         r.value(bus, "sinks.sample_bus", "name", &config->sample_bus) &&
+         r.integer(bus, "sinks.sample_bus", "capacity", &config->sample_bus_capacity, 1, 1 << 24);
+}
+
+bool readRealtime(Reader &r, const pt::ptree &node, RtThreadConfig *realtime)
+{
+  const std::string path = "realtime";
+  uint64_t runtime_us = realtime->runtime_ns / 1000, deadline_us = realtime->deadline_ns / 1000,
+           period_us = realtime->period_ns / 1000;
+  size_t prefault_kb = realtime->stack_prefault >> 10;
+  if (!r.keys(node, path, {"policy", "priority", "runtime_us", "deadline_us", "period_us", "cpus", "lock_memory",
+                           "stack_prefault_kb"}) ||
+      !r.choice<RtPolicy>(node, path, "policy",
+                          {{"default", RtPolicy::Default}, {"fifo", RtPolicy::Fifo}, {"deadline", RtPolicy::Deadline}},
+                          &realtime->policy) ||
+      !r.integer(node, path, "priority", &realtime->priority, 1, 99) ||
+      !r.integer(node, path, "runtime_us", &runtime_us, 0, 1ll << 40) ||
+      !r.integer(node, path, "deadline_us", &deadline_us, 0, 1ll << 40) ||
+      !r.integer(node, path, "period_us", &period_us, 0, 1ll << 40) ||
+      !r.value(node, path, "lock_memory", &realtime->lock_memory) ||
+      !r.integer(node, path, "stack_prefault_kb", &prefault_kb, 0, 1 << 20))
+    return false;
+  realtime->runtime_ns = runtime_us * 1000;
+  realtime->deadline_ns = deadline_us * 1000;
+  realtime->period_ns = period_us * 1000;
+  realtime->stack_prefault = prefault_kb << 10;
+
+  for (const auto &cpu : section(node, "cpus"))
+  {
+    int index = 0;
+    if (!r.integerValue(cpu.second, join(path, "cpus"), &index, 0, CPU_SETSIZE - 1))
+      return false;
+    realtime->cpus.push_back(index);
+  }
+  return true;
+}
+
+bool read(Reader &r, const pt::ptree &root, GyroConfig *config)
+{
+  if (!r.keys(root, "", {"buses", "discover", "device", "fifo", "record_hz", "orientation", "calibration",
+                         "activity", "sinks", "realtime", "telemetry"}) ||
+      !readBuses(r, section(root, "buses"), &config->buses) ||
+      !r.value(root, "", "discover", &config->discover) ||
+      !readDevice(r, section(root, "device"), &config->profile) ||
+      !r.value(root, "", "fifo", &config->fifo) || !r.integer(root, "", "record_hz", &config->record_hz, 0, 100000))
+    return false;
+
+  const pt::ptree &orientation = section(root, "orientation");
+  if (!r.keys(orientation, "orientation", {"enabled", "beta"}) ||
+      !r.value(orientation, "orientation", "enabled", &config->orientation) ||
+      !r.value(orientation, "orientation", "beta", &config->orientation_beta))
+    return false;
+
+  const pt::ptree &calibration = section(root, "calibration");
+  if (!r.keys(calibration, "calibration", {"enabled", "directory", "still_samples"}) ||
+      !r.value(calibration, "calibration", "enabled", &config->calibration) ||
+      !r.value(calibration, "calibration", "directory", &config->calibration_directory) ||
+      !r.integer(calibration, "calibration", "still_samples", &config->calibration_samples, 1, 1000000))
+    return false;
+
+  const pt::ptree &activity = section(root, "activity");
+  ActivityConfig &act = config->activity;
+  if (!r.keys(activity, "activity", {"enabled", "wake_threshold", "wake_duration", "sleep_duration", "gyro_power_down"}) ||
+      !r.value(activity, "activity", "enabled", &act.enabled) ||
+      !r.integer(activity, "activity", "wake_threshold", &act.wake_threshold, 0, 63) ||
+      !r.integer(activity, "activity", "wake_duration", &act.wake_duration, 0, 3) ||
+      !r.integer(activity, "activity", "sleep_duration", &act.sleep_duration, 0, 15) ||
+      !r.value(activity, "activity", "gyro_power_down", &act.gyro_power_down))
+    return false;
+
+  if (!readSinks(r, section(root, "sinks"), config) ||
+      !readRealtime(r, section(root, "realtime"), &config->realtime))
+    return false;
+
+  const pt::ptree &telemetry = section(root, "telemetry");
+  if (!r.keys(telemetry, "telemetry", {"address"}) || !r.value(telemetry, "telemetry", "address", &config->telemetry))
+    return false;
+
+  // The settings that are only wrong together
+  if (!sfe_ism_profile::isValid(config->profile))
+    return r.fail("device", "invalid combination of settings");
+  if (config->profile.gyroDataRate == ISM_GY_ODR_OFF)
+    return r.fail("device.gyro.odr_hz", "the gyroscope paces acquisition and cannot be off");
+  return true;
+}
+} // namespace
+
+namespace gyro_config
+{
+bool parse(const std::string &text, GyroConfig *config, std::string *error)
+{
+  pt::ptree root;
+  try
+  {
+    std::istringstream in(text);
+    pt::read_json(in, root);
+  }
+  catch (const pt::json_parser_error &e)
+  {
+    if (error)
+      *error = "line " + std::to_string(e.line()) + ": " + e.message();
+    return false;
+  }
+
+  GyroConfig parsed;
+  Reader reader;
+  if (!read(reader, root, &parsed))
+  {
+    if (error)
+      *error = reader.error;
+    return false;
+  }
+  *config = std::move(parsed);
+  return true;
+}
+
+bool load(const std::filesystem::path &path, GyroConfig *config, std::string *error)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    if (error)
+      *error = "cannot open " + path.string();
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  return parse(text.str(), config, error);
+}
+
+BusTopology topology(const GyroConfig &config)
+{
+  return config.buses.empty() ? discovery::scan(config.discover) : config.buses;
+}
+
+bool apply(const GyroConfig &config, GyroAPI *api)
+{
+  int record_hz = config.record_hz > 0 ? config.record_hz
+                                       : (int)std::ceil(sfe_ism_profile::gyroDataRateHz(config.profile.gyroDataRate));
+  api->setRecord(true, record_hz);
+  api->setFifo(config.fifo);
+  api->setOrientationFilter(config.orientation, config.orientation_beta);
+  if (!api->setCalibration(config.calibration, config.calibration_directory.c_str(), config.calibration_samples))
+    return false;
+  api->setActivityMode(config.activity);
+  api->setLogMode(config.log_mode);
+  api->setLogRotation(config.log_rotation);
+  api->setRealtime(config.realtime);
+  api->setTelemetry(config.telemetry);
+  return config.sample_bus.empty() || api->openSampleBus(config.sample_bus.c_str(), config.sample_bus_capacity);
+}
+} // namespace gyro_config
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "latency_trace.h"
+
+size_t LatencyHistogram::bucketOf(uint64_t ns)
+{
+  if (ns < kSubBuckets)
+    return (size_t)ns;
+
+  // Position of the leading bit selects the power of two, the next three bits
+  // the linear sub-bucket within it
+  int exponent = std::bit_width(ns) - 1;
+  size_t sub = (size_t)(ns >> (exponent - 3)) & (kSubBuckets - 1);
+  return (size_t)(exponent - 2) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketLow(size_t bucket)
+{
+  if (bucket < kSubBuckets)
+    return bucket;
+
+  int exponent = (int)(bucket / kSubBuckets) + 2;
+  return (uint64_t)(kSubBuckets + bucket % kSubBuckets) << (exponent - 3);
+}
+
+uint64_t LatencyHistogram::bucketHigh(size_t bucket)
+{
+  if (bucket < kSubBuckets)
+    return bucket;
+
+  int exponent = (int)(bucket / kSubBuckets) + 2;
+  return bucketLow(bucket) + ((uint64_t)1 << (exponent - 3)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns, uint64_t count)
+{
+  m_buckets[bucketOf(ns)] += count;
+  m_count += count;
+  m_sum += ns * count;
+  m_min = std::min(m_min, ns);
+  m_max = std::max(m_max, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+  for (size_t i = 0; i < kBuckets; i++)
+    m_buckets[i] += other.m_buckets[i];
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+}
+
+void LatencyHistogram::add(const uint64_t *buckets, uint64_t count, uint64_t sum, uint64_t min, uint64_t max)
+{
+  for (size_t i = 0; i < kBuckets; i++)
+    m_buckets[i] += buckets[i];
+  m_count += count;
+  m_sum += sum;
+  m_min = std::min(m_min, min);
+  m_max = std::max(m_max, max);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+  if (m_count == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t)(p / 100.0 * m_count + 0.5);
+  rank = std::max<uint64_t>(1, std::min(rank, m_count));
+
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++)
+  {
+    seen += m_buckets[i];
+    if (seen >= rank)
+      return std::min(bucketHigh(i), m_max);
+  }
+  return m_max;
+}
+
+namespace latency_trace
+{
+namespace
+{
+constexpr size_t kOps = (size_t)TraceOp::Count;
+constexpr size_t kCounters = (size_t)TraceCounter::Count;
+
+// Written by its owning thread only, read by anyone
+struct ThreadHistogram
+{
+  std::atomic<uint64_t> buckets[LatencyHistogram::kBuckets] = {};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> min{UINT64_MAX};
+  std::atomic<uint64_t> max{0};
+};
+
+struct ThreadTrace
+{
+  ThreadHistogram ops[kOps];
+  std::atomic<uint64_t> counters[kCounters] = {};
+};
+
+// Blocks outlive their threads so that a dump after join() still sees them
+std::mutex g_registry_mutex;
+std::vector<std::unique_ptr<ThreadTrace>> g_registry;
+
+ThreadTrace &local()
+{
+  thread_local ThreadTrace *trace = nullptr;
+  if (!trace)
+  {
+    std::lock_guard<std::mutex> lock(g_registry_mutex);
+    g_registry.push_back(std::make_unique<ThreadTrace>());
+    trace = g_registry.back().get();
+  }
+  return *trace;
+}
+
+// Single writer, so a load and a store replace the locked read-modify-write
+inline void bump(std::atomic<uint64_t> &value, uint64_t n)
+{
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+} // namespace
+
+void record(TraceOp op, uint64_t ns)
+{
+  ThreadHistogram &h = local().ops[(size_t)op];
+  bump(h.buckets[LatencyHistogram::bucketOf(ns)], 1);
+  bump(h.count, 1);
+  bump(h.sum, ns);
+  if (ns < h.min.load(std::memory_order_relaxed))
+    h.min.store(ns, std::memory_order_relaxed);
+  if (ns > h.max.load(std::memory_order_relaxed))
+    h.max.store(ns, std::memory_order_relaxed);
+}
+
+void count(TraceCounter counter, uint64_t n)
+{
+  bump(local().counters[(size_t)counter], n);
+}
+
+LatencyHistogram histogram(TraceOp op)
+{
+  LatencyHistogram total;
+  std::lock_guard<std::mutex> lock(g_registry_mutex);
+  for (auto &trace : g_registry)
+  {
+    const ThreadHistogram &h = trace->ops[(size_t)op];
+    if (h.count.load(std::memory_order_relaxed) == 0)
+      continue;
+
+    uint64_t buckets[LatencyHistogram::kBuckets];
+    for (size_t i = 0; i < LatencyHistogram::kBuckets; i++)
+      buckets[i] = h.buckets[i].load(std::memory_order_relaxed);
+    total.add(buckets, h.count.load(std::memory_order_relaxed), h.sum.load(std::memory_order_relaxed),
+              h.min.load(std::memory_order_relaxed), h.max.load(std::memory_order_relaxed));
+  }
+  return total;
+}
+
+uint64_t counter(TraceCounter counter)
+{
+  uint64_t total = 0;
+  std::lock_guard<std::mutex> lock(g_registry_mutex);
+  for (auto &trace : g_registry)
+    total += trace->counters[(size_t)counter].load(std::memory_order_relaxed);
+  return total;
+}
+
+void reset()
+{
+  std::lock_guard<std::mutex> lock(g_registry_mutex);
+  for (auto &trace : g_registry)
+  {
+    for (ThreadHistogram &h : trace->ops)
+    {
+      for (auto &bucket : h.buckets)
+        bucket.store(0, std::memory_order_relaxed);
+      h.count.store(0, std::memory_order_relaxed);
+      h.sum.store(0, std::memory_order_relaxed);
+      h.min.store(UINT64_MAX, std::memory_order_relaxed);
+      h.max.store(0, std::memory_order_relaxed);
+    }
+    for (auto &value : trace->counters)
+      value.store(0, std::memory_order_relaxed);
+  }
+}
+
+const char *name(TraceOp op)
+{
+  static const char *const kNames[kOps] = {"ioctl", "write", "read", "register write", "register read",
+                                           "status poll", "conversion", "log write", "sweep"};
+  return (size_t)op < kOps ? kNames[(size_t)op] : "unknown";
+}
+
+const char *name(TraceCounter counter)
+{
+  static const char *const kNames[kCounters] = {"bus errors", "not ready"};
+  return (size_t)counter < kCounters ? kNames[(size_t)counter] : "unknown";
+}
+
+void dump(std::ostream &out)
+{
+  out << std::left << std::setw(16) << "operation" << std::right
+      << std::setw(12) << "count" << std::setw(12) << "mean (us)" << std::setw(12) << "p50 (us)"
+      << std::setw(12) << "p99 (us)" << std::setw(12) << "p99.9 (us)" << std::setw(12) << "max (us)" << "\n";
+
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(1);
+  for (size_t i = 0; i < kOps; i++)
+  {
+    LatencyHistogram h = histogram((TraceOp)i);
+    if (h.count() == 0)
+      continue;
+    out << std::left << std::setw(16) << name((TraceOp)i) << std::right
+        << std::setw(12) << h.count()
+        << std::setw(12) << h.mean() / 1000.0
+        << std::setw(12) << h.percentile(50) / 1000.0
+        << std::setw(12) << h.percentile(99) / 1000.0
+        << std::setw(12) << h.percentile(99.9) / 1000.0
+        << std::setw(12) << h.max() / 1000.0 << "\n";
+  }
+  out.flags(flags);
+
+  for (size_t i = 0; i < kCounters; i++)
+    out << name((TraceCounter)i) << ": " << counter((TraceCounter)i) << "\n";
+}
+} // namespace latency_trace
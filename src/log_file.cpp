@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+#include "log_file.h"
+
+// O_DIRECT transfers must be aligned to the logical block size; the page size
+// covers every common device
+static const size_t kDirectAlign = 4096;
+
+static const size_t kBufferedSize = 64 << 10;
+
+struct LogFile::State
+{
+  int fd = -1;
+  size_t window = 0;
+  off_t allocated = 0; // Preallocated length, background thread only once open
+
+  std::mutex mutex;
+  std::condition_variable done;
+  int pending = 0; // Jobs queued or running
+  std::atomic<bool> failed{false};
+
+  // Mapped: window prepared by the background thread
+  char *next = nullptr;
+  bool next_ready = false;
+
+  // Direct: the two halves of the double buffer
+  char *buffers[2] = {nullptr, nullptr};
+};
+
+namespace
+{
+using State = LogFile::State;
+
+void fail(State &state, const char *what)
+{
+  if (!state.failed.exchange(true))
+    perror(what);
+}
+
+// Grows the preallocation to cover end, a whole extent at a time. File systems
+// without fallocate() get a sparse file instead.
+bool reserve(State &state, off_t end)
+{
+  const off_t extent = (off_t)(state.window * LogFile::kExtentWindows);
+  while (state.allocated < end)
+  {
+    if (fallocate(state.fd, 0, state.allocated, extent) != 0 &&
+        (errno != EOPNOTSUPP || ftruncate(state.fd, state.allocated + extent) != 0))
+      return false;
+    state.allocated += extent;
+  }
+  return true;
+}
+
+char *mapWindow(State &state, off_t offset)
+{
+  if (!reserve(state, offset + (off_t)state.window))
+    return nullptr;
+  void *addr = mmap(nullptr, state.window, PROT_READ | PROT_WRITE, MAP_SHARED, state.fd, offset);
+  if (addr == MAP_FAILED)
+    return nullptr;
+
+  // Take the write faults here rather than in the writing thread
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < state.window; i += page)
+    ((volatile char *)addr)[i] = 0;
+  return (char *)addr;
+}
+
+struct Job
+{
+  enum Kind
+  {
+    Prepare, // Mapped: map the window at offset into State::next
+    Retire,  // Mapped: start writeback of a full window and unmap it
+    Sync,    // Mapped: start writeback of a range
+    Write,   // Direct: write a full buffer
+  };
+
+  State *state;
+  Kind kind;
+  char *data;
+  size_t length;
+  off_t offset;
+};
+
+void run(const Job &job)
+{
+  State &state = *job.state;
+  switch (job.kind)
+  {
+  case Job::Prepare:
+  {
+    char *addr = mapWindow(state, job.offset);
+    if (!addr)
+      fail(state, "Failed to map log window");
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.next = addr;
+    state.next_ready = true;
+    break;
+  }
+  case Job::Retire:
+    sync_file_range(state.fd, job.offset, job.length, SYNC_FILE_RANGE_WRITE);
+    munmap(job.data, job.length);
+
+    // Once the window before is on disk, drop it from the page cache so that
+    // hours of capture do not crowd out everything else
+    if (job.offset >= (off_t)job.length)
+    {
+      off_t previous = job.offset - (off_t)job.length;
+      sync_file_range(state.fd, previous, job.length,
+                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+      posix_fadvise(state.fd, previous, job.length, POSIX_FADV_DONTNEED);
+    }
+    break;
+  case Job::Sync:
+    sync_file_range(state.fd, job.offset, job.length, SYNC_FILE_RANGE_WRITE);
+    break;
+  case Job::Write:
+  {
+    if (!reserve(state, job.offset + (off_t)job.length))
+    {
+      fail(state, "Failed to preallocate log file");
+      break;
+    }
+    size_t written = 0;
+    while (written < job.length)
+    {
+      ssize_t n = pwrite(state.fd, job.data + written, job.length - written, job.offset + (off_t)written);
+      if (n <= 0)
+      {
+        fail(state, "Failed to write log file");
+        break;
+      }
+      written += (size_t)n;
+    }
+    break;
+  }
+  }
+}
+
+// Background thread shared by every open LogFile
+class Flusher
+{
+public:
+  Flusher() : m_thread(&Flusher::worker, this) {}
+
+  ~Flusher()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+  }
+
+  void post(const Job &job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(job.state->mutex);
+      job.state->pending++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.push_back(job);
+    }
+    m_wake.notify_one();
+  }
+
+private:
+  void worker()
+  {
+    while (true)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+        if (m_jobs.empty())
+          return;
+        job = m_jobs.front();
+        m_jobs.pop_front();
+      }
+
+      run(job);
+
+      // Notify under the lock: once pending reaches zero the owner may free
+      // the state
+      std::lock_guard<std::mutex> lock(job.state->mutex);
+      job.state->pending--;
+      job.state->done.notify_all();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<Job> m_jobs;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+Flusher &flusher()
+{
+  static Flusher instance;
+  return instance;
+}
+
+void waitIdle(State &state)
+{
+  std::unique_lock<std::mutex> lock(state.mutex);
+  state.done.wait(lock, [&state] { return state.pending == 0; });
+}
+} // namespace
+
+LogFile::LogFile() = default;
+
+LogFile::~LogFile()
+{
+  close();
+}
+
+LogFile::LogFile(LogFile &&other) noexcept
+{
+  *this = std::move(other);
+}
+
+LogFile &LogFile::operator=(LogFile &&other) noexcept
+{
+  if (this != &other)
+  {
+    close();
+    m_mode = other.m_mode;
+    m_state = std::move(other.m_state);
+    m_window = std::exchange(other.m_window, nullptr);
+    m_window_size = std::exchange(other.m_window_size, 0);
+    m_window_used = std::exchange(other.m_window_used, 0);
+    m_window_offset = std::exchange(other.m_window_offset, 0);
+    m_size = std::exchange(other.m_size, 0);
+  }
+  return *this;
+}
+
+bool LogFile::open(const std::filesystem::path &path, LogFileMode mode, size_t window)
+{
+  close();
+
+  auto state = std::make_unique<State>();
+  state->window = window;
+
+  int flags = O_CREAT | O_TRUNC | O_CLOEXEC;
+  if (mode == LogFileMode::Mapped)
+    state->fd = ::open(path.c_str(), flags | O_RDWR, 0644);
+  else if (mode == LogFileMode::Direct)
+  {
+    state->fd = ::open(path.c_str(), flags | O_WRONLY | O_DIRECT, 0644);
+    if (state->fd < 0 && errno == EINVAL)
+    {
+      fprintf(stderr, "%s: file system does not support O_DIRECT, using buffered writes\n", path.c_str());
+      state->fd = ::open(path.c_str(), flags | O_WRONLY, 0644);
+    }
+  }
+  else
+    state->fd = ::open(path.c_str(), flags | O_WRONLY, 0644);
+
+  if (state->fd < 0)
+  {
+    perror("Failed to open log file");
+    return false;
+  }
+
+  switch (mode)
+  {
+  case LogFileMode::Buffered:
+    m_window_size = std::min(window, kBufferedSize);
+    state->buffers[0] = (char *)std::malloc(m_window_size);
+    m_window = state->buffers[0];
+    break;
+  case LogFileMode::Mapped:
+    m_window_size = window;
+    m_window = mapWindow(*state, 0);
+    break;
+  case LogFileMode::Direct:
+    m_window_size = window;
+    state->buffers[0] = (char *)std::aligned_alloc(kDirectAlign, window);
+    state->buffers[1] = (char *)std::aligned_alloc(kDirectAlign, window);
+    m_window = state->buffers[1] ? state->buffers[0] : nullptr;
+    if (m_window && !reserve(*state, (off_t)window))
+      m_window = nullptr;
+    break;
+  }
+
+  m_mode = mode;
+  m_state = std::move(state);
+  m_window_used = 0;
+  m_window_offset = 0;
+  m_size = 0;
+
+  if (!m_window)
+  {
+    perror("Failed to set up log file");
+    close();
+    return false;
+  }
+
+  if (mode == LogFileMode::Mapped)
+    flusher().post({m_state.get(), Job::Prepare, nullptr, 0, (off_t)window});
+  return true;
+}
+
+bool LogFile::write(const char *data, size_t length)
+{
+  if (!m_state || m_state->failed.load(std::memory_order_relaxed))
+    return false;
+
+  while (length > 0)
+  {
+    if (m_window_used == m_window_size && !nextWindow())
+      return false;
+
+    size_t n = std::min(length, m_window_size - m_window_used);
+    std::memcpy(m_window + m_window_used, data, n);
+    m_window_used += n;
+    m_size += n;
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+bool LogFile::writeBuffered(const char *data, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t n = ::write(m_state->fd, data, length);
+    if (n <= 0)
+    {
+      fail(*m_state, "Failed to write log file");
+      return false;
+    }
+    data += n;
+    length -= (size_t)n;
+  }
+  return true;
+}
+
+// Called with the current window full
+bool LogFile::nextWindow()
+{
+  State &state = *m_state;
+  switch (m_mode)
+  {
+  case LogFileMode::Buffered:
+    if (!writeBuffered(m_window, m_window_used))
+      return false;
+    break;
+
+  case LogFileMode::Mapped:
+  {
+    flusher().post({&state, Job::Retire, m_window, m_window_size, m_window_offset});
+
+    // Prepared a whole window ago, so normally already waiting
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.done.wait(lock, [&state] { return state.next_ready; });
+    m_window = std::exchange(state.next, nullptr);
+    state.next_ready = false;
+    lock.unlock();
+
+    if (!m_window)
+      return false;
+    m_window_offset += (off_t)m_window_size;
+    flusher().post({&state, Job::Prepare, nullptr, 0, m_window_offset + (off_t)m_window_size});
+    break;
+  }
+
+  case LogFileMode::Direct:
+    // The other buffer is free once its write has finished
+    waitIdle(state);
+    if (state.failed)
+      return false;
+    flusher().post({&state, Job::Write, m_window, m_window_size, m_window_offset});
+    m_window = m_window == state.buffers[0] ? state.buffers[1] : state.buffers[0];
+    m_window_offset += (off_t)m_window_size;
+    break;
+  }
+
+  m_window_used = 0;
+  return true;
+}
+
+void LogFile::flush()
+{
+  if (!m_state || m_state->failed)
+    return;
+
+  switch (m_mode)
+  {
+  case LogFileMode::Buffered:
+    if (writeBuffered(m_window, m_window_used))
+      m_window_used = 0;
+    break;
+
+  case LogFileMode::Mapped:
+    if (m_window_used > 0)
+      flusher().post({m_state.get(), Job::Sync, nullptr, m_window_used, m_window_offset});
+    break;
+
+  case LogFileMode::Direct:
+  {
+    // Writes the partial window padded to whole blocks; the padding is
+    // overwritten by later records and trimmed by close()
+    waitIdle(*m_state);
+    size_t length = (m_window_used + kDirectAlign - 1) / kDirectAlign * kDirectAlign;
+    if (length == 0)
+      break;
+    std::memset(m_window + m_window_used, 0, length - m_window_used);
+    Job job = {m_state.get(), Job::Write, m_window, length, m_window_offset};
+    run(job);
+    break;
+  }
+  }
+}
+
+void LogFile::close()
+{
+  if (!m_state)
+    return;
+
+  State &state = *m_state;
+  if (m_mode != LogFileMode::Mapped)
+    flush();
+  waitIdle(state);
+
+  if (m_mode == LogFileMode::Mapped)
+  {
+    if (m_window)
+      munmap(m_window, m_window_size);
+    if (state.next)
+      munmap(state.next, m_window_size);
+  }
+  std::free(state.buffers[0]);
+  std::free(state.buffers[1]);
+
+  if (ftruncate(state.fd, (off_t)m_size) != 0)
+    perror("Failed to trim log file");
+  ::close(state.fd);
+
+  m_state.reset();
+  m_window = nullptr;
+  m_window_size = 0;
+  m_window_used = 0;
+  m_window_offset = 0;
+}
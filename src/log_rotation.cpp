@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#ifdef ISM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "log_rotation.h"
+
+namespace log_segments
+{
+namespace
+{
+// Footer member: gzip header with FEXTRA, subfield "IX" holding the entries,
+// the entry count and kIndexMagic, then an empty deflate stream and trailer
+const uint32_t kIndexMagic = 0x584d5349; // "ISMX"
+const size_t kEntrySize = 24;
+const size_t kTrailerSize = 8;            // count, magic
+const size_t kMemberTail = 2 + 8;         // empty deflate block, CRC32, ISIZE
+const size_t kMaxEntries = (0xFFFF - 4 - kTrailerSize) / kEntrySize;
+
+void putLE(std::string *out, uint64_t value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    out->push_back((char)(value >> (8 * i)));
+}
+
+uint64_t getLE(const unsigned char *in, int bytes)
+{
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++)
+    value |= (uint64_t)in[i] << (8 * i);
+  return value;
+}
+
+// Number of the segment file name, if it is a segment of base
+bool parseSegment(const std::filesystem::path &base, const std::string &name, uint64_t *index)
+{
+  const std::string prefix = base.stem().string() + ".";
+  const std::string ext = base.extension().string();
+  if (name.compare(0, prefix.size(), prefix) != 0)
+    return false;
+
+  const char *first = name.data() + prefix.size();
+  const char *last = name.data() + name.size();
+  auto [end, ec] = std::from_chars(first, last, *index);
+  if (ec != std::errc() || end == first)
+    return false;
+
+  std::string rest(end, last);
+  return rest == ext || rest == ext + ".gz";
+}
+
+// Runs posted jobs in order at idle CPU and I/O priority, so compression never
+// competes with acquisition
+class Maintenance
+{
+public:
+  Maintenance() : m_thread(&Maintenance::worker, this) {}
+
+  ~Maintenance()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+  }
+
+  void post(std::function<void()> job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.push_back(std::move(job));
+    }
+    m_wake.notify_all();
+  }
+
+  void drain()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_jobs.empty() && !m_running; });
+  }
+
+private:
+  void worker()
+  {
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+    const int kIoprioWhoProcess = 1, kIoprioClassIdle = 3;
+    syscall(SYS_ioprio_set, kIoprioWhoProcess, tid, kIoprioClassIdle << 13);
+#endif
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+      m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+      if (m_jobs.empty())
+        return;
+
+      std::function<void()> job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+      m_running = true;
+      lock.unlock();
+      job();
+      lock.lock();
+      m_running = false;
+      if (m_jobs.empty())
+        m_idle.notify_all();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake, m_idle;
+  std::deque<std::function<void()>> m_jobs;
+  bool m_running = false;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+Maintenance &maintenance()
+{
+  static Maintenance instance;
+  return instance;
+}
+
+#ifdef ISM_HAVE_ZLIB
+// Time of the first sample row in block, skipping the CSV header
+int64_t firstTimestamp(const char *data, size_t length, int64_t fallback)
+{
+  const char *end = data + length;
+  for (const char *line = data; line < end;)
+  {
+    int64_t timestamp;
+    auto [ptr, ec] = std::from_chars(line, end, timestamp);
+    if (ec == std::errc() && ptr < end && *ptr == ',')
+      return timestamp;
+    line = (const char *)std::memchr(line, '\n', end - line);
+    if (!line)
+      break;
+    line++;
+  }
+  return fallback;
+}
+
+bool writeMember(z_stream *stream, const char *data, size_t length, std::FILE *out)
+{
+  std::string compressed(deflateBound(stream, length), '\0');
+  stream->next_in = (Bytef *)data;
+  stream->avail_in = (uInt)length;
+  stream->next_out = (Bytef *)compressed.data();
+  stream->avail_out = (uInt)compressed.size();
+  if (deflate(stream, Z_FINISH) != Z_STREAM_END)
+    return false;
+
+  size_t n = compressed.size() - stream->avail_out;
+  bool ok = std::fwrite(compressed.data(), 1, n, out) == n;
+  deflateReset(stream);
+  return ok;
+}
+
+std::string indexMember(const std::vector<SegmentIndexEntry> &entries)
+{
+  std::string payload;
+  for (const SegmentIndexEntry &entry : entries)
+  {
+    putLE(&payload, (uint64_t)entry.timestamp, 8);
+    putLE(&payload, entry.offset, 8);
+    putLE(&payload, entry.csv_offset, 8);
+  }
+  putLE(&payload, entries.size(), 4);
+  putLE(&payload, kIndexMagic, 4);
+
+  std::string member = {'\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, 3};
+  putLE(&member, payload.size() + 4, 2); // XLEN
+  member += "IX";
+  putLE(&member, payload.size(), 2);
+  member += payload;
+  member += std::string("\x03\x00", 2);
+  member += std::string(8, '\0');
+  return member;
+}
+#endif
+} // namespace
+
+std::filesystem::path segmentPath(const std::filesystem::path &base, uint64_t index, bool compressed)
+{
+  char number[24];
+  std::snprintf(number, sizeof(number), ".%06llu", (unsigned long long)index);
+  std::string name = base.stem().string() + number + base.extension().string();
+  if (compressed)
+    name += ".gz";
+  return base.parent_path() / name;
+}
+
+uint64_t nextIndex(const std::filesystem::path &base)
+{
+  uint64_t next = 0;
+  std::error_code ec;
+  std::filesystem::path dir = base.parent_path().empty() ? "." : base.parent_path();
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+  {
+    uint64_t index;
+    if (parseSegment(base, entry.path().filename().string(), &index))
+      next = std::max(next, index + 1);
+  }
+  return next;
+}
+
+bool compress(const std::filesystem::path &csv, const std::filesystem::path &gz)
+{
+#ifdef ISM_HAVE_ZLIB
+  std::FILE *in = std::fopen(csv.c_str(), "rb");
+  if (!in)
+    return false;
+  std::filesystem::path partial = gz;
+  partial += ".tmp";
+  std::FILE *out = std::fopen(partial.c_str(), "wb");
+  if (!out)
+  {
+    std::fclose(in);
+    return false;
+  }
+
+  z_stream stream = {};
+  bool ok = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+  // Blocks end on a row boundary after at least kIndexBlock bytes
+  std::vector<SegmentIndexEntry> entries;
+  std::string pending;
+  std::vector<char> chunk(kIndexBlock);
+  uint64_t offset = 0, csv_offset = 0;
+  int64_t timestamp = 0;
+  bool eof = false;
+  while (ok && (!eof || !pending.empty()))
+  {
+    if (!eof)
+    {
+      size_t n = std::fread(chunk.data(), 1, chunk.size(), in);
+      pending.append(chunk.data(), n);
+      eof = n < chunk.size();
+    }
+
+    size_t length = pending.size();
+    if (!eof)
+    {
+      if (pending.size() < kIndexBlock)
+        continue;
+      size_t newline = pending.find('\n', kIndexBlock - 1);
+      if (newline == std::string::npos)
+        continue;
+      length = newline + 1;
+    }
+
+    timestamp = firstTimestamp(pending.data(), length, timestamp);
+    if (entries.size() < kMaxEntries)
+      entries.push_back({timestamp, offset, csv_offset});
+
+    ok = writeMember(&stream, pending.data(), length, out);
+    offset = (uint64_t)std::ftell(out);
+    csv_offset += length;
+    pending.erase(0, length);
+  }
+  deflateEnd(&stream);
+
+  if (ok)
+  {
+    std::string footer = indexMember(entries);
+    ok = std::fwrite(footer.data(), 1, footer.size(), out) == footer.size() && !std::ferror(in);
+  }
+  ok = std::fclose(out) == 0 && ok;
+  std::fclose(in);
+
+  std::error_code ec;
+  if (ok)
+    std::filesystem::rename(partial, gz, ec);
+  if (!ok || ec)
+  {
+    std::filesystem::remove(partial, ec);
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool readIndex(const std::filesystem::path &gz, std::vector<SegmentIndexEntry> *entries)
+{
+  entries->clear();
+  std::FILE *in = std::fopen(gz.c_str(), "rb");
+  if (!in)
+    return false;
+
+  bool ok = false;
+  unsigned char tail[kTrailerSize + kMemberTail];
+  if (std::fseek(in, -(long)sizeof(tail), SEEK_END) == 0 && std::fread(tail, 1, sizeof(tail), in) == sizeof(tail) &&
+      getLE(tail + 4, 4) == kIndexMagic)
+  {
+    size_t count = (size_t)getLE(tail, 4);
+    size_t payload = count * kEntrySize + kTrailerSize;
+    long start = -(long)(12 + 4 + payload + kMemberTail);
+
+    std::vector<unsigned char> member(16 + count * kEntrySize);
+    if (count <= kMaxEntries && std::fseek(in, start, SEEK_END) == 0 &&
+        std::fread(member.data(), 1, member.size(), in) == member.size() && member[0] == 0x1f &&
+        member[1] == 0x8b && member[12] == 'I' && member[13] == 'X' && getLE(&member[14], 2) == payload)
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        const unsigned char *entry = &member[16 + i * kEntrySize];
+        entries->push_back({(int64_t)getLE(entry, 8), getLE(entry + 8, 8), getLE(entry + 16, 8)});
+      }
+      ok = true;
+    }
+  }
+  std::fclose(in);
+  return ok;
+}
+
+const SegmentIndexEntry *find(const std::vector<SegmentIndexEntry> &entries, int64_t timestamp)
+{
+  auto after = std::upper_bound(entries.begin(), entries.end(), timestamp,
+                                [](int64_t t, const SegmentIndexEntry &entry) { return t < entry.timestamp; });
+  if (after == entries.begin())
+    return entries.empty() ? nullptr : &entries.front();
+  return &*(after - 1);
+}
+
+void prune(const std::filesystem::path &base, uint64_t before, size_t keep)
+{
+  std::vector<std::pair<uint64_t, std::filesystem::path>> closed;
+  std::error_code ec;
+  std::filesystem::path dir = base.parent_path().empty() ? "." : base.parent_path();
+  for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+  {
+    uint64_t index;
+    if (parseSegment(base, entry.path().filename().string(), &index) && index < before)
+      closed.push_back({index, entry.path()});
+  }
+  // A segment can briefly exist both plain and compressed
+  std::vector<uint64_t> indices;
+  for (const auto &segment : closed)
+    indices.push_back(segment.first);
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  if (indices.size() <= keep)
+    return;
+
+  uint64_t oldest_kept = indices[indices.size() - keep];
+  for (const auto &segment : closed)
+    if (segment.first < oldest_kept)
+      std::filesystem::remove(segment.second, ec);
+}
+
+void post(std::function<void()> job)
+{
+  maintenance().post(std::move(job));
+}
+
+void drain()
+{
+  maintenance().drain();
+}
+} // namespace log_segments
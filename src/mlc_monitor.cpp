@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "mlc_monitor.h"
+
+namespace ucf
+{
+bool parse(const std::string &text, std::vector<sfe_ism_reg_write_t> *writes, std::string *error)
+{
+  writes->clear();
+  std::istringstream in(text);
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream fields(line);
+    std::string op;
+    if (!(fields >> op) || op.compare(0, 2, "--") == 0)
+      continue;
+
+    unsigned reg, value;
+    std::string rest;
+    if (op != "Ac" || !(fields >> std::hex >> reg >> value) || reg > 0xFF || value > 0xFF || (fields >> rest))
+    {
+      if (error)
+        *error = line;
+      return false;
+    }
+    writes->push_back({(uint8_t)reg, (uint8_t)value});
+  }
+  return true;
+}
+
+bool load(const std::filesystem::path &path, std::vector<sfe_ism_reg_write_t> *writes, std::string *error)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    if (error)
+      *error = "cannot open " + path.string();
+    return false;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  return parse(text.str(), writes, error);
+}
+} // namespace ucf
+
+MlcMonitor::MlcMonitor(QwDevISM330DHCX &device, uint8_t trees, uint16_t pre_words, uint16_t post_words)
+    : m_device(device), m_trees(trees), m_pre_words(std::min(pre_words, kFifoWords)), m_post_words(post_words)
+{
+  if (m_pre_words > 0 || m_post_words > 0)
+    m_fifo.resize(kFifoWords);
+}
+
+bool MlcMonitor::begin()
+{
+  m_pending.clear();
+  if (!m_device.getMlcOutputs(m_outputs))
+    return false;
+  m_bytes_read += sizeof(m_outputs);
+
+  if (!m_fifo.empty())
+  {
+    uint16_t n = m_device.readFifo(m_fifo.data(), kFifoWords);
+    m_bytes_read += 2 + (uint64_t)n * sizeof(sfe_ism_fifo_word_t);
+  }
+  return true;
+}
+
+bool MlcMonitor::poll(int64_t timestamp, std::vector<MlcEvent> *events)
+{
+  uint8_t status;
+  if (!m_device.getMlcStatus(&status))
+    return false;
+  m_bytes_read += 1;
+
+  size_t started = m_pending.size();
+  if (status & m_trees)
+  {
+    uint8_t outputs[8];
+    if (!m_device.getMlcOutputs(outputs))
+      return false;
+    m_bytes_read += sizeof(outputs);
+
+    for (uint8_t tree = 0; tree < 8; tree++)
+    {
+      if (!(m_trees & (1u << tree)) || outputs[tree] == m_outputs[tree])
+        continue;
+      m_pending.push_back({{timestamp, tree, outputs[tree], m_outputs[tree], {}}, m_post_words});
+      m_outputs[tree] = outputs[tree];
+    }
+  }
+
+  if (m_pending.empty())
+    return true;
+
+  // Everything in the FIFO now predates the new events and follows the
+  // earlier ones
+  uint16_t n = 0;
+  if (!m_fifo.empty())
+  {
+    n = m_device.readFifo(m_fifo.data(), kFifoWords);
+    m_bytes_read += 2 + (uint64_t)n * sizeof(sfe_ism_fifo_word_t);
+  }
+
+  for (size_t i = 0; i < m_pending.size(); i++)
+  {
+    Pending &pending = m_pending[i];
+    std::vector<sfe_ism_fifo_word_t> &window = pending.event.window;
+    if (i >= started)
+      window.assign(m_fifo.begin() + (n - std::min(n, m_pre_words)), m_fifo.begin() + n);
+    else
+    {
+      uint16_t take = std::min(n, pending.post_left);
+      window.insert(window.end(), m_fifo.begin(), m_fifo.begin() + take);
+      pending.post_left -= take;
+    }
+  }
+
+  auto done = std::stable_partition(m_pending.begin(), m_pending.end(),
+                                    [](const Pending &pending) { return pending.post_left > 0; });
+  for (auto it = done; it != m_pending.end(); ++it)
+    events->push_back(std::move(it->event));
+  m_pending.erase(done, m_pending.end());
+  return true;
+}
@@ -0,0 +1,130 @@
+#include <cmath>
+
+#include "orientation_filter.h"
+
+// mdps to rad/s
+static const float kMdpsToRads = 3.14159265358979f / 180000.0f;
+
+OrientationFilter::OrientationFilter(size_t num_devices, float beta) : m_beta(beta)
+{
+  resize(num_devices);
+}
+
+void OrientationFilter::resize(size_t num_devices)
+{
+  for (std::vector<float> *column : {&m_q0, &m_q1, &m_q2, &m_q3, &m_gx, &m_gy, &m_gz, &m_ax, &m_ay, &m_az, &m_dt})
+    column->assign(num_devices, 0.0f);
+  reset();
+}
+
+void OrientationFilter::reset()
+{
+  for (size_t i = 0; i < m_q0.size(); i++)
+  {
+    m_q0[i] = 1.0f;
+    m_q1[i] = m_q2[i] = m_q3[i] = 0.0f;
+    m_dt[i] = 0.0f;
+  }
+}
+
+void OrientationFilter::setInput(size_t device, const SampleRecord &sample, float dt)
+{
+  if (device >= m_q0.size())
+    return;
+
+  m_gx[device] = sample.gx * kMdpsToRads;
+  m_gy[device] = sample.gy * kMdpsToRads;
+  m_gz[device] = sample.gz * kMdpsToRads;
+  m_ax[device] = sample.ax;
+  m_ay[device] = sample.ay;
+  m_az[device] = sample.az;
+  m_dt[device] = dt > 0.0f ? dt : 0.0f;
+}
+
+// One Madgwick IMU step for n devices. Kept as a free function over restrict
+// pointers so that the compiler can prove the columns do not alias.
+static void madgwickUpdate(size_t n, float beta,
+                           float *__restrict q0, float *__restrict q1, float *__restrict q2, float *__restrict q3,
+                           const float *__restrict gxs, const float *__restrict gys, const float *__restrict gzs,
+                           const float *__restrict axs, const float *__restrict ays, const float *__restrict azs,
+                           float *__restrict dts)
+{
+  // No early-outs in the body: devices without input (dt == 0) or without a
+  // usable accelerometer reading are masked arithmetically so the loop stays
+  // vectorisable.
+  for (size_t i = 0; i < n; i++)
+  {
+    float w = q0[i], x = q1[i], y = q2[i], z = q3[i];
+    float gx = gxs[i], gy = gys[i], gz = gzs[i];
+    float ax = axs[i], ay = ays[i], az = azs[i];
+    float dt = dts[i];
+
+    // Rate of change of quaternion from gyroscope
+    float qDot0 = 0.5f * (-x * gx - y * gy - z * gz);
+    float qDot1 = 0.5f * (w * gx + y * gz - z * gy);
+    float qDot2 = 0.5f * (w * gy - x * gz + z * gx);
+    float qDot3 = 0.5f * (w * gz + x * gy - y * gx);
+
+    // Normalise accelerometer measurement, zero vector disables the correction
+    float aNorm = ax * ax + ay * ay + az * az;
+    float aValid = aNorm / (aNorm + 1e-30f); // 0 for a zero vector, else 1
+    float recipNorm = 1.0f / std::sqrt(aNorm + (1.0f - aValid));
+    ax *= recipNorm;
+    ay *= recipNorm;
+    az *= recipNorm;
+
+    // Gradient descent corrective step
+    float _2w = 2.0f * w, _2x = 2.0f * x, _2y = 2.0f * y, _2z = 2.0f * z;
+    float _4w = 4.0f * w, _4x = 4.0f * x, _4y = 4.0f * y;
+    float _8x = 8.0f * x, _8y = 8.0f * y;
+    float ww = w * w, xx = x * x, yy = y * y, zz = z * z;
+
+    float s0 = _4w * yy + _2y * ax + _4w * xx - _2x * ay;
+    float s1 = _4x * zz - _2z * ax + 4.0f * ww * x - _2w * ay - _4x + _8x * xx + _8x * yy + _4x * az;
+    float s2 = 4.0f * ww * y + _2w * ax + _4y * zz - _2z * ay - _4y + _8y * xx + _8y * yy + _4y * az;
+    float s3 = 4.0f * xx * z - _2x * ax + 4.0f * yy * z - _2y * ay;
+
+    float sNorm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+    float step = aValid * beta / std::sqrt(sNorm + 1e-12f);
+
+    qDot0 -= step * s0;
+    qDot1 -= step * s1;
+    qDot2 -= step * s2;
+    qDot3 -= step * s3;
+
+    // Integrate and normalise
+    w += qDot0 * dt;
+    x += qDot1 * dt;
+    y += qDot2 * dt;
+    z += qDot3 * dt;
+
+    float qNorm = 1.0f / std::sqrt(w * w + x * x + y * y + z * z);
+    q0[i] = w * qNorm;
+    q1[i] = x * qNorm;
+    q2[i] = y * qNorm;
+    q3[i] = z * qNorm;
+
+    // Input consumed
+    dts[i] = 0.0f;
+  }
+}
+
+void OrientationFilter::update()
+{
+  madgwickUpdate(m_q0.size(), m_beta,
+                 m_q0.data(), m_q1.data(), m_q2.data(), m_q3.data(),
+                 m_gx.data(), m_gy.data(), m_gz.data(),
+                 m_ax.data(), m_ay.data(), m_az.data(),
+                 m_dt.data());
+}
+
+void OrientationFilter::getQuaternion(size_t device, SampleRecord *sample) const
+{
+  if (device >= m_q0.size())
+    return;
+
+  sample->qw = m_q0[device];
+  sample->qx = m_q1[device];
+  sample->qy = m_q2[device];
+  sample->qz = m_q3[device];
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <bit>
+
+#include "raw_codec.h"
+
+namespace raw_codec
+{
+namespace
+{
+// int16 deltas need at most 17 bits once zigzagged
+const unsigned kMaxWidth = 17;
+
+enum class Parse
+{
+  Ok,
+  Partial,
+  Corrupt,
+};
+
+size_t groupCount(size_t count)
+{
+  return (count - 1 + kGroupSamples - 1) / kGroupSamples;
+}
+
+// Validates the block header at in and computes the block size from the
+// group widths
+Parse parseHeader(const uint8_t *in, size_t length, size_t *count, size_t *size)
+{
+  if (length < 4)
+    return Parse::Partial;
+  if (in[0] != kBlockMagic || in[1] != kVersion)
+    return Parse::Corrupt;
+  *count = (size_t)in[2] | (size_t)in[3] << 8;
+  if (*count == 0 || *count > kBlockSamples)
+    return Parse::Corrupt;
+
+  const size_t groups = groupCount(*count);
+  if (length < kHeaderSize + 3 * groups)
+    return Parse::Partial;
+
+  const uint8_t *widths = in + kHeaderSize;
+  size_t bits = 0;
+  for (size_t axis = 0; axis < 3; axis++)
+    for (size_t g = 0; g < groups; g++)
+    {
+      unsigned width = widths[axis * groups + g];
+      if (width > kMaxWidth)
+        return Parse::Corrupt;
+      bits += width * std::min(kGroupSamples, *count - 1 - g * kGroupSamples);
+    }
+
+  *size = kHeaderSize + 3 * groups + (bits + 7) / 8;
+  return length < *size ? Parse::Partial : Parse::Ok;
+}
+
+class BitWriter
+{
+public:
+  explicit BitWriter(uint8_t *out) : m_out(out) {}
+
+  void put(uint32_t value, unsigned width)
+  {
+    m_acc |= (uint64_t)value << m_bits;
+    m_bits += width;
+    while (m_bits >= 8)
+    {
+      *m_out++ = (uint8_t)m_acc;
+      m_acc >>= 8;
+      m_bits -= 8;
+    }
+  }
+
+  uint8_t *finish()
+  {
+    if (m_bits > 0)
+      *m_out++ = (uint8_t)m_acc;
+    return m_out;
+  }
+
+private:
+  uint8_t *m_out;
+  uint64_t m_acc = 0;
+  unsigned m_bits = 0;
+};
+
+class BitReader
+{
+public:
+  explicit BitReader(const uint8_t *in) : m_in(in) {}
+
+  // Only called for bits the header accounted for, so never reads past the block
+  uint32_t get(unsigned width)
+  {
+    while (m_bits < width)
+    {
+      m_acc |= (uint64_t)*m_in++ << m_bits;
+      m_bits += 8;
+    }
+    uint32_t value = (uint32_t)(m_acc & ((1u << width) - 1));
+    m_acc >>= width;
+    m_bits -= width;
+    return value;
+  }
+
+private:
+  const uint8_t *m_in;
+  uint64_t m_acc = 0;
+  unsigned m_bits = 0;
+};
+
+void putInt16(uint8_t *out, int16_t value)
+{
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)((uint16_t)value >> 8);
+}
+
+int16_t getInt16(const uint8_t *in)
+{
+  return (int16_t)(uint16_t)(in[0] | in[1] << 8);
+}
+} // namespace
+
+size_t encodeBlock(const sfe_ism_raw_data_t *samples, size_t count, uint8_t *out)
+{
+  if (count == 0 || count > kBlockSamples)
+    return 0;
+
+  // Split into axes so the passes below run on plain arrays
+  int32_t axes[3][kBlockSamples];
+  for (size_t i = 0; i < count; i++)
+  {
+    axes[0][i] = samples[i].xData;
+    axes[1][i] = samples[i].yData;
+    axes[2][i] = samples[i].zData;
+  }
+
+  const size_t deltas = count - 1;
+  uint32_t zigzag[3][kBlockSamples];
+  for (size_t axis = 0; axis < 3; axis++)
+  {
+    const int32_t *v = axes[axis];
+    uint32_t *zz = zigzag[axis];
+    for (size_t i = 0; i < deltas; i++)
+    {
+      int32_t d = v[i + 1] - v[i];
+      zz[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+    }
+  }
+
+  out[0] = kBlockMagic;
+  out[1] = kVersion;
+  out[2] = (uint8_t)count;
+  out[3] = (uint8_t)(count >> 8);
+  putInt16(out + 4, samples[0].xData);
+  putInt16(out + 6, samples[0].yData);
+  putInt16(out + 8, samples[0].zData);
+
+  const size_t groups = deltas > 0 ? groupCount(count) : 0;
+  uint8_t *widths = out + kHeaderSize;
+  for (size_t axis = 0; axis < 3; axis++)
+    for (size_t g = 0; g < groups; g++)
+    {
+      const uint32_t *zz = zigzag[axis] + g * kGroupSamples;
+      size_t n = std::min(kGroupSamples, deltas - g * kGroupSamples);
+      uint32_t bits = 0;
+      for (size_t i = 0; i < n; i++)
+        bits |= zz[i];
+      widths[axis * groups + g] = (uint8_t)std::bit_width(bits);
+    }
+
+  BitWriter writer(widths + 3 * groups);
+  for (size_t axis = 0; axis < 3; axis++)
+    for (size_t g = 0; g < groups; g++)
+    {
+      const uint32_t *zz = zigzag[axis] + g * kGroupSamples;
+      size_t n = std::min(kGroupSamples, deltas - g * kGroupSamples);
+      unsigned width = widths[axis * groups + g];
+      if (width == 0)
+        continue;
+      for (size_t i = 0; i < n; i++)
+        writer.put(zz[i], width);
+    }
+  return (size_t)(writer.finish() - out);
+}
+
+size_t blockSize(const uint8_t *in, size_t length)
+{
+  size_t count, size;
+  return parseHeader(in, length, &count, &size) == Parse::Ok ? size : 0;
+}
+
+size_t decodeBlock(const uint8_t *in, size_t length, sfe_ism_raw_data_t *samples, size_t *count)
+{
+  size_t n, size;
+  if (parseHeader(in, length, &n, &size) != Parse::Ok)
+    return 0;
+
+  const size_t deltas = n - 1;
+  const size_t groups = deltas > 0 ? groupCount(n) : 0;
+  const uint8_t *widths = in + kHeaderSize;
+  BitReader reader(widths + 3 * groups);
+
+  uint32_t zigzag[3][kBlockSamples];
+  for (size_t axis = 0; axis < 3; axis++)
+    for (size_t g = 0; g < groups; g++)
+    {
+      uint32_t *zz = zigzag[axis] + g * kGroupSamples;
+      size_t count_in_group = std::min(kGroupSamples, deltas - g * kGroupSamples);
+      unsigned width = widths[axis * groups + g];
+      if (width == 0)
+        std::fill(zz, zz + count_in_group, 0u);
+      else
+        for (size_t i = 0; i < count_in_group; i++)
+          zz[i] = reader.get(width);
+    }
+
+  int32_t d[3][kBlockSamples];
+  for (size_t axis = 0; axis < 3; axis++)
+    for (size_t i = 0; i < deltas; i++)
+      d[axis][i] = (int32_t)(zigzag[axis][i] >> 1) ^ -(int32_t)(zigzag[axis][i] & 1);
+
+  int16_t x = getInt16(in + 4), y = getInt16(in + 6), z = getInt16(in + 8);
+  samples[0] = {x, y, z};
+  for (size_t i = 0; i < deltas; i++)
+  {
+    x = (int16_t)(x + d[0][i]);
+    y = (int16_t)(y + d[1][i]);
+    z = (int16_t)(z + d[2][i]);
+    samples[i + 1] = {x, y, z};
+  }
+
+  *count = n;
+  return size;
+}
+
+void encode(const sfe_ism_raw_data_t *samples, size_t count, std::vector<uint8_t> *out)
+{
+  while (count > 0)
+  {
+    size_t n = std::min(count, kBlockSamples);
+    size_t start = out->size();
+    out->resize(start + maxBlockSize(n));
+    out->resize(start + encodeBlock(samples, n, out->data() + start));
+    samples += n;
+    count -= n;
+  }
+}
+
+bool decode(const uint8_t *in, size_t length, std::vector<sfe_ism_raw_data_t> *out)
+{
+  sfe_ism_raw_data_t block[kBlockSamples];
+  while (length > 0)
+  {
+    size_t count;
+    size_t size = decodeBlock(in, length, block, &count);
+    if (size == 0)
+      return false;
+    out->insert(out->end(), block, block + count);
+    in += size;
+    length -= size;
+  }
+  return true;
+}
+
+bool indexBlocks(const uint8_t *in, size_t length, std::vector<size_t> *offsets)
+{
+  offsets->clear();
+  size_t offset = 0;
+  while (offset < length)
+  {
+    size_t size = blockSize(in + offset, length - offset);
+    if (size == 0)
+      return false;
+    offsets->push_back(offset);
+    offset += size;
+  }
+  return true;
+}
+} // namespace raw_codec
+
+bool RawStreamEncoder::add(const sfe_ism_raw_data_t &sample)
+{
+  m_pending[m_count++] = sample;
+  return m_count == raw_codec::kBlockSamples && flush();
+}
+
+bool RawStreamEncoder::flush()
+{
+  if (m_count == 0)
+    return false;
+  raw_codec::encode(m_pending, m_count, &m_output);
+  m_count = 0;
+  return true;
+}
+
+bool RawStreamDecoder::feed(const uint8_t *data, size_t length, std::vector<sfe_ism_raw_data_t> *samples)
+{
+  m_buffer.insert(m_buffer.end(), data, data + length);
+
+  sfe_ism_raw_data_t block[raw_codec::kBlockSamples];
+  size_t offset = 0;
+  while (offset < m_buffer.size())
+  {
+    size_t count, size;
+    raw_codec::Parse parse =
+        raw_codec::parseHeader(m_buffer.data() + offset, m_buffer.size() - offset, &count, &size);
+    if (parse == raw_codec::Parse::Partial)
+      break;
+    if (parse == raw_codec::Parse::Corrupt)
+    {
+      m_buffer.clear();
+      return false;
+    }
+    raw_codec::decodeBlock(m_buffer.data() + offset, size, block, &count);
+    samples->insert(samples->end(), block, block + count);
+    offset += size;
+  }
+  m_buffer.erase(m_buffer.begin(), m_buffer.begin() + (ptrdiff_t)offset);
+  return true;
+}
@@ -0,0 +1,104 @@
+#include <cmath>
+
+#include "ready_poller.h"
+
+ReadyPoller::ReadyPoller(double nominal_period_ns)
+{
+  reset(nominal_period_ns);
+}
+
+void ReadyPoller::reset(double nominal_period_ns)
+{
+  m_period = nominal_period_ns;
+  m_next_edge = 0.0;
+  m_has_anchor = false;
+  m_anchor = 0.0;
+  m_prev_poll = -1;
+  m_locked = false;
+  m_searching = true;
+  m_since_probe = 0;
+  m_probe_interval = 1;
+  m_polls = 0;
+  m_not_ready = 0;
+}
+
+int64_t ReadyPoller::nextPoll() const
+{
+  // Unknown rate, nothing to schedule
+  if (m_period <= 0.0)
+    return m_prev_poll;
+
+  double step = m_period / 16.0;
+
+  // Fine search until a not-ready to ready transition brackets an edge
+  if (!m_locked || m_searching)
+    return m_prev_poll < 0 ? 0 : m_prev_poll + (int64_t)step;
+
+  // Deliberately early once in a while to measure the phase again
+  if (m_since_probe >= m_probe_interval)
+    return (int64_t)(m_next_edge - step);
+
+  return (int64_t)(m_next_edge + step);
+}
+
+void ReadyPoller::observe(int64_t t, bool ready)
+{
+  int64_t lower = m_prev_poll;
+  m_prev_poll = t;
+  m_polls++;
+
+  if (!ready)
+  {
+    m_not_ready++;
+    m_searching = true;
+    return;
+  }
+
+  if (m_period <= 0.0)
+    return;
+
+  m_searching = false;
+  m_since_probe++;
+
+  if (lower >= 0 && t - lower <= m_period / 4.0)
+  {
+    // The edge lies in (lower, t]
+    double edge = 0.5 * (double)(lower + t);
+    if (m_has_anchor)
+    {
+      double periods = std::round((edge - m_anchor) / m_period);
+      if (periods >= 1.0)
+        m_period = (edge - m_anchor) / periods;
+      if (periods >= kMaxBaseline)
+        m_anchor = edge;
+    }
+    else
+    {
+      m_has_anchor = true;
+      m_anchor = edge;
+    }
+
+    m_next_edge = edge + m_period;
+    m_locked = true;
+    m_since_probe = 0;
+    if (m_probe_interval < kProbeInterval)
+      m_probe_interval *= 2;
+  }
+  else if (m_locked && t >= m_next_edge)
+  {
+    // Loose bracket: the data is the newest edge predicted before t
+    double passed = std::floor(((double)t - m_next_edge) / m_period);
+    m_next_edge += (passed + 1.0) * m_period;
+  }
+  else if (m_locked)
+  {
+    // Ready before the predicted edge, the phase has moved: measure it again
+    m_next_edge = (double)t + m_period;
+    m_since_probe = m_probe_interval;
+  }
+  else
+  {
+    // Data was pending from before the search started, keep searching
+    m_searching = true;
+  }
+}
@@ -0,0 +1,135 @@
+#include <alloca.h>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "rt_thread.h"
+
+namespace
+{
+// Layout of the sched_setattr(2) argument, which glibc does not declare
+struct SchedAttr
+{
+  uint32_t size;
+  uint32_t sched_policy;
+  uint64_t sched_flags;
+  int32_t sched_nice;
+  uint32_t sched_priority;
+  uint64_t sched_runtime;
+  uint64_t sched_deadline;
+  uint64_t sched_period;
+};
+
+std::string failure(const char *what)
+{
+  return std::string(what) + ": " + std::strerror(errno);
+}
+
+void setScheduling(const RtThreadConfig &config, RtThreadReport *report)
+{
+  if (config.policy == RtPolicy::Fifo)
+  {
+    sched_param param = {};
+    param.sched_priority = config.priority;
+    int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (error != 0)
+    {
+      errno = error;
+      report->notes.push_back(failure("SCHED_FIFO"));
+    }
+
+    int policy;
+    report->scheduling = pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy == SCHED_FIFO &&
+                         param.sched_priority == config.priority;
+  }
+  else if (config.policy == RtPolicy::Deadline)
+  {
+    SchedAttr attr = {};
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE;
+    attr.sched_runtime = config.runtime_ns;
+    attr.sched_deadline = config.deadline_ns ? config.deadline_ns : config.period_ns;
+    attr.sched_period = config.period_ns;
+    if (syscall(SYS_sched_setattr, 0, &attr, 0) != 0)
+      report->notes.push_back(failure("SCHED_DEADLINE"));
+    report->scheduling = sched_getscheduler(0) == SCHED_DEADLINE;
+  }
+}
+
+void setAffinity(const RtThreadConfig &config, RtThreadReport *report)
+{
+  if (config.cpus.empty())
+    return;
+
+  cpu_set_t wanted;
+  CPU_ZERO(&wanted);
+  for (int cpu : config.cpus)
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &wanted);
+  if (sched_setaffinity(0, sizeof(wanted), &wanted) != 0)
+    report->notes.push_back(failure("CPU affinity"));
+
+  cpu_set_t actual;
+  report->affinity = sched_getaffinity(0, sizeof(actual), &actual) == 0 && CPU_EQUAL(&wanted, &actual);
+}
+
+void lockMemory(const RtThreadConfig &config, RtThreadReport *report)
+{
+  if (!config.lock_memory)
+    return;
+
+  rlimit limit = {};
+  bool unlimited = getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY;
+  if (unlimited && mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+    return;
+
+  report->future_locked = false;
+  if (mlockall(MCL_CURRENT) == 0)
+  {
+    report->notes.emplace_back("memlock limit is finite, later mappings are not locked");
+    return;
+  }
+  report->memory_locked = false;
+  report->notes.push_back(failure("mlockall"));
+}
+} // namespace
+
+namespace rt_thread
+{
+RtThreadReport apply(const RtThreadConfig &config)
+{
+  RtThreadReport report;
+  // Pin before changing the policy, so the thread never runs at real-time
+  // priority on a CPU it should stay off
+  setAffinity(config, &report);
+  setScheduling(config, &report);
+  lockMemory(config, &report);
+  prefaultStack(config.stack_prefault);
+  return report;
+}
+
+void prefaultStack(size_t bytes)
+{
+  if (bytes == 0)
+    return;
+  volatile char *stack = (volatile char *)alloca(bytes);
+  const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < bytes; i += page)
+    stack[i] = 0;
+}
+} // namespace rt_thread
+
+std::ostream &operator<<(std::ostream &out, const RtThreadReport &report)
+{
+  out << "scheduling " << (report.scheduling ? "granted" : "NOT granted") << ", affinity "
+      << (report.affinity ? "granted" : "NOT granted") << ", memory "
+      << (!report.memory_locked ? "NOT locked" : report.future_locked ? "locked" : "locked (current mappings only)");
+  for (const std::string &note : report.notes)
+    out << "\n  " << note;
+  return out;
+}
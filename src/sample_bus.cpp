@@ -0,0 +1,253 @@
+#include <climits>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "sample_bus.h"
+
+namespace
+{
+
+size_t alignUp(size_t value, size_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+size_t deviceStride(uint32_t capacity)
+{
+  return alignUp(sizeof(SampleBusDevice) + capacity * sizeof(SampleBusSlot), 64);
+}
+
+size_t segmentSize(uint32_t num_devices, uint32_t capacity)
+{
+  return alignUp(sizeof(SampleBusHeader), 64) + num_devices * deviceStride(capacity);
+}
+
+SampleBusDevice *deviceAt(SampleBusHeader *header, size_t device)
+{
+  uint8_t *base = reinterpret_cast<uint8_t *>(header) + alignUp(sizeof(SampleBusHeader), 64);
+  return reinterpret_cast<SampleBusDevice *>(base + device * deviceStride(header->capacity));
+}
+
+SampleBusSlot *slotsOf(SampleBusDevice *device)
+{
+  return reinterpret_cast<SampleBusSlot *>(device + 1);
+}
+
+long futex(std::atomic<uint32_t> *word, int op, uint32_t value, const struct timespec *timeout)
+{
+  // Shared (not FUTEX_PRIVATE) so that waiters in other processes are woken
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), op, value, timeout, nullptr, 0);
+}
+
+}; // namespace
+
+SampleBus::~SampleBus()
+{
+  close();
+}
+
+bool SampleBus::create(const char *name, uint32_t num_devices, uint32_t capacity)
+{
+  close();
+
+  uint32_t slots = 1;
+  while (slots < capacity)
+    slots <<= 1;
+
+  size_t size = segmentSize(num_devices, slots);
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    perror("Failed to create sample bus");
+    return false;
+  }
+  if (ftruncate(fd, (off_t)size) != 0)
+  {
+    perror("Failed to size sample bus");
+    ::close(fd);
+    shm_unlink(name);
+    return false;
+  }
+
+  // MAP_POPULATE so the acquisition thread never takes a page fault
+  void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+  {
+    perror("Failed to map sample bus");
+    shm_unlink(name);
+    return false;
+  }
+
+  SampleBusHeader *header = new (map) SampleBusHeader();
+  header->num_devices = num_devices;
+  header->capacity = slots;
+  header->futex.store(0, std::memory_order_relaxed);
+  header->waiters.store(0, std::memory_order_relaxed);
+  for (uint32_t d = 0; d < num_devices; d++)
+  {
+    SampleBusDevice *device = new (deviceAt(header, d)) SampleBusDevice();
+    device->head.store(0, std::memory_order_relaxed);
+    SampleBusSlot *slot = slotsOf(device);
+    for (uint32_t i = 0; i < slots; i++)
+      new (&slot[i].seq) std::atomic<uint64_t>(0);
+  }
+
+  // Readers check the magic last, so publish it once everything else is set
+  header->version = kSampleBusVersion;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kSampleBusMagic;
+
+  m_name = name;
+  m_map = map;
+  m_map_size = size;
+  m_header = header;
+  return true;
+}
+
+void SampleBus::close()
+{
+  if (m_map == nullptr)
+    return;
+
+  // Wake anyone still waiting so they can notice the bus went away
+  m_header->futex.fetch_add(1, std::memory_order_release);
+  futex(&m_header->futex, FUTEX_WAKE, INT_MAX, nullptr);
+
+  munmap(m_map, m_map_size);
+  shm_unlink(m_name.c_str());
+  m_map = nullptr;
+  m_header = nullptr;
+  m_map_size = 0;
+}
+
+void SampleBus::publish(size_t device, const SampleRecord &sample)
+{
+  if (m_header == nullptr || device >= m_header->num_devices)
+    return;
+
+  SampleBusDevice *ring = deviceAt(m_header, device);
+  uint64_t index = ring->head.load(std::memory_order_relaxed);
+  SampleBusSlot &slot = slotsOf(ring)[index & (m_header->capacity - 1)];
+
+  slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&slot.record, &sample, sizeof(sample));
+  slot.seq.store(2 * index + 2, std::memory_order_release);
+  ring->head.store(index + 1, std::memory_order_release);
+
+  // seq_cst pairs with wait(), so either the reader sees the new sequence or we
+  // see the reader registered as a waiter
+  m_header->futex.fetch_add(1, std::memory_order_seq_cst);
+  if (m_header->waiters.load(std::memory_order_seq_cst) != 0)
+    futex(&m_header->futex, FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+SampleBusReader::~SampleBusReader()
+{
+  detach();
+}
+
+bool SampleBusReader::attach(const char *name)
+{
+  detach();
+
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SampleBusHeader))
+  {
+    ::close(fd);
+    return false;
+  }
+
+  void *map = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  SampleBusHeader *header = static_cast<SampleBusHeader *>(map);
+  bool valid = header->magic == kSampleBusMagic;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  valid = valid && header->version == kSampleBusVersion &&
+          segmentSize(header->num_devices, header->capacity) <= (size_t)st.st_size;
+  if (!valid)
+  {
+    munmap(map, (size_t)st.st_size);
+    return false;
+  }
+
+  m_map = map;
+  m_map_size = (size_t)st.st_size;
+  m_header = header;
+  return true;
+}
+
+void SampleBusReader::detach()
+{
+  if (m_map == nullptr)
+    return;
+  munmap(m_map, m_map_size);
+  m_map = nullptr;
+  m_header = nullptr;
+  m_map_size = 0;
+}
+
+uint64_t SampleBusReader::head(size_t device) const
+{
+  if (m_header == nullptr || device >= m_header->num_devices)
+    return 0;
+  return deviceAt(m_header, device)->head.load(std::memory_order_acquire);
+}
+
+uint64_t SampleBusReader::oldest(size_t device) const
+{
+  uint64_t published = head(device);
+  return published > capacity() ? published - capacity() : 0;
+}
+
+bool SampleBusReader::read(size_t device, uint64_t index, SampleRecord *sample) const
+{
+  if (m_header == nullptr || device >= m_header->num_devices)
+    return false;
+
+  SampleBusSlot &slot = slotsOf(deviceAt(m_header, device))[index & (m_header->capacity - 1)];
+  uint64_t expected = 2 * index + 2;
+
+  if (slot.seq.load(std::memory_order_acquire) != expected)
+    return false;
+  std::memcpy(sample, &slot.record, sizeof(*sample));
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  // If the publisher lapped us while copying, the sample is torn
+  return slot.seq.load(std::memory_order_relaxed) == expected;
+}
+
+uint32_t SampleBusReader::sequence() const
+{
+  return m_header ? m_header->futex.load(std::memory_order_acquire) : 0;
+}
+
+bool SampleBusReader::wait(uint32_t sequence, int64_t timeout_us) const
+{
+  if (m_header == nullptr)
+    return false;
+
+  struct timespec timeout = {(time_t)(timeout_us / 1000000), (long)(timeout_us % 1000000) * 1000};
+
+  m_header->waiters.fetch_add(1, std::memory_order_seq_cst);
+  long ret = 0;
+  if (m_header->futex.load(std::memory_order_seq_cst) == sequence)
+    ret = futex(&m_header->futex, FUTEX_WAIT, sequence, &timeout);
+  m_header->waiters.fetch_sub(1, std::memory_order_acq_rel);
+
+  return ret == 0 || m_header->futex.load(std::memory_order_acquire) != sequence;
+}
@@ -0,0 +1,216 @@
+#include <charconv>
+#include <cstring>
+#include <mutex>
+
+#include "sample_log.h"
+
+// Longest row: the timestamp and seven floats, each with its separator
+static const size_t kMaxRowLength = 20 + 7 * 16 + 2;
+
+// Segment opened by the maintenance thread, waiting to be written. The
+// maintenance thread opens it under the mutex, and only while it is still
+// wanted, so it never truncates a file the writer has opened itself.
+struct SampleLog::NextSegment
+{
+  std::mutex mutex;
+  LogFile file;
+  uint64_t wanted = 0;
+  bool ready = false;
+  bool closed = false;
+};
+
+bool SampleLog::open(const std::filesystem::path &path, bool orientation, LogFileMode mode,
+                     const LogRotation &rotation)
+{
+  close();
+  m_orientation = orientation;
+  m_mode = mode;
+  m_rotation = rotation;
+  m_base = path;
+  m_segment = 0;
+  m_segment_empty = true;
+
+  if (!m_rotation.enabled())
+  {
+    if (!m_file.open(path, mode))
+      return false;
+    writeHeader();
+    return true;
+  }
+
+  m_segment = log_segments::nextIndex(path);
+  if (!m_file.open(log_segments::segmentPath(path, m_segment), mode))
+    return false;
+  writeHeader();
+
+  m_next = std::make_shared<NextSegment>();
+  prepareNext();
+  return true;
+}
+
+void SampleLog::close()
+{
+  if (!m_file.isOpen())
+    return;
+
+  if (!m_rotation.enabled())
+  {
+    m_file.close();
+    return;
+  }
+
+  // Discard the segment opened ahead; one still queued is never opened
+  {
+    std::lock_guard<std::mutex> lock(m_next->mutex);
+    m_next->closed = true;
+    if (m_next->ready)
+    {
+      m_next->file.close();
+      std::error_code ec;
+      std::filesystem::remove(log_segments::segmentPath(m_base, m_next->wanted), ec);
+      m_next->ready = false;
+    }
+  }
+  m_next.reset();
+
+  m_file.close();
+  retire(LogFile(), m_segment);
+}
+
+void SampleLog::writeHeader()
+{
+  const char *header = m_orientation ? "time (us),x (mdps),y (mdps),z(mdps),qw,qx,qy,qz\n"
+                                     : "time (us),x (mdps),y (mdps),z(mdps)\n";
+  m_file.write(header, std::strlen(header));
+}
+
+bool SampleLog::shouldRoll(int64_t timestamp) const
+{
+  if (m_segment_empty)
+    return false;
+  if (m_rotation.max_bytes > 0 && m_file.size() >= m_rotation.max_bytes)
+    return true;
+  return m_rotation.interval_us > 0 &&
+         timestamp / m_rotation.interval_us != m_segment_start / m_rotation.interval_us;
+}
+
+void SampleLog::roll()
+{
+  LogFile next;
+  {
+    std::lock_guard<std::mutex> lock(m_next->mutex);
+    if (m_next->ready)
+      next = std::move(m_next->file);
+    m_next->ready = false;
+    m_next->wanted = 0;
+
+    // The maintenance thread fell behind; open it here rather than stall
+    if (!next.isOpen() && !next.open(log_segments::segmentPath(m_base, m_segment + 1), m_mode))
+      return;
+  }
+
+  std::swap(m_file, next);
+  m_segment++;
+  m_segment_empty = true;
+  writeHeader();
+
+  prepareNext();
+  retire(std::move(next), m_segment - 1);
+}
+
+void SampleLog::prepareNext()
+{
+  std::shared_ptr<NextSegment> next = m_next;
+  uint64_t index = m_segment + 1;
+  {
+    std::lock_guard<std::mutex> lock(next->mutex);
+    next->wanted = index;
+  }
+
+  std::filesystem::path path = log_segments::segmentPath(m_base, index);
+  LogFileMode mode = m_mode;
+  log_segments::post([next, path, index, mode]
+  {
+    std::lock_guard<std::mutex> lock(next->mutex);
+    if (next->closed || next->wanted != index)
+      return;
+    next->ready = next->file.open(path, mode);
+  });
+}
+
+// Closes, compresses and prunes a finished segment in the background
+void SampleLog::retire(LogFile file, uint64_t segment)
+{
+  auto closing = std::make_shared<LogFile>(std::move(file));
+  std::filesystem::path base = m_base;
+  LogRotation rotation = m_rotation;
+  log_segments::post([closing, base, segment, rotation]
+  {
+    closing->close();
+
+    std::filesystem::path csv = log_segments::segmentPath(base, segment);
+    std::error_code ec;
+    if (rotation.compress && log_segments::compress(csv, log_segments::segmentPath(base, segment, true)))
+      std::filesystem::remove(csv, ec);
+    if (rotation.keep_segments > 0)
+      log_segments::prune(base, segment + 1, rotation.keep_segments);
+  });
+}
+
+// Same text as an ostream with default formatting (%g, six digits)
+static char *appendValue(char *out, char *end, float value)
+{
+  out = std::to_chars(out, end, value, std::chars_format::general, 6).ptr;
+  *out++ = ',';
+  return out;
+}
+
+void SampleLog::write(const SampleRecord &sample)
+{
+  if (m_rotation.enabled() && shouldRoll(sample.timestamp))
+    roll();
+  if (m_segment_empty)
+  {
+    m_segment_start = sample.timestamp;
+    m_segment_empty = false;
+  }
+
+  char row[kMaxRowLength];
+  char *end = row + sizeof(row);
+
+  char *out = std::to_chars(row, end, sample.timestamp).ptr;
+  *out++ = ',';
+  out = appendValue(out, end, sample.gx);
+  out = appendValue(out, end, sample.gy);
+  out = appendValue(out, end, sample.gz);
+  if (m_orientation)
+  {
+    out = appendValue(out, end, sample.qw);
+    out = appendValue(out, end, sample.qx);
+    out = appendValue(out, end, sample.qy);
+    out = appendValue(out, end, sample.qz);
+  }
+  *out++ = '\n';
+
+  m_file.write(row, out - row);
+}
+
+void SampleLog::writeGap(int64_t timestamp)
+{
+  char row[kMaxRowLength];
+  char *out = std::to_chars(row, row + sizeof(row), timestamp).ptr;
+  *out++ = ',';
+  int columns = m_orientation ? 7 : 3;
+  for (int i = 0; i < columns; i++)
+  {
+    std::memcpy(out, "nan,", 4);
+    out += 4;
+  }
+  *out++ = '\n';
+  m_file.write(row, out - row);
+}
+
+void SampleLog::flush()
+{
+  m_file.flush();
+}
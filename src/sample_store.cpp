@@ -0,0 +1,139 @@
+#include "sample_store.h"
+
+SampleChunkPool::SampleChunkPool(size_t capacity) : m_chunks(new SampleChunk[capacity])
+{
+  m_free.reserve(capacity);
+  for (size_t i = capacity; i > 0; i--)
+    m_free.push_back(&m_chunks[i - 1]);
+}
+
+SampleChunk *SampleChunkPool::acquire()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_free.empty())
+    return nullptr;
+  SampleChunk *chunk = m_free.back();
+  m_free.pop_back();
+  return chunk;
+}
+
+void SampleChunkPool::release(SampleChunk *chunk)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_free.push_back(chunk);
+}
+
+size_t SampleChunkPool::available()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_free.size();
+}
+
+SampleStore::SampleStore(size_t num_devices, size_t chunks_per_device)
+    : m_chunks_per_device(chunks_per_device < 2 ? 2 : chunks_per_device),
+      m_pool(num_devices * (chunks_per_device < 2 ? 2 : chunks_per_device))
+{
+  for (size_t i = 0; i < num_devices; i++)
+    m_devices.emplace_back(new DeviceColumns());
+}
+
+SampleChunk *SampleStore::nextChunk(DeviceColumns &columns)
+{
+  SampleChunk *chunk = nullptr;
+
+  if (columns.chunks < m_chunks_per_device)
+  {
+    chunk = m_pool.acquire();
+    if (chunk != nullptr)
+      columns.chunks++;
+  }
+
+  if (chunk == nullptr)
+  {
+    // Device is at its quota, recycle its oldest chunk. Readers hold the
+    // shared lock while they walk the list, so wait for them to finish.
+    std::unique_lock<std::shared_mutex> lock(columns.recycle_mutex);
+    chunk = columns.head;
+    columns.head = chunk->next.load(std::memory_order_relaxed);
+  }
+
+  chunk->first = columns.total.load(std::memory_order_relaxed);
+  chunk->count.store(0, std::memory_order_relaxed);
+  chunk->next.store(nullptr, std::memory_order_relaxed);
+
+  if (columns.tail == nullptr)
+  {
+    std::unique_lock<std::shared_mutex> lock(columns.recycle_mutex);
+    columns.head = chunk;
+  }
+  else
+  {
+    columns.tail->next.store(chunk, std::memory_order_release);
+  }
+  columns.tail = chunk;
+  return chunk;
+}
+
+bool SampleStore::append(size_t device, const SampleRecord &sample)
+{
+  if (device >= m_devices.size())
+    return false;
+
+  DeviceColumns &columns = *m_devices[device];
+  SampleChunk *chunk = columns.tail;
+  uint32_t index = chunk != nullptr ? chunk->count.load(std::memory_order_relaxed) : kSampleChunkSize;
+
+  if (index == kSampleChunkSize)
+  {
+    chunk = nextChunk(columns);
+    index = 0;
+  }
+
+  chunk->timestamp[index] = sample.timestamp;
+  chunk->gx[index] = sample.gx;
+  chunk->gy[index] = sample.gy;
+  chunk->gz[index] = sample.gz;
+  chunk->ax[index] = sample.ax;
+  chunk->ay[index] = sample.ay;
+  chunk->az[index] = sample.az;
+  chunk->temp[index] = sample.temp;
+  chunk->qw[index] = sample.qw;
+  chunk->qx[index] = sample.qx;
+  chunk->qy[index] = sample.qy;
+  chunk->qz[index] = sample.qz;
+
+  // Publish the sample to readers
+  chunk->count.store(index + 1, std::memory_order_release);
+  columns.total.store(chunk->first + index + 1, std::memory_order_release);
+  return true;
+}
+
+uint64_t SampleStore::size(size_t device) const
+{
+  return m_devices[device]->total.load(std::memory_order_acquire);
+}
+
+uint64_t SampleStore::oldest(size_t device) const
+{
+  const DeviceColumns &columns = *m_devices[device];
+  std::shared_lock<std::shared_mutex> lock(columns.recycle_mutex);
+  return columns.head != nullptr ? columns.head->first : 0;
+}
+
+bool SampleStore::latest(size_t device, SampleRecord *sample) const
+{
+  uint64_t total = size(device);
+  if (total == 0)
+    return false;
+
+  bool found = false;
+  forEachChunk(device, total - 1, [&](const SampleView &view)
+               {
+                 if (view.first != total - 1)
+                   return;
+                 *sample = {view.timestamp[0], view.gx[0], view.gy[0], view.gz[0],
+                            view.ax[0], view.ay[0], view.az[0], view.temp[0],
+                            view.qw[0], view.qx[0], view.qy[0], view.qz[0]};
+                 found = true; });
+  return found;
+}
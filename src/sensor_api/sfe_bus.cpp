@@ -44,6 +44,7 @@
 // and Serial Peripheral Interface (SPI). 
 
 #include "sfe_bus.h"
+#include "latency_trace.h"
 
 #define kMaxTransferBuffer 32
 #define SPI_READ 0x80
@@ -137,6 +138,7 @@ bool QwI2C::writeRegisterByte(uint8_t i2c_address, uint8_t offset, uint8_t dataT
 
 int QwI2C::writeRegisterRegion(uint8_t i2c_address, uint8_t offset, const uint8_t *data, uint16_t length)
 {
+    ISM_TRACE_SCOPE(TraceOp::RegisterWrite);
 
     _i2cPort->beginTransmission(i2c_address);
     _i2cPort->write(offset);
@@ -155,6 +157,7 @@ int QwI2C::writeRegisterRegion(uint8_t i2c_address, uint8_t offset, const uint8_
 //
 int QwI2C::readRegisterRegion(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t numBytes)
 {
+    ISM_TRACE_SCOPE(TraceOp::RegisterRead);
     uint8_t nChunk;
     uint16_t nReturned;
 
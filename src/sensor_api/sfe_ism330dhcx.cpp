@@ -390,6 +390,29 @@ bool QwDevISM330DHCX::getGyro(sfe_ism_data_t *gyroData)
     return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// getRawAllSensors()
+//
+// Retrieves raw temperature, gyroscope and accelerometer values in a single
+// auto-increment burst, instead of one bus transaction per sensor.
+//
+//  Parameter    Description
+//  ---------   -----------------------------
+//  allData      Data type pointer at which data will be stored.
+//
+bool QwDevISM330DHCX::getRawAllSensors(sfe_ism_raw_all_t *allData)
+{
+    uint8_t buff[14];
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_OUT_TEMP_L, buff, sizeof(buff));
+
+    if (retVal != 0)
+        return false;
+
+    decodeRawAll(buff, allData);
+
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // Conversions Methods
 //
@@ -746,6 +769,49 @@ bool QwDevISM330DHCX::resetTimestamp()
 
     return true;
 }
+
+//////////////////////////////////////////////////////////////////////////////////
+// getTimestamp()
+//
+// Reads the time stamp counter (TIMESTAMP0..3) in one transfer. One count is
+// nominally 25us, see getFreqFineTuning().
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  ticks       Counter value
+//
+
+bool QwDevISM330DHCX::getTimestamp(uint32_t *ticks)
+{
+    int32_t retVal = ism330dhcx_timestamp_raw_get(&sfe_dev, ticks);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getFreqFineTuning()
+//
+// Reads INTERNAL_FREQ_FINE, the factory measured deviation of the device's
+// oscillator. The actual output data rates are (1 + 0.0015 * fine) times
+// nominal and one time stamp count is 25us / (1 + 0.0015 * fine).
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  fine        Signed deviation, in steps of 0.15%
+//
+
+bool QwDevISM330DHCX::getFreqFineTuning(int8_t *fine)
+{
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_INTERNAL_FREQ_FINE, (uint8_t *)fine, 1);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
 //
 //
 //////////////////////////////////////////////////////////////////////////////////
@@ -887,6 +953,31 @@ bool QwDevISM330DHCX::setFifoTimestampDec(uint8_t val)
     return true;
 }
 
+
+//////////////////////////////////////////////////////////////////////////////////
+// setTempFifoBatchSet()
+//
+// Sets the batch data rate for the temperature sensor
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  val         The rate, 0 = not batched, 1 = 52Hz, 2 = 12.5Hz, 3 = 1.6Hz
+//
+// See sfe_ism330dhcx_defs.h for a list of valid arguments
+
+bool QwDevISM330DHCX::setTempFifoBatchSet(uint8_t val)
+{
+    int32_t retVal;
+    if (val > 3)
+        return false;
+
+    retVal = ism330dhcx_fifo_temp_batch_set(&sfe_dev, (ism330dhcx_odr_t_batch_t)val);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
 //
 //
 //////////////////////////////////////////////////////////////////////////////////
@@ -1039,6 +1130,95 @@ bool QwDevISM330DHCX::setBatchCounterInt1(bool enable)
     return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////////
+// getFifoLevel()
+//
+// Returns the number of unread words in the FIFO, 0 on error.
+//
+
+uint16_t QwDevISM330DHCX::getFifoLevel()
+{
+    uint16_t level;
+
+    if (!getFifoStatus(&level, nullptr))
+        return 0;
+
+    return level;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getFifoStatus()
+//
+// Reads FIFO_STATUS1 and FIFO_STATUS2 in one burst, where the ST driver's
+// ism330dhcx_fifo_data_level_get() and ism330dhcx_fifo_ovr_flag_get() take a
+// transaction per register.
+//
+//  Parameter    Description
+//  ---------    -----------------------------
+//  level        Number of unread words in the FIFO
+//  overrun      FIFO_OVR_IA: the FIFO is full and the oldest words are being
+//               overwritten. Optional.
+//
+
+bool QwDevISM330DHCX::getFifoStatus(uint16_t *level, bool *overrun)
+{
+    uint8_t status[2];
+
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_FIFO_STATUS1, status, sizeof(status));
+
+    if (retVal != 0)
+        return false;
+
+    *level = (uint16_t)(((status[1] & 0x03) << 8) | status[0]);
+    if (overrun)
+        *overrun = (status[1] & 0x40) != 0;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// readFifo()
+//
+// Drains up to maxWords words from the FIFO in a single burst. The FIFO output
+// registers wrap from FIFO_DATA_OUT_Z_H back to FIFO_DATA_OUT_TAG, so one
+// auto-increment read returns consecutive words.
+//
+//  Parameter    Description
+//  ---------    -----------------------------
+//  words        Destination for the FIFO words
+//  maxWords     Capacity of words
+//  overrun      Set to the overrun flag read with the level, see
+//               getFifoStatus(). Optional.
+//  retval       Number of words read, 0 if the FIFO is empty or on error
+//
+
+uint16_t QwDevISM330DHCX::readFifo(sfe_ism_fifo_word_t *words, uint16_t maxWords, bool *overrun)
+{
+    static_assert(sizeof(sfe_ism_fifo_word_t) == 7, "FIFO words must be packed");
+
+    uint16_t level;
+    if (!getFifoStatus(&level, overrun))
+        return 0;
+
+    if (level > maxWords)
+        level = maxWords;
+
+    // Bursts are limited to 65535 bytes by the bus length argument
+    if (level > 0xFFFF / sizeof(sfe_ism_fifo_word_t))
+        level = 0xFFFF / sizeof(sfe_ism_fifo_word_t);
+
+    if (level == 0)
+        return 0;
+
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_FIFO_DATA_OUT_TAG, (uint8_t *)words,
+                                         level * sizeof(sfe_ism_fifo_word_t));
+
+    if (retVal != 0)
+        return 0;
+
+    return level;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // setAccelStatustoInt2
 //
@@ -1505,28 +1685,39 @@ bool QwDevISM330DHCX::resetSensorHub()
 
     return true;
 }
-//
-//
-//////////////////////////////////////////////////////////////////////////////////
 
 //////////////////////////////////////////////////////////////////////////////////
-// Self Test
-//
-//
-//
-//
-//
+// setHubSlaveBatching
 //
+// Batches the data read from one external sensor into the FIFO, tagged
+// SENSORHUB_SLAVEx.
 //
+//  Parameter   Description
+//  ---------   -----------------------------
+//  sensor      The external sensor (0-3)
+//  enable      Enable/disables fifo batching
 
-bool QwDevISM330DHCX::setAccelSelfTest(uint8_t val)
+bool QwDevISM330DHCX::setHubSlaveBatching(uint8_t sensor, bool enable)
 {
     int32_t retVal;
 
-    if (val > 2)
+    switch (sensor)
+    {
+    case 0:
+        retVal = ism330dhcx_sh_batch_slave_0_set(&sfe_dev, (uint8_t)enable);
+        break;
+    case 1:
+        retVal = ism330dhcx_sh_batch_slave_1_set(&sfe_dev, (uint8_t)enable);
+        break;
+    case 2:
+        retVal = ism330dhcx_sh_batch_slave_2_set(&sfe_dev, (uint8_t)enable);
+        break;
+    case 3:
+        retVal = ism330dhcx_sh_batch_slave_3_set(&sfe_dev, (uint8_t)enable);
+        break;
+    default:
         return false;
-
-    retVal = ism330dhcx_xl_self_test_set(&sfe_dev, (ism330dhcx_st_xl_t)val);
+    }
 
     if (retVal != 0)
         return false;
@@ -1534,98 +1725,954 @@ bool QwDevISM330DHCX::setAccelSelfTest(uint8_t val)
     return true;
 }
 
-bool QwDevISM330DHCX::setGyroSelfTest(uint8_t val)
+//////////////////////////////////////////////////////////////////////////////////
+// configureHub
+//
+// Programs the sensor hub to read up to four external sensors at the given
+// rate, optionally batching each into the FIFO. The controller is stopped
+// while the slave registers change and started again at the end. The reads
+// are triggered by the accelerometer, which must be running.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  sensors     8-bit I2C address, first register and length (up to 6 bytes to fit a FIFO
+//              word) per sensor
+//  count       Number of sensors (1-4)
+//  rate        Selects the rate, see setHubODR()
+//  batch       Batch the sensors into the FIFO
+
+bool QwDevISM330DHCX::configureHub(const sfe_hub_sensor_settings_t *sensors, uint8_t count, uint8_t rate, bool batch)
 {
-    int32_t retVal;
+    if (count == 0 || count > 4 || rate > 3)
+        return false;
 
-    // 0, 1, or 3
-    if (val > 3)
+    if (!enableSensorI2C(false))
         return false;
 
-    retVal = ism330dhcx_gy_self_test_set(&sfe_dev, (ism330dhcx_st_g_t)val);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        sfe_hub_sensor_settings_t settings = sensors[i];
+        if (settings.lenData == 0 || settings.lenData > 6)
+            return false;
+        if (!setHubSensorRead(i, &settings) || !setHubSlaveBatching(i, batch))
+            return false;
+    }
 
-    if (retVal != 0)
+    if (!setNumberHubSensors(count - 1) || !setHubODR(rate) || !setHubWriteMode(0))
         return false;
 
-    return true;
+    return enableSensorI2C(true);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeHubRegister
+//
+// Writes one register of an external sensor through the sensor hub, for
+// example to start a magnetometer's continuous mode before configureHub().
+// The write goes out on the next accelerometer data ready, which must be
+// running; the controller is left stopped.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  address     8-bit I2C address of the external sensor (7-bit address << 1)
+//  reg         Register to write
+//  value       Value to write
+//  retval      true once the write completed without a NACK
+
+bool QwDevISM330DHCX::writeHubRegister(uint8_t address, uint8_t reg, uint8_t value)
+{
+    ism330dhcx_sh_cfg_write_t write = {address, reg, value};
+
+    if (!enableSensorI2C(false))
+        return false;
+    if (ism330dhcx_sh_cfg_write(&sfe_dev, &write) != 0)
+        return false;
+    if (!setNumberHubSensors(0) || !setHubWriteMode(1) || !enableSensorI2C(true))
+        return false;
+
+    // Every poll is a bus transaction, so the bound is in transfers rather
+    // than time; at 400kHz it covers more than one 12.5Hz accelerometer period
+    const int maxPolls = 1000;
+    bool done = false;
+    for (int i = 0; i < maxPolls && !done; i++)
+        done = getHubStatus();
+
+    bool nack = getExternalSensorNack(0);
+    if (!enableSensorI2C(false))
+        return false;
+
+    return done && !nack;
 }
 //
 //
 //////////////////////////////////////////////////////////////////////////////////
 
 //////////////////////////////////////////////////////////////////////////////////
-// checkStatus
+// Accelerometer User Offsets
 //
-// Checks if data is ready for both the acclerometer and the gyroscope
 //
-
-bool QwDevISM330DHCX::checkStatus()
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+// setAccelUserOffset()
+//
+// Loads the accelerometer user offset registers. The device subtracts these
+// from every output sample, so the correction costs nothing on the host.
+//
+//  Parameter     Description
+//  ---------     -----------------------------
+//  x, y, z       Offsets in two's complement, -127 to 127
+//  coarseWeight  false = 2^-10 g/LSB (~1 mg), true = 2^-6 g/LSB (~16 mg)
+//
+bool QwDevISM330DHCX::setAccelUserOffset(int8_t x, int8_t y, int8_t z, bool coarseWeight)
 {
-    ism330dhcx_status_reg_t tempVal;
-    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+    int32_t retVal;
+    uint8_t offsets[3] = {(uint8_t)x, (uint8_t)y, (uint8_t)z};
 
+    retVal = ism330dhcx_xl_offset_weight_set(&sfe_dev, coarseWeight ? ISM330DHCX_LSb_16mg : ISM330DHCX_LSb_1mg);
     if (retVal != 0)
         return false;
 
-    if ((tempVal.xlda == 1) && (tempVal.gda == 1))
-        return true;
+    // X_OFS_USR, Y_OFS_USR and Z_OFS_USR are contiguous
+    retVal = ism330dhcx_write_reg(&sfe_dev, ISM330DHCX_X_OFS_USR, offsets, sizeof(offsets));
+    if (retVal != 0)
+        return false;
 
-    return false;
+    retVal = ism330dhcx_xl_usr_offset_set(&sfe_dev, (x != 0 || y != 0 || z != 0) ? 1 : 0);
+    if (retVal != 0)
+        return false;
+
+    return true;
 }
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
 
 //////////////////////////////////////////////////////////////////////////////////
-// checkAccelStatus
+// Activity / Inactivity
 //
-// Checks if data is ready for the acclerometer
+//
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+// setActivityMode()
+//
+// Enables the inactivity function. After setSleepDuration() without motion
+// above the wake-up threshold, the device drops the accelerometer to 12.5Hz
+// and, depending on the mode, puts the gyroscope to sleep or powers it down;
+// the first motion above the threshold restores the configured rates. Also
+// sets INTERRUPTS_ENABLE, which the function needs, in the same write.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  mode        0 = off, 1 = gyro unaffected, 2 = gyro sleep, 3 = gyro power-down
+//
+// See sfe_ism330dhcx_defs.h for a list of valid arguments
 
-bool QwDevISM330DHCX::checkAccelStatus()
+bool QwDevISM330DHCX::setActivityMode(uint8_t mode)
 {
-    ism330dhcx_status_reg_t tempVal;
-    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+    if (mode > 3)
+        return false;
+
+    ism330dhcx_tap_cfg2_t tapCfg2;
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_TAP_CFG2, (uint8_t *)&tapCfg2, 1);
 
     if (retVal != 0)
         return false;
 
-    if (tempVal.xlda == 1)
-        return true;
+    tapCfg2.inact_en = mode;
+    tapCfg2.interrupts_enable = mode != 0;
+    retVal = ism330dhcx_write_reg(&sfe_dev, ISM330DHCX_TAP_CFG2, (uint8_t *)&tapCfg2, 1);
 
-    return false;
+    if (retVal != 0)
+        return false;
+
+    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
-// checkAccelStatus
+// setWakeUpThreshold()
+//
+// Sets the slope the accelerometer must exceed to count as motion.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  threshold   0 - 63, in steps of full scale / 64, or / 256 with fineWeight
+//  fineWeight  Selects the finer step
 //
-// Checks if data is ready for the gyroscope
 
-bool QwDevISM330DHCX::checkGyroStatus()
+bool QwDevISM330DHCX::setWakeUpThreshold(uint8_t threshold, bool fineWeight)
 {
-    ism330dhcx_status_reg_t tempVal;
-    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+    if (threshold > 63)
+        return false;
+
+    int32_t retVal = ism330dhcx_wkup_threshold_set(&sfe_dev, threshold);
 
     if (retVal != 0)
         return false;
 
-    if (tempVal.gda == 1)
-        return true;
+    retVal = ism330dhcx_wkup_ths_weight_set(&sfe_dev, (ism330dhcx_wake_ths_w_t)fineWeight);
 
-    return false;
+    if (retVal != 0)
+        return false;
+
+    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
-// checkAccelStatus
+// setWakeUpDuration()
+//
+// Sets how long the slope must stay above the threshold to wake up.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  duration    0 - 3, in accelerometer output periods
 //
-// Checks if data is ready for the temperature sensor
 
-bool QwDevISM330DHCX::checkTempStatus()
+bool QwDevISM330DHCX::setWakeUpDuration(uint8_t duration)
 {
-    ism330dhcx_status_reg_t tempVal;
-    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+    if (duration > 3)
+        return false;
+
+    int32_t retVal = ism330dhcx_wkup_dur_set(&sfe_dev, duration);
 
     if (retVal != 0)
         return false;
 
-    if (tempVal.tda == 1)
-        return true;
+    return true;
+}
 
-    return false;
+//////////////////////////////////////////////////////////////////////////////////
+// setSleepDuration()
+//
+// Sets how long the device must be still before it goes to sleep.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  duration    0 - 15, in 512 accelerometer output periods (0 = 16 periods)
+//
+
+bool QwDevISM330DHCX::setSleepDuration(uint8_t duration)
+{
+    if (duration > 15)
+        return false;
+
+    int32_t retVal = ism330dhcx_act_sleep_dur_set(&sfe_dev, duration);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getSleepState()
+//
+// Reads WAKE_UP_SRC once.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  asleep      true while the inactivity function holds the device asleep
+//  changed     Optional, true if the state changed since the last read
+//
+
+bool QwDevISM330DHCX::getSleepState(bool *asleep, bool *changed)
+{
+    ism330dhcx_wake_up_src_t wakeUpSrc;
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_WAKE_UP_SRC, (uint8_t *)&wakeUpSrc, 1);
+
+    if (retVal != 0)
+        return false;
+
+    *asleep = wakeUpSrc.sleep_state;
+    if (changed)
+        *changed = wakeUpSrc.sleep_change_ia;
+
+    return true;
+}
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////
+// Machine Learning Core
+//
+//
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+// loadUcf()
+//
+// Replays a configuration exported by ST's tools (.ucf, see ucf::parse()) to
+// the device. A UCF is a list of single register writes; the MLC program is
+// written one byte at a time to PAGE_VALUE, which advances the page address
+// by itself. With register address auto-increment (CTRL3_C IF_INC) turned
+// off for the load, each run of PAGE_VALUE writes goes out as one burst to
+// that register, instead of one bus transaction per byte.
+//
+// IF_INC is restored afterwards, to the value the UCF wrote to CTRL3_C if it
+// did. A UCF that resets or reboots the device is rejected: the reset would
+// turn IF_INC back on under the batched writes.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  writes      Register writes in UCF order
+//  length      Number of entries in writes
+//  retval      true on success, false on bus error or a resetting UCF
+//
+bool QwDevISM330DHCX::loadUcf(const sfe_ism_reg_write_t *writes, uint32_t length)
+{
+    const uint8_t ifInc = 0x04, swReset = 0x01, boot = 0x80;
+    const uint8_t embeddedBank = 0x80, bankMask = 0xC0; // FUNC_CFG_ACCESS
+
+    for (uint32_t i = 0, bank = 0; i < length; i++)
+    {
+        if (writes[i].reg == ISM330DHCX_FUNC_CFG_ACCESS)
+            bank = writes[i].value & bankMask;
+        else if (bank == 0 && writes[i].reg == ISM330DHCX_CTRL3_C && (writes[i].value & (swReset | boot)))
+            return false;
+    }
+
+    uint8_t ctrl3;
+    if (readRegisterRegion(ISM330DHCX_CTRL3_C, &ctrl3, 1) != 0)
+        return false;
+    uint8_t restore = ctrl3;
+    ctrl3 &= ~ifInc;
+    if (writeRegisterRegion(ISM330DHCX_CTRL3_C, &ctrl3, 1) != 0)
+        return false;
+
+    uint8_t burst[32];
+    uint8_t bank = 0;
+    bool ok = true;
+    uint32_t i = 0;
+
+    while (ok && i < length)
+    {
+        uint8_t reg = writes[i].reg;
+        uint8_t value = writes[i].value;
+
+        if (bank == embeddedBank && reg == ISM330DHCX_PAGE_VALUE)
+        {
+            uint16_t n = 0;
+            while (i < length && n < sizeof(burst) && writes[i].reg == ISM330DHCX_PAGE_VALUE)
+                burst[n++] = writes[i++].value;
+            ok = writeRegisterRegion(reg, burst, n) == 0;
+            continue;
+        }
+
+        if (reg == ISM330DHCX_FUNC_CFG_ACCESS)
+            bank = value & bankMask;
+        else if (bank == 0 && reg == ISM330DHCX_CTRL3_C)
+        {
+            restore = value;
+            value &= ~ifInc;
+        }
+
+        ok = writeRegisterRegion(reg, &value, 1) == 0;
+        i++;
+    }
+
+    // Back in the user bank, also after a failed write
+    uint8_t userBank = 0;
+    if (bank != 0 && writeRegisterRegion(ISM330DHCX_FUNC_CFG_ACCESS, &userBank, 1) != 0)
+        return false;
+    if (writeRegisterRegion(ISM330DHCX_CTRL3_C, &restore, 1) != 0)
+        return false;
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// setMlc()
+//
+// Enables the Machine Learning Core, which runs the decision trees loaded by
+// loadUcf(), and restarts its algorithms.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  enable      Enables/disables the MLC
+//
+
+bool QwDevISM330DHCX::setMlc(bool enable)
+{
+    int32_t retVal = ism330dhcx_mlc_set(&sfe_dev, (uint8_t)enable);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// setMlcDataRate()
+//
+// Sets the rate at which the MLC evaluates its features and trees.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  rate        0 = 12.5Hz, 1 = 26Hz, 2 = 52Hz, 3 = 104Hz
+//
+// See sfe_ism330dhcx_defs.h for a list of valid arguments
+
+bool QwDevISM330DHCX::setMlcDataRate(uint8_t rate)
+{
+    if (rate > 3)
+        return false;
+
+    int32_t retVal = ism330dhcx_mlc_data_rate_set(&sfe_dev, (ism330dhcx_mlc_odr_t)rate);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getMlcStatus()
+//
+// Reads MLC_STATUS_MAINPAGE: bit n is set while decision tree n+1 has a new
+// result. It lives in the user bank, so polling it costs one read.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  status      Bit mask of the trees with a new output
+//
+
+bool QwDevISM330DHCX::getMlcStatus(uint8_t *status)
+{
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_MLC_STATUS_MAINPAGE, status, 1);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getMlcOutputs()
+//
+// Reads the output class of all eight decision trees (MLC0_SRC..MLC7_SRC).
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  outputs     Array of 8, output of tree n+1 at index n
+//
+
+bool QwDevISM330DHCX::getMlcOutputs(uint8_t *outputs)
+{
+    int32_t retVal = ism330dhcx_mlc_out_get(&sfe_dev, outputs);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// setMlcInt1() / setMlcInt2()
+//
+// Routes the result of the selected decision trees to INT1 or INT2, through
+// the pin's embedded function interrupt.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  trees       Bit mask, bit n for tree n+1; 0 unroutes all of them
+//
+
+bool QwDevISM330DHCX::setMlcInt1(uint8_t trees)
+{
+    return routeEmbeddedInterrupt(ISM330DHCX_MLC_INT1, &trees, 1, ISM330DHCX_MD1_CFG);
+}
+
+bool QwDevISM330DHCX::setMlcInt2(uint8_t trees)
+{
+    return routeEmbeddedInterrupt(ISM330DHCX_MLC_INT2, &trees, 1, ISM330DHCX_MD2_CFG);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// routeEmbeddedInterrupt()
+//
+// Writes the per-function routing masks of an interrupt pin in the embedded
+// function bank, then sets or clears the pin's INTx_EMB_FUNC bit to match.
+// The bit is shared by every embedded source of the pin (EMB_FUNC_INTx,
+// FSM_INTx_A/B, MLC_INTx), so it is only cleared when all of them read back
+// as unrouted.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  intReg      First routing register (MLC_INT1, FSM_INT1_A, ...)
+//  masks       Values of the routing registers
+//  count       Number of routing registers
+//  mdCfgReg    MD1_CFG or MD2_CFG
+//
+
+bool QwDevISM330DHCX::routeEmbeddedInterrupt(uint8_t intReg, uint8_t *masks, uint8_t count, uint8_t mdCfgReg)
+{
+    int32_t retVal = ism330dhcx_mem_bank_set(&sfe_dev, ISM330DHCX_EMBEDDED_FUNC_BANK);
+
+    if (retVal == 0)
+        retVal = ism330dhcx_write_reg(&sfe_dev, intReg, masks, count);
+
+    // The pin's four routing registers are consecutive, read them in one go
+    uint8_t sources[4];
+    uint8_t firstSource = mdCfgReg == ISM330DHCX_MD1_CFG ? ISM330DHCX_EMB_FUNC_INT1 : ISM330DHCX_EMB_FUNC_INT2;
+    if (retVal == 0)
+        retVal = ism330dhcx_read_reg(&sfe_dev, firstSource, sources, sizeof(sources));
+
+    // Return to the user bank even if the write failed
+    if (ism330dhcx_mem_bank_set(&sfe_dev, ISM330DHCX_USER_BANK) != 0 || retVal != 0)
+        return false;
+
+    bool routed = false;
+    for (uint8_t i = 0; i < sizeof(sources); i++)
+        routed = routed || sources[i] != 0;
+
+    // MD1_CFG / MD2_CFG: INT1_EMB_FUNC / INT2_EMB_FUNC is bit 1 of both
+    uint8_t mdCfg;
+    if (ism330dhcx_read_reg(&sfe_dev, mdCfgReg, &mdCfg, 1) != 0)
+        return false;
+    mdCfg = routed ? (mdCfg | 0x02) : (mdCfg & ~0x02);
+    if (ism330dhcx_write_reg(&sfe_dev, mdCfgReg, &mdCfg, 1) != 0)
+        return false;
+
+    return true;
+}
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////
+// Finite State Machine
+//
+//
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+// writeAdvancedPages()
+//
+// Writes a block of the embedded function pages (the FSM programs and their
+// configuration). ism330dhcx_ln_pg_write() writes one byte per transaction and
+// rewrites PAGE_SEL after each; here PAGE_SEL and PAGE_ADDRESS are set once per
+// page and the bytes go to PAGE_VALUE in one burst, with register address
+// auto-increment (CTRL3_C IF_INC) turned off so the burst stays on PAGE_VALUE
+// while the device advances the page address.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  address     Page address, page number in bits 11:8
+//  data        Bytes to write
+//  length      Number of bytes
+//  retval      true on success, false on bus error
+//
+bool QwDevISM330DHCX::writeAdvancedPages(uint16_t address, const uint8_t *data, uint16_t length)
+{
+    const uint8_t ifInc = 0x04, pageWrite = 0x40, pageRwMask = 0x60;
+
+    uint8_t ctrl3;
+    if (readRegisterRegion(ISM330DHCX_CTRL3_C, &ctrl3, 1) != 0)
+        return false;
+    uint8_t noIncrement = ctrl3 & ~ifInc;
+    if (writeRegisterRegion(ISM330DHCX_CTRL3_C, &noIncrement, 1) != 0)
+        return false;
+
+    bool ok = ism330dhcx_mem_bank_set(&sfe_dev, ISM330DHCX_EMBEDDED_FUNC_BANK) == 0;
+
+    uint8_t pageRw = 0;
+    if (ok)
+        ok = readRegisterRegion(ISM330DHCX_PAGE_RW, &pageRw, 1) == 0;
+    uint8_t writeMode = (pageRw & ~pageRwMask) | pageWrite;
+    if (ok)
+        ok = writeRegisterRegion(ISM330DHCX_PAGE_RW, &writeMode, 1) == 0;
+
+    while (ok && length > 0)
+    {
+        uint8_t pageSel = (uint8_t)(((address >> 8) & 0x0F) << 4) | 0x01;
+        uint8_t pageAddress = (uint8_t)address;
+        uint16_t n = 256 - pageAddress;
+        if (n > length)
+            n = length;
+
+        ok = writeRegisterRegion(ISM330DHCX_PAGE_SEL, &pageSel, 1) == 0 &&
+             writeRegisterRegion(ISM330DHCX_PAGE_ADDRESS, &pageAddress, 1) == 0 &&
+             writeRegisterRegion(ISM330DHCX_PAGE_VALUE, (uint8_t *)data, n) == 0;
+
+        address += n;
+        data += n;
+        length -= n;
+    }
+
+    // Leave page mode, the user bank and IF_INC as they were, also after a
+    // failed write
+    pageRw &= ~pageRwMask;
+    writeRegisterRegion(ISM330DHCX_PAGE_RW, &pageRw, 1);
+    if (ism330dhcx_mem_bank_set(&sfe_dev, ISM330DHCX_USER_BANK) != 0)
+        return false;
+    if (writeRegisterRegion(ISM330DHCX_CTRL3_C, &ctrl3, 1) != 0)
+        return false;
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// loadFsmPrograms()
+//
+// Uploads FSM programs back to back from startAddress, sets the number of
+// programs and the start address, and enables programs 1..count. The programs
+// and their configuration take two writeAdvancedPages() calls in total.
+//
+//  Parameter     Description
+//  ---------     -----------------------------
+//  programs      Program bytes as produced by ST's tools
+//  count         Number of programs, up to 16
+//  rate          FSM rate, 0 = 12.5Hz, 1 = 26Hz, 2 = 52Hz, 3 = 104Hz
+//  startAddress  Page address of the first program
+//  retval        true on success, false on bus error or bad arguments
+//
+// See sfe_ism330dhcx_defs.h for a list of valid rates
+
+bool QwDevISM330DHCX::loadFsmPrograms(const sfe_ism_fsm_program_t *programs, uint8_t count, uint8_t rate,
+                                      uint16_t startAddress)
+{
+    if (count == 0 || count > 16 || rate > 3)
+        return false;
+
+    uint32_t end = startAddress;
+    for (uint8_t i = 0; i < count; i++)
+        end += programs[i].length;
+    if (end > 0x1000)
+        return false;
+
+    // Stop the running programs while their code is replaced
+    ism330dhcx_emb_fsm_enable_t enable = {};
+    if (ism330dhcx_fsm_enable_set(&sfe_dev, &enable) != 0)
+        return false;
+
+    // FSM_PROGRAMS is written to both of its bytes, as ST's driver does,
+    // followed by FSM_START_ADD_L/H
+    uint8_t config[4] = {count, count, (uint8_t)startAddress, (uint8_t)(startAddress >> 8)};
+    if (!writeAdvancedPages(ISM330DHCX_FSM_PROGRAMS, config, sizeof(config)))
+        return false;
+
+    uint16_t address = startAddress;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!writeAdvancedPages(address, programs[i].data, programs[i].length))
+            return false;
+        address += programs[i].length;
+    }
+
+    if (ism330dhcx_fsm_data_rate_set(&sfe_dev, (ism330dhcx_fsm_odr_t)rate) != 0)
+        return false;
+
+    uint16_t mask = (uint16_t)((1u << count) - 1);
+    *(uint8_t *)&enable.fsm_enable_a = (uint8_t)mask;
+    *(uint8_t *)&enable.fsm_enable_b = (uint8_t)(mask >> 8);
+    if (ism330dhcx_fsm_enable_set(&sfe_dev, &enable) != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getFsmStatus()
+//
+// Reads FSM_STATUS_A_MAINPAGE and FSM_STATUS_B_MAINPAGE in one transfer: bit
+// n is set when program n+1 has raised its interrupt.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  status      Bit mask of the programs with a new output
+//
+
+bool QwDevISM330DHCX::getFsmStatus(uint16_t *status)
+{
+    uint8_t buff[2];
+
+    int32_t retVal = ism330dhcx_read_reg(&sfe_dev, ISM330DHCX_FSM_STATUS_A_MAINPAGE, buff, sizeof(buff));
+
+    if (retVal != 0)
+        return false;
+
+    *status = (uint16_t)((buff[1] << 8) | buff[0]);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getFsmOutputs()
+//
+// Reads the output registers of all sixteen programs (FSM_OUTS1..FSM_OUTS16).
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  outputs     Array of 16, output of program n+1 at index n
+//
+
+bool QwDevISM330DHCX::getFsmOutputs(uint8_t *outputs)
+{
+    int32_t retVal = ism330dhcx_fsm_out_get(&sfe_dev, (ism330dhcx_fsm_out_t *)outputs);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// setFsmLongCounter()
+//
+// Sets the FSM long counter, shared by all programs.
+//
+
+bool QwDevISM330DHCX::setFsmLongCounter(uint16_t value)
+{
+    int32_t retVal = ism330dhcx_long_cnt_set(&sfe_dev, value);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// setFsmInt1() / setFsmInt2()
+//
+// Routes the interrupt of the selected programs to INT1 or INT2.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  programs    Bit mask, bit n for program n+1; 0 unroutes all of them
+//
+
+bool QwDevISM330DHCX::setFsmInt1(uint16_t programs)
+{
+    uint8_t masks[2] = {(uint8_t)programs, (uint8_t)(programs >> 8)};
+    return routeEmbeddedInterrupt(ISM330DHCX_FSM_INT1_A, masks, sizeof(masks), ISM330DHCX_MD1_CFG);
+}
+
+bool QwDevISM330DHCX::setFsmInt2(uint16_t programs)
+{
+    uint8_t masks[2] = {(uint8_t)programs, (uint8_t)(programs >> 8)};
+    return routeEmbeddedInterrupt(ISM330DHCX_FSM_INT2_A, masks, sizeof(masks), ISM330DHCX_MD2_CFG);
+}
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////
+// Self Test
+//
+//
+//
+//
+//
+//
+//
+
+bool QwDevISM330DHCX::setAccelSelfTest(uint8_t val)
+{
+    int32_t retVal;
+
+    if (val > 2)
+        return false;
+
+    retVal = ism330dhcx_xl_self_test_set(&sfe_dev, (ism330dhcx_st_xl_t)val);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+
+bool QwDevISM330DHCX::setGyroSelfTest(uint8_t val)
+{
+    int32_t retVal;
+
+    // 0, 1, or 3
+    if (val > 3)
+        return false;
+
+    retVal = ism330dhcx_gy_self_test_set(&sfe_dev, (ism330dhcx_st_g_t)val);
+
+    if (retVal != 0)
+        return false;
+
+    return true;
+}
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkStatus
+//
+// Checks if data is ready for both the acclerometer and the gyroscope
+//
+
+bool QwDevISM330DHCX::checkStatus()
+{
+    ism330dhcx_status_reg_t tempVal;
+    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+
+    if (retVal != 0)
+        return false;
+
+    if ((tempVal.xlda == 1) && (tempVal.gda == 1))
+        return true;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkAccelStatus
+//
+// Checks if data is ready for the acclerometer
+
+bool QwDevISM330DHCX::checkAccelStatus()
+{
+    ism330dhcx_status_reg_t tempVal;
+    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+
+    if (retVal != 0)
+        return false;
+
+    if (tempVal.xlda == 1)
+        return true;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkAccelStatus
+//
+// Checks if data is ready for the gyroscope
+
+bool QwDevISM330DHCX::checkGyroStatus()
+{
+    ism330dhcx_status_reg_t tempVal;
+    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+
+    if (retVal != 0)
+        return false;
+
+    if (tempVal.gda == 1)
+        return true;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkAccelStatus
+//
+// Checks if data is ready for the temperature sensor
+
+bool QwDevISM330DHCX::checkTempStatus()
+{
+    ism330dhcx_status_reg_t tempVal;
+    int32_t retVal = ism330dhcx_status_reg_get(&sfe_dev, &tempVal);
+
+    if (retVal != 0)
+        return false;
+
+    if (tempVal.tda == 1)
+        return true;
+
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Compile-time profiles
+//
+//
+//
+//
+//////////////////////////////////////////////////////////////////////////////////
+// applyRegisterPlan()
+//
+// Writes a list of (register, value) pairs to the device. Runs of consecutive
+// registers are merged into a single auto-increment burst, so a sorted plan
+// costs one bus transaction per contiguous block rather than one per register.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  plan        Register writes, sorted by register address
+//  length      Number of entries in plan
+//
+bool QwDevISM330DHCX::applyRegisterPlan(const sfe_ism_reg_write_t *plan, uint16_t length)
+{
+    uint8_t burst[16];
+    uint16_t i = 0;
+
+    while (i < length)
+    {
+        uint8_t startReg = plan[i].reg;
+        uint16_t n = 0;
+
+        while (i < length && n < sizeof(burst) && plan[i].reg == startReg + n)
+            burst[n++] = plan[i++].value;
+
+        if (writeRegisterRegion(startReg, burst, n) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// applyProfile()
+//
+// Same as applyProfile<P>() for a profile only known at run time, e.g. read
+// from a configuration file. The plan is computed here rather than by the
+// compiler, and written the same way.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  profile     Device profile, rejected unless sfe_ism_profile::isValid()
+//
+
+bool QwDevISM330DHCX::applyProfile(const sfe_ism_profile_t &profile)
+{
+    if (!sfe_ism_profile::isValid(profile))
+        return false;
+
+    sfe_ism_reg_write_t plan[sfe_ism_profile::kImageLength];
+    size_t length = sfe_ism_profile::registerPlan(profile, plan);
+
+    if (!deviceReset())
+        return false;
+
+    // The reset bit self-clears once the user registers are restored
+    int tries = 0;
+    while (!getDeviceReset())
+        if (++tries > 10)
+            return false;
+
+    if (!applyRegisterPlan(plan, (uint16_t)length))
+        return false;
+
+    fullScaleAccel = profile.accelFullScale;
+    fullScaleGyro = profile.gyroFullScale;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkProfile()
+//
+// Same as checkProfile<P>() for a profile only known at run time.
+//
+//  Parameter   Description
+//  ---------   -----------------------------
+//  profile     Device profile
+//  intact      true if CTRL1_XL and CTRL2_G still hold the profile
+//
+
+bool QwDevISM330DHCX::checkProfile(const sfe_ism_profile_t &profile, bool *intact)
+{
+    const std::array<uint8_t, sfe_ism_profile::kImageLength> image = sfe_ism_profile::registerImage(profile);
+
+    uint8_t ctrl[2];
+    if (readRegisterRegion(ISM330DHCX_CTRL1_XL, ctrl, sizeof(ctrl)) != 0)
+        return false;
+
+    *intact = ctrl[0] == image[2] && ctrl[1] == image[3];
+    return true;
 }
@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+namespace
+{
+// Single writer, so a load and a store replace the locked read-modify-write
+inline void bump(std::atomic<uint64_t> &value, uint64_t n)
+{
+  value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+std::string withLabel(const std::string &labels, const std::string &label)
+{
+  if (labels.empty())
+    return "{" + label + "}";
+  return "{" + labels + "," + label + "}";
+}
+
+std::string labelSet(const std::string &labels)
+{
+  return labels.empty() ? "" : "{" + labels + "}";
+}
+
+void header(std::ostream &out, const char *name, const char *type, const char *help)
+{
+  out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+void summary(std::ostream &out, const char *name, const std::string &labels, const LatencyHistogram &h)
+{
+  for (double q : kQuantiles)
+  {
+    std::ostringstream quantile;
+    quantile << "quantile=\"" << q << "\"";
+    out << name << withLabel(labels, quantile.str()) << " " << h.percentile(q * 100.0) * 1e-9 << "\n";
+  }
+  out << name << "_sum" << labelSet(labels) << " " << h.mean() * h.count() * 1e-9 << "\n";
+  out << name << "_count" << labelSet(labels) << " " << h.count() << "\n";
+}
+
+int64_t steadyNow()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Unix socket for a path, TCP for host:port. A stale socket left at the path
+// is replaced; any other file there is left alone and fails the listen.
+int listenOn(const std::string &address, std::string *unix_path)
+{
+  size_t colon = address.rfind(':');
+  if (address.empty() || address[0] == '/' || colon == std::string::npos)
+  {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (address.empty() || address.size() >= sizeof(addr.sun_path))
+      return -1;
+    std::memcpy(addr.sun_path, address.c_str(), address.size());
+
+    struct stat st;
+    if (lstat(address.c_str(), &st) == 0)
+    {
+      if (!S_ISSOCK(st.st_mode))
+        return -1;
+      unlink(address.c_str());
+    }
+    else if (errno != ENOENT)
+      return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+    {
+      if (fd >= 0)
+        close(fd);
+      return -1;
+    }
+    *unix_path = address;
+    return fd;
+  }
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  int port = std::atoi(address.c_str() + colon + 1);
+  std::string host = address.substr(0, colon);
+  if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.empty() ? "127.0.0.1" : host.c_str(), &addr.sin_addr) != 1)
+    return -1;
+  addr.sin_port = htons((uint16_t)port);
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int reuse = 1;
+  if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+      bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0)
+  {
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  return fd;
+}
+} // namespace
+
+void Telemetry::reset(size_t devices)
+{
+  m_devices.clear();
+  for (size_t i = 0; i < devices; i++)
+    m_devices.push_back(std::make_unique<Device>());
+}
+
+void Telemetry::setInterval(size_t device, double interval_us)
+{
+  m_devices[device]->interval_us = interval_us;
+}
+
+void Telemetry::sample(size_t device, int64_t timestamp_us)
+{
+  Device &d = *m_devices[device];
+  bump(d.samples, 1);
+
+  // Anything under one and a half intervals is jitter
+  if (d.last_us != 0 && d.interval_us > 0.0 && timestamp_us - d.last_us > 1.5 * d.interval_us)
+    bump(d.dropped, (uint64_t)std::llround((timestamp_us - d.last_us) / d.interval_us) - 1);
+  d.last_us = timestamp_us;
+}
+
+void Telemetry::restart(size_t device)
+{
+  m_devices[device]->last_us = 0;
+}
+
+void Telemetry::latency(size_t device, uint64_t ns)
+{
+  Device &d = *m_devices[device];
+  bump(d.buckets[LatencyHistogram::bucketOf(ns)], 1);
+  bump(d.count, 1);
+  bump(d.sum, ns);
+  if (ns < d.min.load(std::memory_order_relaxed))
+    d.min.store(ns, std::memory_order_relaxed);
+  if (ns > d.max.load(std::memory_order_relaxed))
+    d.max.store(ns, std::memory_order_relaxed);
+}
+
+void Telemetry::notReady(size_t device)
+{
+  bump(m_devices[device]->not_ready, 1);
+}
+
+void Telemetry::fifo(size_t device, uint16_t level, bool overrun)
+{
+  Device &d = *m_devices[device];
+  d.fifo_level.store(level, std::memory_order_relaxed);
+  if (overrun)
+    bump(d.fifo_overruns, 1);
+}
+
+void Telemetry::busErrors(size_t device, uint64_t errors)
+{
+  if (errors > 0)
+    bump(m_devices[device]->bus_errors, errors);
+}
+
+void Telemetry::fault(size_t device)
+{
+  Device &d = *m_devices[device];
+  bump(d.faults, 1);
+  d.online.store(false, std::memory_order_relaxed);
+  d.last_us = 0;
+}
+
+void Telemetry::setOnline(size_t device, bool online)
+{
+  m_devices[device]->online.store(online, std::memory_order_relaxed);
+}
+
+DeviceMetrics Telemetry::snapshot(size_t device) const
+{
+  const Device &d = *m_devices[device];
+  DeviceMetrics metrics;
+  metrics.online = d.online.load(std::memory_order_relaxed);
+  metrics.samples = d.samples.load(std::memory_order_relaxed);
+  metrics.dropped = d.dropped.load(std::memory_order_relaxed);
+  metrics.not_ready = d.not_ready.load(std::memory_order_relaxed);
+  metrics.bus_errors = d.bus_errors.load(std::memory_order_relaxed);
+  metrics.faults = d.faults.load(std::memory_order_relaxed);
+  metrics.fifo_overruns = d.fifo_overruns.load(std::memory_order_relaxed);
+  metrics.fifo_level = d.fifo_level.load(std::memory_order_relaxed);
+
+  uint64_t buckets[LatencyHistogram::kBuckets];
+  for (size_t i = 0; i < LatencyHistogram::kBuckets; i++)
+    buckets[i] = d.buckets[i].load(std::memory_order_relaxed);
+  metrics.latency.add(buckets, d.count.load(std::memory_order_relaxed), d.sum.load(std::memory_order_relaxed),
+                      d.min.load(std::memory_order_relaxed), d.max.load(std::memory_order_relaxed));
+  return metrics;
+}
+
+namespace telemetry
+{
+void writePrometheus(std::ostream &out, const std::vector<DeviceMetrics> &devices,
+                     const std::vector<std::string> &labels)
+{
+  auto label = [&](size_t i) { return i < labels.size() ? labels[i] : "device=\"" + std::to_string(i) + "\""; };
+  auto each = [&](const char *name, const char *type, const char *help, auto value)
+  {
+    header(out, name, type, help);
+    for (size_t i = 0; i < devices.size(); i++)
+      out << name << labelSet(label(i)) << " " << value(devices[i]) << "\n";
+  };
+
+  each("ism330dhcx_up", "gauge", "Whether the device is online.",
+       [](const DeviceMetrics &m) { return m.online ? 1 : 0; });
+  each("ism330dhcx_sample_rate_hz", "gauge", "Samples delivered per second over the last refresh interval.",
+       [](const DeviceMetrics &m) { return m.rate_hz; });
+  each("ism330dhcx_samples_total", "counter", "Samples delivered to the sinks.",
+       [](const DeviceMetrics &m) { return m.samples; });
+  each("ism330dhcx_dropped_samples_total", "counter", "Samples missing from the stream between delivered ones.",
+       [](const DeviceMetrics &m) { return m.dropped; });
+  each("ism330dhcx_not_ready_polls_total", "counter", "Data-ready polls that found no new sample.",
+       [](const DeviceMetrics &m) { return m.not_ready; });
+  each("ism330dhcx_bus_errors_total", "counter", "Failed bus transfers while working with the device.",
+       [](const DeviceMetrics &m) { return m.bus_errors; });
+  each("ism330dhcx_faults_total", "counter", "Times the device went offline.",
+       [](const DeviceMetrics &m) { return m.faults; });
+  each("ism330dhcx_fifo_level_words", "gauge", "FIFO words found by the last drain.",
+       [](const DeviceMetrics &m) { return m.fifo_level; });
+  each("ism330dhcx_fifo_overruns_total", "counter", "FIFO drains that found the overrun flag set.",
+       [](const DeviceMetrics &m) { return m.fifo_overruns; });
+
+  header(out, "ism330dhcx_read_latency_seconds", "summary", "From the data-ready poll to the sample in hand.");
+  for (size_t i = 0; i < devices.size(); i++)
+    summary(out, "ism330dhcx_read_latency_seconds", label(i), devices[i].latency);
+
+  // Only built with ISM_LATENCY_TRACE does the trace record anything
+  bool traced = false;
+  for (size_t op = 0; op < (size_t)TraceOp::Count; op++)
+  {
+    LatencyHistogram h = latency_trace::histogram((TraceOp)op);
+    if (h.count() == 0)
+      continue;
+    if (!traced)
+      header(out, "ism330dhcx_trace_latency_seconds", "summary", "Latency per traced operation.");
+    traced = true;
+    summary(out, "ism330dhcx_trace_latency_seconds", std::string("op=\"") + latency_trace::name((TraceOp)op) + "\"", h);
+  }
+  if (!traced)
+    return;
+  header(out, "ism330dhcx_trace_events_total", "counter", "Events counted by the latency trace.");
+  for (size_t c = 0; c < (size_t)TraceCounter::Count; c++)
+    out << "ism330dhcx_trace_events_total{event=\"" << latency_trace::name((TraceCounter)c) << "\"} "
+        << latency_trace::counter((TraceCounter)c) << "\n";
+}
+} // namespace telemetry
+
+bool TelemetryServer::start(const std::string &address, const Telemetry &telemetry,
+                            const std::vector<std::string> &labels, int64_t refresh_ms)
+{
+  stop();
+  m_listen = listenOn(address, &m_unix_path);
+  m_wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (m_listen < 0 || m_wake < 0)
+  {
+    stop();
+    return false;
+  }
+
+  m_telemetry = &telemetry;
+  m_labels = labels;
+  m_refresh_ns = refresh_ms * 1000000;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rates.assign(telemetry.size(), 0.0);
+    m_last_samples.assign(telemetry.size(), 0);
+    m_last_refresh = steadyNow();
+  }
+  m_thread = std::thread(&TelemetryServer::serve, this);
+  return true;
+}
+
+void TelemetryServer::stop()
+{
+  if (m_thread.joinable())
+  {
+    uint64_t one = 1;
+    if (write(m_wake, &one, sizeof(one)) != sizeof(one))
+      perror("Failed to wake the telemetry thread");
+    m_thread.join();
+  }
+  if (m_listen >= 0)
+    close(m_listen);
+  if (m_wake >= 0)
+    close(m_wake);
+  m_listen = m_wake = -1;
+  if (!m_unix_path.empty())
+    unlink(m_unix_path.c_str());
+  m_unix_path.clear();
+}
+
+std::string TelemetryServer::render()
+{
+  std::vector<DeviceMetrics> devices(m_telemetry ? m_telemetry->size() : 0);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+      devices[i] = m_telemetry->snapshot(i);
+      devices[i].rate_hz = i < m_rates.size() ? m_rates[i] : 0.0;
+    }
+  }
+  std::ostringstream out;
+  telemetry::writePrometheus(out, devices, m_labels);
+  return out.str();
+}
+
+void TelemetryServer::refresh()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  int64_t now = steadyNow();
+  double elapsed = (now - m_last_refresh) * 1e-9;
+  for (size_t i = 0; i < m_rates.size(); i++)
+  {
+    uint64_t samples = m_telemetry->snapshot(i).samples;
+    m_rates[i] = elapsed > 0.0 ? (samples - m_last_samples[i]) / elapsed : 0.0;
+    m_last_samples[i] = samples;
+  }
+  m_last_refresh = now;
+}
+
+void TelemetryServer::serve()
+{
+  pid_t tid = (pid_t)syscall(SYS_gettid);
+  setpriority(PRIO_PROCESS, tid, 19);
+
+  int64_t next_refresh = steadyNow() + m_refresh_ns;
+  while (true)
+  {
+    int64_t wait_ms = std::max<int64_t>(0, (next_refresh - steadyNow()) / 1000000);
+    pollfd fds[2] = {{m_listen, POLLIN, 0}, {m_wake, POLLIN, 0}};
+    if (poll(fds, 2, (int)wait_ms) < 0 && errno != EINTR)
+      return;
+    if (fds[1].revents & POLLIN)
+      return;
+
+    if (steadyNow() >= next_refresh)
+    {
+      refresh();
+      next_refresh += m_refresh_ns;
+    }
+    if (fds[0].revents & POLLIN)
+    {
+      int client = accept4(m_listen, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client >= 0)
+      {
+        answer(client);
+        close(client);
+      }
+    }
+  }
+}
+
+void TelemetryServer::answer(int client)
+{
+  // A scraper sends its request first; a plain reader may send nothing
+  char request[1024];
+  ssize_t n = 0;
+  pollfd fd = {client, POLLIN, 0};
+  if (poll(&fd, 1, 100) > 0)
+    n = recv(client, request, sizeof(request), 0);
+  bool http = n >= 4 && std::memcmp(request, "GET ", 4) == 0;
+
+  std::string body = render();
+  std::string response;
+  if (http)
+    response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+               std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+  response += body;
+
+  // A stalled client is dropped rather than waited for
+  timeval timeout = {1, 0};
+  setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  size_t sent = 0;
+  while (sent < response.size())
+  {
+    ssize_t k = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (k <= 0)
+      return;
+    sent += (size_t)k;
+  }
+}
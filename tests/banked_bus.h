@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include "sfe_ism330dhcx.h"
+
+// Register file with the user, sensor hub and embedded function banks, the
+// advanced feature pages behind PAGE_VALUE and a FIFO. Honours CTRL3_C IF_INC.
+class BankedBus : public sfe_ISM330DHCX::QwIDeviceBus
+{
+public:
+    BankedBus()
+    {
+        user[ISM330DHCX_WHO_AM_I] = ISM330DHCX_ID;
+        user[ISM330DHCX_CTRL3_C] = 0x04;
+    }
+
+    bool ping(uint8_t address) { return true; }
+
+    bool writeRegisterByte(uint8_t address, uint8_t offset, uint8_t data)
+    {
+        return writeRegisterRegion(address, offset, &data, 1) == 0;
+    }
+
+    int writeRegisterRegion(uint8_t address, uint8_t offset, const uint8_t *data, uint16_t length)
+    {
+        transactions++;
+        bool increment = user[ISM330DHCX_CTRL3_C] & 0x04;
+        for (uint16_t i = 0; i < length; i++)
+            writeRegister(increment ? offset + i : offset, data[i]);
+        return 0;
+    }
+
+    int readRegisterRegion(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t numBytes)
+    {
+        transactions++;
+        bool increment = user[ISM330DHCX_CTRL3_C] & 0x04;
+        for (uint16_t i = 0; i < numBytes; i++)
+        {
+            uint8_t r = increment ? reg + i : reg;
+            if (bank() == 0 && reg == ISM330DHCX_FIFO_DATA_OUT_TAG)
+            {
+                // Wraps from FIFO_DATA_OUT_Z_H back to the tag
+                data[i] = fifo.empty() ? 0 : fifo.front()[i % 7];
+                if (i % 7 == 6 && !fifo.empty())
+                    fifo.pop_front();
+            }
+            else if (bank() == 0 && r == ISM330DHCX_FIFO_STATUS1)
+                data[i] = (uint8_t)fifo.size();
+            else if (bank() == 0 && r == ISM330DHCX_FIFO_STATUS1 + 1)
+                data[i] = (uint8_t)(((fifo.size() >> 8) & 0x03) | (overrun ? 0x40 : 0x00));
+            else
+                data[i] = r == ISM330DHCX_FUNC_CFG_ACCESS ? user[r] : regs()[r];
+        }
+        return 0;
+    }
+
+    void writeRegister(uint8_t reg, uint8_t value)
+    {
+        if (reg == ISM330DHCX_FUNC_CFG_ACCESS)
+            user[reg] = value;
+        else if (bank() == 0x80 && reg == ISM330DHCX_PAGE_SEL)
+            page_sel = value >> 4;
+        else if (bank() == 0x80 && reg == ISM330DHCX_PAGE_ADDRESS)
+            page_address = value;
+        else if (bank() == 0x80 && reg == ISM330DHCX_PAGE_VALUE)
+            pages[page_sel * 256 + page_address++] = value;
+        else
+            regs()[reg] = value;
+    }
+
+    uint8_t bank() const { return user[ISM330DHCX_FUNC_CFG_ACCESS] & 0xC0; }
+    uint8_t *regs() { return bank() == 0x80 ? embedded : bank() == 0x40 ? hub : user; }
+
+    uint8_t user[256] = {};
+    uint8_t embedded[256] = {};
+    uint8_t hub[256] = {};
+    uint8_t pages[16 * 256] = {};
+    uint8_t page_sel = 0, page_address = 0;
+    std::deque<std::array<uint8_t, 7>> fifo;
+    bool overrun = false; // FIFO_OVR_IA
+    int transactions = 0;
+};
@@ -0,0 +1,82 @@
+#include "activity_monitor.h"
+#include "banked_bus.h"
+#include <iostream>
+
+int main()
+{
+    int failures = 0;
+
+    BankedBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    dev.init();
+
+    // Gyro sleep with interrupts enabled, in one write
+    bus.transactions = 0;
+    if (!dev.setActivityMode(ISM_ACT_XL_12Hz5_GY_SLEEP) || bus.user[ISM330DHCX_TAP_CFG2] != (0x80 | (2 << 5)) ||
+        bus.transactions != 2)
+    {
+        std::cout << "FAIL: setActivityMode" << std::endl;
+        failures++;
+    }
+    if (!dev.setWakeUpThreshold(5) || !dev.setWakeUpDuration(2) || !dev.setSleepDuration(9) ||
+        bus.user[ISM330DHCX_WAKE_UP_THS] != 5 || bus.user[ISM330DHCX_WAKE_UP_DUR] != ((2 << 5) | 9))
+    {
+        std::cout << "FAIL: wake-up and sleep settings" << std::endl;
+        failures++;
+    }
+    if (dev.setActivityMode(4) || dev.setWakeUpThreshold(64) || dev.setWakeUpDuration(4) || dev.setSleepDuration(16))
+    {
+        std::cout << "FAIL: out of range setting accepted" << std::endl;
+        failures++;
+    }
+    if (!dev.setWakeUpThreshold(5, true) || bus.user[ISM330DHCX_WAKE_UP_DUR] != ((2 << 5) | 0x10 | 9))
+    {
+        std::cout << "FAIL: fine wake-up weight" << std::endl;
+        failures++;
+    }
+
+    bool asleep = true, changed = false;
+    bus.user[ISM330DHCX_WAKE_UP_SRC] = 0x10 | 0x40;
+    if (!dev.getSleepState(&asleep, &changed) || !asleep || !changed)
+    {
+        std::cout << "FAIL: getSleepState" << std::endl;
+        failures++;
+    }
+    if (!dev.setActivityMode(ISM_ACT_OFF) || bus.user[ISM330DHCX_TAP_CFG2] != 0)
+    {
+        std::cout << "FAIL: activity mode off" << std::endl;
+        failures++;
+    }
+
+    // Checked every 50ms awake, every 80ms asleep
+    const int64_t ms = 1000000;
+    ActivityMonitor monitor;
+    if (monitor.observe(0, false) || monitor.nextCheck() != 50 * ms)
+    {
+        std::cout << "FAIL: awake schedule" << std::endl;
+        failures++;
+    }
+    if (!monitor.observe(50 * ms, true) || !monitor.asleep() || monitor.nextCheck() != 130 * ms)
+    {
+        std::cout << "FAIL: falling asleep" << std::endl;
+        failures++;
+    }
+    monitor.observe(130 * ms, true);
+    if (!monitor.observe(210 * ms, false) || monitor.wakeUps() != 1 || monitor.sleepTime(1000 * ms) != 160 * ms ||
+        monitor.nextCheck() != 260 * ms)
+    {
+        std::cout << "FAIL: waking up" << std::endl;
+        failures++;
+    }
+    monitor.observe(300 * ms, true);
+    if (monitor.sleepTime(400 * ms) != 260 * ms)
+    {
+        std::cout << "FAIL: time asleep" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All activity tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include "async_device.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Register file behind a slow bus; flags overlapping transfers on one bus
+class SlowBus : public sfe_ISM330DHCX::QwIDeviceBus
+{
+public:
+    explicit SlowBus(int id) : m_id(id) {}
+
+    bool ping(uint8_t address) { return true; }
+
+    bool writeRegisterByte(uint8_t address, uint8_t offset, uint8_t data)
+    {
+        return writeRegisterRegion(address, offset, &data, 1) == 0;
+    }
+
+    int writeRegisterRegion(uint8_t address, uint8_t offset, const uint8_t *data, uint16_t length)
+    {
+        transfer();
+        return 0;
+    }
+
+    int readRegisterRegion(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t numBytes)
+    {
+        transfer();
+        for (uint16_t i = 0; i < numBytes; i++)
+            data[i] = 0;
+        if (reg == ISM330DHCX_STATUS_REG)
+            data[0] = 0x07;
+        if (reg == ISM330DHCX_OUTX_L_G)
+        {
+            // x = 100 * bus id + address, y = -x, z = reads so far
+            int16_t values[3] = {(int16_t)(100 * m_id + addr), (int16_t)-(100 * m_id + addr), (int16_t)m_reads};
+            std::memcpy(data, values, sizeof(values));
+        }
+        m_reads++;
+        return 0;
+    }
+
+    std::atomic<bool> overlapped{false};
+
+private:
+    void transfer()
+    {
+        if (m_busy.exchange(true))
+            overlapped = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        m_busy = false;
+    }
+
+    int m_id;
+    int m_reads = 0;
+    std::atomic<bool> m_busy{false};
+};
+
+static Task<void> follow(AsyncISM330DHCX &device, int samples, int *failures)
+{
+    for (int i = 0; i < samples; i++)
+    {
+        if (!co_await device.gyroReadyAsync())
+            (*failures)++;
+
+        sfe_ism_data_t gyro;
+        if (!co_await device.readGyroAsync(&gyro) || gyro.xData != -gyro.yData)
+            (*failures)++;
+    }
+}
+
+int main()
+{
+    int failures = 0;
+    const int buses = 4, devices_per_bus = 2, samples = 10;
+
+    std::vector<std::unique_ptr<SlowBus>> slow;
+    for (int b = 0; b < buses; b++)
+        slow.push_back(std::make_unique<SlowBus>(b));
+
+    EventLoop loop;
+    std::vector<std::unique_ptr<AsyncBus>> async_buses;
+    std::vector<std::unique_ptr<AsyncISM330DHCX>> devices;
+    for (int b = 0; b < buses; b++)
+    {
+        async_buses.push_back(std::make_unique<AsyncBus>(loop, *slow[b]));
+        for (int d = 0; d < devices_per_bus; d++)
+            devices.push_back(std::make_unique<AsyncISM330DHCX>(*async_buses[b], ISM330DHCX_ADDRESS_LOW + d));
+    }
+
+    int sample_failures = 0;
+    for (auto &device : devices)
+        loop.spawn(follow(*device, samples, &sample_failures));
+
+    auto start = std::chrono::steady_clock::now();
+    loop.run();
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Two transfers per sample at 2 ms each: 320 ms one after the other, 80 ms
+    // with the buses overlapped
+    double serial = 2.0 * 2 * samples * buses * devices_per_bus;
+    std::cout << "8 sensors on 4 buses: " << elapsed << " ms (serial " << serial << " ms)" << std::endl;
+    if (elapsed > serial / 2)
+    {
+        std::cout << "FAIL: buses did not overlap" << std::endl;
+        failures++;
+    }
+    if (sample_failures)
+    {
+        std::cout << "FAIL: " << sample_failures << " bad samples" << std::endl;
+        failures++;
+    }
+    for (auto &bus : slow)
+        if (bus->overlapped)
+        {
+            std::cout << "FAIL: overlapping transfers on one bus" << std::endl;
+            failures++;
+        }
+
+    // Conversion uses the configured full scale
+    SlowBus plain(1);
+    EventLoop single;
+    AsyncBus async_plain(single, plain);
+    AsyncISM330DHCX device(async_plain, ISM330DHCX_ADDRESS_HIGH, ISM_500dps);
+    sfe_ism_data_t gyro = {};
+    single.spawn([](AsyncISM330DHCX &dev, sfe_ism_data_t *out) -> Task<void>
+                 { co_await dev.readGyroAsync(out); }(device, &gyro));
+    single.run();
+    if (gyro.xData != (100 + ISM330DHCX_ADDRESS_HIGH) * 17.5f)
+    {
+        std::cout << "FAIL: converted " << gyro.xData << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All async device tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include "calibration.h"
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+int main()
+{
+    int failures = 0;
+
+    // Still period statistics on a known sequence
+    StillPeriod still;
+    for (int i = 0; i < 1000; i++)
+    {
+        float noise = (i % 2) ? 50.0f : -50.0f;
+        SampleRecord sample = {i, 120.0f + noise, -80.0f, 40.0f, 12.0f, -20.0f, 1030.0f, 31.0f};
+        still.add(sample);
+    }
+    float gyro[3], accel[3], temp;
+    still.mean(gyro, accel, &temp);
+    if (std::fabs(gyro[0] - 120.0f) > 1e-3f || std::fabs(gyro[1] + 80.0f) > 1e-3f || std::fabs(temp - 31.0f) > 1e-3f)
+    {
+        std::cout << "FAIL: still period mean " << gyro[0] << " " << gyro[1] << " " << temp << std::endl;
+        failures++;
+    }
+    if (std::fabs(still.gyroStdDev() - 50.0f) > 0.1f)
+    {
+        std::cout << "FAIL: still period std dev " << still.gyroStdDev() << std::endl;
+        failures++;
+    }
+
+    // A single temperature only determines the offset
+    DeviceCalibration calibration;
+    calibration.address = 0x6b;
+    const float bias_at_25[3] = {100.0f, -50.0f, 20.0f};
+    calibration.addObservation(25.0f, bias_at_25);
+    calibration.fit();
+    if (calibration.slope[0] != 0.0f || calibration.bias[0] != 100.0f)
+    {
+        std::cout << "FAIL: single temperature fit " << calibration.bias[0] << " " << calibration.slope[0] << std::endl;
+        failures++;
+    }
+
+    // Runs at other temperatures reveal the slope: bias = b + s * (T - 25)
+    const float slope[3] = {4.0f, -2.0f, 0.5f};
+    for (float t : {35.0f, 45.0f})
+    {
+        float bias[3];
+        for (int i = 0; i < 3; i++)
+            bias[i] = bias_at_25[i] + slope[i] * (t - 25.0f);
+        calibration.addObservation(t, bias);
+    }
+    calibration.fit();
+    for (int i = 0; i < 3; i++)
+    {
+        float predicted = calibration.bias[i] + calibration.slope[i] * (25.0f - calibration.reference_temp);
+        if (std::fabs(calibration.slope[i] - slope[i]) > 1e-3f || std::fabs(predicted - bias_at_25[i]) > 1e-2f)
+        {
+            std::cout << "FAIL: axis " << i << " slope " << calibration.slope[i] << " expected " << slope[i] << std::endl;
+            failures++;
+        }
+    }
+
+    // The turn-on bias of this run wins over the stored runs at the same
+    // temperature; they only contribute the slope
+    DeviceCalibration rerun;
+    for (float offset : {100.0f, 160.0f, 220.0f})
+    {
+        const float run[3] = {offset, -offset, 0.0f};
+        rerun.addObservation(30.0f, run);
+    }
+    rerun.fit();
+    if (rerun.bias[0] != 220.0f || rerun.bias[1] != -220.0f || rerun.reference_temp != 30.0f || rerun.slope[0] != 0.0f)
+    {
+        std::cout << "FAIL: stored runs outweigh the current one, bias " << rerun.bias[0] << std::endl;
+        failures++;
+    }
+
+    // Level mount, z up: 1030 mg on z and small offsets elsewhere
+    const float level[3] = {12.0f, -20.0f, 1030.0f};
+    calibration.computeAccelOffset(level);
+    if (calibration.accel_coarse || calibration.accel_offset[0] != 12 || calibration.accel_offset[1] != -20 ||
+        calibration.accel_offset[2] != 31)
+    {
+        std::cout << "FAIL: accel offset " << (int)calibration.accel_offset[0] << " " << (int)calibration.accel_offset[1]
+                  << " " << (int)calibration.accel_offset[2] << std::endl;
+        failures++;
+    }
+
+    // Offsets beyond the fine range switch to the coarse weight
+    DeviceCalibration coarse;
+    const float upside_down[3] = {300.0f, 0.0f, -1000.0f};
+    coarse.computeAccelOffset(upside_down);
+    if (!coarse.accel_coarse || coarse.accel_offset[0] != 19 || coarse.accel_offset[2] != 0)
+    {
+        std::cout << "FAIL: coarse accel offset " << (int)coarse.accel_offset[0] << std::endl;
+        failures++;
+    }
+
+    // Persisted calibration round trips exactly
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::filesystem::path path = DeviceCalibration::pathFor(directory, "/dev/i2c-16", calibration.address);
+    if (path.filename() != "calibration_dev_i2c_16_0x6b.txt" || !calibration.save(path))
+    {
+        std::cout << "FAIL: could not save " << path << std::endl;
+        failures++;
+    }
+
+    // The same address on two adapters keeps two files
+    DeviceCalibration other = calibration;
+    other.bias[0] = calibration.bias[0] + 1.0f;
+    std::filesystem::path other_path = DeviceCalibration::pathFor(directory, "/dev/i2c-17", calibration.address);
+    DeviceCalibration reloaded;
+    if (other_path == path || !other.save(other_path) || !reloaded.load(path) ||
+        reloaded.bias[0] != calibration.bias[0])
+    {
+        std::cout << "FAIL: devices at one address on two buses share a calibration" << std::endl;
+        failures++;
+    }
+    std::filesystem::remove(other_path);
+    DeviceCalibration loaded;
+    if (!loaded.load(path) || loaded.address != 0x6b || loaded.n != calibration.n ||
+        loaded.sum_tb[2] != calibration.sum_tb[2] || loaded.slope[1] != calibration.slope[1] ||
+        loaded.accel_offset[2] != calibration.accel_offset[2])
+    {
+        std::cout << "FAIL: loaded calibration differs" << std::endl;
+        failures++;
+    }
+    std::filesystem::remove(path);
+
+    // Correction pass only touches devices that produced a sample
+    GyroCalibration correction;
+    correction.resize(2);
+    correction.setModel(0, calibration);
+    correction.setModel(1, calibration);
+    std::vector<SampleRecord> sweep(2, SampleRecord{0, 140.0f, -70.0f, 30.0f, 0.0f, 0.0f, 1000.0f, 35.0f});
+    std::vector<uint8_t> acquired = {1, 0};
+    correction.apply(sweep, acquired);
+    if (std::fabs(sweep[0].gx) > 1e-2f || std::fabs(sweep[0].gy) > 1e-2f || std::fabs(sweep[0].gz - 5.0f) > 1e-2f ||
+        sweep[1].gx != 140.0f)
+    {
+        std::cout << "FAIL: corrected " << sweep[0].gx << " " << sweep[0].gy << " " << sweep[0].gz << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All calibration tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+#include "clock_sync.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static const double kPi = 3.14159265358979323846;
+
+int main()
+{
+    int failures = 0;
+    std::mt19937 rng(7);
+
+    // Oscillator 120 ppm slow against its factory calibration (fine = 4),
+    // read over a bus adding 80..1500us of latency
+    DeviceClock clock;
+    const int8_t fine = 4;
+    const double true_tick = DeviceClock::kNominalTickNs / (1.0 + 0.0015 * fine) * (1.0 + 120e-6);
+    const int64_t anchor = 1000000000;
+    clock.reset(anchor, fine);
+    std::exponential_distribution<double> latency(1.0 / 300000.0);
+    uint32_t ticks = 0;
+    double worst = 0.0;
+    for (int i = 0; i < 60 * 1000; i++) // 60 s of reads at 1 kHz
+    {
+        ticks += 40;
+        int64_t sampled = anchor + (int64_t)(ticks * true_tick);
+        clock.observe(clock.unwrap(ticks), sampled + 80000 + (int64_t)std::min(latency(rng), 1420000.0));
+        if (i > 30 * 1000)
+            worst = std::max(worst, std::fabs((double)(clock.toHost(ticks) - sampled)));
+    }
+    std::cout << "Clock skew " << clock.skewPpm() << " ppm (true 120), worst error over the last 30 s " << worst / 1000.0
+              << " us" << std::endl;
+    if (std::fabs(clock.skewPpm() - 120.0) > 5.0 || worst > 20000.0)
+    {
+        std::cout << "FAIL: clock estimate" << std::endl;
+        failures++;
+    }
+
+    DeviceClock wrapping;
+    wrapping.reset(0);
+    wrapping.unwrap(0xFFFFFFF0u);
+    if (wrapping.unwrap(0x10) != 0x100000010ull)
+    {
+        std::cout << "FAIL: counter wrap" << std::endl;
+        failures++;
+    }
+
+    // Two devices sampling a common 37Hz rotation at 6667Hz, their sample
+    // grids offset by 61us and drifting 200 ppm apart; frames at 1kHz
+    std::vector<SyncFrame> frames;
+    StreamAligner aligner(2, 1000.0, [&](const SyncFrame &frame) { frames.push_back(frame); }, 2.5e6 / 6667.0);
+    auto signal = [](double t_us) { return (float)(1000.0 * std::sin(2.0 * kPi * 37.0 * t_us * 1e-6)); };
+    const double period[2] = {1e6 / 6667.0, 1e6 / 6667.0 * (1.0 + 200e-6)};
+    const double start[2] = {10.0, 71.0};
+    for (int k = 0; k < 66670; k++)
+    {
+        for (size_t d = 0; d < 2; d++)
+        {
+            // Device 1 has a 3ms gap
+            if (d == 1 && k >= 20000 && k < 20020)
+                continue;
+            // Sample times are whole microseconds, as in SampleRecord
+            int64_t t = (int64_t)std::llround(start[d] + k * period[d]);
+            aligner.push(d, {t, signal((double)t), 0, 0, 0, 0, 1000, 25});
+        }
+    }
+
+    double worst_value = 0.0;
+    size_t invalid = 0;
+    bool on_grid = true;
+    for (const SyncFrame &frame : frames)
+    {
+        on_grid = on_grid && frame.timestamp % 1000 == 0;
+        for (size_t d = 0; d < 2; d++)
+        {
+            if (!frame.valid[d])
+            {
+                invalid++;
+                continue;
+            }
+            worst_value = std::max(worst_value, (double)std::fabs(frame.samples[d].gx - signal((double)frame.timestamp)));
+        }
+    }
+    std::cout << frames.size() << " frames, worst interpolation error " << worst_value << " mdps, " << invalid
+              << " invalid samples" << std::endl;
+    // 1us of timing error is 0.23 mdps at this amplitude and frequency
+    if (frames.size() < 9990 || !on_grid || worst_value > 1.0 || invalid < 2 || invalid > 4)
+    {
+        std::cout << "FAIL: aligned frames" << std::endl;
+        failures++;
+    }
+
+    // A device that goes offline or to sleep stops holding frames back
+    frames.clear();
+    StreamAligner paused(2, 1000.0, [&](const SyncFrame &frame) { frames.push_back(frame); });
+    for (int64_t t = 0; t <= 10000; t += 500)
+    {
+        paused.push(0, {t, 1, 0, 0, 0, 0, 1000, 25});
+        if (t <= 3000)
+            paused.push(1, {t, 2, 0, 0, 0, 0, 1000, 25});
+    }
+    size_t held = frames.size();
+    paused.setActive(1, false);
+    size_t released = frames.size();
+    for (int64_t t = 10500; t <= 12000; t += 500)
+        paused.push(0, {t, 1, 0, 0, 0, 0, 1000, 25});
+    bool marked = frames.size() == 13 && frames.back().timestamp == 12000 && frames.back().valid[0] &&
+                  !frames.back().valid[1] && frames[2].valid[1];
+    paused.setActive(1, true);
+    paused.push(0, {12500, 1, 0, 0, 0, 0, 1000, 25});
+    paused.push(0, {13000, 1, 0, 0, 0, 0, 1000, 25});
+    size_t waiting = frames.size();
+    paused.push(1, {13000, 2, 0, 0, 0, 0, 1000, 25});
+    if (held != 4 || released != 11 || !marked || waiting != 13 || frames.size() != 14 || !frames.back().valid[1])
+    {
+        std::cout << "FAIL: inactive device held frames back (" << held << ", " << released << ", "
+                  << frames.size() << ")" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All clock sync tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
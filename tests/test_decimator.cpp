@@ -0,0 +1,99 @@
+#include "decimator.h"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+static const double kPi = 3.14159265358979323846;
+
+// Peak |gx| of the decimated outputs of a sine at freq (fraction of the
+// input rate), after the filter has settled
+static float decimatedPeak(unsigned factor, double freq)
+{
+    Decimator decimator(factor);
+    float peak = 0.0f;
+    size_t settle = decimator.taps();
+    for (size_t i = 0; i < settle + 200 * factor; i++)
+    {
+        SampleRecord in = {(int64_t)i, (float)std::sin(2.0 * kPi * freq * i), 0, 0, 0, 0, 0, 25.0f};
+        SampleRecord out;
+        if (decimator.push(in, &out) && i >= settle)
+            peak = std::max(peak, std::fabs(out.gx));
+    }
+    return peak;
+}
+
+int main()
+{
+    int failures = 0;
+
+    std::vector<float> taps = fir::decimationFilter(8);
+    double sum = 0.0;
+    bool symmetric = taps.size() % 2 == 1;
+    for (size_t i = 0; i < taps.size(); i++)
+    {
+        sum += taps[i];
+        symmetric = symmetric && std::fabs(taps[i] - taps[taps.size() - 1 - i]) < 1e-7f;
+    }
+    if (std::fabs(sum - 1.0) > 1e-5 || !symmetric || fir::decimationFilter(1).size() != 1)
+    {
+        std::cout << "FAIL: filter design" << std::endl;
+        failures++;
+    }
+
+    // 6667Hz to about 100Hz: 20Hz passes, 150Hz (which would alias to about
+    // 50Hz) is removed
+    const unsigned factor = 66;
+    float pass = decimatedPeak(factor, 20.0 / 6667.0);
+    float alias = decimatedPeak(factor, 150.0 / 6667.0);
+    std::cout << "Decimating by " << factor << " (" << fir::decimationFilter(factor).size() << " taps): 20Hz gain " << pass
+              << ", 150Hz gain " << alias << std::endl;
+    if (std::fabs(pass - 1.0f) > 0.01f || alias > 0.001f)
+    {
+        std::cout << "FAIL: passband or stopband" << std::endl;
+        failures++;
+    }
+
+    // Constant input comes out unchanged from the first sample on, with the
+    // quaternion and timestamp of the sample at the group delay
+    Decimator decimator(4);
+    std::vector<SampleRecord> outputs;
+    for (int i = 0; i < 100; i++)
+    {
+        SampleRecord in = {i * 150, 10, 20, 30, 0, 0, 1000, 25};
+        in.qx = (float)i;
+        SampleRecord out;
+        if (decimator.push(in, &out))
+            outputs.push_back(out);
+    }
+    bool constant = outputs.size() == 25;
+    for (const SampleRecord &out : outputs)
+        constant = constant && std::fabs(out.gy - 20.0f) < 1e-3f && std::fabs(out.az - 1000.0f) < 1e-2f &&
+                   std::fabs(out.temp - 25.0f) < 1e-3f;
+    const SampleRecord &last = outputs.back();
+    if (!constant || last.qx != 96.0f - decimator.delay() || last.timestamp != (int64_t)(96 - decimator.delay()) * 150)
+    {
+        std::cout << "FAIL: constant input or delay alignment" << std::endl;
+        failures++;
+    }
+
+    // Two outputs, two devices, each sink sees only its own rate
+    MultiRatePipeline pipeline(2);
+    size_t fast = 0, slow = 0, device1 = 0;
+    pipeline.addOutput(4, [&](size_t device, const SampleRecord &) { fast++; });
+    pipeline.addOutput(66, [&](size_t device, const SampleRecord &) {
+        slow++;
+        device1 += device == 1;
+    });
+    for (int i = 0; i < 6600; i++)
+        for (size_t device = 0; device < 2; device++)
+            pipeline.push(device, {i * 150, 1, 2, 3, 4, 5, 6, 25});
+    if (fast != 2 * 1650 || slow != 2 * 100 || device1 != 100 || pipeline.factor(1) != 66)
+    {
+        std::cout << "FAIL: pipeline produced " << fast << " and " << slow << " samples" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All decimator tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
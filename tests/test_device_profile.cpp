@@ -0,0 +1,187 @@
+#include "sfe_ism330dhcx.h"
+#include <cstring>
+#include <iostream>
+
+// Register file standing in for a real device, counts bus transactions.
+class FakeBus : public sfe_ISM330DHCX::QwIDeviceBus
+{
+public:
+    FakeBus() { softwareReset(); }
+
+    bool ping(uint8_t address) { return true; }
+
+    bool writeRegisterByte(uint8_t address, uint8_t offset, uint8_t data)
+    {
+        return writeRegisterRegion(address, offset, &data, 1) == 0;
+    }
+
+    int writeRegisterRegion(uint8_t address, uint8_t offset, const uint8_t *data, uint16_t length)
+    {
+        writes++;
+        for (uint16_t i = 0; i < length; i++)
+            regs[offset + i] = data[i];
+        if (regs[ISM330DHCX_CTRL3_C] & 0x01)
+            softwareReset();
+        return 0;
+    }
+
+    int readRegisterRegion(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t numBytes)
+    {
+        std::memcpy(data, &regs[reg], numBytes);
+        return 0;
+    }
+
+    void softwareReset()
+    {
+        std::memset(regs, 0, sizeof(regs));
+        for (size_t i = 0; i < sfe_ism_profile::kImageLength; i++)
+            regs[sfe_ism_profile::kImageRegs[i]] = sfe_ism_profile::kResetImage[i];
+        regs[ISM330DHCX_WHO_AM_I] = ISM330DHCX_ID;
+    }
+
+    uint8_t regs[256];
+    int writes = 0;
+};
+
+constexpr sfe_ism_profile_t kTestProfile = {
+    .gyroDataRate = ISM_GY_ODR_6667Hz,
+    .gyroFullScale = ISM_500dps,
+    .gyroFilterLP1 = true,
+    .gyroLP1Bandwidth = ISM_MEDIUM,
+};
+
+static_assert(sfe_ism_profile::planLength(kTestProfile) == 5);
+static_assert(sfe_ism_profile::registerPlan<kTestProfile>()[0].reg == ISM330DHCX_CTRL2_G);
+static_assert(sfe_ism_profile::registerPlan<kTestProfile>()[0].value == 0xA4);
+static_assert(sfe_ism_profile::planLength(sfe_ism_profile_t{.blockDataUpdate = false, .deviceConfig = false}) == 0);
+
+int main()
+{
+    int failures = 0;
+    FakeBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+
+    if (!dev.init())
+    {
+        std::cout << "FAIL: init" << std::endl;
+        return 1;
+    }
+
+    // Applying the profile through the plan must match the runtime setters
+    bus.writes = 0;
+    if (!dev.applyProfile<kTestProfile>())
+    {
+        std::cout << "FAIL: applyProfile" << std::endl;
+        return 1;
+    }
+    int planWrites = bus.writes;
+    uint8_t planned[256];
+    std::memcpy(planned, bus.regs, sizeof(planned));
+
+    dev.deviceReset();
+    bus.writes = 0;
+    dev.setDeviceConfig();
+    dev.setBlockDataUpdate();
+    dev.setGyroDataRate(kTestProfile.gyroDataRate);
+    dev.setGyroFullScale(kTestProfile.gyroFullScale);
+    dev.setGyroFilterLP1();
+    dev.setGyroLP1Bandwidth(kTestProfile.gyroLP1Bandwidth);
+    int setterWrites = bus.writes;
+
+    if (std::memcmp(planned, bus.regs, sizeof(planned)) != 0)
+    {
+        std::cout << "FAIL: register image differs from runtime setters" << std::endl;
+        failures++;
+    }
+
+    // A profile only known at run time goes through the same plan
+    bus.writes = 0;
+    bool intact = false;
+    if (!dev.applyProfile(kTestProfile) || bus.writes != planWrites ||
+        std::memcmp(planned, bus.regs, sizeof(planned)) != 0 || !dev.checkProfile(kTestProfile, &intact) || !intact)
+    {
+        std::cout << "FAIL: run-time applyProfile differs from applyProfile<P>()" << std::endl;
+        failures++;
+    }
+    if (dev.applyProfile(sfe_ism_profile_t{.gyroFullScale = 3}))
+    {
+        std::cout << "FAIL: invalid run-time profile applied" << std::endl;
+        failures++;
+    }
+
+    std::cout << "Register writes: plan " << planWrites << ", setters " << setterWrites << std::endl;
+    if (planWrites >= setterWrites)
+    {
+        std::cout << "FAIL: plan is not smaller than setter sequence" << std::endl;
+        failures++;
+    }
+
+    // Profile conversion must match the runtime conversion bit for bit
+    bus.regs[ISM330DHCX_OUTX_L_G] = 0x34;
+    bus.regs[ISM330DHCX_OUTX_H_G] = 0x12;
+    bus.regs[ISM330DHCX_OUTY_L_G] = 0xFE;
+    bus.regs[ISM330DHCX_OUTY_H_G] = 0xFF;
+    bus.regs[ISM330DHCX_OUTZ_L_G] = 0x00;
+    bus.regs[ISM330DHCX_OUTZ_H_G] = 0x80;
+    sfe_ism_data_t runtime, profiled;
+    dev.getGyro(&runtime);
+    dev.getGyro<kTestProfile>(&profiled);
+    if (runtime.xData != profiled.xData || runtime.yData != profiled.yData || runtime.zData != profiled.zData)
+    {
+        std::cout << "FAIL: profile conversion differs from getGyro()" << std::endl;
+        failures++;
+    }
+
+    // The compile-time bound device must read the same data as the ST path,
+    // and its configuration methods must still reach the bus
+    QwDevISM330DHCXBound<FakeBus> bound;
+    bound.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    if (!bound.init())
+    {
+        std::cout << "FAIL: bound init" << std::endl;
+        return 1;
+    }
+
+    bus.regs[ISM330DHCX_OUTX_L_A] = 0x10;
+    bus.regs[ISM330DHCX_OUTY_H_A] = 0xC0;
+    bus.regs[ISM330DHCX_OUT_TEMP_L] = 0x80;
+    bus.regs[ISM330DHCX_STATUS_REG] = 0x02;
+    sfe_ism_raw_all_t viaSt, viaBound;
+    dev.getRawAllSensors(&viaSt);
+    bound.getRawAllSensors(&viaBound);
+    sfe_ism_raw_data_t boundGyro;
+    bound.getRawGyro(&boundGyro);
+    if (std::memcmp(&viaSt, &viaBound, sizeof(viaSt)) != 0 || boundGyro.xData != viaSt.gyro.xData ||
+        boundGyro.yData != viaSt.gyro.yData || boundGyro.zData != viaSt.gyro.zData)
+    {
+        std::cout << "FAIL: bound device reads differ from the ST path" << std::endl;
+        failures++;
+    }
+    if (bound.checkGyroStatus() != dev.checkGyroStatus() || bound.checkAccelStatus() != dev.checkAccelStatus())
+    {
+        std::cout << "FAIL: bound status differs from the ST path" << std::endl;
+        failures++;
+    }
+
+    bus.regs[ISM330DHCX_FIFO_STATUS1] = 0x2C;
+    bus.regs[ISM330DHCX_FIFO_STATUS2] = 0x41;
+    if (bound.getFifoLevel() != dev.getFifoLevel() || bound.getFifoLevel() != 0x12C)
+    {
+        std::cout << "FAIL: bound FIFO level differs from the ST path" << std::endl;
+        failures++;
+    }
+    bus.regs[ISM330DHCX_FIFO_STATUS1] = 0;
+    bus.regs[ISM330DHCX_FIFO_STATUS2] = 0;
+
+    if (!bound.setGyroFullScale(ISM_2000dps) || bound.getGyroFullScale() != ISM_2000dps ||
+        (bus.regs[ISM330DHCX_CTRL2_G] & 0x0F) != ISM_2000dps)
+    {
+        std::cout << "FAIL: bound device configuration" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "Device profile test passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
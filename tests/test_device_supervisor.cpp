@@ -0,0 +1,103 @@
+#include "device_supervisor.h"
+#include "banked_bus.h"
+#include "sfe_ism330dhcx_profile.h"
+#include <iostream>
+
+static constexpr sfe_ism_profile_t kProfile = {
+    .accelDataRate = ISM_XL_ODR_6667Hz,
+    .accelFullScale = ISM_4g,
+    .gyroDataRate = ISM_GY_ODR_6667Hz,
+    .gyroFullScale = ISM_250dps,
+};
+
+int main()
+{
+    int failures = 0;
+    const int64_t ms = 1000000;
+
+    // Errors take the device offline once; retries back off from 1ms
+    DeviceSupervisor supervisor;
+    if (supervisor.observe(0, 0) || !supervisor.online())
+    {
+        std::cout << "FAIL: offline without errors" << std::endl;
+        failures++;
+    }
+    if (!supervisor.observe(10 * ms, 3) || supervisor.online() || supervisor.nextRetry() != 11 * ms ||
+        supervisor.observe(10 * ms, 1))
+    {
+        std::cout << "FAIL: going offline" << std::endl;
+        failures++;
+    }
+    int64_t t = supervisor.nextRetry();
+    int64_t previous = 0;
+    for (int i = 0; i < 12; i++)
+    {
+        supervisor.recovered(t, false);
+        int64_t interval = supervisor.nextRetry() - t;
+        if (interval < previous || interval > DeviceSupervisor::kMaxRetry)
+        {
+            std::cout << "FAIL: retry interval " << interval << " after " << previous << std::endl;
+            failures++;
+        }
+        previous = interval;
+        t = supervisor.nextRetry();
+    }
+    if (previous != DeviceSupervisor::kMaxRetry)
+    {
+        std::cout << "FAIL: retries did not reach the longest interval" << std::endl;
+        failures++;
+    }
+    supervisor.recovered(t, true);
+    if (!supervisor.online() || supervisor.faults() != 1 || supervisor.attempts() != 13 ||
+        supervisor.downtime(t + 5 * ms) != t - 10 * ms)
+    {
+        std::cout << "FAIL: recovery" << std::endl;
+        failures++;
+    }
+
+    // A second fault starts again from the shortest retry
+    supervisor.observe(t + 20 * ms, 1);
+    if (supervisor.nextRetry() != t + 21 * ms || supervisor.downtime(t + 30 * ms) != t)
+    {
+        std::cout << "FAIL: second fault" << std::endl;
+        failures++;
+    }
+
+    // A device that never answered is not counted as down
+    DeviceSupervisor absent(false);
+    if (absent.online() || absent.nextRetry() != 0 || absent.downtime(100 * ms) != 0)
+    {
+        std::cout << "FAIL: absent device" << std::endl;
+        failures++;
+    }
+    absent.recovered(100 * ms, true);
+    if (!absent.online() || absent.downtime(200 * ms) != 0)
+    {
+        std::cout << "FAIL: absent device appearing" << std::endl;
+        failures++;
+    }
+
+    // The profile check tells a reset device from one that kept its setup
+    BankedBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    dev.init();
+    bool intact = true;
+    bus.transactions = 0;
+    if (!dev.checkProfile<kProfile>(&intact) || intact || bus.transactions != 1)
+    {
+        std::cout << "FAIL: reset device reported intact" << std::endl;
+        failures++;
+    }
+    constexpr auto plan = sfe_ism_profile::registerPlan<kProfile>();
+    dev.applyRegisterPlan(plan.data(), (uint16_t)plan.size());
+    if (!dev.checkProfile<kProfile>(&intact) || !intact)
+    {
+        std::cout << "FAIL: configured device reported reset" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All device supervisor tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
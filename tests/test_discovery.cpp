@@ -0,0 +1,61 @@
+#include "discovery.h"
+#include <fstream>
+#include <iostream>
+
+static void addAdapter(const std::filesystem::path &sysfs, const std::string &entry, const std::string &name)
+{
+    std::filesystem::create_directories(sysfs / entry);
+    std::ofstream(sysfs / entry / "name") << name << "\n";
+}
+
+int main()
+{
+    int failures = 0;
+
+    // Fake sysfs with both CH341 drivers, an on-board adapter and noise
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "ism_test_discovery";
+    std::filesystem::remove_all(root);
+    std::filesystem::path sysfs = root / "sys", dev = root / "dev";
+    addAdapter(sysfs, "i2c-10", "CH341 I2C USB bus 002 device 003");
+    addAdapter(sysfs, "i2c-1", "Synopsys DesignWare I2C adapter");
+    addAdapter(sysfs, "i2c-3", "i2c-ch341-usb at bus 001 device 004");
+    addAdapter(sysfs, "i2c-x", "ch341 lookalike");
+    std::filesystem::create_directories(dev);
+    std::ofstream(dev / "i2c-3") << "not a device";
+
+    std::vector<I2cBus> ch341 = discovery::adapters(discovery::kCh341, sysfs, dev);
+    if (ch341.size() != 2 || ch341[0].path != (dev / "i2c-3").string() || ch341[1].path != (dev / "i2c-10").string() ||
+        ch341[1].name != "CH341 I2C USB bus 002 device 003")
+    {
+        std::cout << "FAIL: CH341 adapters" << std::endl;
+        failures++;
+    }
+    if (discovery::adapters("", sysfs, dev).size() != 3)
+    {
+        std::cout << "FAIL: unfiltered adapters" << std::endl;
+        failures++;
+    }
+    if (!discovery::adapters(discovery::kCh341, root / "missing", dev).empty())
+    {
+        std::cout << "FAIL: adapters without sysfs" << std::endl;
+        failures++;
+    }
+
+    // Probing fails cleanly on a missing node and finds nothing on a file
+    // that is not an adapter
+    if (discovery::probe(&ch341[1]) || !discovery::probe(&ch341[0]) || !ch341[0].addresses.empty())
+    {
+        std::cout << "FAIL: probe" << std::endl;
+        failures++;
+    }
+    if (!discovery::scan(discovery::kCh341, sysfs, dev).empty())
+    {
+        std::cout << "FAIL: scan kept adapters without devices" << std::endl;
+        failures++;
+    }
+
+    std::filesystem::remove_all(root);
+    if (failures == 0)
+        std::cout << "All discovery tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
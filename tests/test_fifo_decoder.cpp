@@ -0,0 +1,100 @@
+#include "fifo_decoder.h"
+#include "banked_bus.h"
+#include <iostream>
+#include <vector>
+
+static sfe_ism_fifo_word_t word(uint8_t sensor, int16_t x, int16_t y = 0, int16_t z = 0)
+{
+    return {(uint8_t)(sensor << 3), {(uint8_t)x, (uint8_t)(x >> 8), (uint8_t)y, (uint8_t)(y >> 8), (uint8_t)z,
+                                     (uint8_t)(z >> 8)}};
+}
+
+int main()
+{
+    int failures = 0;
+
+    // Sensor field of the tags, see ism330dhcx_fifo_tag_t
+    const uint8_t gyro = 0x01, accel = 0x02, temp = 0x03, timestamp = 0x04, slave0 = 0x0E, slave2 = 0x10, nack = 0x19,
+                  compressed = 0x07;
+
+    // Accel at half the gyro rate, the magnetometer on slave 0 and a second
+    // sensor on slave 2 slower still; the drain splits the stream in two
+    std::vector<sfe_ism_fifo_word_t> first = {word(gyro, 1, 2, 3), word(accel, 100, -200, 1000), word(slave0, 0x1234, -5, 7),
+                                              word(temp, 256), word(gyro, 4, 5, 6), word(timestamp, 9)};
+    std::vector<sfe_ism_fifo_word_t> second = {word(accel, 101, -201, 1001), word(slave2, 42), word(gyro, 7, 8, 9),
+                                               word(nack, 0), word(compressed, 0),
+                                               word(gyro, -1, -2, -3)};
+
+    FifoDecoder decoder;
+    std::vector<FifoSample> samples;
+    size_t n = decoder.decode(first.data(), first.size(), &samples);
+    n += decoder.decode(second.data(), second.size(), &samples);
+
+    if (n != 4 || samples.size() != 4)
+    {
+        std::cout << "FAIL: " << samples.size() << " samples decoded, expected 4" << std::endl;
+        return 1;
+    }
+    if (samples[0].gyro.xData != 1 || samples[0].gyro.zData != 3 || samples[0].fresh != 0 ||
+        samples[1].gyro.yData != 5 || samples[1].accel.yData != -200 || samples[1].temp != 256 ||
+        samples[1].fresh != (FifoDecoder::kFreshAccel | FifoDecoder::kFreshTemp | FifoDecoder::kFreshHub0) ||
+        samples[1].hub[0][0] != 0x34 || samples[1].hub[0][1] != 0x12 || samples[1].hub[0][2] != 0xFB)
+    {
+        std::cout << "FAIL: first drain" << std::endl;
+        failures++;
+    }
+    if (samples[2].accel.zData != 1001 || samples[2].hub[0][0] != 0x34 || samples[2].hub[2][0] != 42 ||
+        samples[2].timestamp != 9 ||
+        samples[2].fresh != (FifoDecoder::kFreshAccel | FifoDecoder::kFreshTimestamp | FifoDecoder::kFreshHub0 << 2))
+    {
+        std::cout << "FAIL: state carried across drains" << std::endl;
+        failures++;
+    }
+    if (samples[3].gyro.xData != -1 || samples[3].fresh != 0 || samples[3].accel.xData != 101)
+    {
+        std::cout << "FAIL: sample without new accel" << std::endl;
+        failures++;
+    }
+    if (decoder.hubNacks() != 1 || decoder.skipped() != 1)
+    {
+        std::cout << "FAIL: " << decoder.hubNacks() << " NACKs and " << decoder.skipped() << " skipped words" << std::endl;
+        failures++;
+    }
+
+    // Two slaves batched at 26Hz
+    BankedBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    dev.init();
+    sfe_hub_sensor_settings_t sensors[] = {{0x60, 0x00, 6}, {0x3C, 0x28, 6}};
+    if (!dev.configureHub(sensors, 2, ISM_SH_ODR_26Hz))
+    {
+        std::cout << "FAIL: configureHub" << std::endl;
+        failures++;
+    }
+    // SLVx_ADD is the 8-bit address with the read bit set, SLVx_CONFIG holds the
+    // length in bits 2:0, the batch enable in bit 3 and (slave 0) the rate
+    if (bus.hub[ISM330DHCX_SLV0_ADD] != 0x61 || bus.hub[ISM330DHCX_SLV0_SUBADD] != 0x00 ||
+        bus.hub[ISM330DHCX_SLV0_CONFIG] != (ISM_SH_ODR_26Hz << 6 | 0x08 | 6) || bus.hub[ISM330DHCX_SLV0_ADD + 3] != 0x3D ||
+        bus.hub[ISM330DHCX_SLV0_SUBADD + 3] != 0x28 || bus.hub[ISM330DHCX_SLV1_CONFIG] != (0x08 | 6))
+    {
+        std::cout << "FAIL: slave registers" << std::endl;
+        failures++;
+    }
+    // MASTER_CONFIG: two sensors (aux_sens_on = 1), controller on
+    if ((bus.hub[ISM330DHCX_MASTER_CONFIG] & 0x07) != 0x05 || bus.bank() != 0)
+    {
+        std::cout << "FAIL: MASTER_CONFIG 0x" << std::hex << (int)bus.hub[ISM330DHCX_MASTER_CONFIG] << std::dec << std::endl;
+        failures++;
+    }
+    sfe_hub_sensor_settings_t tooLong = {0x60, 0x00, 7};
+    if (dev.configureHub(&tooLong, 1, ISM_SH_ODR_26Hz) || dev.configureHub(sensors, 5, ISM_SH_ODR_26Hz))
+    {
+        std::cout << "FAIL: bad hub configuration accepted" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All FIFO decoder tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
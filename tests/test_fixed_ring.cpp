@@ -0,0 +1,61 @@
+#include "fixed_ring.h"
+#include <iostream>
+
+int main()
+{
+    int failures = 0;
+
+    FixedRing<int> ring;
+    ring.push(1);
+    if (!ring.empty() || ring.dropped() != 1)
+    {
+        std::cout << "FAIL: push before reset" << std::endl;
+        failures++;
+    }
+
+    // In order until full, then the oldest go
+    ring.reset(4);
+    for (int i = 0; i < 3; i++)
+        ring.push(i);
+    if (ring.size() != 3 || ring.front() != 0 || ring.dropped() != 0)
+    {
+        std::cout << "FAIL: partial fill" << std::endl;
+        failures++;
+    }
+    ring.pop_front();
+    for (int i = 3; i < 9; i++)
+        ring.push(i);
+    std::vector<int> out = {-1};
+    ring.drainTo(&out);
+    if (out != std::vector<int>{-1, 5, 6, 7, 8} || !ring.empty() || ring.dropped() != 4 || ring.capacity() != 4)
+    {
+        std::cout << "FAIL: overwrite oldest" << std::endl;
+        failures++;
+    }
+
+    // Wraps around the end of its storage without losing order
+    for (int round = 0; round < 10; round++)
+    {
+        ring.push(round);
+        ring.push(round + 100);
+        if (ring.front() != round || ring[1] != round + 100 || ring.back() != round + 100)
+        {
+            std::cout << "FAIL: wrap round " << round << std::endl;
+            failures++;
+        }
+        ring.pop_front();
+        ring.pop_front();
+    }
+
+    ring.push(1);
+    ring.clear();
+    if (!ring.empty() || ring.dropped() != 4)
+    {
+        std::cout << "FAIL: clear" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All fixed ring tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include "fsm_monitor.h"
+#include "banked_bus.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+int main()
+{
+    int failures = 0;
+
+    BankedBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    dev.init();
+
+    // The first program crosses from page 4 into page 5
+    std::vector<uint8_t> first(300), second(40);
+    for (size_t i = 0; i < first.size(); i++)
+        first[i] = (uint8_t)(i * 7 + 1);
+    for (size_t i = 0; i < second.size(); i++)
+        second[i] = (uint8_t)(i * 13 + 5);
+    sfe_ism_fsm_program_t programs[] = {{first.data(), (uint16_t)first.size()},
+                                        {second.data(), (uint16_t)second.size()}};
+
+    bus.transactions = 0;
+    if (!dev.loadFsmPrograms(programs, 2, ISM_FSM_ODR_52Hz))
+    {
+        std::cout << "FAIL: loadFsmPrograms" << std::endl;
+        failures++;
+    }
+    const uint8_t *start = bus.pages + ISM330DHCX_FSM_START_ADDRESS;
+    const uint8_t config[] = {2, 2, 0x00, 0x04};
+    if (std::memcmp(bus.pages + ISM330DHCX_FSM_PROGRAMS, config, sizeof(config)) != 0 ||
+        std::memcmp(start, first.data(), first.size()) != 0 ||
+        std::memcmp(start + first.size(), second.data(), second.size()) != 0)
+    {
+        std::cout << "FAIL: program pages" << std::endl;
+        failures++;
+    }
+    if (bus.embedded[ISM330DHCX_FSM_ENABLE_A] != 0x03 || bus.embedded[ISM330DHCX_FSM_ENABLE_B] != 0 ||
+        !(bus.embedded[ISM330DHCX_EMB_FUNC_EN_B] & 0x01) ||
+        (bus.embedded[ISM330DHCX_EMB_FUNC_ODR_CFG_B] & 0x18) != (ISM_FSM_ODR_52Hz << 3))
+    {
+        std::cout << "FAIL: FSM not enabled" << std::endl;
+        failures++;
+    }
+    if (bus.bank() != 0 || bus.user[ISM330DHCX_CTRL3_C] != 0x04 || (bus.embedded[ISM330DHCX_PAGE_RW] & 0x60) != 0)
+    {
+        std::cout << "FAIL: bank, IF_INC or page mode not restored" << std::endl;
+        failures++;
+    }
+    size_t bytes = sizeof(config) + first.size() + second.size();
+    std::cout << bytes << " program bytes loaded in " << bus.transactions << " transactions" << std::endl;
+    if (bus.transactions > (int)bytes / 4)
+    {
+        std::cout << "FAIL: program bytes were not written in bursts" << std::endl;
+        failures++;
+    }
+
+    std::vector<uint8_t> large(4096 - ISM330DHCX_FSM_START_ADDRESS + 1);
+    sfe_ism_fsm_program_t overflowing = {large.data(), (uint16_t)large.size()};
+    if (dev.loadFsmPrograms(programs, 0, ISM_FSM_ODR_52Hz) || dev.loadFsmPrograms(programs, 17, ISM_FSM_ODR_52Hz) ||
+        dev.loadFsmPrograms(&overflowing, 1, ISM_FSM_ODR_52Hz))
+    {
+        std::cout << "FAIL: bad program set accepted" << std::endl;
+        failures++;
+    }
+
+    // Interrupt routing, programs 2 and 9
+    if (!dev.setFsmInt1(0x0102) || bus.embedded[ISM330DHCX_FSM_INT1_A] != 0x02 ||
+        bus.embedded[ISM330DHCX_FSM_INT1_B] != 0x01 || !(bus.user[ISM330DHCX_MD1_CFG] & 0x02) || bus.bank() != 0)
+    {
+        std::cout << "FAIL: setFsmInt1" << std::endl;
+        failures++;
+    }
+    if (!dev.setFsmInt1(0) || (bus.user[ISM330DHCX_MD1_CFG] & 0x02))
+    {
+        std::cout << "FAIL: setFsmInt1 did not unroute" << std::endl;
+        failures++;
+    }
+
+    // INT1_EMB_FUNC is shared with the MLC; unrouting the FSM keeps its trees
+    if (!dev.setMlcInt1(0x01) || !dev.setFsmInt1(0x0004) || !dev.setFsmInt1(0) ||
+        !(bus.user[ISM330DHCX_MD1_CFG] & 0x02) || bus.embedded[ISM330DHCX_MLC_INT1] != 0x01 || bus.bank() != 0)
+    {
+        std::cout << "FAIL: setFsmInt1(0) unrouted the MLC" << std::endl;
+        failures++;
+    }
+    if (!dev.setMlcInt1(0) || (bus.user[ISM330DHCX_MD1_CFG] & 0x02) || !dev.setFsmInt2(0x0001) ||
+        !dev.setMlcInt2(0) || !(bus.user[ISM330DHCX_MD2_CFG] & 0x02))
+    {
+        std::cout << "FAIL: shared embedded interrupt bit" << std::endl;
+        failures++;
+    }
+
+    // Program 2 raises its interrupt; program 3 is not monitored
+    FsmMonitor monitor(dev, 0x0003, 1);
+    monitor.begin();
+    std::vector<FsmEvent> events;
+    for (int i = 0; i < 10; i++)
+        monitor.poll(i, &events);
+    uint64_t idle = monitor.bytesRead();
+
+    bus.embedded[ISM330DHCX_FSM_OUTS1 + 1] = 0x40;
+    bus.embedded[ISM330DHCX_FSM_OUTS1 + 2] = 0x11;
+    bus.user[ISM330DHCX_FSM_STATUS_A_MAINPAGE] = 0x06;
+    monitor.poll(10, &events);
+    bus.user[ISM330DHCX_FSM_STATUS_A_MAINPAGE] = 0;
+    monitor.poll(11, &events);
+
+    if (events.size() != 1 || events[0].device != 1 || events[0].program != 1 || events[0].output != 0x40 ||
+        events[0].previous != 0 || events[0].timestamp != 10)
+    {
+        std::cout << "FAIL: FSM event" << std::endl;
+        failures++;
+    }
+    if (idle != 16 + 10 * 2)
+    {
+        std::cout << "FAIL: idle polls read " << idle << " bytes" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All FSM tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
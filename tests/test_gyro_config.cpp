@@ -0,0 +1,149 @@
+#include "gyro_config.h"
+#include <iostream>
+
+static const char *kExample = R"({
+    "buses": [
+        {"path": "/dev/i2c-16", "devices": ["0x6A", 107]},
+        {"path": "/dev/i2c-17", "devices": ["0x6b"]}
+    ],
+    "device": {
+        "accel": {"odr_hz": 104, "full_scale_g": 4},
+        "gyro": {"odr_hz": 833, "full_scale_dps": 500, "lp1": true, "lp1_bandwidth": "strong"}
+    },
+    "fifo": true,
+    "orientation": {"enabled": true, "beta": 0.05},
+    "activity": {"enabled": true, "wake_threshold": 4, "sleep_duration": 2},
+    "sinks": {
+        "csv": {"folder": "/tmp/run", "mode": "direct",
+                "rotation": {"max_mb": 64, "interval_s": 3600, "keep_segments": 24}},
+        "sample_bus": {"name": "/ism_samples", "capacity": 4096}
+    },
+    "realtime": {"policy": "fifo", "priority": 70, "cpus": [2, 3], "lock_memory": true},
+    "telemetry": {"address": "127.0.0.1:9464"}
+})";
+
+// Error for text, empty if it parsed
+static std::string errorOf(const std::string &text)
+{
+    GyroConfig config;
+    std::string error;
+    if (gyro_config::parse(text, &config, &error))
+        return "";
+    return error;
+}
+
+int main()
+{
+    int failures = 0;
+
+    GyroConfig config;
+    std::string error;
+    if (!gyro_config::parse(kExample, &config, &error))
+    {
+        std::cout << "FAIL: parse example: " << error << std::endl;
+        return 1;
+    }
+    if (config.buses.size() != 2 || config.buses[0].path != "/dev/i2c-16" ||
+        config.buses[0].addresses != std::vector<uint8_t>{0x6A, 0x6B} || config.buses[1].addresses.size() != 1 ||
+        gyro_config::topology(config).size() != 2)
+    {
+        std::cout << "FAIL: buses" << std::endl;
+        failures++;
+    }
+    if (!config.fifo || config.record_hz != 0 || !config.orientation || config.orientation_beta != 0.05f ||
+        config.calibration || !config.activity.enabled || config.activity.wake_threshold != 4 ||
+        config.activity.sleep_duration != 2)
+    {
+        std::cout << "FAIL: acquisition settings" << std::endl;
+        failures++;
+    }
+    if (config.log_folder != "/tmp/run" || config.log_mode != LogFileMode::Direct ||
+        config.log_rotation.max_bytes != 64ull << 20 || config.log_rotation.interval_us != 3600000000ll ||
+        !config.log_rotation.compress || config.log_rotation.keep_segments != 24 ||
+        config.sample_bus != "/ism_samples" || config.sample_bus_capacity != 4096)
+    {
+        std::cout << "FAIL: sinks" << std::endl;
+        failures++;
+    }
+    if (config.realtime.policy != RtPolicy::Fifo || config.realtime.priority != 70 ||
+        config.realtime.cpus != std::vector<int>{2, 3} || !config.realtime.lock_memory ||
+        config.telemetry != "127.0.0.1:9464")
+    {
+        std::cout << "FAIL: realtime and telemetry" << std::endl;
+        failures++;
+    }
+
+    // The device section becomes the same minimal plan as the equivalent
+    // compile-time profile
+    constexpr sfe_ism_profile_t kExpected = {
+        .accelDataRate = ISM_XL_ODR_104Hz,
+        .accelFullScale = ISM_4g,
+        .gyroDataRate = ISM_GY_ODR_833Hz,
+        .gyroFullScale = ISM_500dps,
+        .gyroFilterLP1 = true,
+        .gyroLP1Bandwidth = ISM_STRONG,
+    };
+    constexpr auto expected = sfe_ism_profile::registerPlan<kExpected>();
+    sfe_ism_reg_write_t plan[sfe_ism_profile::kImageLength];
+    size_t length = sfe_ism_profile::registerPlan(config.profile, plan);
+    bool same = length == expected.size();
+    for (size_t i = 0; same && i < length; i++)
+        same = plan[i].reg == expected[i].reg && plan[i].value == expected[i].value;
+    if (!same || plan[0].reg != ISM330DHCX_CTRL1_XL || plan[0].value != 0x48 || plan[1].value != 0x74)
+    {
+        std::cout << "FAIL: register plan" << std::endl;
+        failures++;
+    }
+
+    // Defaults: the GyroAPI profile, discovery, logging at the gyroscope rate
+    if (!gyro_config::parse("{}", &config) || !config.buses.empty() || config.discover != discovery::kCh341 ||
+        sfe_ism_profile::planLength(config.profile) != sfe_ism_profile::planLength(kGyroApiProfile) ||
+        config.log_folder != "logs")
+    {
+        std::cout << "FAIL: defaults" << std::endl;
+        failures++;
+    }
+
+    // Errors name the offending key
+    struct
+    {
+        const char *text;
+        const char *error;
+    } rejected[] = {
+        {R"({"fifo": true, "fifi": true})", "fifi: unknown key"},
+        {R"({"device": {"gyro": {"odr": 833}}})", "device.gyro.odr: unknown key"},
+        {R"({"device": {"gyro": {"odr_hz": 800}}})", "device.gyro.odr_hz: unsupported rate 800 Hz"},
+        {R"({"device": {"gyro": {"odr_hz": -5}}})", "device.gyro.odr_hz: negative rate -5 Hz"},
+        {R"({"device": {"accel": {"odr_hz": -104}}})", "device.accel.odr_hz: negative rate -104 Hz"},
+        {R"({"device": {"gyro": {"odr_hz": 0}}})",
+         "device.gyro.odr_hz: the gyroscope paces acquisition and cannot be off"},
+        {R"({"device": {"accel": {"full_scale_g": 6}}})", "device.accel.full_scale_g: unsupported full scale 6"},
+        {R"({"device": {"gyro": {"lp1_bandwidth": "hard"}}})",
+         "device.gyro.lp1_bandwidth: \"hard\" is not one of ultra_light, very_light, light, medium, strong, "
+         "very_strong, aggressive, xtreme"},
+        {R"({"buses": [{"path": "/dev/i2c-1", "devices": ["0x80"]}]})", "buses[0].devices: 128 is outside 8..119"},
+        {R"({"buses": [{"path": "/dev/i2c-1"}]})", "buses[0].devices: missing"},
+        {R"({"realtime": {"priority": "high"}})", "realtime.priority: invalid value \"high\""},
+        {R"({"fifo": "maybe"})", "fifo: invalid value \"maybe\""},
+    };
+    for (const auto &r : rejected)
+        if (errorOf(r.text) != r.error)
+        {
+            std::cout << "FAIL: " << r.text << " gave \"" << errorOf(r.text) << "\"" << std::endl;
+            failures++;
+        }
+    if (errorOf("{\"fifo\": }").compare(0, 7, "line 1:") != 0)
+    {
+        std::cout << "FAIL: syntax error" << std::endl;
+        failures++;
+    }
+    if (gyro_config::load("/nonexistent/gyro.json", &config, &error) || error != "cannot open /nonexistent/gyro.json")
+    {
+        std::cout << "FAIL: missing file" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All configuration tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
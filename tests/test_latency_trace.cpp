@@ -0,0 +1,106 @@
+#include "latency_trace.h"
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+int main()
+{
+    int failures = 0;
+
+    // Every bucket bound maps back to its bucket and buckets are contiguous
+    for (size_t b = 0; b < LatencyHistogram::kBuckets; b++)
+    {
+        if (LatencyHistogram::bucketOf(LatencyHistogram::bucketLow(b)) != b ||
+            LatencyHistogram::bucketOf(LatencyHistogram::bucketHigh(b)) != b ||
+            (b > 0 && LatencyHistogram::bucketLow(b) != LatencyHistogram::bucketHigh(b - 1) + 1))
+        {
+            std::cout << "FAIL: bucket " << b << std::endl;
+            failures++;
+            break;
+        }
+    }
+    if (LatencyHistogram::bucketHigh(LatencyHistogram::kBuckets - 1) != UINT64_MAX)
+    {
+        std::cout << "FAIL: buckets do not cover 64 bits" << std::endl;
+        failures++;
+    }
+
+    // Uniform 1..100000 ns: percentiles within the 12.5% bucket width
+    LatencyHistogram uniform;
+    for (uint64_t ns = 1; ns <= 100000; ns++)
+        uniform.record(ns);
+    for (double p : {50.0, 90.0, 99.0, 99.9})
+    {
+        double expected = p * 1000.0;
+        double got = (double)uniform.percentile(p);
+        if (got < expected || got > expected * 1.125)
+        {
+            std::cout << "FAIL: p" << p << " = " << got << " expected " << expected << std::endl;
+            failures++;
+        }
+    }
+    if (uniform.min() != 1 || uniform.max() != 100000 || std::fabs(uniform.mean() - 50000.5) > 1e-6)
+    {
+        std::cout << "FAIL: summary " << uniform.min() << " " << uniform.max() << " " << uniform.mean() << std::endl;
+        failures++;
+    }
+
+    // Recording from several threads, each on its own block, adds up exactly
+    const int threads = 4, per_thread = 100000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([t]
+                             {
+            for (int i = 0; i < per_thread; i++)
+            {
+                latency_trace::record(TraceOp::RegisterRead, 1000 * (t + 1));
+                latency_trace::count(TraceCounter::NotReady);
+            } });
+
+    // Queries race with the writers and must never see more than was recorded
+    uint64_t seen = latency_trace::histogram(TraceOp::RegisterRead).count();
+    for (auto &worker : workers)
+        worker.join();
+
+    LatencyHistogram reads = latency_trace::histogram(TraceOp::RegisterRead);
+    if (seen > (uint64_t)threads * per_thread || reads.count() != (uint64_t)threads * per_thread ||
+        reads.min() != 1000 || reads.max() != 4000 ||
+        latency_trace::counter(TraceCounter::NotReady) != (uint64_t)threads * per_thread)
+    {
+        std::cout << "FAIL: aggregate count " << reads.count() << " min " << reads.min() << " max " << reads.max()
+                  << std::endl;
+        failures++;
+    }
+
+    {
+        latency_trace::Scope scope(TraceOp::Sweep);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    LatencyHistogram sweep = latency_trace::histogram(TraceOp::Sweep);
+    if (sweep.count() != 1 || sweep.max() < 2000000)
+    {
+        std::cout << "FAIL: scope recorded " << sweep.max() << " ns" << std::endl;
+        failures++;
+    }
+
+    std::ostringstream dump;
+    latency_trace::dump(dump);
+    if (dump.str().find("register read") == std::string::npos || dump.str().find("not ready: 400000") == std::string::npos)
+    {
+        std::cout << "FAIL: dump\n" << dump.str();
+        failures++;
+    }
+
+    latency_trace::reset();
+    if (latency_trace::histogram(TraceOp::RegisterRead).count() != 0 || latency_trace::counter(TraceCounter::NotReady) != 0)
+    {
+        std::cout << "FAIL: reset" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All latency trace tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
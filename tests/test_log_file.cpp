@@ -0,0 +1,103 @@
+#include "log_file.h"
+#include "sample_log.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static std::string readFile(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static const char *modeName(LogFileMode mode)
+{
+    switch (mode)
+    {
+    case LogFileMode::Buffered:
+        return "buffered";
+    case LogFileMode::Mapped:
+        return "mapped";
+    case LogFileMode::Direct:
+        return "direct";
+    }
+    return "unknown";
+}
+
+int main()
+{
+    int failures = 0;
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "ism330dhcx_test_log_file.bin";
+
+    // Records of odd lengths crossing many 4 KiB windows and several extents
+    std::string expected;
+    for (int i = 0; expected.size() < 300000; i++)
+        expected += "record " + std::to_string(i) + std::string(i % 13, 'x') + "\n";
+
+    for (LogFileMode mode : {LogFileMode::Buffered, LogFileMode::Mapped, LogFileMode::Direct})
+    {
+        LogFile file;
+        if (!file.open(path, mode, 4096))
+        {
+            std::cout << "FAIL: " << modeName(mode) << " open" << std::endl;
+            failures++;
+            continue;
+        }
+
+        size_t half = expected.size() / 2 + 7;
+        file.write(expected.data(), half);
+
+        // Whatever was flushed must be readable while the file is open
+        file.flush();
+        if (readFile(path).compare(0, half, expected, 0, half) != 0)
+        {
+            std::cout << "FAIL: " << modeName(mode) << " contents after flush" << std::endl;
+            failures++;
+        }
+
+        // Moving an open file keeps writing where it left off
+        LogFile moved = std::move(file);
+        if (file.isOpen() || !moved.isOpen())
+        {
+            std::cout << "FAIL: " << modeName(mode) << " move" << std::endl;
+            failures++;
+        }
+        for (size_t i = half; i < expected.size(); i += 1000)
+            moved.write(expected.data() + i, std::min<size_t>(1000, expected.size() - i));
+        moved.close();
+
+        std::string contents = readFile(path);
+        if (contents != expected)
+        {
+            std::cout << "FAIL: " << modeName(mode) << " file has " << contents.size() << " bytes, expected "
+                      << expected.size() << (contents.size() == expected.size() ? " (contents differ)" : "")
+                      << std::endl;
+            failures++;
+        }
+    }
+
+    // CSV rows match the ostream formatting the log used to have
+    SampleLog log;
+    log.open(path, true);
+    SampleRecord sample = {1700000000123456, 123.25f, -45.5f, 0.000123f, 0, 0, 0, 25.0f, 1.0f, 0.0f, -0.5f, 1234567.0f};
+    log.write(sample);
+    log.writeGap(1700000000200000);
+    log.close();
+    std::string csv = readFile(path);
+    std::string row = "1700000000123456,123.25,-45.5,0.000123,1,0,-0.5,1.23457e+06,\n"
+                      "1700000000200000,nan,nan,nan,nan,nan,nan,nan,\n";
+    if (csv != "time (us),x (mdps),y (mdps),z(mdps),qw,qx,qy,qz\n" + row)
+    {
+        std::cout << "FAIL: CSV row " << csv << std::endl;
+        failures++;
+    }
+
+    std::filesystem::remove(path);
+    if (failures == 0)
+        std::cout << "All log file tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
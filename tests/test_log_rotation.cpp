@@ -0,0 +1,202 @@
+#include "log_rotation.h"
+#include "sample_log.h"
+#include <filesystem>
+#include <iterator>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef ISM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+static std::string readFile(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static SampleRecord sampleAt(int64_t timestamp)
+{
+    return {timestamp, (float)(timestamp % 1000), -45.5f, 6.125f, 12.0f, -20.0f, 1000.0f, 25.0f};
+}
+
+#ifdef ISM_HAVE_ZLIB
+// Whole file through zlib, as any gzip reader would see it
+static std::string gunzip(const std::filesystem::path &path)
+{
+    std::string out;
+    gzFile in = gzopen(path.c_str(), "rb");
+    char buffer[65536];
+    int n;
+    while ((n = gzread(in, buffer, sizeof(buffer))) > 0)
+        out.append(buffer, n);
+    gzclose(in);
+    return out;
+}
+
+// One gzip member starting at offset
+static std::string inflateMember(const std::string &file, uint64_t offset)
+{
+    z_stream stream = {};
+    inflateInit2(&stream, 15 + 16);
+    stream.next_in = (Bytef *)file.data() + offset;
+    stream.avail_in = (uInt)(file.size() - offset);
+
+    std::string out;
+    char buffer[65536];
+    int result;
+    do
+    {
+        stream.next_out = (Bytef *)buffer;
+        stream.avail_out = sizeof(buffer);
+        result = inflate(&stream, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+    } while (result == Z_OK);
+    inflateEnd(&stream);
+    return out;
+}
+#endif
+
+int main()
+{
+    int failures = 0;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "ism330dhcx_test_log_rotation";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::filesystem::path base = dir / "sensor0.csv";
+
+    // Size based rotation, one sample per 100 us
+    LogRotation rotation;
+    rotation.max_bytes = 200000;
+    SampleLog log;
+    log.open(base, false, LogFileMode::Mapped, rotation);
+    std::ostringstream expected;
+    const int kSamples = 40000;
+    for (int i = 0; i < kSamples; i++)
+        log.write(sampleAt(1000000 + i * 100));
+    uint64_t last = log.segment();
+    log.close();
+    log_segments::drain();
+
+    if (last < 3)
+    {
+        std::cout << "FAIL: only " << last + 1 << " segments written" << std::endl;
+        failures++;
+    }
+
+    // Every segment is closed, compressed (when built with zlib) and starts
+    // with the header; together they hold every sample in order
+    std::string rows;
+    size_t segments = 0;
+    for (uint64_t i = 0; i <= last; i++)
+    {
+        std::string text;
+#ifdef ISM_HAVE_ZLIB
+        std::filesystem::path gz = log_segments::segmentPath(base, i, true);
+        if (!std::filesystem::exists(gz) || std::filesystem::exists(log_segments::segmentPath(base, i)))
+        {
+            std::cout << "FAIL: segment " << i << " not compressed" << std::endl;
+            failures++;
+            continue;
+        }
+        text = gunzip(gz);
+#else
+        text = readFile(log_segments::segmentPath(base, i));
+#endif
+        const std::string header = "time (us),x (mdps),y (mdps),z(mdps)\n";
+        if (text.compare(0, header.size(), header) != 0)
+        {
+            std::cout << "FAIL: segment " << i << " header" << std::endl;
+            failures++;
+        }
+        if (i < last && text.size() < rotation.max_bytes)
+        {
+            std::cout << "FAIL: segment " << i << " rolled at " << text.size() << " bytes" << std::endl;
+            failures++;
+        }
+        rows += text.substr(header.size());
+        segments++;
+    }
+    if (std::filesystem::exists(log_segments::segmentPath(base, last + 1)))
+    {
+        std::cout << "FAIL: segment opened ahead was left behind" << std::endl;
+        failures++;
+    }
+
+    std::istringstream lines(rows);
+    std::string line;
+    int count = 0;
+    while (std::getline(lines, line))
+    {
+        if (line.compare(0, line.find(','), std::to_string(1000000 + count * 100)) != 0)
+        {
+            std::cout << "FAIL: row " << count << " is " << line << std::endl;
+            failures++;
+            break;
+        }
+        count++;
+    }
+    if (count != kSamples)
+    {
+        std::cout << "FAIL: " << count << " rows across " << segments << " segments" << std::endl;
+        failures++;
+    }
+
+#ifdef ISM_HAVE_ZLIB
+    // The index finds the block holding a timestamp, which inflates on its own
+    std::filesystem::path gz = log_segments::segmentPath(base, 1, true);
+    std::vector<SegmentIndexEntry> index;
+    if (!log_segments::readIndex(gz, &index) || index.size() < 2)
+    {
+        std::cout << "FAIL: segment index has " << index.size() << " entries" << std::endl;
+        failures++;
+    }
+    else
+    {
+        int64_t target = index[1].timestamp + 300;
+        const SegmentIndexEntry *entry = log_segments::find(index, target);
+        std::string block = inflateMember(readFile(gz), entry->offset);
+        std::string wanted = std::to_string(target) + ",";
+        if (entry != &index[1] || block.compare(0, std::to_string(entry->timestamp).size(), std::to_string(entry->timestamp)) != 0 ||
+            block.find("\n" + wanted) == std::string::npos)
+        {
+            std::cout << "FAIL: seek to " << target << std::endl;
+            failures++;
+        }
+    }
+#endif
+
+    // Time based rotation at 1 s boundaries with the oldest segments pruned;
+    // numbering continues after the segments already in the directory
+    rotation = LogRotation();
+    rotation.interval_us = 1000000;
+    rotation.keep_segments = 2;
+    log.open(base, true, LogFileMode::Buffered, rotation);
+    uint64_t first = log.segment();
+    for (int i = 0; i < 50; i++)
+        log.write(sampleAt(5000000 + i * 100000));
+    last = log.segment();
+    log.close();
+    log_segments::drain();
+
+    if (first != segments || last - first != 4)
+    {
+        std::cout << "FAIL: time rotation wrote segments " << first << " to " << last << std::endl;
+        failures++;
+    }
+    auto remaining = std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator());
+    if (remaining != 2)
+    {
+        std::cout << "FAIL: " << remaining << " segments left after pruning to 2" << std::endl;
+        failures++;
+    }
+
+    std::filesystem::remove_all(dir);
+    if (failures == 0)
+        std::cout << "All log rotation tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
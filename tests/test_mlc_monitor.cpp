@@ -0,0 +1,139 @@
+#include "mlc_monitor.h"
+#include "banked_bus.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Shaped like an ST export: sensors off, MLC program in two pages, MLC on
+static std::string exampleUcf()
+{
+    std::string text = "--ISM330DHCX vibration classification\n--\nAc 10 00\nAc 11 00\nAc 01 80\nAc 05 00\n"
+                       "Ac 17 40\nAc 02 11\nAc 08 EA\n";
+    char line[16];
+    for (int i = 0; i < 22; i++)
+    {
+        std::snprintf(line, sizeof(line), "Ac 09 %02X\n", (i * 7) & 0xFF);
+        text += line;
+    }
+    text += "Ac 02 21\nAc 08 00\n";
+    for (int i = 0; i < 300; i++)
+    {
+        std::snprintf(line, sizeof(line), "Ac 09 %02X\n", (i * 13 + 5) & 0xFF);
+        text += line;
+    }
+    text += "Ac 04 00\nAc 05 10\nAc 17 00\nAc 60 15\nAc 01 00\nAc 10 40\n";
+    return text;
+}
+
+int main()
+{
+    int failures = 0;
+
+    std::vector<sfe_ism_reg_write_t> writes;
+    std::string error;
+    if (!ucf::parse(exampleUcf(), &writes, &error) || writes.size() != 7 + 22 + 2 + 300 + 6)
+    {
+        std::cout << "FAIL: parse UCF: " << error << std::endl;
+        return 1;
+    }
+    if (ucf::parse("Ac 10 00\nWAIT 5\n", &writes, &error) || error != "WAIT 5")
+    {
+        std::cout << "FAIL: unknown UCF line accepted" << std::endl;
+        failures++;
+    }
+    ucf::parse(exampleUcf(), &writes);
+
+    // Replaying the UCF a write at a time gives the reference state
+    BankedBus reference;
+    for (const sfe_ism_reg_write_t &w : writes)
+        reference.writeRegisterRegion(0, w.reg, &w.value, 1);
+
+    BankedBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    dev.init();
+    bus.transactions = 0;
+    if (!dev.loadUcf(writes.data(), (uint32_t)writes.size()))
+    {
+        std::cout << "FAIL: loadUcf" << std::endl;
+        failures++;
+    }
+    if (std::memcmp(bus.pages, reference.pages, sizeof(bus.pages)) != 0 ||
+        std::memcmp(bus.embedded, reference.embedded, sizeof(bus.embedded)) != 0 ||
+        std::memcmp(bus.user, reference.user, sizeof(bus.user)) != 0)
+    {
+        std::cout << "FAIL: batched load differs from the UCF" << std::endl;
+        failures++;
+    }
+    std::cout << "UCF of " << writes.size() << " writes loaded in " << bus.transactions << " transactions"
+              << std::endl;
+    if (bus.transactions > (int)writes.size() / 4)
+    {
+        std::cout << "FAIL: page writes were not batched" << std::endl;
+        failures++;
+    }
+
+    std::vector<sfe_ism_reg_write_t> resetting = {{ISM330DHCX_CTRL3_C, 0x05}};
+    if (dev.loadUcf(resetting.data(), 1) || bus.user[ISM330DHCX_CTRL3_C] != 0x04)
+    {
+        std::cout << "FAIL: resetting UCF accepted" << std::endl;
+        failures++;
+    }
+
+    // Interrupt routing
+    if (!dev.setMlcInt1(0x05) || bus.embedded[ISM330DHCX_MLC_INT1] != 0x05 ||
+        !(bus.user[ISM330DHCX_MD1_CFG] & 0x02) || bus.bank() != 0)
+    {
+        std::cout << "FAIL: setMlcInt1" << std::endl;
+        failures++;
+    }
+    if (!dev.setMlcDataRate(ISM_MLC_ODR_104Hz) || !dev.setMlc(true))
+    {
+        std::cout << "FAIL: MLC setup" << std::endl;
+        failures++;
+    }
+
+    // Tree 1 goes from class 0 to class 4 with 100 words in the FIFO
+    MlcMonitor monitor(dev, 0x03, 16, 8);
+    monitor.begin();
+    std::vector<MlcEvent> events;
+    for (int i = 0; i < 10; i++)
+        monitor.poll(i, &events);
+    uint64_t idle = monitor.bytesRead();
+
+    for (uint8_t i = 0; i < 100; i++)
+        bus.fifo.push_back({0x08, i, 0, 0, 0, 0, 0});
+    bus.embedded[ISM330DHCX_MLC0_SRC] = 4;
+    bus.embedded[ISM330DHCX_MLC0_SRC + 2] = 9; // Tree 3 is not monitored
+    bus.user[ISM330DHCX_MLC_STATUS_MAINPAGE] = 0x05;
+    monitor.poll(10, &events);
+    bus.user[ISM330DHCX_MLC_STATUS_MAINPAGE] = 0;
+    for (uint8_t i = 100; i < 105; i++)
+        bus.fifo.push_back({0x08, i, 0, 0, 0, 0, 0});
+    monitor.poll(11, &events);
+    if (!events.empty())
+    {
+        std::cout << "FAIL: event completed before its post window" << std::endl;
+        failures++;
+    }
+    for (uint8_t i = 105; i < 120; i++)
+        bus.fifo.push_back({0x08, i, 0, 0, 0, 0, 0});
+    monitor.poll(12, &events);
+
+    if (events.size() != 1 || events[0].tree != 0 || events[0].output != 4 || events[0].previous != 0 ||
+        events[0].timestamp != 10 || events[0].window.size() != 24 || events[0].window.front().data[0] != 84 ||
+        events[0].window.back().data[0] != 107)
+    {
+        std::cout << "FAIL: event window" << std::endl;
+        failures++;
+    }
+    if (idle > 8 + 2 + 10)
+    {
+        std::cout << "FAIL: idle polls read " << idle << " bytes" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All MLC tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+#include "orientation_filter.h"
+#include <cmath>
+#include <iostream>
+
+int main()
+{
+    int failures = 0;
+    const size_t devices = 8;
+    const float dt = 1.0f / 1000.0f;
+    OrientationFilter filter(devices, 0.1f);
+
+    // Device i spins about z at 10*(i+1) dps, level, for one second.
+    // Device 7 gets no input at all and must stay at identity.
+    for (int step = 0; step < 1000; step++)
+    {
+        for (size_t i = 0; i + 1 < devices; i++)
+        {
+            SampleRecord sample = {0, 0.0f, 0.0f, 10000.0f * (i + 1), 0.0f, 0.0f, 1000.0f, 25.0f};
+            filter.setInput(i, sample, dt);
+        }
+        filter.update();
+    }
+
+    for (size_t i = 0; i < devices; i++)
+    {
+        SampleRecord out = {};
+        filter.getQuaternion(i, &out);
+        float expected = i + 1 < devices ? 10.0f * (i + 1) : 0.0f;
+        float yaw = 2.0f * std::atan2(out.qz, out.qw) * 180.0f / 3.14159265f;
+        float norm = out.qw * out.qw + out.qx * out.qx + out.qy * out.qy + out.qz * out.qz;
+        if (std::fabs(yaw - expected) > 0.5f || std::fabs(norm - 1.0f) > 1e-4f)
+        {
+            std::cout << "FAIL: device " << i << " yaw " << yaw << " expected " << expected << std::endl;
+            failures++;
+        }
+    }
+
+    // A tilted, stationary sensor converges to the tilt seen by the accelerometer
+    OrientationFilter tilt(1, 0.5f);
+    const float angle = 30.0f * 3.14159265f / 180.0f;
+    for (int step = 0; step < 20000; step++)
+    {
+        SampleRecord sample = {0, 0.0f, 0.0f, 0.0f, 0.0f, 1000.0f * std::sin(angle), 1000.0f * std::cos(angle), 25.0f};
+        tilt.setInput(0, sample, dt);
+        tilt.update();
+    }
+    SampleRecord out = {};
+    tilt.getQuaternion(0, &out);
+    float roll = std::atan2(2.0f * (out.qw * out.qx + out.qy * out.qz), 1.0f - 2.0f * (out.qx * out.qx + out.qy * out.qy));
+    if (std::fabs(std::fabs(roll) - angle) > 0.01f)
+    {
+        std::cout << "FAIL: roll " << roll << " expected " << angle << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "Orientation filter test passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
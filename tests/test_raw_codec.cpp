@@ -0,0 +1,144 @@
+#include "raw_codec.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+static bool same(const std::vector<sfe_ism_raw_data_t> &a, const std::vector<sfe_ism_raw_data_t> &b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+        if (a[i].xData != b[i].xData || a[i].yData != b[i].yData || a[i].zData != b[i].zData)
+            return false;
+    return true;
+}
+
+int main()
+{
+    int failures = 0;
+    std::mt19937 rng(7);
+
+    // Gyro at 6.66 kHz: a slow motion plus 2 LSB rms of noise
+    std::normal_distribution<double> noise(0.0, 2.0);
+    std::vector<sfe_ism_raw_data_t> samples;
+    for (int i = 0; i < 20000; i++)
+    {
+        double t = i / 6660.0;
+        samples.push_back({(int16_t)std::lround(2000 * std::sin(2 * t) + noise(rng)),
+                           (int16_t)std::lround(-150 + 800 * std::sin(0.7 * t) + noise(rng)),
+                           (int16_t)std::lround(30 + noise(rng))});
+    }
+
+    std::vector<uint8_t> encoded;
+    raw_codec::encode(samples.data(), samples.size(), &encoded);
+    std::vector<sfe_ism_raw_data_t> decoded;
+    if (!raw_codec::decode(encoded.data(), encoded.size(), &decoded) || !same(samples, decoded))
+    {
+        std::cout << "FAIL: round trip" << std::endl;
+        failures++;
+    }
+
+    double ratio = (double)(samples.size() * sizeof(sfe_ism_raw_data_t)) / encoded.size();
+    std::cout << "Compression ratio " << ratio << std::endl;
+    if (ratio < 3.0)
+    {
+        std::cout << "FAIL: compression ratio below 3" << std::endl;
+        failures++;
+    }
+
+    // Full-scale swings need 17-bit deltas; short and single-sample blocks
+    for (size_t count : {1, 2, 33, 255, 256, 257, 1000})
+    {
+        std::vector<sfe_ism_raw_data_t> extreme;
+        for (size_t i = 0; i < count; i++)
+        {
+            int16_t v = (int16_t)(i % 2 ? 32767 : -32768);
+            extreme.push_back({v, (int16_t)-v, (int16_t)rng()});
+        }
+        std::vector<uint8_t> bytes;
+        raw_codec::encode(extreme.data(), extreme.size(), &bytes);
+        std::vector<sfe_ism_raw_data_t> back;
+        if (!raw_codec::decode(bytes.data(), bytes.size(), &back) || !same(extreme, back))
+        {
+            std::cout << "FAIL: round trip of " << count << " extreme samples" << std::endl;
+            failures++;
+        }
+        if (bytes.size() > raw_codec::maxBlockSize(raw_codec::kBlockSamples) * ((count + 255) / 256))
+        {
+            std::cout << "FAIL: block larger than maxBlockSize" << std::endl;
+            failures++;
+        }
+    }
+
+    // Random access: decode only the block holding sample 12345
+    std::vector<size_t> offsets;
+    if (!raw_codec::indexBlocks(encoded.data(), encoded.size(), &offsets) ||
+        offsets.size() != (samples.size() + raw_codec::kBlockSamples - 1) / raw_codec::kBlockSamples)
+    {
+        std::cout << "FAIL: block index" << std::endl;
+        failures++;
+    }
+    else
+    {
+        const size_t wanted = 12345;
+        size_t offset = offsets[wanted / raw_codec::kBlockSamples];
+        sfe_ism_raw_data_t block[raw_codec::kBlockSamples];
+        size_t count = 0;
+        raw_codec::decodeBlock(encoded.data() + offset, encoded.size() - offset, block, &count);
+        const sfe_ism_raw_data_t &s = block[wanted % raw_codec::kBlockSamples];
+        if (count != raw_codec::kBlockSamples || s.xData != samples[wanted].xData ||
+            s.zData != samples[wanted].zData)
+        {
+            std::cout << "FAIL: random access" << std::endl;
+            failures++;
+        }
+    }
+
+    // Streaming, with the bytes arriving in odd-sized pieces
+    RawStreamEncoder encoder;
+    size_t blocks = 0;
+    for (size_t i = 0; i < 1000; i++)
+        blocks += encoder.add(samples[i]);
+    blocks += encoder.flush();
+    if (blocks != 4)
+    {
+        std::cout << "FAIL: encoder produced " << blocks << " blocks" << std::endl;
+        failures++;
+    }
+
+    RawStreamDecoder decoder;
+    std::vector<sfe_ism_raw_data_t> streamed;
+    const std::vector<uint8_t> &wire = encoder.output();
+    for (size_t i = 0; i < wire.size(); i += 37)
+        if (!decoder.feed(wire.data() + i, std::min<size_t>(37, wire.size() - i), &streamed))
+        {
+            std::cout << "FAIL: stream decoder rejected valid data" << std::endl;
+            failures++;
+        }
+    if (decoder.buffered() != 0 || !same(streamed, std::vector<sfe_ism_raw_data_t>(samples.begin(), samples.begin() + 1000)))
+    {
+        std::cout << "FAIL: streamed samples" << std::endl;
+        failures++;
+    }
+
+    // Corruption is reported, not decoded
+    std::vector<uint8_t> corrupt = encoded;
+    corrupt[0] ^= 0xFF;
+    std::vector<sfe_ism_raw_data_t> ignored;
+    if (raw_codec::decode(corrupt.data(), corrupt.size(), &ignored) ||
+        decoder.feed(corrupt.data(), corrupt.size(), &ignored))
+    {
+        std::cout << "FAIL: corrupt block accepted" << std::endl;
+        failures++;
+    }
+    if (raw_codec::blockSize(encoded.data(), 5) != 0)
+    {
+        std::cout << "FAIL: truncated block accepted" << std::endl;
+        failures++;
+    }
+
+    if (failures == 0)
+        std::cout << "All raw codec tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
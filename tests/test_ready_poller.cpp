@@ -0,0 +1,98 @@
+#include "ready_poller.h"
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+// Device whose data-ready flag rises every period_ns from phase_ns on and is
+// cleared by reading the data
+struct SimulatedDevice
+{
+    double period_ns;
+    double phase_ns;
+    int64_t consumed = -1;
+
+    int64_t edgesBefore(int64_t t) const { return (int64_t)std::floor((t - phase_ns) / period_ns); }
+
+    bool poll(int64_t t)
+    {
+        int64_t latest = edgesBefore(t);
+        if (latest <= consumed)
+            return false;
+        consumed = latest;
+        return true;
+    }
+};
+
+static int run(const char *label, double nominal, double actual, double phase, int64_t bus_ns, bool check_lock)
+{
+    int failures = 0;
+    SimulatedDevice device{actual, phase};
+    ReadyPoller poller(nominal);
+
+    const int64_t duration = (int64_t)(4000 * actual);
+    int64_t t = 0;
+    uint64_t reads = 0;
+    double latency = 0.0;
+    while (t < duration)
+    {
+        t = std::max(t, poller.nextPoll());
+        bool ready = device.poll(t);
+        poller.observe(t, ready);
+        if (ready)
+        {
+            reads++;
+            latency += t - (device.phase_ns + device.consumed * device.period_ns);
+        }
+        t += bus_ns;
+    }
+
+    uint64_t edges = device.edgesBefore(duration) + 1;
+    double wasted = (double)poller.notReady() / poller.polls();
+    double period_error = std::fabs(poller.period() - actual) / actual;
+
+    std::cout << label << ": " << reads << "/" << edges << " samples, " << poller.notReady() << " of " << poller.polls()
+              << " polls not ready, period " << poller.period() << " ns, mean latency " << latency / reads << " ns"
+              << std::endl;
+
+    if (check_lock && (!poller.locked() || period_error > 1e-4 || wasted > 0.05 || reads + 2 < edges ||
+                       latency / reads > actual / 4))
+    {
+        std::cout << "FAIL: " << label << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // Oscillator 1.3% slow, fast bus: locks on the true period
+    failures += run("6667 Hz, fast bus", 1e9 / 6667, 1.013e9 / 6667, 37000, 2000, true);
+
+    // Oscillator 1.5% fast at 104 Hz
+    failures += run("104 Hz", 1e9 / 104, 0.985e9 / 104, 4100000, 200000, true);
+
+    // Bus slower than the output rate: cannot bracket, degrades to polling
+    // back to back and still reads a sample on every poll
+    {
+        SimulatedDevice device{1e9 / 6667, 0};
+        ReadyPoller poller(1e9 / 6667);
+        int64_t t = 0;
+        for (int i = 0; i < 1000; i++)
+        {
+            t = std::max(t, poller.nextPoll());
+            poller.observe(t, device.poll(t));
+            t += 1000000;
+        }
+        if (poller.notReady() > 1)
+        {
+            std::cout << "FAIL: slow bus " << poller.notReady() << " not ready" << std::endl;
+            failures++;
+        }
+    }
+
+    if (failures == 0)
+        std::cout << "All ready poller tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include "rt_thread.h"
+#include <iostream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <thread>
+
+int main()
+{
+    int failures = 0;
+
+    // Nothing requested: nothing to be refused
+    std::thread([&]()
+                {
+        RtThreadReport report = rt_thread::apply(RtThreadConfig());
+        if (!report.granted() || !report.notes.empty())
+        {
+            std::cout << "FAIL: default config reported " << report << std::endl;
+            failures++;
+        } })
+        .join();
+
+    // Pinning to a CPU we are allowed on is always granted
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    int cpu = 0;
+    while (!CPU_ISSET(cpu, &allowed))
+        cpu++;
+
+    std::thread([&]()
+                {
+        RtThreadConfig config;
+        config.cpus = {cpu};
+        RtThreadReport report = rt_thread::apply(config);
+        if (!report.affinity || sched_getcpu() != cpu)
+        {
+            std::cout << "FAIL: not pinned to CPU " << cpu << ": " << report << std::endl;
+            failures++;
+        } })
+        .join();
+
+    // Real-time policy and memory locking depend on privileges; the report
+    // must match what the kernel says either way
+    std::thread([&]()
+                {
+        RtThreadConfig config;
+        config.policy = RtPolicy::Fifo;
+        config.priority = 10;
+        config.lock_memory = true;
+        RtThreadReport report = rt_thread::apply(config);
+        std::cout << "SCHED_FIFO + mlockall: " << report << std::endl;
+
+        int policy;
+        sched_param param;
+        pthread_getschedparam(pthread_self(), &policy, &param);
+        if (report.scheduling != (policy == SCHED_FIFO && param.sched_priority == 10))
+        {
+            std::cout << "FAIL: scheduling report does not match the thread" << std::endl;
+            failures++;
+        }
+        if (report.granted() != report.notes.empty() && report.future_locked)
+        {
+            std::cout << "FAIL: refusals without notes" << std::endl;
+            failures++;
+        }
+        munlockall(); })
+        .join();
+
+    if (failures == 0)
+        std::cout << "All real-time thread tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+#include "sample_bus.h"
+#include <iostream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main()
+{
+    const std::string name = "/ism330dhcx_test_bus_" + std::to_string(getpid());
+    const uint64_t total = 100000;
+
+    SampleBus bus;
+    if (!bus.create(name.c_str(), 2, 1000))
+    {
+        std::cout << "FAIL: create" << std::endl;
+        return 1;
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        // Reader process: follow device 1 until the last sample arrives
+        SampleBusReader reader;
+        if (!reader.attach(name.c_str()) || reader.numDevices() != 2 || reader.capacity() != 1024)
+            _exit(2);
+
+        uint64_t next = 0, received = 0, errors = 0;
+        while (next < total)
+        {
+            uint32_t sequence = reader.sequence();
+            uint64_t head = reader.head(1);
+            if (next < reader.oldest(1))
+                next = reader.oldest(1); // lapped, skip ahead
+            for (; next < head; next++)
+            {
+                SampleRecord sample;
+                if (!reader.read(1, next, &sample))
+                    continue;
+                if (sample.timestamp != (int64_t)next || sample.gz != (float)next)
+                    errors++;
+                received++;
+            }
+            if (next < total)
+                reader.wait(sequence, 100000);
+        }
+        std::cout << "Reader received " << received << " of " << total << " samples" << std::endl;
+        _exit(errors == 0 && received > 0 ? 0 : 3);
+    }
+
+    for (uint64_t i = 0; i < total; i++)
+    {
+        bus.publish(0, {(int64_t)i, 0, 0, 0, 0, 0, 0, 0});
+        bus.publish(1, {(int64_t)i, 0, 0, (float)i, 0, 0, 0, 0});
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    bus.close();
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::cout << "FAIL: reader exited with " << WEXITSTATUS(status) << std::endl;
+        return 1;
+    }
+
+    SampleBusReader gone;
+    if (gone.attach(name.c_str()))
+    {
+        std::cout << "FAIL: bus still exists after close" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Sample bus test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "telemetry.h"
+#include "banked_bus.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Everything a client of the socket at path receives after sending request
+static std::string fetch(const std::string &path, const std::string &request)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return "";
+    }
+    if (!request.empty() && send(fd, request.data(), request.size(), 0) != (ssize_t)request.size())
+        return "";
+
+    std::string response;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        response.append(buffer, (size_t)n);
+    close(fd);
+    return response;
+}
+
+static bool contains(const std::string &text, const std::string &line)
+{
+    return text.find(line) != std::string::npos;
+}
+
+int main()
+{
+    int failures = 0;
+
+    // Counters: a 1 ms stream with two samples missing, then a restart
+    Telemetry telemetry;
+    telemetry.reset(2);
+    telemetry.setInterval(0, 1000.0);
+    for (int64_t t : {1000, 2000, 3000, 6000, 7100, 500000, 501000})
+    {
+        if (t == 500000)
+            telemetry.restart(0);
+        telemetry.sample(0, t);
+    }
+    for (uint64_t ns = 1000; ns <= 100000; ns += 1000)
+        telemetry.latency(0, ns);
+    telemetry.notReady(0);
+    telemetry.fifo(1, 300, true);
+    telemetry.fifo(1, 12, false);
+    telemetry.busErrors(1, 3);
+    telemetry.fault(1);
+
+    DeviceMetrics first = telemetry.snapshot(0), second = telemetry.snapshot(1);
+    if (first.samples != 7 || first.dropped != 2 || first.not_ready != 1 || !first.online ||
+        first.latency.count() != 100 || first.latency.percentile(50) < 50000 || first.latency.percentile(50) > 57000)
+    {
+        std::cout << "FAIL: device 0 counters" << std::endl;
+        failures++;
+    }
+    if (second.online || second.faults != 1 || second.bus_errors != 3 || second.fifo_level != 12 ||
+        second.fifo_overruns != 1 || second.samples != 0)
+    {
+        std::cout << "FAIL: device 1 counters" << std::endl;
+        failures++;
+    }
+
+    std::ostringstream page;
+    telemetry::writePrometheus(page, {first, second}, {"device=\"0\"", "device=\"1\",address=\"0x6b\""});
+    for (const char *line : {"# TYPE ism330dhcx_samples_total counter\n", "ism330dhcx_samples_total{device=\"0\"} 7\n",
+                             "ism330dhcx_dropped_samples_total{device=\"0\"} 2\n",
+                             "ism330dhcx_up{device=\"1\",address=\"0x6b\"} 0\n",
+                             "ism330dhcx_fifo_overruns_total{device=\"1\",address=\"0x6b\"} 1\n",
+                             "ism330dhcx_read_latency_seconds_count{device=\"0\"} 100\n",
+                             "ism330dhcx_read_latency_seconds{device=\"0\",quantile=\"0.99\"}"})
+        if (!contains(page.str(), line))
+        {
+            std::cout << "FAIL: exposition lacks " << line << std::endl;
+            failures++;
+        }
+
+    // The driver reads the overrun flag with the level, in one transaction
+    BankedBus bus;
+    QwDevISM330DHCX dev;
+    dev.setCommunicationBus(bus, ISM330DHCX_ADDRESS_HIGH);
+    dev.init();
+    for (uint8_t i = 0; i < 5; i++)
+        bus.fifo.push_back({0x08, i, 0, 0, 0, 0, 0});
+    bus.overrun = true;
+    bus.transactions = 0;
+    sfe_ism_fifo_word_t words[16];
+    bool overrun = false;
+    if (dev.readFifo(words, 16, &overrun) != 5 || !overrun || bus.transactions != 2)
+    {
+        std::cout << "FAIL: FIFO status burst" << std::endl;
+        failures++;
+    }
+
+    // Served over a Unix socket while a writer keeps counting
+    const std::string path = "/tmp/ism330dhcx_test_telemetry_" + std::to_string(getpid()) + ".sock";
+    TelemetryServer server;
+    // A socket left by an earlier run is replaced
+    {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+        bind(stale, (sockaddr *)&addr, sizeof(addr));
+        close(stale);
+    }
+    if (!server.start(path, telemetry, {"device=\"0\"", "device=\"1\""}, 20))
+    {
+        std::cout << "FAIL: server start" << std::endl;
+        return 1;
+    }
+    auto stop = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+    int64_t t = 1000000;
+    while (std::chrono::steady_clock::now() < stop)
+    {
+        telemetry.sample(0, t += 1000);
+        usleep(100);
+    }
+
+    std::string http = fetch(path, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    std::string plain = fetch(path, "");
+    if (http.compare(0, 15, "HTTP/1.0 200 OK") != 0 || !contains(http, "\r\n\r\n# HELP ism330dhcx_up") ||
+        !contains(http, "ism330dhcx_samples_total{device=\"0\"}"))
+    {
+        std::cout << "FAIL: HTTP scrape" << std::endl;
+        failures++;
+    }
+    if (plain.compare(0, 16, "# HELP ism330dhc") != 0)
+    {
+        std::cout << "FAIL: plain read" << std::endl;
+        failures++;
+    }
+    std::string rate = "ism330dhcx_sample_rate_hz{device=\"0\"} ";
+    size_t at = http.find(rate);
+    if (at == std::string::npos || std::atof(http.c_str() + at + rate.size()) <= 0.0)
+    {
+        std::cout << "FAIL: sample rate" << std::endl;
+        failures++;
+    }
+
+    server.stop();
+    if (server.running() || access(path.c_str(), F_OK) == 0)
+    {
+        std::cout << "FAIL: server stop" << std::endl;
+        failures++;
+    }
+
+    // Anything but a socket at the path is refused and left in place
+    FILE *file = std::fopen(path.c_str(), "w");
+    std::fputs("keep", file);
+    std::fclose(file);
+    if (server.start(path, telemetry, {"device=\"0\"", "device=\"1\""}, 20) || access(path.c_str(), F_OK) != 0)
+    {
+        std::cout << "FAIL: non-socket path replaced" << std::endl;
+        failures++;
+    }
+    std::remove(path.c_str());
+
+    if (failures == 0)
+        std::cout << "All telemetry tests passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}